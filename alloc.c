@@ -0,0 +1,21 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alloc.h"
+
+static void out_of_memory() {
+    fprintf(stderr, "Fatal: Out of memory.\n");
+    exit(1);
+}
+
+void* checked_calloc(size_t count, size_t size) {
+    void *mem = calloc(count ? count : 1, size);
+    if (!mem) out_of_memory();
+    return mem;
+}
+
+void* checked_realloc(void *ptr, size_t count, size_t size) {
+    void *mem = realloc(ptr, (count ? count : 1) * size);
+    if (!mem) out_of_memory();
+    return mem;
+}
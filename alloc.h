@@ -0,0 +1,18 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+
+/*
+ * Checked allocation. Running out of memory is fatal: these report it and
+ * exit(1) rather than return NULL, so callers never test the result.
+ */
+
+// Returns 'count' zeroed elements of 'size' bytes. A count of 0 still
+// allocates one element, so the result is never NULL.
+void* checked_calloc(size_t count, size_t size);
+
+// Resizes 'ptr' (NULL for a new array) to 'count' elements of 'size' bytes.
+void* checked_realloc(void *ptr, size_t count, size_t size);
+
+#endif // ALLOC_H
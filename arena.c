@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "alloc.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT (sizeof(((ArenaBlock*) 0)->data[0]))
+
+void arena_init(Arena *arena) {
+    arena->head = NULL;
+    arena->bytes_used = 0;
+}
+
+static ArenaBlock* new_block(size_t size) {
+    ArenaBlock *block = (ArenaBlock*) checked_realloc(NULL, 1, sizeof(ArenaBlock) + size);
+    block->used = 0;
+    block->size = size;
+    block->next = NULL;
+    return block;
+}
+
+void* arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+    arena->bytes_used += size;
+
+    if (size > ARENA_BLOCK_SIZE / 4) {
+        // Large requests get a block of their own, linked behind the current
+        // one so the space left in the current block is not wasted.
+        ArenaBlock *block = new_block(size);
+        block->used = size;
+        if (arena->head) {
+            block->next = arena->head->next;
+            arena->head->next = block;
+        } else {
+            arena->head = block;
+        }
+        return block->data;
+    }
+
+    ArenaBlock *block = arena->head;
+    if (!block || block->used + size > block->size) {
+        block = new_block(ARENA_BLOCK_SIZE);
+        block->next = arena->head;
+        arena->head = block;
+    }
+    void *mem = (char*) block->data + block->used;
+    block->used += size;
+    return mem;
+}
+
+void* arena_calloc(Arena *arena, size_t size) {
+    void *mem = arena_alloc(arena, size);
+    memset(mem, 0, size);
+    return mem;
+}
+
+void arena_free(Arena *arena) {
+    ArenaBlock *block = arena->head;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->bytes_used = 0;
+}
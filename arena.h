@@ -0,0 +1,37 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * A region allocator. Allocations are carved sequentially out of large blocks,
+ * so objects created together end up next to each other in memory, and the
+ * whole region is released at once instead of object by object.
+ */
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used;
+    size_t size;
+    // Keep the payload aligned for any object stored in it.
+    union { long double ld; void *p; long long ll; } data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;     // Block currently being filled
+    size_t bytes_used;    // Total bytes handed out (for statistics)
+} Arena;
+
+// Initializes an empty arena. A zero-filled Arena is also valid.
+void arena_init(Arena *arena);
+
+// Returns 'size' bytes of suitably aligned, uninitialized memory.
+void* arena_alloc(Arena *arena, size_t size);
+
+// Same as arena_alloc, but the memory is zero-filled.
+void* arena_calloc(Arena *arena, size_t size);
+
+// Releases every allocation made from the arena at once.
+void arena_free(Arena *arena);
+
+#endif // ARENA_H
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "ir.h"           // The IR module being optimized
+#include "ir_reader.h"    // Textual 3AC input
+#include "ir_binary.h"    // Binary 3AC input and output
+#include "driver.h"       // Options, pipeline and output shared with the compiler
+#include "string_pool.h"  // Interned identifiers and literals
+
+/*
+ * c99-opt: runs the optimizer on 3AC saved by the compiler, without the
+ * front end. The input is a .3ac file or a binary file from --binary; the
+ * result is written back as text, and optionally as binary.
+ */
+
+// Returns 1 if the file starts with the binary 3AC magic number.
+static int is_binary_ir(const char *filename) {
+    FILE *fp = fopen(filename, "rb");
+    uint32_t magic = 0;
+    if (!fp) return 0;
+    int binary = fread(&magic, sizeof(magic), 1, fp) == 1 && magic == IR_BINARY_MAGIC;
+    fclose(fp);
+    return binary;
+}
+
+static int load_input(const char *filename) {
+    if (!is_binary_ir(filename)) return read_ir_file(filename);
+    IRBinaryView view;
+    if (open_ir_binary(filename, &view) != 0) return -1;
+    load_ir_binary(&view);
+    close_ir_binary(&view);
+    return 0;
+}
+
+// Passes and frame layout track temporaries, which register allocation
+// has replaced.
+static int is_register_allocated(const IRFunction *fn) {
+    for (int i = 0; i < fn->num_instrs; i++) {
+        const Instruction *instr = &fn->instrs[i];
+        if (instr->result.type == OP_REGISTER || instr->arg1.type == OP_REGISTER ||
+            instr->arg2.type == OP_REGISTER) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Returns the module's stack slots to the heap, as the IR generator made
+// them, so that the passes see the same IR as in the compiler and the frames
+// are laid out again afterwards.
+static void undo_frame_layout(IRFunction *fn) {
+    for (int i = 0; i < fn->num_instrs; i++) {
+        Instruction *instr = &fn->instrs[i];
+        if (instr->opcode == IR_ALLOC_STACK) {
+            instr->opcode = IR_ALLOC_HEAP;
+            instr->arg2 = create_operand_none();
+        }
+    }
+    fn->frame_size = 0;
+}
+
+int main(int argc, char **argv) {
+    DriverOptions options = { NULL, NULL, 0 };
+    if (driver_list_passes(argc, argv)) return 0;
+    for (int i = 2; i < argc; i++) {
+        int parsed = parse_driver_option(argv[i], &options);
+        if (parsed < 0) return 1;
+        if (parsed == 0) {
+            fprintf(stderr, "Unknown option '%s'.\n", argv[i]);
+            return 1;
+        }
+    }
+    if (argc < 2 || (!options.destination && !options.binary_file)) {
+        fprintf(stderr, "Usage: %s <input.3ac> <output.3ac> [-O<level>] [--passes=a,b,...] [--inline-budget=N] [--registers=K] [--binary=file.3acb] [--list-passes]\n", argv[0]);
+        return 1;
+    }
+
+    if (load_input(argv[1]) != 0) {
+        free_ir_module();
+        free_string_pool();
+        return 1;
+    }
+    for (int i = -1; i < ir_module.num_functions; i++) {
+        if (is_register_allocated(i < 0 ? &ir_module.globals : &ir_module.functions[i])) {
+            fprintf(stderr, "Error: %s is already register-allocated; save the IR without --registers.\n", argv[1]);
+            free_ir_module();
+            free_string_pool();
+            return 1;
+        }
+    }
+    for (int i = 0; i < ir_module.num_functions; i++) undo_frame_layout(&ir_module.functions[i]);
+
+    optimize_module(&ir_module);
+    if (options.num_registers > 0) allocate_module_registers(&ir_module, options.num_registers);
+    int status = write_module(&ir_module, &options);
+    free_ir_module();
+    free_string_pool();
+    return status;
+}
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "callgraph.h"
+#include "cfg.h"
+#include "alloc.h"
+
+static void add_callee(CallGraphNode *node, int callee) {
+    if (node->num_callees == node->callees_capacity) {
+        node->callees_capacity = node->callees_capacity ? node->callees_capacity * 2 : 4;
+        node->callees = (int*) checked_realloc(node->callees, node->callees_capacity, sizeof(int));
+    }
+    node->callees[node->num_callees++] = callee;
+}
+
+static void scan_calls(CallGraph *graph, int caller, const Instruction *instrs, int count, const int *function_of) {
+    for (int i = 0; i < count; i++) {
+        if (instrs[i].opcode != IR_CALL && instrs[i].opcode != IR_TAILCALL) continue;
+        int callee = function_of[instrs[i].arg1.val.name];
+        if (callee < 0) continue;
+        add_callee(&graph->nodes[caller], callee);
+        graph->nodes[callee].num_callers++;
+    }
+}
+
+// Tarjan's algorithm. Components are completed callees first, which is the
+// bottom-up order.
+typedef struct {
+    CallGraph *graph;
+    int *index;     // Visit number + 1, or 0 if not visited yet
+    int *low;
+    char *on_stack;
+    int *stack;
+    int stack_size;
+    int counter;
+    int num_ordered;
+} SCCWalk;
+
+static void visit_function(SCCWalk *w, int f) {
+    CallGraphNode *node = &w->graph->nodes[f];
+    w->index[f] = w->low[f] = ++w->counter;
+    w->stack[w->stack_size++] = f;
+    w->on_stack[f] = 1;
+    for (int c = 0; c < node->num_callees; c++) {
+        int callee = node->callees[c];
+        if (callee == f) node->recursive = 1;
+        if (!w->index[callee]) {
+            visit_function(w, callee);
+            if (w->low[callee] < w->low[f]) w->low[f] = w->low[callee];
+        } else if (w->on_stack[callee] && w->index[callee] < w->low[f]) {
+            w->low[f] = w->index[callee];
+        }
+    }
+    if (w->low[f] != w->index[f]) return;
+    int first = w->num_ordered;
+    int member;
+    do {
+        member = w->stack[--w->stack_size];
+        w->on_stack[member] = 0;
+        w->graph->bottom_up[w->num_ordered++] = member;
+    } while (member != f);
+    if (w->num_ordered - first > 1) {
+        for (int i = first; i < w->num_ordered; i++) w->graph->nodes[w->graph->bottom_up[i]].recursive = 1;
+    }
+}
+
+CallGraph* build_call_graph(IRModule *module) {
+    CallGraph *graph = (CallGraph*) checked_calloc(1, sizeof(CallGraph));
+    int n = graph->num_nodes = module->num_functions;
+    graph->nodes = (CallGraphNode*) checked_calloc(n, sizeof(CallGraphNode));
+    graph->bottom_up = (int*) checked_calloc(n, sizeof(int));
+
+    int num_names = string_pool_size();
+    int *function_of = (int*) checked_calloc(num_names, sizeof(int)); // StringId -> function index
+    memset(function_of, -1, num_names * sizeof(int));
+    for (int f = 0; f < n; f++) function_of[module->functions[f].name] = f;
+    for (int f = 0; f < n; f++) {
+        IRFunction *fn = &module->functions[f];
+        if (fn->blocks) {
+            for (int b = 0; b < fn->num_blocks; b++) {
+                scan_calls(graph, f, fn->blocks[b]->instrs, fn->blocks[b]->num_instrs, function_of);
+            }
+        } else {
+            scan_calls(graph, f, fn->instrs, fn->num_instrs, function_of);
+        }
+    }
+    free(function_of);
+
+    SCCWalk w;
+    memset(&w, 0, sizeof(w));
+    w.graph = graph;
+    w.index = (int*) checked_calloc(n, sizeof(int));
+    w.low = (int*) checked_calloc(n, sizeof(int));
+    w.on_stack = (char*) checked_calloc(n, sizeof(char));
+    w.stack = (int*) checked_calloc(n, sizeof(int));
+    for (int f = 0; f < n; f++) {
+        if (!w.index[f]) visit_function(&w, f);
+    }
+    free(w.index);
+    free(w.low);
+    free(w.on_stack);
+    free(w.stack);
+    return graph;
+}
+
+void free_call_graph(CallGraph *graph) {
+    if (!graph) return;
+    for (int f = 0; f < graph->num_nodes; f++) {
+        free(graph->nodes[f].callees);
+    }
+    free(graph->nodes);
+    free(graph->bottom_up);
+    free(graph);
+}
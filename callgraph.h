@@ -0,0 +1,33 @@
+#ifndef CALLGRAPH_H
+#define CALLGRAPH_H
+
+#include "ir.h"
+
+/*
+ * The call graph of a module: one node per function with IR, and an edge
+ * for every call site whose callee has IR (calls to library functions such
+ * as printf have no node). Functions that can reach themselves through
+ * calls are marked recursive; they form the strongly connected components
+ * with a cycle.
+ */
+
+typedef struct {
+    int *callees;           // Function index of each call site's callee, in code order
+    int num_callees;
+    int callees_capacity;
+    int num_callers;        // Call sites in other functions or this one
+    int recursive;          // On a call cycle, possibly calling itself
+} CallGraphNode;
+
+typedef struct {
+    CallGraphNode *nodes;   // Indexed like module->functions
+    int num_nodes;
+    int *bottom_up;         // Function indices, callees before their callers
+} CallGraph;
+
+// Builds the call graph from the functions' IR, linear or in blocks.
+CallGraph* build_call_graph(IRModule *module);
+
+void free_call_graph(CallGraph *graph);
+
+#endif // CALLGRAPH_H
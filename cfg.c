@@ -0,0 +1,469 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "alloc.h"
+
+BasicBlock* new_basic_block(IRFunction *fn, int label) {
+    BasicBlock *block = (BasicBlock*) checked_calloc(1, sizeof(BasicBlock));
+    block->label = label;
+    if (fn->num_blocks == fn->blocks_capacity) {
+        fn->blocks_capacity = fn->blocks_capacity ? fn->blocks_capacity * 2 : 16;
+        fn->blocks = (BasicBlock**) checked_realloc(fn->blocks, fn->blocks_capacity, sizeof(BasicBlock*));
+    }
+    block->id = fn->num_blocks;
+    fn->blocks[fn->num_blocks++] = block;
+    return block;
+}
+
+void block_append(BasicBlock *block, Instruction instr) {
+    if (block->num_instrs == block->capacity) {
+        block->capacity = block->capacity ? block->capacity * 2 : 8;
+        block->instrs = (Instruction*) checked_realloc(block->instrs, block->capacity, sizeof(Instruction));
+    }
+    block->instrs[block->num_instrs++] = instr;
+}
+
+void block_insert(BasicBlock *block, int index, Instruction instr) {
+    block_append(block, instr);
+    memmove(&block->instrs[index + 1], &block->instrs[index],
+            (block->num_instrs - 1 - index) * sizeof(Instruction));
+    block->instrs[index] = instr;
+}
+
+void block_insert_before_terminator(BasicBlock *block, Instruction instr) {
+    int index = block->num_instrs;
+    if (block_terminator(block)) index--;
+    block_insert(block, index, instr);
+}
+
+static void push_block(BasicBlock ***list, int *count, int *capacity, BasicBlock *block) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 2;
+        *list = (BasicBlock**) checked_realloc(*list, *capacity, sizeof(BasicBlock*));
+    }
+    (*list)[(*count)++] = block;
+}
+
+static void erase_block(BasicBlock **list, int *count, BasicBlock *block) {
+    for (int i = 0; i < *count; i++) {
+        if (list[i] == block) {
+            memmove(&list[i], &list[i + 1], (*count - i - 1) * sizeof(BasicBlock*));
+            (*count)--;
+            return;
+        }
+    }
+}
+
+// Adds a predecessor, with an empty argument for it in every phi.
+static void push_pred(BasicBlock *block, BasicBlock *pred) {
+    push_block(&block->preds, &block->num_preds, &block->preds_capacity, pred);
+    for (int i = 0; i < block->num_phis; i++) {
+        PhiNode *phi = &block->phis[i];
+        phi->args = (Operand*) checked_realloc(phi->args, block->num_preds, sizeof(Operand));
+        phi->args[block->num_preds - 1] = create_operand_none();
+    }
+}
+
+// Removes a predecessor together with its phi arguments.
+static void erase_pred(BasicBlock *block, BasicBlock *pred) {
+    for (int i = 0; i < block->num_preds; i++) {
+        if (block->preds[i] != pred) continue;
+        int after = block->num_preds - i - 1;
+        memmove(&block->preds[i], &block->preds[i + 1], after * sizeof(BasicBlock*));
+        for (int j = 0; j < block->num_phis; j++) {
+            memmove(&block->phis[j].args[i], &block->phis[j].args[i + 1], after * sizeof(Operand));
+        }
+        block->num_preds--;
+        return;
+    }
+}
+
+void add_cfg_edge(BasicBlock *from, BasicBlock *to) {
+    for (int i = 0; i < from->num_succs; i++) {
+        if (from->succs[i] == to) return;
+    }
+    push_block(&from->succs, &from->num_succs, &from->succs_capacity, to);
+    push_pred(to, from);
+}
+
+void remove_cfg_edge(BasicBlock *from, BasicBlock *to) {
+    erase_block(from->succs, &from->num_succs, to);
+    erase_pred(to, from);
+}
+
+int block_label(BasicBlock *block) {
+    if (block->label < 0) {
+        block->label = create_operand_label().val.label;
+    }
+    return block->label;
+}
+
+int is_block_terminator(OpCode opcode) {
+    return opcode == IR_GOTO || opcode == IR_IF_FALSE_GOTO || opcode == IR_IF_TRUE_GOTO ||
+           opcode == IR_JUMP_TABLE || opcode == IR_RETURN || opcode == IR_TAILCALL || opcode == IR_HALT;
+}
+
+Instruction* block_terminator(BasicBlock *block) {
+    if (block->num_instrs == 0) return NULL;
+    Instruction *last = &block->instrs[block->num_instrs - 1];
+    return is_block_terminator(last->opcode) ? last : NULL;
+}
+
+int block_falls_through(BasicBlock *block) {
+    Instruction *last = block_terminator(block);
+    return !last || last->opcode == IR_IF_FALSE_GOTO || last->opcode == IR_IF_TRUE_GOTO;
+}
+
+void redirect_cfg_edge(BasicBlock *from, BasicBlock *old_to, BasicBlock *new_to) {
+    int slot = -1;
+    int already_linked = 0;
+    for (int i = 0; i < from->num_succs; i++) {
+        if (from->succs[i] == old_to) slot = i;
+        if (from->succs[i] == new_to) already_linked = 1;
+    }
+    if (slot < 0) return;
+
+    Instruction *last = block_terminator(from);
+    if (last && last->result.type == OP_LABEL && last->result.val.label == old_to->label) {
+        last->result.val.label = block_label(new_to);
+    } else if (last && last->opcode == IR_JUMP_TABLE) {
+        JumpTable *table = &ir_module.jump_tables[last->result.val.int_val];
+        for (int l = 0; l < table->num_labels; l++) {
+            if (table->labels[l] == old_to->label) table->labels[l] = block_label(new_to);
+        }
+    }
+
+    erase_pred(old_to, from);
+    if (already_linked) {
+        erase_block(from->succs, &from->num_succs, old_to);
+    } else {
+        from->succs[slot] = new_to;
+        push_pred(new_to, from);
+    }
+}
+
+PhiNode* block_add_phi(BasicBlock *block, Operand origin) {
+    if (block->num_phis == block->phis_capacity) {
+        block->phis_capacity = block->phis_capacity ? block->phis_capacity * 2 : 4;
+        block->phis = (PhiNode*) checked_realloc(block->phis, block->phis_capacity, sizeof(PhiNode));
+    }
+    PhiNode *phi = &block->phis[block->num_phis++];
+    phi->result = origin;
+    phi->origin = origin;
+    phi->args = (Operand*) checked_realloc(NULL, block->num_preds ? block->num_preds : 1, sizeof(Operand));
+    for (int i = 0; i < block->num_preds; i++) {
+        phi->args[i] = create_operand_none();
+    }
+    return phi;
+}
+
+static void free_block(BasicBlock *block) {
+    for (int i = 0; i < block->num_phis; i++) {
+        free(block->phis[i].args);
+    }
+    free(block->phis);
+    free(block->dom_children);
+    free(block->instrs);
+    free(block->succs);
+    free(block->preds);
+    free(block);
+}
+
+void delete_basic_block(IRFunction *fn, BasicBlock *block) {
+    while (block->num_succs > 0) {
+        remove_cfg_edge(block, block->succs[block->num_succs - 1]);
+    }
+    while (block->num_preds > 0) {
+        remove_cfg_edge(block->preds[block->num_preds - 1], block);
+    }
+    fn->blocks[block->id] = NULL;
+    free_block(block);
+}
+
+void free_cfg(IRFunction *fn) {
+    for (int i = 0; i < fn->num_blocks; i++) {
+        if (fn->blocks[i]) free_block(fn->blocks[i]);
+    }
+    free(fn->blocks);
+    fn->blocks = NULL;
+    fn->num_blocks = 0;
+    fn->blocks_capacity = 0;
+    fn->in_ssa = 0;
+}
+
+void compact_blocks(IRFunction *fn) {
+    int out = 0;
+    for (int i = 0; i < fn->num_blocks; i++) {
+        if (fn->blocks[i]) {
+            fn->blocks[i]->id = out;
+            fn->blocks[out++] = fn->blocks[i];
+        }
+    }
+    fn->num_blocks = out;
+}
+
+void move_basic_block(IRFunction *fn, BasicBlock *block, int position) {
+    int from = block->id;
+    if (from < position) {
+        memmove(&fn->blocks[from], &fn->blocks[from + 1], (position - from) * sizeof(BasicBlock*));
+    } else {
+        memmove(&fn->blocks[position + 1], &fn->blocks[position], (from - position) * sizeof(BasicBlock*));
+    }
+    fn->blocks[position] = block;
+    int low = from < position ? from : position;
+    int high = from < position ? position : from;
+    for (int i = low; i <= high; i++) fn->blocks[i]->id = i;
+}
+
+static BasicBlock* label_target(BasicBlock **label_block, int label, BasicBlock *exit_block) {
+    if (!label_block[label]) {
+        fprintf(stderr, "IR Error: Jump to undefined label L%d.\n", label);
+        return exit_block;
+    }
+    return label_block[label];
+}
+
+void build_cfg(IRFunction *fn) {
+    free_cfg(fn);
+    BasicBlock *entry = new_basic_block(fn, -1);
+    BasicBlock *exit_block = new_basic_block(fn, -1);
+
+    // Pass 1: split the instruction array into blocks and map labels to blocks.
+    BasicBlock **label_block = (BasicBlock**) checked_calloc(ir_module.num_labels + 1, sizeof(BasicBlock*));
+    BasicBlock *current = NULL;
+    for (int i = 0; i < fn->num_instrs; i++) {
+        Instruction *instr = &fn->instrs[i];
+        if (instr->opcode == IR_LABEL) {
+            current = new_basic_block(fn, instr->result.val.label);
+            label_block[instr->result.val.label] = current;
+            continue;
+        }
+        if (!current) {
+            current = new_basic_block(fn, -1);
+        }
+        block_append(current, *instr);
+        if (is_block_terminator(instr->opcode)) {
+            current = NULL;
+        }
+    }
+
+    // Pass 2: connect the blocks. A block falls through to the next one in
+    // layout order, or to the exit block if it is the last one.
+    add_cfg_edge(entry, fn->num_blocks > 2 ? fn->blocks[2] : exit_block);
+    for (int i = 2; i < fn->num_blocks; i++) {
+        BasicBlock *block = fn->blocks[i];
+        BasicBlock *next = (i + 1 < fn->num_blocks) ? fn->blocks[i + 1] : exit_block;
+        Instruction *last = block_terminator(block);
+        if (block_falls_through(block)) {
+            add_cfg_edge(block, next);
+        }
+        if (!last) continue;
+        if (last->opcode == IR_RETURN || last->opcode == IR_TAILCALL || last->opcode == IR_HALT) {
+            add_cfg_edge(block, exit_block);
+        } else if (last->opcode == IR_JUMP_TABLE) {
+            JumpTable *table = &ir_module.jump_tables[last->result.val.int_val];
+            for (int l = 0; l < table->num_labels; l++) {
+                add_cfg_edge(block, label_target(label_block, table->labels[l], exit_block));
+            }
+        } else {
+            add_cfg_edge(block, label_target(label_block, last->result.val.label, exit_block));
+        }
+    }
+    free(label_block);
+}
+
+int compute_reverse_postorder(IRFunction *fn, BasicBlock **order) {
+    // Iterative depth-first search; next_succ[] is the edge each block on the
+    // stack will follow next.
+    int n = fn->num_blocks;
+    BasicBlock **stack = (BasicBlock**) checked_realloc(NULL, n, sizeof(BasicBlock*));
+    int *next_succ = (int*) checked_calloc(n, sizeof(int));
+    char *visited = (char*) checked_calloc(n, sizeof(char));
+    for (int i = 0; i < n; i++) {
+        fn->blocks[i]->rpo = -1;
+    }
+
+    int depth = 0;
+    int done = 0; // Blocks finished so far, filled into order[] from the back
+    stack[depth++] = fn->blocks[CFG_ENTRY];
+    visited[CFG_ENTRY] = 1;
+    while (depth > 0) {
+        BasicBlock *block = stack[depth - 1];
+        if (next_succ[block->id] < block->num_succs) {
+            BasicBlock *succ = block->succs[next_succ[block->id]++];
+            if (!visited[succ->id]) {
+                visited[succ->id] = 1;
+                stack[depth++] = succ;
+            }
+        } else {
+            depth--;
+            order[n - 1 - done++] = block;
+        }
+    }
+    // Shift the reached blocks to the front of the array.
+    memmove(order, order + n - done, done * sizeof(BasicBlock*));
+    for (int i = 0; i < done; i++) {
+        order[i]->rpo = i;
+    }
+    free(stack);
+    free(next_succ);
+    free(visited);
+    return done;
+}
+
+static BasicBlock* intersect_dominators(BasicBlock *a, BasicBlock *b) {
+    while (a != b) {
+        while (a->rpo > b->rpo) a = a->idom;
+        while (b->rpo > a->rpo) b = b->idom;
+    }
+    return a;
+}
+
+void compute_dominators(IRFunction *fn) {
+    // Cooper, Harvey and Kennedy's iterative algorithm over reverse postorder.
+    BasicBlock **order = (BasicBlock**) checked_realloc(NULL, fn->num_blocks, sizeof(BasicBlock*));
+    int reached = compute_reverse_postorder(fn, order);
+    for (int i = 0; i < fn->num_blocks; i++) {
+        fn->blocks[i]->idom = NULL;
+        fn->blocks[i]->num_dom_children = 0;
+        fn->blocks[i]->dom_pre = fn->blocks[i]->dom_post = -1;
+    }
+    BasicBlock *entry = order[0];
+    entry->idom = entry;
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 1; i < reached; i++) {
+            BasicBlock *block = order[i];
+            BasicBlock *new_idom = NULL;
+            for (int p = 0; p < block->num_preds; p++) {
+                BasicBlock *pred = block->preds[p];
+                if (pred->rpo < 0 || !pred->idom) continue;
+                new_idom = new_idom ? intersect_dominators(pred, new_idom) : pred;
+            }
+            if (new_idom != block->idom) {
+                block->idom = new_idom;
+                changed = 1;
+            }
+        }
+    }
+    entry->idom = NULL;
+
+    for (int i = 1; i < reached; i++) {
+        BasicBlock *parent = order[i]->idom;
+        push_block(&parent->dom_children, &parent->num_dom_children, &parent->dom_children_capacity, order[i]);
+    }
+
+    // Number the dominator tree in preorder; a dominates b exactly when b's
+    // interval lies inside a's.
+    BasicBlock **stack = order; // Reuse the array: the tree has 'reached' nodes
+    int *next_child = (int*) checked_calloc(fn->num_blocks, sizeof(int));
+    int depth = 0, counter = 0;
+    stack[depth++] = entry;
+    entry->dom_pre = counter++;
+    while (depth > 0) {
+        BasicBlock *block = stack[depth - 1];
+        if (next_child[block->id] < block->num_dom_children) {
+            BasicBlock *child = block->dom_children[next_child[block->id]++];
+            child->dom_pre = counter++;
+            stack[depth++] = child;
+        } else {
+            block->dom_post = counter;
+            depth--;
+        }
+    }
+    free(next_child);
+    free(order);
+}
+
+int block_dominates(BasicBlock *a, BasicBlock *b) {
+    if (a->dom_pre < 0 || b->dom_pre < 0) return 0;
+    return a->dom_pre <= b->dom_pre && b->dom_pre < a->dom_post;
+}
+
+static void emit_jump(IRFunction *fn, BasicBlock *target) {
+    Instruction jump;
+    memset(&jump, 0, sizeof(jump));
+    jump.opcode = IR_GOTO;
+    jump.result.type = OP_LABEL;
+    jump.result.val.label = block_label(target);
+    ir_append(fn, jump);
+}
+
+void linearize_cfg(IRFunction *fn) {
+    if (!fn->blocks) return;
+    BasicBlock *exit_block = fn->blocks[CFG_EXIT];
+    fn->num_instrs = 0;
+
+    for (int i = 0; i < fn->num_blocks; i++) {
+        BasicBlock *block = fn->blocks[i];
+        if (block == exit_block) continue;
+        if (block->label >= 0) {
+            Instruction label;
+            memset(&label, 0, sizeof(label));
+            label.opcode = IR_LABEL;
+            label.result.type = OP_LABEL;
+            label.result.val.label = block->label;
+            ir_append(fn, label);
+        }
+        for (int j = 0; j < block->num_instrs; j++) {
+            ir_append(fn, block->instrs[j]);
+        }
+
+        // Make the fall-through explicit when the layout does not provide it.
+        if (block_falls_through(block) && block->num_succs > 0) {
+            BasicBlock *fallthrough = block->succs[0];
+            int next = i + 1;
+            if (next < fn->num_blocks && fn->blocks[next] == exit_block) next++;
+            BasicBlock *layout_next = next < fn->num_blocks ? fn->blocks[next] : exit_block;
+            if (fallthrough != layout_next) {
+                emit_jump(fn, fallthrough);
+            }
+        }
+    }
+    // Jumps to the exit block land at the end of the function.
+    if (exit_block->label >= 0) {
+        Instruction label;
+        memset(&label, 0, sizeof(label));
+        label.opcode = IR_LABEL;
+        label.result.type = OP_LABEL;
+        label.result.val.label = exit_block->label;
+        ir_append(fn, label);
+    }
+    free_cfg(fn);
+}
+
+static void print_block_list(FILE *fp, BasicBlock **list, int count) {
+    for (int i = 0; i < count; i++) {
+        fprintf(fp, " B%d", list[i]->id);
+    }
+}
+
+void print_cfg(FILE *fp, IRFunction *fn) {
+    fprintf(fp, "%s: %d blocks\n", fn->name >= 0 ? string_from_id(fn->name) : "<globals>", fn->num_blocks);
+    for (int i = 0; i < fn->num_blocks; i++) {
+        BasicBlock *block = fn->blocks[i];
+        fprintf(fp, "  B%d", block->id);
+        if (i == CFG_ENTRY) fprintf(fp, " (entry)");
+        if (i == CFG_EXIT) fprintf(fp, " (exit)");
+        if (block->label >= 0) fprintf(fp, " [L%d]", block->label);
+        fprintf(fp, " %d instrs, preds:", block->num_instrs);
+        print_block_list(fp, block->preds, block->num_preds);
+        fprintf(fp, ", succs:");
+        print_block_list(fp, block->succs, block->num_succs);
+        fprintf(fp, "\n");
+        for (int j = 0; j < block->num_phis; j++) {
+            PhiNode *phi = &block->phis[j];
+            fprintf(fp, "    PHI ");
+            print_operand(fp, phi->result);
+            fprintf(fp, " <-");
+            for (int k = 0; k < block->num_preds; k++) {
+                fprintf(fp, " B%d:", block->preds[k]->id);
+                print_operand(fp, phi->args[k]);
+            }
+            fprintf(fp, "\n");
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include <stdio.h>
+#include "ir.h"
+
+/*
+ * Control-flow graph of an IRFunction. build_cfg() splits the function's
+ * instruction array into basic blocks at labels and after jumps, returns and
+ * HALT, and links the blocks with predecessor/successor edges. Every CFG has
+ * a dedicated empty entry block (no predecessors) and exit block (reached by
+ * every RETURN/HALT and by falling off the end of the function).
+ *
+ * While the CFG exists its blocks are the authoritative copy of the code;
+ * linearize_cfg() writes them back to the instruction array in layout order.
+ */
+
+#define CFG_ENTRY 0 // Index of the entry block in fn->blocks
+#define CFG_EXIT  1 // Index of the exit block in fn->blocks
+
+// An SSA phi function at the start of a block (see ssa.h). args[i] is the
+// value flowing in from the block's preds[i]; the CFG edge functions below
+// keep the two arrays in step.
+typedef struct {
+    Operand result;
+    Operand origin;             // Variable the phi merges, before renaming
+    Operand *args;
+} PhiNode;
+
+typedef struct BasicBlock {
+    int id;                     // Index in fn->blocks; also the layout order
+    int label;                  // IR label that starts the block, or -1
+    Instruction *instrs;        // Body, without the leading label
+    int num_instrs;
+    int capacity;
+    // If the block can fall through, succs[0] is its fall-through successor.
+    struct BasicBlock **succs;
+    int num_succs;
+    int succs_capacity;
+    struct BasicBlock **preds;
+    int num_preds;
+    int preds_capacity;
+    PhiNode *phis;              // Only while the function is in SSA form
+    int num_phis;
+    int phis_capacity;
+    // Filled in by compute_dominators(); unreachable blocks have rpo == -1.
+    int rpo;                    // Position in reverse postorder
+    struct BasicBlock *idom;    // Immediate dominator; NULL for the entry block
+    struct BasicBlock **dom_children;
+    int num_dom_children;
+    int dom_children_capacity;
+    int dom_pre, dom_post;      // Preorder interval in the dominator tree
+} BasicBlock;
+
+// Builds the CFG of 'fn' from its instruction array, replacing any old CFG.
+void build_cfg(IRFunction *fn);
+
+// Writes the blocks back to fn->instrs in layout order, adding the labels
+// and jumps that the layout needs, and releases the CFG.
+void linearize_cfg(IRFunction *fn);
+
+// Releases the CFG without touching fn->instrs.
+void free_cfg(IRFunction *fn);
+
+// Creates an empty block at the end of the layout.
+BasicBlock* new_basic_block(IRFunction *fn, int label);
+
+// Appends an instruction to a block.
+void block_append(BasicBlock *block, Instruction instr);
+
+// Inserts an instruction before position 'index' of a block.
+void block_insert(BasicBlock *block, int index, Instruction instr);
+
+// Appends an instruction to a block, keeping its jump (if any) last.
+void block_insert_before_terminator(BasicBlock *block, Instruction instr);
+
+// Adds the edge from -> to, unless it already exists.
+void add_cfg_edge(BasicBlock *from, BasicBlock *to);
+
+// Removes the edge from -> to, if present.
+void remove_cfg_edge(BasicBlock *from, BasicBlock *to);
+
+// Moves the edge from -> old_to over to new_to, keeping its successor slot,
+// and retargets the block's jump if it jumped to old_to.
+void redirect_cfg_edge(BasicBlock *from, BasicBlock *old_to, BasicBlock *new_to);
+
+// Returns the block's label, creating one if it has none.
+int block_label(BasicBlock *block);
+
+// Returns the block's last instruction if it is a jump, RETURN or HALT.
+Instruction* block_terminator(BasicBlock *block);
+
+// Returns 1 if control can reach the end of the block without a jump.
+int block_falls_through(BasicBlock *block);
+
+// Returns 1 for opcodes that end a basic block.
+int is_block_terminator(OpCode opcode);
+
+// Adds a phi for 'origin' with one OP_NONE argument per predecessor.
+PhiNode* block_add_phi(BasicBlock *block, Operand origin);
+
+// Lists the blocks reachable from the entry in reverse postorder and sets
+// their rpo fields (others get -1). 'order' needs room for fn->num_blocks
+// entries; returns the number of reachable blocks.
+int compute_reverse_postorder(IRFunction *fn, BasicBlock **order);
+
+// Builds the dominator tree of the reachable blocks.
+void compute_dominators(IRFunction *fn);
+
+// Returns 1 if 'a' dominates 'b'. Needs compute_dominators().
+int block_dominates(BasicBlock *a, BasicBlock *b);
+
+// Disconnects a block and frees it, leaving NULL in fn->blocks until the
+// next compact_blocks().
+void delete_basic_block(IRFunction *fn, BasicBlock *block);
+
+// Drops deleted blocks (NULL entries) from fn->blocks and renumbers the rest.
+void compact_blocks(IRFunction *fn);
+
+// Moves a block to another position in the layout and renumbers the blocks.
+void move_basic_block(IRFunction *fn, BasicBlock *block, int position);
+
+// Prints blocks and edges, for debugging.
+void print_cfg(FILE *fp, IRFunction *fn);
+
+#endif // CFG_H
@@ -0,0 +1,329 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "passes.h"
+#include "cfg.h"
+#include "liveness.h"
+#include "alloc.h"
+
+/*
+ * Removing copies, in two passes.
+ *
+ * "copy-prop" works on SSA form, where every temporary has one definition:
+ * after 'ASSIGN t2, t1' (or 'ASSIGN t2, 5') every use of t2 can read t1 (or
+ * 5) instead, and the copy goes away.
+ *
+ * "coalesce" runs after SSA destruction, when copies between temporaries are
+ * what is left of phis, assignments and call results. It builds the
+ * interference graph of the function's temporaries from liveness: two
+ * temporaries interfere if one is written while the other holds a live
+ * value. The two sides of a copy that do not interfere are merged, and the
+ * copy disappears. Finally the remaining temporaries are colored greedily,
+ * so ones whose live ranges never overlap share a number.
+ */
+
+// Functions with more temporaries than this are left alone: every pair of
+// temporaries that are live together is an edge of the interference graph.
+#define COALESCE_MAX_TEMPS 100000
+
+static int is_copy(const Instruction *instr) {
+    return instr->opcode == IR_ASSIGN && instr->result.type == OP_TEMPORARY;
+}
+
+/* --- Copy propagation --- */
+
+static Operand copied_value(Operand *value, int num_temps, Operand op) {
+    while (op.type == OP_TEMPORARY && op.val.temp < num_temps && value[op.val.temp].type != OP_NONE) {
+        op = value[op.val.temp];
+    }
+    return op;
+}
+
+int run_copy_propagation(IRFunction *fn) {
+    int num_temps = ir_module.num_temps;
+    Operand *value = (Operand*) checked_calloc(num_temps, sizeof(Operand)); // OP_NONE: not a copy
+    int changes = 0;
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        for (int i = 0; i < block->num_instrs; i++) {
+            Instruction *instr = &block->instrs[i];
+            if (!is_copy(instr) || instr->result.val.temp >= num_temps) continue;
+            if (instr->arg1.type == OP_TEMPORARY || is_constant_operand(instr->arg1)) {
+                value[instr->result.val.temp] = instr->arg1;
+            }
+        }
+    }
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        for (int i = 0; i < block->num_phis; i++) {
+            PhiNode *phi = &block->phis[i];
+            for (int p = 0; p < block->num_preds; p++) {
+                phi->args[p] = copied_value(value, num_temps, phi->args[p]);
+            }
+        }
+        int kept = 0;
+        for (int i = 0; i < block->num_instrs; i++) {
+            Instruction instr = block->instrs[i];
+            if (is_copy(&instr) && instr.result.val.temp < num_temps &&
+                value[instr.result.val.temp].type != OP_NONE) {
+                changes++;
+                continue;
+            }
+            instr.arg1 = copied_value(value, num_temps, instr.arg1);
+            instr.arg2 = copied_value(value, num_temps, instr.arg2);
+            if (ir_reads_result(instr.opcode)) instr.result = copied_value(value, num_temps, instr.result);
+            block->instrs[kept++] = instr;
+        }
+        block->num_instrs = kept;
+    }
+    free(value);
+    return changes;
+}
+
+/* --- Coalescing --- */
+
+// The interference graph is sparse: edges live in a hash set for lookups and
+// in per-temporary adjacency lists for walking neighbours.
+typedef struct {
+    int *items;
+    int count;
+    int capacity;
+} AdjList;
+
+typedef struct {
+    Liveness *lv;
+    unsigned long long *edges;  // Hash set of (low << 32 | high) + 1; 0 is empty
+    size_t edges_capacity;      // Power of two
+    size_t num_edges;
+    AdjList *adj;
+    int *rep;                   // Union-find parent of each temporary
+} Coalescer;
+
+static size_t edge_slot(Coalescer *co, unsigned long long key) {
+    size_t mask = co->edges_capacity - 1;
+    size_t i = (size_t) ((key * 0x9e3779b97f4a7c15ull) >> 20) & mask;
+    while (co->edges[i] && co->edges[i] != key) i = (i + 1) & mask;
+    return i;
+}
+
+static unsigned long long edge_key(int a, int b) {
+    if (a > b) { int t = a; a = b; b = t; }
+    return (((unsigned long long) a << 32) | (unsigned int) b) + 1;
+}
+
+static int interferes(Coalescer *co, int a, int b) {
+    unsigned long long key = edge_key(a, b);
+    return co->edges[edge_slot(co, key)] == key;
+}
+
+static void adj_push(AdjList *list, int value) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 4;
+        list->items = (int*) checked_realloc(list->items, list->capacity, sizeof(int));
+    }
+    list->items[list->count++] = value;
+}
+
+static void add_interference(Coalescer *co, int a, int b) {
+    if (a == b) return;
+    if (2 * (co->num_edges + 1) > co->edges_capacity) {
+        unsigned long long *old = co->edges;
+        size_t old_capacity = co->edges_capacity;
+        co->edges_capacity *= 2;
+        co->edges = (unsigned long long*) checked_calloc(co->edges_capacity, sizeof(unsigned long long));
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old[i]) co->edges[edge_slot(co, old[i])] = old[i];
+        }
+        free(old);
+    }
+    unsigned long long key = edge_key(a, b);
+    size_t slot = edge_slot(co, key);
+    if (co->edges[slot]) return;
+    co->edges[slot] = key;
+    co->num_edges++;
+    adj_push(&co->adj[a], b);
+    adj_push(&co->adj[b], a);
+}
+
+static int find_rep(Coalescer *co, int t) {
+    while (co->rep[t] != t) {
+        co->rep[t] = co->rep[co->rep[t]];
+        t = co->rep[t];
+    }
+    return t;
+}
+
+// Walks each block backwards from its live-out set. 'live' holds the live
+// temporaries as a list, and 'position' their place in it (or -1).
+static void build_interference(Coalescer *co, IRFunction *fn) {
+    Liveness *lv = co->lv;
+    int *live = (int*) checked_calloc(lv->num_temps, sizeof(int));
+    int *position = (int*) checked_calloc(lv->num_temps, sizeof(int));
+    memset(position, -1, lv->num_temps * sizeof(int));
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        int num_live = live_out_temps(lv, b, live);
+        for (int i = 0; i < num_live; i++) position[live[i]] = i;
+        for (int i = block->num_instrs - 1; i >= 0; i--) {
+            Instruction *instr = &block->instrs[i];
+            int def = ir_defines_result(instr->opcode) ? liveness_index(lv, instr->result) : -1;
+            if (def >= 0) {
+                // A copy's destination may share a number with its source.
+                int source = is_copy(instr) ? liveness_index(lv, instr->arg1) : -1;
+                for (int l = 0; l < num_live; l++) {
+                    if (live[l] != source) add_interference(co, def, live[l]);
+                }
+                if (position[def] >= 0) {
+                    int last = live[--num_live];
+                    live[position[def]] = last;
+                    position[last] = position[def];
+                    position[def] = -1;
+                }
+            }
+            Operand uses[3];
+            int num_uses = instruction_uses(instr, uses);
+            for (int u = 0; u < num_uses; u++) {
+                int t = liveness_index(lv, uses[u]);
+                if (t >= 0 && position[t] < 0) {
+                    position[t] = num_live;
+                    live[num_live++] = t;
+                }
+            }
+        }
+        for (int i = 0; i < num_live; i++) position[live[i]] = -1;
+    }
+    free(live);
+    free(position);
+}
+
+// Merges the two sides of every copy that do not interfere. Returns the
+// number of merges.
+static int merge_copies(Coalescer *co, IRFunction *fn) {
+    Liveness *lv = co->lv;
+    int merged = 0;
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        for (int i = 0; i < block->num_instrs; i++) {
+            Instruction *instr = &block->instrs[i];
+            if (!is_copy(instr)) continue;
+            int dst = liveness_index(lv, instr->result);
+            int src = liveness_index(lv, instr->arg1);
+            if (dst < 0 || src < 0) continue;
+            dst = find_rep(co, dst);
+            src = find_rep(co, src);
+            if (dst == src || interferes(co, dst, src)) continue;
+            // The merged temporary interferes with everything either one did.
+            // The one with fewer neighbours joins the other, so only the
+            // shorter list is walked: a long chain of copies does not copy
+            // one growing list over and over.
+            int keep = dst, gone = src;
+            if (co->adj[gone].count > co->adj[keep].count) {
+                keep = src;
+                gone = dst;
+            }
+            co->rep[gone] = keep;
+            for (int n = 0; n < co->adj[gone].count; n++) {
+                add_interference(co, keep, find_rep(co, co->adj[gone].items[n]));
+            }
+            free(co->adj[gone].items);
+            memset(&co->adj[gone], 0, sizeof(AdjList));
+            merged++;
+        }
+    }
+    return merged;
+}
+
+static int compare_ints(const void *a, const void *b) {
+    int x = *(const int*) a, y = *(const int*) b;
+    return (x > y) - (x < y);
+}
+
+// Colors the merged temporaries in order of first appearance and renames
+// them. Color c becomes the function's c-th lowest temporary, so numbers
+// stay within the range the function already used. Returns the number of
+// temporaries saved.
+static int assign_temporaries(Coalescer *co, IRFunction *fn) {
+    Liveness *lv = co->lv;
+    int n = lv->num_temps;
+    int *color = (int*) checked_calloc(n, sizeof(int));
+    int *taken = (int*) checked_calloc(n + 1, sizeof(int)); // Color -> last node that saw it taken
+    int *sorted = (int*) checked_calloc(n, sizeof(int));
+    memset(color, -1, n * sizeof(int));
+    memcpy(sorted, lv->temps, n * sizeof(int));
+    qsort(sorted, n, sizeof(int), compare_ints);
+
+    int num_colors = 0;
+    for (int t = 0; t < n; t++) {
+        if (find_rep(co, t) != t) continue;
+        for (int a = 0; a < co->adj[t].count; a++) {
+            int c = color[find_rep(co, co->adj[t].items[a])];
+            if (c >= 0) taken[c] = t + 1;
+        }
+        int c = 0;
+        while (taken[c] == t + 1) c++;
+        color[t] = c;
+        if (c == num_colors) num_colors++;
+    }
+
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        for (int i = 0; i < block->num_instrs; i++) {
+            Operand *ops[3] = { &block->instrs[i].result, &block->instrs[i].arg1, &block->instrs[i].arg2 };
+            for (int k = 0; k < 3; k++) {
+                int t = liveness_index(lv, *ops[k]);
+                if (t >= 0) ops[k]->val.temp = sorted[color[find_rep(co, t)]];
+            }
+        }
+    }
+    free(color);
+    free(taken);
+    free(sorted);
+    return n - num_colors;
+}
+
+static int remove_self_copies(IRFunction *fn) {
+    int removed = 0;
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        int kept = 0;
+        for (int i = 0; i < block->num_instrs; i++) {
+            Instruction *instr = &block->instrs[i];
+            if (is_copy(instr) && are_operands_equal(instr->result, instr->arg1)) {
+                removed++;
+            } else {
+                block->instrs[kept++] = *instr;
+            }
+        }
+        block->num_instrs = kept;
+    }
+    return removed;
+}
+
+int run_coalesce(IRFunction *fn) {
+    Coalescer co;
+    co.lv = compute_liveness(fn);
+    int n = co.lv->num_temps;
+    if (n == 0 || n > COALESCE_MAX_TEMPS) {
+        free_liveness(co.lv);
+        return 0;
+    }
+    co.edges_capacity = 1024;
+    co.num_edges = 0;
+    co.edges = (unsigned long long*) checked_calloc(co.edges_capacity, sizeof(unsigned long long));
+    co.adj = (AdjList*) checked_calloc(n, sizeof(AdjList));
+    co.rep = (int*) checked_calloc(n, sizeof(int));
+    for (int t = 0; t < n; t++) co.rep[t] = t;
+
+    build_interference(&co, fn);
+    merge_copies(&co, fn);
+    int saved = assign_temporaries(&co, fn);
+    int removed = remove_self_copies(fn);
+
+    for (int t = 0; t < n; t++) free(co.adj[t].items);
+    free(co.adj);
+    free(co.edges);
+    free(co.rep);
+    free_liveness(co.lv);
+    return saved + removed;
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "passes.h"
+#include "cfg.h"
+#include "alloc.h"
+
+/*
+ * Dead-code elimination on SSA form, by marking and sweeping. Instructions
+ * with an effect the program can observe are live from the start: stores,
+ * calls, jumps, returns, PARAM, and writes to identifiers (which are memory
+ * once the function is in SSA form). A temporary is live if a live
+ * instruction or phi reads it, and then so is its definition. Everything
+ * left unmarked is deleted.
+ */
+
+typedef struct {
+    int block;
+    int index; // Instruction index, or -(phi index + 1)
+} DefSite;
+
+// Whether an instruction must stay regardless of who reads its result.
+static int has_side_effect(const Instruction *instr) {
+    if (instr->opcode == IR_NOP) return 0;
+    if (!ir_defines_result(instr->opcode)) return 1;
+    if (instr->opcode == IR_CALL) return 1;
+    return instr->result.type != OP_TEMPORARY;
+}
+
+typedef struct {
+    int num_temps;
+    char *live;
+    int *worklist;
+    int worklist_size;
+} Liveness;
+
+static void mark_live(Liveness *lv, Operand op) {
+    if (op.type != OP_TEMPORARY || op.val.temp >= lv->num_temps || lv->live[op.val.temp]) return;
+    lv->live[op.val.temp] = 1;
+    lv->worklist[lv->worklist_size++] = op.val.temp;
+}
+
+static void mark_operands(Liveness *lv, const Instruction *instr) {
+    mark_live(lv, instr->arg1);
+    mark_live(lv, instr->arg2);
+    if (ir_reads_result(instr->opcode)) mark_live(lv, instr->result);
+}
+
+int run_dce(IRFunction *fn) {
+    Liveness lv;
+    lv.num_temps = ir_module.num_temps;
+    lv.live = (char*) checked_calloc(lv.num_temps, sizeof(char));
+    lv.worklist = (int*) checked_calloc(lv.num_temps, sizeof(int));
+    lv.worklist_size = 0;
+
+    // Definition sites of each temporary, as lists in one array. Instructions
+    // with side effects are live anyway and are not listed.
+    int *def_start = (int*) checked_calloc(lv.num_temps + 1, sizeof(int));
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        for (int i = 0; i < block->num_phis; i++) {
+            def_start[block->phis[i].result.val.temp + 1]++;
+        }
+        for (int i = 0; i < block->num_instrs; i++) {
+            Instruction *instr = &block->instrs[i];
+            if (!has_side_effect(instr) && ir_defines_result(instr->opcode) && instr->result.type == OP_TEMPORARY) {
+                def_start[instr->result.val.temp + 1]++;
+            }
+        }
+    }
+    for (int t = 0; t < lv.num_temps; t++) def_start[t + 1] += def_start[t];
+    DefSite *defs = (DefSite*) checked_calloc(def_start[lv.num_temps], sizeof(DefSite));
+    int *cursor = (int*) checked_calloc(lv.num_temps + 1, sizeof(int));
+    memcpy(cursor, def_start, (lv.num_temps + 1) * sizeof(int));
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        for (int i = 0; i < block->num_phis; i++) {
+            DefSite *site = &defs[cursor[block->phis[i].result.val.temp]++];
+            site->block = b;
+            site->index = -(i + 1);
+        }
+        for (int i = 0; i < block->num_instrs; i++) {
+            Instruction *instr = &block->instrs[i];
+            if (has_side_effect(instr)) {
+                mark_operands(&lv, instr);
+            } else if (ir_defines_result(instr->opcode) && instr->result.type == OP_TEMPORARY) {
+                DefSite *site = &defs[cursor[instr->result.val.temp]++];
+                site->block = b;
+                site->index = i;
+            }
+        }
+    }
+    free(cursor);
+
+    // Propagate liveness from uses to definitions.
+    while (lv.worklist_size > 0) {
+        int t = lv.worklist[--lv.worklist_size];
+        for (int d = def_start[t]; d < def_start[t + 1]; d++) {
+            BasicBlock *block = fn->blocks[defs[d].block];
+            if (defs[d].index < 0) {
+                PhiNode *phi = &block->phis[-defs[d].index - 1];
+                for (int p = 0; p < block->num_preds; p++) mark_live(&lv, phi->args[p]);
+            } else {
+                mark_operands(&lv, &block->instrs[defs[d].index]);
+            }
+        }
+    }
+
+    int removed = 0;
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        int kept = 0;
+        for (int i = 0; i < block->num_phis; i++) {
+            if (lv.live[block->phis[i].result.val.temp]) {
+                block->phis[kept++] = block->phis[i];
+            } else {
+                free(block->phis[i].args);
+                removed++;
+            }
+        }
+        block->num_phis = kept;
+        kept = 0;
+        for (int i = 0; i < block->num_instrs; i++) {
+            Instruction *instr = &block->instrs[i];
+            if (has_side_effect(instr) ||
+                (instr->result.type == OP_TEMPORARY && lv.live[instr->result.val.temp])) {
+                block->instrs[kept++] = *instr;
+            } else {
+                removed++;
+            }
+        }
+        block->num_instrs = kept;
+    }
+
+    free(def_start);
+    free(defs);
+    free(lv.live);
+    free(lv.worklist);
+    return removed;
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "driver.h"
+#include "passes.h"      // Optimization pass manager
+#include "frame.h"       // Stack frame layout of local aggregates
+#include "regalloc.h"    // Linear-scan register allocation
+#include "ir_binary.h"   // Binary 3AC output
+#include "string_pool.h"
+
+int driver_list_passes(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--list-passes") == 0) {
+            list_ir_passes(stdout);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int parse_driver_option(const char *arg, DriverOptions *options) {
+    if (arg[0] != '-') {
+        options->destination = arg;
+    } else if (strncmp(arg, "-O", 2) == 0) {
+        set_optimization_level(atoi(arg + 2));
+    } else if (strncmp(arg, "--passes=", 9) == 0) {
+        if (!set_pass_pipeline(arg + 9)) return -1;
+    } else if (strncmp(arg, "--inline-budget=", 16) == 0) {
+        set_inline_budget(atoi(arg + 16));
+    } else if (strncmp(arg, "--registers=", 12) == 0) {
+        options->num_registers = atoi(arg + 12);
+        if (options->num_registers < MIN_REGISTERS) {
+            fprintf(stderr, "Error: --registers needs at least %d registers.\n", MIN_REGISTERS);
+            return -1;
+        }
+    } else if (strncmp(arg, "--binary=", 9) == 0) {
+        options->binary_file = arg + 9;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+void optimize_module(IRModule *module) {
+    printf("\n--- Running Optimization Passes ---\n");
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    run_pass_pipeline(module);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("--- Optimization Complete (%.3f ms) ---\n\n",
+           ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9) * 1000.0);
+    layout_stack_frames(module);
+}
+
+void allocate_module_registers(IRModule *module, int num_registers) {
+    printf("--- Register Allocation (%d registers) ---\n", num_registers);
+    // Index -1 stands for the global initializers.
+    for (int i = -1; i < module->num_functions; i++) {
+        IRFunction *fn = i < 0 ? &module->globals : &module->functions[i];
+        if (fn->num_instrs == 0) continue;
+        int spilled = allocate_registers(fn, num_registers);
+        printf("%s: %d used, %d spilled\n", i < 0 ? "(globals)" : string_from_id(fn->name),
+               registers_used(fn), spilled);
+    }
+    printf("------------------------------------------\n\n");
+}
+
+int write_module(IRModule *module, const DriverOptions *options) {
+    int status = 0;
+    if (options->destination) {
+        print_ir_to_file(options->destination); // Save IR to file
+        printf("--- 3-Address Code Generated to %s ---\n", options->destination);
+    }
+    if (options->binary_file) {
+        if (write_ir_binary(options->binary_file, module) == 0) {
+            printf("--- Binary 3-Address Code Generated to %s ---\n", options->binary_file);
+        } else {
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,38 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include "ir.h"
+
+/*
+ * The command-line driver shared by the compiler (parser.y) and c99-opt:
+ * the options both take, the optimization pipeline, register allocation and
+ * writing the result. Each tool handles its own input and extra options.
+ */
+
+typedef struct {
+    const char *destination; // Textual 3AC output, or NULL
+    const char *binary_file; // Binary 3AC output (see ir_binary.h), or NULL
+    int num_registers;       // 0 leaves the temporaries unallocated
+} DriverOptions;
+
+// Returns 1 after listing the passes if --list-passes is anywhere on the
+// command line; the tool then exits.
+int driver_list_passes(int argc, char **argv);
+
+// Parses one argument after the input file if it is a shared option.
+// Returns 1 if it was, 0 if the tool must handle it, or -1 after reporting
+// a bad value.
+int parse_driver_option(const char *arg, DriverOptions *options);
+
+// Runs the pass pipeline, timing it, and lays out the stack frames.
+void optimize_module(IRModule *module);
+
+// Allocates num_registers registers in every function and the global
+// initializers, and reports how many were used and spilled.
+void allocate_module_registers(IRModule *module, int num_registers);
+
+// Writes the module to the outputs named in 'options'. Returns 0, or 1 if
+// the binary file could not be written.
+int write_module(IRModule *module, const DriverOptions *options);
+
+#endif // DRIVER_H
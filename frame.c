@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frame.h"
+#include "string_pool.h"
+#include "alloc.h"
+
+#define ADDRESS_RETURNED 1
+#define ADDRESS_LEAKED   2
+
+typedef struct {
+    char *is_global;        // StringId -> named by the global declarations
+    int *function_of;       // StringId -> function index, or -1
+    int *summary;           // Function -> ADDRESS_* flags for its arguments
+    char *name_derived;     // StringId -> may hold an address being traced
+    char *temp_derived;     // Temporary -> likewise
+    int *call_of;           // PARAM -> index of its CALL or TAILCALL, or -1
+    int num_names;
+    int num_temps;
+} EscapeAnalysis;
+
+// Pairs every PARAM with its call: a call with k arguments takes the last
+// k PARAMs not taken by a call before it.
+static void pair_params(EscapeAnalysis *ea, const IRFunction *fn) {
+    int *stack = (int*) checked_calloc(fn->num_instrs, sizeof(int));
+    int stack_size = 0;
+    for (int i = 0; i < fn->num_instrs; i++) {
+        const Instruction *instr = &fn->instrs[i];
+        ea->call_of[i] = -1;
+        if (instr->opcode == IR_PARAM) {
+            stack[stack_size++] = i;
+        } else if (instr->opcode == IR_CALL || instr->opcode == IR_TAILCALL) {
+            int k = instr->arg2.val.int_val;
+            if (k < 0 || k > stack_size) k = stack_size;
+            for (int j = stack_size - k; j < stack_size; j++) ea->call_of[stack[j]] = i;
+            stack_size -= k;
+        }
+    }
+    free(stack);
+}
+
+static int is_derived(const EscapeAnalysis *ea, Operand op) {
+    if (op.type == OP_TEMPORARY) return op.val.temp < ea->num_temps && ea->temp_derived[op.val.temp];
+    if (op.type == OP_IDENTIFIER) return op.val.name < ea->num_names && ea->name_derived[op.val.name];
+    return 0;
+}
+
+// Marks 'op' as holding a traced address. Returns -1 if 'op' is a global,
+// 1 if it was not marked yet, and 0 otherwise.
+static int mark_derived(EscapeAnalysis *ea, Operand op) {
+    if (op.type == OP_TEMPORARY && op.val.temp < ea->num_temps) {
+        if (ea->temp_derived[op.val.temp]) return 0;
+        ea->temp_derived[op.val.temp] = 1;
+        return 1;
+    }
+    if (op.type == OP_IDENTIFIER && op.val.name < ea->num_names) {
+        if (ea->is_global[op.val.name]) return -1;
+        if (ea->name_derived[op.val.name]) return 0;
+        ea->name_derived[op.val.name] = 1;
+        return 1;
+    }
+    return 0;
+}
+
+// Follows the address of the local aggregate 'local' (or, with -1, the
+// function's arguments) until nothing new is derived from it, and returns
+// how it leaves the function as ADDRESS_* flags. Needs pair_params first.
+static int trace_address(EscapeAnalysis *ea, const IRFunction *fn, int local) {
+    memset(ea->name_derived, 0, ea->num_names);
+    memset(ea->temp_derived, 0, ea->num_temps);
+    if (local >= 0) {
+        ea->name_derived[local] = 1;
+    } else {
+        for (int i = 0; i < fn->num_instrs; i++) {
+            Operand arg = fn->instrs[i].arg1;
+            if (arg.type == OP_IDENTIFIER && ir_param_index(arg.val.name) >= 0) ea->name_derived[arg.val.name] = 1;
+        }
+    }
+    int flags = 0;
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 0; i < fn->num_instrs; i++) {
+            const Instruction *instr = &fn->instrs[i];
+            int marked = 0;
+            switch (instr->opcode) {
+                case IR_RETURN:
+                    if (is_derived(ea, instr->arg1)) flags |= ADDRESS_RETURNED;
+                    break;
+                case IR_INDEX_STORE:
+                    if (is_derived(ea, instr->arg2)) flags |= ADDRESS_LEAKED;
+                    break;
+                case IR_DEREF_STORE:
+                    if (is_derived(ea, instr->arg1)) flags |= ADDRESS_LEAKED;
+                    break;
+                case IR_PARAM: {
+                    if (!is_derived(ea, instr->arg1)) break;
+                    int call = ea->call_of[i];
+                    if (call < 0) {
+                        flags |= ADDRESS_LEAKED;
+                        break;
+                    }
+                    const Instruction *call_instr = &fn->instrs[call];
+                    StringId name = call_instr->arg1.val.name;
+                    int callee = name < ea->num_names ? ea->function_of[name] : -1;
+                    int effect = callee >= 0 ? ea->summary[callee] : ADDRESS_RETURNED;
+                    flags |= effect & ADDRESS_LEAKED;
+                    if (!(effect & ADDRESS_RETURNED)) break;
+                    if (call_instr->opcode == IR_TAILCALL) {
+                        flags |= ADDRESS_RETURNED;
+                    } else {
+                        marked = mark_derived(ea, call_instr->result);
+                    }
+                    break;
+                }
+                case IR_ADDR_OF: case IR_ADDR:
+                    if (!is_derived(ea, instr->arg1)) break;
+                    // The address of a variable holding a traced address
+                    // could be used to store it anywhere.
+                    if (instr->arg1.type != OP_IDENTIFIER || instr->arg1.val.name != local) {
+                        flags |= ADDRESS_LEAKED;
+                        break;
+                    }
+                    marked = mark_derived(ea, instr->result);
+                    break;
+                case IR_INDEX_LOAD: case IR_DEREF_LOAD: case IR_DEREF: case IR_CALL:
+                case IR_ALLOC_HEAP: case IR_ALLOC_STACK: case IR_FREE_HEAP:
+                    break;
+                default:
+                    if (ir_defines_result(instr->opcode) &&
+                        (is_derived(ea, instr->arg1) || is_derived(ea, instr->arg2))) {
+                        marked = mark_derived(ea, instr->result);
+                    }
+                    break;
+            }
+            if (marked < 0) flags |= ADDRESS_LEAKED;
+            if (marked > 0) changed = 1;
+        }
+        if (local >= 0 && flags) break;
+    }
+    return flags;
+}
+
+static int slot_alignment(int size) {
+    int align = 1;
+    while (align < 8 && size > 0 && size % (align * 2) == 0) align *= 2;
+    return align;
+}
+
+static int layout_frame(EscapeAnalysis *ea, IRFunction *fn) {
+    // The allocations that stay in the frame, with escapes decided once
+    // per name (a name declared in two scopes gets two slots).
+    char *checked = (char*) checked_calloc(ea->num_names, sizeof(char)); // 0 unknown, 1 stays, 2 escapes
+    int *slots = (int*) checked_calloc(fn->num_instrs, sizeof(int));
+    int num_slots = 0;
+    for (int i = 0; i < fn->num_instrs; i++) {
+        const Instruction *instr = &fn->instrs[i];
+        if (instr->opcode != IR_ALLOC_HEAP || instr->result.type != OP_IDENTIFIER ||
+            instr->arg1.type != OP_INT_CONST) {
+            continue;
+        }
+        StringId name = instr->result.val.name;
+        if (name >= ea->num_names || ea->is_global[name]) continue;
+        if (!checked[name]) checked[name] = trace_address(ea, fn, name) ? 2 : 1;
+        if (checked[name] == 1) slots[num_slots++] = i;
+    }
+
+    // Most aligned first, otherwise in code order.
+    for (int i = 1; i < num_slots; i++) {
+        int slot = slots[i];
+        int align = slot_alignment(fn->instrs[slot].arg1.val.int_val);
+        int j = i;
+        while (j > 0 && slot_alignment(fn->instrs[slots[j - 1]].arg1.val.int_val) < align) {
+            slots[j] = slots[j - 1];
+            j--;
+        }
+        slots[j] = slot;
+    }
+    int offset = 0;
+    for (int i = 0; i < num_slots; i++) {
+        Instruction *instr = &fn->instrs[slots[i]];
+        int size = instr->arg1.val.int_val;
+        int align = slot_alignment(size);
+        offset = (offset + align - 1) / align * align;
+        instr->opcode = IR_ALLOC_STACK;
+        instr->arg2 = create_operand_int(offset);
+        offset += size;
+    }
+    fn->frame_size = (offset + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT * FRAME_ALIGNMENT;
+
+    // The frame goes away with the function; nothing to free.
+    int kept = 0;
+    for (int i = 0; i < fn->num_instrs; i++) {
+        const Instruction *instr = &fn->instrs[i];
+        if (instr->opcode == IR_FREE_HEAP && instr->arg1.type == OP_IDENTIFIER &&
+            instr->arg1.val.name < ea->num_names && checked[instr->arg1.val.name] == 1) {
+            continue;
+        }
+        fn->instrs[kept++] = *instr;
+    }
+    fn->num_instrs = kept;
+    free(checked);
+    free(slots);
+    return num_slots;
+}
+
+int layout_stack_frames(IRModule *module) {
+    EscapeAnalysis ea;
+    memset(&ea, 0, sizeof(ea));
+    ea.num_names = string_pool_size();
+    ea.num_temps = module->num_temps;
+    ea.is_global = (char*) checked_calloc(ea.num_names, sizeof(char));
+    ea.function_of = (int*) checked_calloc(ea.num_names, sizeof(int));
+    ea.summary = (int*) checked_calloc(module->num_functions, sizeof(int));
+    ea.name_derived = (char*) checked_calloc(ea.num_names, sizeof(char));
+    ea.temp_derived = (char*) checked_calloc(ea.num_temps, sizeof(char));
+    for (int i = 0; i < module->globals.num_instrs; i++) {
+        const Instruction *instr = &module->globals.instrs[i];
+        if (instr->result.type == OP_IDENTIFIER) ea.is_global[instr->result.val.name] = 1;
+    }
+    memset(ea.function_of, -1, ea.num_names * sizeof(int));
+    int max_instrs = 0;
+    for (int f = 0; f < module->num_functions; f++) {
+        ea.function_of[module->functions[f].name] = f;
+        if (module->functions[f].num_instrs > max_instrs) max_instrs = module->functions[f].num_instrs;
+    }
+    ea.call_of = (int*) checked_calloc(max_instrs, sizeof(int));
+
+    // Summaries start out empty and only grow, so recursive functions
+    // settle on the smallest consistent answer.
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int f = 0; f < module->num_functions; f++) {
+            pair_params(&ea, &module->functions[f]);
+            int flags = ea.summary[f] | trace_address(&ea, &module->functions[f], -1);
+            if (flags != ea.summary[f]) {
+                ea.summary[f] = flags;
+                changed = 1;
+            }
+        }
+    }
+
+    int moved = 0;
+    for (int f = 0; f < module->num_functions; f++) {
+        pair_params(&ea, &module->functions[f]);
+        moved += layout_frame(&ea, &module->functions[f]);
+    }
+    free(ea.is_global);
+    free(ea.function_of);
+    free(ea.summary);
+    free(ea.name_derived);
+    free(ea.temp_derived);
+    free(ea.call_of);
+    return moved;
+}
+
+void print_stack_frame(FILE *fp, const IRFunction *fn) {
+    int printed = 0;
+    for (int i = 0; i < fn->num_instrs; i++) {
+        const Instruction *instr = &fn->instrs[i];
+        if (instr->opcode != IR_ALLOC_STACK && instr->opcode != IR_ALLOC_HEAP) continue;
+        if (!printed) {
+            fprintf(fp, "%s: %d-byte frame\n", string_from_id(fn->name), fn->frame_size);
+            printed = 1;
+        }
+        fprintf(fp, "    %s: %d bytes", string_from_id(instr->result.val.name), instr->arg1.val.int_val);
+        if (instr->opcode == IR_ALLOC_STACK) {
+            fprintf(fp, " at offset %d\n", instr->arg2.val.int_val);
+        } else {
+            fprintf(fp, " on the heap (escapes)\n");
+        }
+    }
+}
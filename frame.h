@@ -0,0 +1,34 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdio.h>
+#include "ir.h"
+
+/*
+ * Stack frame layout. The IR generator gives every local struct, union and
+ * array an 'ALLOC_HEAP name, size', and a 'FREE_HEAP name' where its scope
+ * ends. Those whose address cannot outlive the function become 'ALLOC_STACK
+ * name, size, offset': a slot at a fixed offset in the function's frame,
+ * which is fn->frame_size bytes long, and lose their FREE_HEAPs.
+ *
+ * A local escapes when a value derived from its address (by copies,
+ * arithmetic or ADDR_OF) is returned, stored to memory or to a global, or
+ * passed to a function that lets its arguments escape. Escaping locals keep
+ * their heap allocation. Each function with IR is summarized by whether it
+ * may return or leak an address derived from its arguments; a function
+ * without IR (a library function) may return one but does not keep it.
+ *
+ * Slots are aligned to the largest power of two (up to 8) dividing their
+ * size, placed by decreasing alignment, and the frame is a multiple of 16.
+ */
+
+#define FRAME_ALIGNMENT 16
+
+// Lays out the frames of the module's functions, which must be linear.
+// Returns the number of allocations moved to the stack.
+int layout_stack_frames(IRModule *module);
+
+// Prints the frame size and where each local aggregate lives.
+void print_stack_frame(FILE *fp, const IRFunction *fn);
+
+#endif // FRAME_H
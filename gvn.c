@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "passes.h"
+#include "cfg.h"
+#include "alloc.h"
+
+/*
+ * Value numbering on SSA form. Each instruction is hashed on its opcode and
+ * the value numbers of its operands; if an equal expression is already
+ * available, the instruction is deleted and its temporary is replaced by the
+ * earlier one everywhere. Operations on constants are folded on the way.
+ *
+ * "lvn" keeps the table for one basic block at a time. "gvn" walks the
+ * dominator tree and keeps the entries of every dominating block in scope,
+ * so an expression computed in a dominator is reused below it.
+ *
+ * Temporaries are single-assignment, so expressions over temporaries and
+ * constants stay valid wherever they are in scope. Identifiers and loads read
+ * memory: their entries carry a memory epoch, bumped by every store, call
+ * and identifier write, and are only reused inside the block that made them.
+ * A store also records the value it wrote, so a later load of the same place
+ * reuses it.
+ */
+
+typedef struct {
+    OpCode opcode;
+    Operand arg1, arg2;
+    int block;  // Block id for memory-dependent entries, -1 otherwise
+    int epoch;  // Memory epoch for memory-dependent entries, 0 otherwise
+} ExprKey;
+
+typedef struct {
+    ExprKey key;
+    Operand value;
+    int next;   // Next entry in the bucket, or -1
+} ExprEntry;
+
+typedef struct {
+    IRFunction *fn;
+    int num_temps;
+    Operand *value;    // Value of each temporary; OP_NONE while it is its own
+    int *buckets;
+    int num_buckets;   // Power of two
+    ExprEntry *entries;
+    int num_entries;
+    int entries_capacity;
+    int epoch;
+    int changes;
+} ValueNumbering;
+
+static Operand value_of(ValueNumbering *vn, Operand op) {
+    while (op.type == OP_TEMPORARY && op.val.temp < vn->num_temps &&
+           vn->value[op.val.temp].type != OP_NONE) {
+        op = vn->value[op.val.temp];
+    }
+    return op;
+}
+
+static unsigned int hash_operand(Operand op) {
+    unsigned int h = (unsigned int) op.type * 0x9e3779b1u;
+    if (op.type == OP_FLOAT_CONST) {
+        double d = operand_float_value(op);
+        unsigned int bits[2] = { 0, 0 };
+        memcpy(bits, &d, sizeof(d) < sizeof(bits) ? sizeof(d) : sizeof(bits));
+        return h ^ bits[0] ^ (bits[1] * 31u);
+    }
+    return h ^ ((unsigned int) op.val.id * 0x85ebca6bu);
+}
+
+static unsigned int hash_key(const ExprKey *key) {
+    unsigned int h = (unsigned int) key->opcode * 0xc2b2ae35u;
+    h ^= hash_operand(key->arg1) + 0x27d4eb2fu + (h << 6) + (h >> 2);
+    h ^= hash_operand(key->arg2) + 0x165667b1u + (h << 6) + (h >> 2);
+    h ^= (unsigned int) key->block * 0x1b873593u;
+    h ^= (unsigned int) key->epoch * 0xcc9e2d51u;
+    return h;
+}
+
+static int keys_equal(const ExprKey *a, const ExprKey *b) {
+    return a->opcode == b->opcode && a->block == b->block && a->epoch == b->epoch &&
+           are_operands_equal(a->arg1, b->arg1) && are_operands_equal(a->arg2, b->arg2);
+}
+
+static Operand* lookup(ValueNumbering *vn, const ExprKey *key) {
+    int e = vn->buckets[hash_key(key) & (vn->num_buckets - 1)];
+    for (; e >= 0; e = vn->entries[e].next) {
+        if (keys_equal(&vn->entries[e].key, key)) return &vn->entries[e].value;
+    }
+    return NULL;
+}
+
+static void insert(ValueNumbering *vn, const ExprKey *key, Operand value) {
+    if (vn->num_entries == vn->entries_capacity) {
+        vn->entries_capacity = vn->entries_capacity ? vn->entries_capacity * 2 : 256;
+        vn->entries = (ExprEntry*) checked_realloc(vn->entries, vn->entries_capacity, sizeof(ExprEntry));
+    }
+    unsigned int bucket = hash_key(key) & (vn->num_buckets - 1);
+    ExprEntry *entry = &vn->entries[vn->num_entries];
+    entry->key = *key;
+    entry->value = value;
+    entry->next = vn->buckets[bucket];
+    vn->buckets[bucket] = vn->num_entries++;
+}
+
+// Removes the entries added since 'mark'. Entries are only ever removed in
+// reverse order of insertion, so each one is the head of its bucket.
+static void undo_to(ValueNumbering *vn, int mark) {
+    while (vn->num_entries > mark) {
+        ExprEntry *entry = &vn->entries[--vn->num_entries];
+        vn->buckets[hash_key(&entry->key) & (vn->num_buckets - 1)] = entry->next;
+    }
+}
+
+static int is_commutative(OpCode opcode) {
+    switch (opcode) {
+        case IR_ADD: case IR_MUL: case IR_EQ: case IR_NE:
+        case IR_AND: case IR_OR: case IR_BIT_AND: case IR_BIT_OR: case IR_XOR:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Opcodes whose result depends only on their operands (and, for loads and
+// reads of identifiers, on memory).
+static int is_numberable(OpCode opcode) {
+    switch (opcode) {
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+        case IR_ASSIGN:
+        case IR_EQ: case IR_NE: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+        case IR_AND: case IR_OR: case IR_BIT_AND: case IR_BIT_OR: case IR_XOR:
+        case IR_SHL: case IR_SHR:
+        case IR_UNARY_MINUS: case IR_NOT: case IR_BIT_NOT:
+        case IR_ADDR_OF: case IR_DEREF_LOAD: case IR_INDEX_LOAD:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int is_value_operand(Operand op) {
+    return op.type == OP_TEMPORARY || is_constant_operand(op);
+}
+
+static ExprKey make_key(ValueNumbering *vn, BasicBlock *block, OpCode opcode, Operand arg1, Operand arg2) {
+    ExprKey key;
+    key.opcode = opcode;
+    key.arg1 = arg1;
+    key.arg2 = arg2;
+    if (is_commutative(opcode) && hash_operand(arg2) < hash_operand(arg1)) {
+        key.arg1 = arg2;
+        key.arg2 = arg1;
+    }
+    int reads_memory = opcode == IR_INDEX_LOAD || opcode == IR_DEREF_LOAD ||
+                       arg1.type == OP_IDENTIFIER || arg2.type == OP_IDENTIFIER;
+    key.block = reads_memory ? block->id : -1;
+    key.epoch = reads_memory ? vn->epoch : 0;
+    return key;
+}
+
+static void number_instruction(ValueNumbering *vn, BasicBlock *block, Instruction *instr) {
+    instr->arg1 = value_of(vn, instr->arg1);
+    instr->arg2 = value_of(vn, instr->arg2);
+    if (ir_reads_result(instr->opcode)) instr->result = value_of(vn, instr->result);
+
+    int defines_temp = ir_defines_result(instr->opcode) && instr->result.type == OP_TEMPORARY &&
+                       instr->result.val.temp < vn->num_temps;
+    if (defines_temp && instr->opcode == IR_ASSIGN && is_value_operand(instr->arg1)) {
+        // A copy: the temporary is just another name for the value.
+        vn->value[instr->result.val.temp] = instr->arg1;
+        instr->opcode = IR_NOP;
+        vn->changes++;
+        return;
+    }
+    Operand folded;
+    if (defines_temp && fold_constant_operation(instr->opcode, instr->arg1, instr->arg2, &folded)) {
+        vn->value[instr->result.val.temp] = folded;
+        instr->opcode = IR_NOP;
+        vn->changes++;
+        return;
+    }
+    if (defines_temp && is_numberable(instr->opcode)) {
+        ExprKey key = make_key(vn, block, instr->opcode, instr->arg1, instr->arg2);
+        Operand *known = lookup(vn, &key);
+        if (known) {
+            vn->value[instr->result.val.temp] = *known;
+            instr->opcode = IR_NOP;
+            vn->changes++;
+        } else {
+            insert(vn, &key, instr->result);
+        }
+        return;
+    }
+
+    // Anything that may write memory starts a new epoch.
+    switch (instr->opcode) {
+        case IR_INDEX_STORE:
+            vn->epoch++;
+            if (is_value_operand(instr->arg2)) {
+                ExprKey key = make_key(vn, block, IR_INDEX_LOAD, instr->result, instr->arg1);
+                insert(vn, &key, instr->arg2);
+            }
+            break;
+        case IR_DEREF_STORE:
+            vn->epoch++;
+            if (is_value_operand(instr->arg1)) {
+                ExprKey key = make_key(vn, block, IR_DEREF_LOAD, instr->result, create_operand_none());
+                insert(vn, &key, instr->arg1);
+            }
+            break;
+        case IR_CALL: case IR_TAILCALL: case IR_ALLOC_HEAP: case IR_ALLOC_STACK: case IR_FREE_HEAP:
+            vn->epoch++;
+            break;
+        default:
+            if (ir_defines_result(instr->opcode) && instr->result.type == OP_IDENTIFIER) {
+                vn->epoch++;
+                if (instr->opcode == IR_ASSIGN && is_value_operand(instr->arg1)) {
+                    ExprKey key = make_key(vn, block, IR_ASSIGN, instr->result, create_operand_none());
+                    insert(vn, &key, instr->arg1);
+                }
+            }
+            break;
+    }
+}
+
+// A phi whose arguments all have the same value (ignoring the phi itself,
+// around a loop) is that value.
+static int number_phi(ValueNumbering *vn, BasicBlock *block, PhiNode *phi) {
+    Operand same = create_operand_none();
+    for (int p = 0; p < block->num_preds; p++) {
+        Operand arg = value_of(vn, phi->args[p]);
+        phi->args[p] = arg;
+        if (arg.type == OP_NONE || are_operands_equal(arg, phi->result)) continue;
+        if (same.type != OP_NONE && !are_operands_equal(arg, same)) return 0;
+        same = arg;
+    }
+    if (!is_value_operand(same)) return 0;
+    vn->value[phi->result.val.temp] = same;
+    return 1;
+}
+
+static void number_block(ValueNumbering *vn, BasicBlock *block) {
+    int kept = 0;
+    for (int i = 0; i < block->num_phis; i++) {
+        if (number_phi(vn, block, &block->phis[i])) {
+            free(block->phis[i].args);
+            vn->changes++;
+        } else {
+            block->phis[kept++] = block->phis[i];
+        }
+    }
+    block->num_phis = kept;
+    for (int i = 0; i < block->num_instrs; i++) {
+        number_instruction(vn, block, &block->instrs[i]);
+    }
+}
+
+// Rewrites every remaining use to its value and drops deleted instructions.
+static void substitute_values(ValueNumbering *vn) {
+    IRFunction *fn = vn->fn;
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        for (int i = 0; i < block->num_phis; i++) {
+            for (int p = 0; p < block->num_preds; p++) {
+                block->phis[i].args[p] = value_of(vn, block->phis[i].args[p]);
+            }
+        }
+        int kept = 0;
+        for (int i = 0; i < block->num_instrs; i++) {
+            Instruction instr = block->instrs[i];
+            if (instr.opcode == IR_NOP) continue;
+            instr.arg1 = value_of(vn, instr.arg1);
+            instr.arg2 = value_of(vn, instr.arg2);
+            if (ir_reads_result(instr.opcode)) instr.result = value_of(vn, instr.result);
+            block->instrs[kept++] = instr;
+        }
+        block->num_instrs = kept;
+    }
+}
+
+static int run_value_numbering(IRFunction *fn, int local_only) {
+    ValueNumbering vn;
+    memset(&vn, 0, sizeof(vn));
+    vn.fn = fn;
+    vn.num_temps = ir_module.num_temps;
+    vn.value = (Operand*) checked_calloc(vn.num_temps, sizeof(Operand));
+    int num_instrs = 0;
+    for (int b = 0; b < fn->num_blocks; b++) num_instrs += fn->blocks[b]->num_instrs;
+    vn.num_buckets = 64;
+    while (vn.num_buckets < 2 * num_instrs) vn.num_buckets *= 2;
+    vn.buckets = (int*) checked_calloc(vn.num_buckets, sizeof(int));
+    memset(vn.buckets, -1, vn.num_buckets * sizeof(int));
+
+    if (local_only) {
+        for (int b = 0; b < fn->num_blocks; b++) {
+            number_block(&vn, fn->blocks[b]);
+            undo_to(&vn, 0);
+        }
+    } else {
+        // Preorder walk of the dominator tree; leaving a block drops the
+        // entries it added.
+        compute_dominators(fn);
+        BasicBlock **stack = (BasicBlock**) checked_calloc(fn->num_blocks, sizeof(BasicBlock*));
+        int *mark = (int*) checked_calloc(fn->num_blocks, sizeof(int));
+        int *next_child = (int*) checked_calloc(fn->num_blocks, sizeof(int));
+        int depth = 0;
+        stack[depth++] = fn->blocks[CFG_ENTRY];
+        number_block(&vn, fn->blocks[CFG_ENTRY]);
+        while (depth > 0) {
+            BasicBlock *block = stack[depth - 1];
+            if (next_child[block->id] < block->num_dom_children) {
+                BasicBlock *child = block->dom_children[next_child[block->id]++];
+                mark[child->id] = vn.num_entries;
+                number_block(&vn, child);
+                stack[depth++] = child;
+            } else {
+                undo_to(&vn, mark[block->id]);
+                depth--;
+            }
+        }
+        free(stack);
+        free(mark);
+        free(next_child);
+    }
+    substitute_values(&vn);
+
+    free(vn.value);
+    free(vn.buckets);
+    free(vn.entries);
+    return vn.changes;
+}
+
+int run_lvn(IRFunction *fn) {
+    return run_value_numbering(fn, 1);
+}
+
+int run_gvn(IRFunction *fn) {
+    return run_value_numbering(fn, 0);
+}
@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "passes.h"
+#include "callgraph.h"
+#include "string_pool.h"
+#include "alloc.h"
+
+/*
+ * Function inlining. Functions are visited bottom-up over the call graph,
+ * so a callee has received its own inlined calls before it is copied into
+ * its callers. A call is inlined when the callee has IR, is not main, is not
+ * recursive, and costs (in instructions, labels not counted) at most the
+ * inline budget.
+ *
+ *         PARAM a                      ASSIGN p0, a
+ *         PARAM b             =>       ASSIGN p1, b
+ *         CALL f, 2,t                  <body of f>
+ *                              Lend:
+ *
+ * In the copied body ARG0 and ARG1 read p0 and p1, RETURN v becomes
+ * 'ASSIGN t, v' and a jump to Lend, a TAILCALL becomes a CALL into t and a
+ * jump to Lend, and temporaries, labels and local names
+ * are renamed (a local x becomes x.<n>, n counting the inlined calls).
+ * Names that the global declarations define are shared. An inlined TAILCALL
+ * puts back the RETURN it replaced, after Lend.
+ */
+
+#define DEFAULT_INLINE_BUDGET 30
+
+// Inlining into a function stops once it has grown by its own size plus
+// this many instructions.
+#define INLINE_GROWTH_SLACK 1000
+
+static int inline_budget = DEFAULT_INLINE_BUDGET;
+
+void set_inline_budget(int budget) {
+    inline_budget = budget < 0 ? 0 : budget;
+}
+
+// Maps from old to new numbers that are reset for every inlined call by
+// bumping a stamp rather than clearing them.
+typedef struct {
+    int *value;
+    int *stamp;
+    int size;
+} RenameMap;
+
+static int* rename_slot(RenameMap *map, int key, int stamp) {
+    if (key >= map->size) {
+        int size = map->size ? map->size : 64;
+        while (size <= key) size *= 2;
+        map->value = (int*) checked_realloc(map->value, size, sizeof(int));
+        map->stamp = (int*) checked_realloc(map->stamp, size, sizeof(int));
+        memset(map->stamp + map->size, 0, (size - map->size) * sizeof(int));
+        map->size = size;
+    }
+    if (map->stamp[key] != stamp) {
+        map->stamp[key] = stamp;
+        map->value[key] = -1;
+    }
+    return &map->value[key];
+}
+
+typedef struct {
+    IRModule *module;
+    int *function_of;       // StringId -> function index, or -1
+    char *is_global;        // StringId -> defined by the global declarations
+    int num_names;          // Size of the two arrays above
+    int *cost;              // Per function
+    RenameMap temps, labels, names;
+    int num_sites;          // Calls inlined so far; also the rename stamp
+    Instruction *out;       // The caller's new instructions
+    int out_size;
+    int out_capacity;
+} Inliner;
+
+static void out_append(Inliner *in, Instruction instr) {
+    if (in->out_size == in->out_capacity) {
+        in->out_capacity = in->out_capacity ? in->out_capacity * 2 : 64;
+        in->out = (Instruction*) checked_realloc(in->out, in->out_capacity, sizeof(Instruction));
+    }
+    in->out[in->out_size++] = instr;
+}
+
+static Instruction make_instr(OpCode opcode, Operand result, Operand arg1, Operand arg2) {
+    Instruction instr;
+    instr.opcode = opcode;
+    instr.result = result;
+    instr.arg1 = arg1;
+    instr.arg2 = arg2;
+    return instr;
+}
+
+static int is_function_name(const Inliner *in, Operand op) {
+    return op.type == OP_IDENTIFIER && op.val.name < in->num_names && in->function_of[op.val.name] >= 0;
+}
+
+// Instructions the callee adds to a caller, or -1 if it cannot be inlined.
+static int inline_cost(IRFunction *fn) {
+    if (fn->name == string_id(intern_string("main"))) return -1;
+    int cost = 0;
+    for (int i = 0; i < fn->num_instrs; i++) {
+        OpCode opcode = fn->instrs[i].opcode;
+        if (opcode == IR_HALT) return -1;
+        if (opcode != IR_LABEL && opcode != IR_NOP) cost++;
+    }
+    return cost;
+}
+
+// Number of arguments the callee reads (one more than its highest ARGn).
+static int parameters_read(IRFunction *fn) {
+    int count = 0;
+    for (int i = 0; i < fn->num_instrs; i++) {
+        const Operand *ops[3] = { &fn->instrs[i].result, &fn->instrs[i].arg1, &fn->instrs[i].arg2 };
+        for (int k = 0; k < 3; k++) {
+            if (ops[k]->type != OP_IDENTIFIER) continue;
+            int n = ir_param_index(ops[k]->val.name);
+            if (n >= count) count = n + 1;
+        }
+    }
+    return count;
+}
+
+static Operand rename_operand(Inliner *in, Operand op, const Operand *args) {
+    int stamp = in->num_sites;
+    int *slot;
+    switch (op.type) {
+        case OP_TEMPORARY:
+            slot = rename_slot(&in->temps, op.val.temp, stamp);
+            if (*slot < 0) *slot = create_operand_temp().val.temp;
+            op.val.temp = *slot;
+            return op;
+        case OP_LABEL:
+            slot = rename_slot(&in->labels, op.val.label, stamp);
+            if (*slot < 0) *slot = create_operand_label().val.label;
+            op.val.label = *slot;
+            return op;
+        case OP_IDENTIFIER: {
+            int n = ir_param_index(op.val.name);
+            if (n >= 0) return args[n];
+            if (op.val.name < in->num_names && in->is_global[op.val.name]) return op;
+            slot = rename_slot(&in->names, op.val.name, stamp);
+            if (*slot < 0) {
+                const char *name = string_from_id(op.val.name);
+                char *local = (char*) checked_calloc(strlen(name) + 16, sizeof(char));
+                sprintf(local, "%s.%d", name, stamp);
+                *slot = string_id(intern_string(local));
+                free(local);
+            }
+            op.val.name = *slot;
+            return op;
+        }
+        default:
+            return op;
+    }
+}
+
+// Appends a renamed copy of the callee's body that leaves its return value
+// in 'result'.
+static void copy_callee(Inliner *in, IRFunction *callee, const Operand *args, Operand result) {
+    in->num_sites++;
+    Operand none = create_operand_none();
+    Operand end = create_operand_label();
+    int last = callee->num_instrs - 1;
+    while (last >= 0 && callee->instrs[last].opcode == IR_LABEL) last--;
+    for (int i = 0; i < callee->num_instrs; i++) {
+        Instruction instr = callee->instrs[i];
+        if (instr.opcode == IR_NOP) continue;
+        if (instr.opcode == IR_RETURN) {
+            if (instr.arg1.type != OP_NONE) {
+                out_append(in, make_instr(IR_ASSIGN, result, rename_operand(in, instr.arg1, args), none));
+            }
+            if (i != last) out_append(in, make_instr(IR_GOTO, end, none, none));
+            continue;
+        }
+        if (instr.opcode == IR_TAILCALL) {
+            out_append(in, make_instr(IR_CALL, result, instr.arg1, instr.arg2));
+            if (i != last) out_append(in, make_instr(IR_GOTO, end, none, none));
+            continue;
+        }
+        if (instr.opcode == IR_JUMP_TABLE) {
+            JumpTable *table = &ir_module.jump_tables[instr.result.val.int_val];
+            int num_labels = table->num_labels;
+            int *labels = (int*) checked_calloc(num_labels, sizeof(int));
+            for (int l = 0; l < num_labels; l++) {
+                Operand label;
+                label.type = OP_LABEL;
+                label.val.label = table->labels[l];
+                labels[l] = rename_operand(in, label, args).val.label;
+            }
+            instr.result = create_operand_int(add_jump_table(labels, num_labels));
+            free(labels);
+        } else {
+            instr.result = rename_operand(in, instr.result, args);
+        }
+        // The callee's name in a CALL stays as it is.
+        if (instr.opcode != IR_CALL) instr.arg1 = rename_operand(in, instr.arg1, args);
+        instr.arg2 = rename_operand(in, instr.arg2, args);
+        out_append(in, instr);
+    }
+    out_append(in, make_instr(IR_LABEL, end, none, none));
+}
+
+static int inline_calls(Inliner *in, CallGraph *graph, int caller) {
+    IRFunction *fn = &in->module->functions[caller];
+    int n = fn->num_instrs;
+    // Pair every PARAM with its CALL: arguments are pushed in order and a
+    // CALL with k arguments takes the last k.
+    int *stack = (int*) checked_calloc(n, sizeof(int));
+    int *first_param = (int*) checked_calloc(n, sizeof(int)); // CALL -> index in 'params', or -1
+    int *params = (int*) checked_calloc(n, sizeof(int));       // PARAM indices, grouped per CALL
+    int *param_call = (int*) checked_calloc(n, sizeof(int));   // PARAM -> its CALL, or -1
+    int stack_size = 0, num_params = 0;
+    memset(param_call, -1, n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        Instruction *instr = &fn->instrs[i];
+        first_param[i] = -1;
+        if (instr->opcode == IR_PARAM) {
+            stack[stack_size++] = i;
+        } else if (instr->opcode == IR_CALL || instr->opcode == IR_TAILCALL) {
+            int k = instr->arg2.val.int_val;
+            if (k < 0 || k > stack_size) {
+                stack_size = 0;
+                continue;
+            }
+            first_param[i] = num_params;
+            for (int j = stack_size - k; j < stack_size; j++) {
+                params[num_params++] = stack[j];
+                param_call[stack[j]] = i;
+            }
+            stack_size -= k;
+        }
+    }
+
+    // Choose the calls to inline, as long as the caller stays small enough.
+    char *inline_at = (char*) checked_calloc(n, sizeof(char));
+    int size = n, limit = 2 * n + INLINE_GROWTH_SLACK, chosen = 0;
+    for (int i = 0; i < n; i++) {
+        Instruction *instr = &fn->instrs[i];
+        if (instr->opcode != IR_CALL && instr->opcode != IR_TAILCALL) continue;
+        if (first_param[i] < 0 || !is_function_name(in, instr->arg1)) continue;
+        int callee = in->function_of[instr->arg1.val.name];
+        if (graph->nodes[callee].recursive || callee == caller) continue;
+        int cost = in->cost[callee];
+        if (cost < 0 || cost > inline_budget || size + cost > limit) continue;
+        if (parameters_read(&in->module->functions[callee]) > instr->arg2.val.int_val) continue;
+        inline_at[i] = 1;
+        size += cost;
+        chosen++;
+    }
+
+    if (chosen > 0) {
+        // Argument temporaries, created when their PARAM is reached.
+        Operand *arg_temp = (Operand*) checked_calloc(n, sizeof(Operand));
+        in->out_size = 0;
+        for (int i = 0; i < n; i++) {
+            Instruction instr = fn->instrs[i];
+            if (instr.opcode == IR_PARAM && param_call[i] >= 0 && inline_at[param_call[i]]) {
+                arg_temp[i] = create_operand_temp();
+                out_append(in, make_instr(IR_ASSIGN, arg_temp[i], instr.arg1, create_operand_none()));
+            } else if (inline_at[i]) {
+                int k = instr.arg2.val.int_val;
+                Operand *args = (Operand*) checked_calloc(k, sizeof(Operand));
+                for (int j = 0; j < k; j++) args[j] = arg_temp[params[first_param[i] + j]];
+                Operand result = instr.opcode == IR_TAILCALL ? create_operand_temp() : instr.result;
+                copy_callee(in, &in->module->functions[in->function_of[instr.arg1.val.name]], args, result);
+                if (instr.opcode == IR_TAILCALL) {
+                    out_append(in, make_instr(IR_RETURN, create_operand_none(), result, create_operand_none()));
+                }
+                free(args);
+            } else {
+                out_append(in, instr);
+            }
+        }
+        free(arg_temp);
+        // Hand the new array to the function and keep its old one for reuse.
+        Instruction *old = fn->instrs;
+        int old_capacity = fn->capacity;
+        fn->instrs = in->out;
+        fn->num_instrs = in->out_size;
+        fn->capacity = in->out_capacity;
+        in->out = old;
+        in->out_capacity = old_capacity;
+        in->out_size = 0;
+        in->cost[caller] = inline_cost(fn);
+    }
+    free(stack);
+    free(first_param);
+    free(params);
+    free(param_call);
+    free(inline_at);
+    return chosen;
+}
+
+int run_inliner(IRModule *module) {
+    if (inline_budget == 0 || module->num_functions == 0) return 0;
+    Inliner in;
+    memset(&in, 0, sizeof(in));
+    in.module = module;
+    in.num_names = string_pool_size();
+    in.function_of = (int*) checked_calloc(in.num_names, sizeof(int));
+    in.is_global = (char*) checked_calloc(in.num_names, sizeof(char));
+    memset(in.function_of, -1, in.num_names * sizeof(int));
+    for (int f = 0; f < module->num_functions; f++) {
+        in.function_of[module->functions[f].name] = f;
+    }
+    for (int i = 0; i < module->globals.num_instrs; i++) {
+        const Operand *ops[3] = { &module->globals.instrs[i].result, &module->globals.instrs[i].arg1,
+                                  &module->globals.instrs[i].arg2 };
+        for (int k = 0; k < 3; k++) {
+            if (ops[k]->type == OP_IDENTIFIER) in.is_global[ops[k]->val.name] = 1;
+        }
+    }
+    in.cost = (int*) checked_calloc(module->num_functions, sizeof(int));
+    for (int f = 0; f < module->num_functions; f++) {
+        in.cost[f] = inline_cost(&module->functions[f]);
+    }
+
+    CallGraph *graph = build_call_graph(module);
+    int changes = 0;
+    for (int i = 0; i < graph->num_nodes; i++) {
+        changes += inline_calls(&in, graph, graph->bottom_up[i]);
+    }
+    free_call_graph(graph);
+    free(in.function_of);
+    free(in.is_global);
+    free(in.cost);
+    free(in.temps.value);
+    free(in.temps.stamp);
+    free(in.labels.value);
+    free(in.labels.stamp);
+    free(in.names.value);
+    free(in.names.stamp);
+    free(in.out);
+    return changes;
+}
@@ -0,0 +1,542 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "ir.h"
+#include "string_pool.h"  // Operand names are interned
+#include "cfg.h"
+#include "alloc.h"
+
+/* --- The IR module --- */
+IRModule ir_module = { .globals = { .name = -1 } };
+
+Operand create_operand_none() {
+    Operand op;
+    op.type = OP_NONE;
+    op.val.id = 0;
+    return op;
+}
+
+Operand create_operand_int(int val) {
+    Operand op;
+    op.type = OP_INT_CONST;
+    op.val.int_val = val;
+    return op;
+}
+
+Operand create_operand_float(double val) {
+    //printf("DEBUG: Float constant: %f\n", val);
+    if (ir_module.num_float_consts == ir_module.float_consts_capacity) {
+        ir_module.float_consts_capacity = ir_module.float_consts_capacity ? ir_module.float_consts_capacity * 2 : 16;
+        ir_module.float_consts = (double*) checked_realloc(ir_module.float_consts, ir_module.float_consts_capacity, sizeof(double));
+    }
+    Operand op;
+    op.type = OP_FLOAT_CONST;
+    op.val.float_index = ir_module.num_float_consts;
+    ir_module.float_consts[ir_module.num_float_consts++] = val;
+    return op;
+}
+
+Operand create_operand_char(char val) {
+    Operand op;
+    op.type = OP_CHAR_CONST;
+    op.val.char_val = val;
+    return op;
+}
+
+Operand create_operand_string(const char *val) {
+    Operand op;
+    op.type = OP_STRING_LITERAL;
+    op.val.str_id = string_id(intern_string(val));
+    return op;
+}
+
+Operand create_operand_identifier(const char *name) {
+    Operand op;
+    op.type = OP_IDENTIFIER;
+    op.val.name = string_id(intern_string(name));
+    return op;
+}
+
+Operand create_operand_temp() {
+    Operand op;
+    op.type = OP_TEMPORARY;
+    op.val.temp = ir_module.num_temps++;
+    return op;
+}
+
+Operand create_operand_label() {
+    Operand op;
+    op.type = OP_LABEL;
+    op.val.label = ir_module.num_labels++;
+    return op;
+}
+
+Operand create_operand_register(int reg) {
+    Operand op;
+    op.type = OP_REGISTER;
+    op.val.reg = reg;
+    return op;
+}
+
+int ir_param_index(StringId name) {
+    const char *s = string_from_id(name);
+    if (strncmp(s, "ARG", 3) != 0 || s[3] < '0' || s[3] > '9' || strlen(s + 3) > 9) return -1;
+    for (const char *p = s + 3; *p; p++) {
+        if (*p < '0' || *p > '9') return -1;
+    }
+    return atoi(s + 3);
+}
+
+int add_jump_table(const int *labels, int num_labels) {
+    if (ir_module.num_jump_tables == ir_module.jump_tables_capacity) {
+        ir_module.jump_tables_capacity = ir_module.jump_tables_capacity ? ir_module.jump_tables_capacity * 2 : 8;
+        ir_module.jump_tables = (JumpTable*) checked_realloc(ir_module.jump_tables, ir_module.jump_tables_capacity, sizeof(JumpTable));
+    }
+    JumpTable *table = &ir_module.jump_tables[ir_module.num_jump_tables];
+    table->labels = (int*) checked_calloc(num_labels, sizeof(int));
+    memcpy(table->labels, labels, num_labels * sizeof(int));
+    table->num_labels = num_labels;
+    return ir_module.num_jump_tables++;
+}
+
+double operand_float_value(Operand op) {
+    return ir_module.float_consts[op.val.float_index];
+}
+
+void ir_append(IRFunction *fn, Instruction instr) {
+    if (fn->num_instrs == fn->capacity) {
+        fn->capacity = fn->capacity ? fn->capacity * 2 : 64;
+        fn->instrs = (Instruction*) checked_realloc(fn->instrs, fn->capacity, sizeof(Instruction));
+    }
+    fn->instrs[fn->num_instrs++] = instr;
+}
+
+IRFunction* add_ir_function(const char *name) {
+    if (ir_module.num_functions == ir_module.functions_capacity) {
+        ir_module.functions_capacity = ir_module.functions_capacity ? ir_module.functions_capacity * 2 : 8;
+        ir_module.functions = (IRFunction*) checked_realloc(ir_module.functions, ir_module.functions_capacity, sizeof(IRFunction));
+    }
+    IRFunction *fn = &ir_module.functions[ir_module.num_functions++];
+    fn->name = string_id(intern_string(name));
+    fn->instrs = NULL;
+    fn->num_instrs = 0;
+    fn->capacity = 0;
+    fn->blocks = NULL;
+    fn->num_blocks = 0;
+    fn->blocks_capacity = 0;
+    fn->in_ssa = 0;
+    fn->frame_size = 0;
+    return fn;
+}
+
+
+IRFunction* find_ir_function(const char *name) {
+    const char *interned = find_interned_string(name);
+    if (!interned) return NULL;
+    StringId id = string_id(interned);
+    for (int i = 0; i < ir_module.num_functions; i++) {
+        if (ir_module.functions[i].name == id) {
+            return &ir_module.functions[i];
+        }
+    }
+    return NULL;
+}
+// Function to print an operand
+void print_operand(FILE *fp, Operand op) {
+    switch (op.type) {
+        case OP_NONE: break;
+        case OP_INT_CONST: fprintf(fp, "%d", op.val.int_val); break;
+        case OP_FLOAT_CONST: fprintf(fp, "%f", operand_float_value(op)); break;
+        case OP_CHAR_CONST: fprintf(fp, "%d", op.val.char_val); break;
+        case OP_STRING_LITERAL: fprintf(fp, "\"%s\"", string_from_id(op.val.str_id)); break;
+        case OP_IDENTIFIER: fprintf(fp, "%s", string_from_id(op.val.name)); break;
+        case OP_TEMPORARY: fprintf(fp, "t%d", op.val.temp); break;
+        case OP_LABEL: fprintf(fp, "L%d", op.val.label); break;
+        case OP_REGISTER: fprintf(fp, "r%d", op.val.reg); break;
+    }
+}
+
+// Helper to print the instructions of one function
+void print_ir_function(FILE *fp, IRFunction *fn) {
+    if (fn->name >= 0) {
+        fprintf(fp, "%s:\n", string_from_id(fn->name));
+    }
+    for (int i = 0; i < fn->num_instrs; i++) {
+        Instruction *current = &fn->instrs[i];
+        switch (current->opcode) {
+            case IR_HALT:
+                fprintf(fp, "\tHALT");
+                if (current->arg1.type != OP_NONE) {
+                    fprintf(fp, " ");
+                    print_operand(fp, current->arg1);
+                }
+                fprintf(fp, "\n");
+                break;
+            case IR_LABEL:
+                print_operand(fp, current->result);
+                fprintf(fp, ":\n");
+                break;
+            case IR_ASSIGN:
+                fprintf(fp, "\tASSIGN ");
+                print_operand(fp, current->result);
+                fprintf(fp, ", ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, "\n");
+                break;
+            case IR_ADD:
+            case IR_SUB:
+            case IR_MUL:
+            case IR_DIV:
+            case IR_MOD:
+            case IR_SHL:
+            case IR_SHR:
+            case IR_EQ:
+            case IR_NE:
+            case IR_LT:
+            case IR_GT:
+            case IR_LE:
+            case IR_GE:
+            case IR_AND:
+            case IR_OR:
+            case IR_BIT_AND:
+            case IR_BIT_OR:
+            case IR_XOR:
+                fprintf(fp, "\t%s ",
+                        current->opcode == IR_ADD ? "ADD" :
+                        current->opcode == IR_SUB ? "SUB" :
+                        current->opcode == IR_MUL ? "MUL" :
+                        current->opcode == IR_DIV ? "DIV" :
+                        current->opcode == IR_MOD ? "MOD" :
+                        current->opcode == IR_SHL ? "SHL" :
+                        current->opcode == IR_SHR ? "SHR" :
+                        current->opcode == IR_EQ ? "EQ" :
+                        current->opcode == IR_NE ? "NE" :
+                        current->opcode == IR_LT ? "LT" :
+                        current->opcode == IR_GT ? "GT" :
+                        current->opcode == IR_LE ? "LE" :
+                        current->opcode == IR_GE ? "GE" :
+                        current->opcode == IR_AND ? "AND" :
+                        current->opcode == IR_OR ? "OR" :
+                        current->opcode == IR_BIT_AND ? "BIT_AND" :
+                        current->opcode == IR_BIT_OR ? "BIT_OR" : "XOR");
+                print_operand(fp, current->result);
+                fprintf(fp, ", ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, ", ");
+                print_operand(fp, current->arg2);
+                fprintf(fp, "\n");
+                break;
+            case IR_UNARY_MINUS:
+            case IR_NOT:
+            case IR_BIT_NOT:
+            case IR_ADDR:
+            case IR_DEREF:
+                fprintf(fp, "\t%s ",
+                        current->opcode == IR_UNARY_MINUS ? "UMINUS" :
+                        current->opcode == IR_NOT ? "NOT" :
+                        current->opcode == IR_BIT_NOT ? "BIT_NOT" :
+                        current->opcode == IR_ADDR ? "ADDR" : "DEREF_LOAD");
+                print_operand(fp, current->result);
+                fprintf(fp, ", ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, "\n");
+                break;
+            case IR_ALLOC_HEAP:
+                fprintf(fp, "\tALLOC_HEAP ");
+                print_operand(fp, current->result);
+                fprintf(fp, ", ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, "\n");
+                break;
+            case IR_ALLOC_STACK:
+                fprintf(fp, "\tALLOC_STACK ");
+                print_operand(fp, current->result);
+                fprintf(fp, ", ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, ", ");
+                print_operand(fp, current->arg2);
+                fprintf(fp, "\n");
+                break;
+            case IR_SPILL: case IR_RELOAD:
+                fprintf(fp, "\t%s ", current->opcode == IR_SPILL ? "SPILL" : "RELOAD");
+                print_operand(fp, current->result);
+                fprintf(fp, ", ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, "\n");
+                break;
+            case IR_FREE_HEAP:
+                fprintf(fp, "\tFREE_HEAP ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, "\n");
+                break;
+            case IR_ADDR_OF:
+                fprintf(fp, "\tADDR_OF ");
+                print_operand(fp, current->result);
+                fprintf(fp, ", ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, "\n");
+                break;
+            case IR_DEREF_LOAD:
+                fprintf(fp, "\tDEREF_LOAD ");
+                print_operand(fp, current->result);
+                fprintf(fp, ", ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, "\n");
+                break;
+            case IR_DEREF_STORE:
+                fprintf(fp, "\tDEREF_STORE ");
+                print_operand(fp, current->result);
+                fprintf(fp, ", ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, "\n");
+                break;
+            case IR_INDEX_LOAD:
+            case IR_INDEX_STORE:
+                fprintf(fp, "\t%s ", current->opcode == IR_INDEX_LOAD ? "INDEX_LOAD" : "INDEX_STORE");
+                print_operand(fp, current->result);
+                fprintf(fp, ", ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, ", ");
+                print_operand(fp, current->arg2);
+                fprintf(fp, "\n");
+                break;
+            case IR_GOTO:
+                fprintf(fp, "\tJUMP ");
+                print_operand(fp, current->result);
+                fprintf(fp, "\n");
+                break;
+            case IR_IF_FALSE_GOTO:
+                fprintf(fp, "\tJUMPF ");
+                print_operand(fp, current->result);
+                fprintf(fp, ", ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, "\n");
+                break;
+            case IR_IF_TRUE_GOTO:
+                fprintf(fp, "\tJUMPT ");
+                print_operand(fp, current->result);
+                fprintf(fp, ", ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, "\n");
+                break;
+            case IR_JUMP_TABLE: {
+                JumpTable *table = &ir_module.jump_tables[current->result.val.int_val];
+                fprintf(fp, "\tJUMP_TABLE ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, ", [");
+                for (int l = 0; l < table->num_labels; l++) {
+                    fprintf(fp, "%sL%d", l ? ", " : "", table->labels[l]);
+                }
+                fprintf(fp, "]\n");
+                break;
+            }
+            case IR_CALL:
+                fprintf(fp, "\tCALL ");
+                fprintf(fp, "%s, %d,", string_from_id(current->arg1.val.name), current->arg2.val.int_val);
+                print_operand(fp, current->result);
+                fprintf(fp, "\n");
+                break;
+            case IR_TAILCALL:
+                fprintf(fp, "\tTAILCALL %s, %d\n", string_from_id(current->arg1.val.name), current->arg2.val.int_val);
+                break;
+            case IR_PARAM:
+                fprintf(fp, "\tPARAM ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, "\n");
+                break;
+            case IR_RETURN:
+                fprintf(fp, "\tRETURN ");
+                print_operand(fp, current->arg1);
+                fprintf(fp, "\n");
+                break;
+            case IR_NOP:
+                fprintf(fp, "\tNOP\n");
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Function to print the IR to a file
+void print_ir_to_file(const char *filename) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        perror("Could not open 3AC output file");
+        return;
+    }
+    IRFunction *main_fn = find_ir_function("main");
+
+    // First, print the global declarations
+    fprintf(fp, "# --- Global DECLARATIONS ---\n");
+    print_ir_function(fp, &ir_module.globals);
+
+    // Second, print the main function's instructions
+    fprintf(fp, "# --- MAIN FUNCTION ---\n");
+    if (main_fn) {
+        print_ir_function(fp, main_fn);
+    }
+
+    // Finaly, print the other functions' instructions
+    fprintf(fp, "\n# --- OTHER FUNCTIONS ---\n");
+    for (int i = 0; i < ir_module.num_functions; i++) {
+        if (&ir_module.functions[i] != main_fn) {
+            print_ir_function(fp, &ir_module.functions[i]);
+        }
+    }
+    fclose(fp);
+}
+
+// Main cleanup function for the IR module
+void free_ir_module() {
+    // Operand names are interned and owned by the string pool.
+    free(ir_module.globals.instrs);
+    for (int i = 0; i < ir_module.num_functions; i++) {
+        free_cfg(&ir_module.functions[i]);
+        free(ir_module.functions[i].instrs);
+    }
+    free(ir_module.functions);
+    free(ir_module.float_consts);
+    for (int i = 0; i < ir_module.num_jump_tables; i++) {
+        free(ir_module.jump_tables[i].labels);
+    }
+    free(ir_module.jump_tables);
+    memset(&ir_module, 0, sizeof(ir_module));
+    ir_module.globals.name = -1;
+}
+
+/* --- Operand helpers for the optimizer --- */
+
+/**
+ * @brief Compares two operands to see if they are identical.
+ * This is crucial for matching addresses in the peephole optimizer.
+ */
+int are_operands_equal(Operand op1, Operand op2) {
+    if (op1.type != op2.type) {
+        return 0; // Not equal if types differ
+    }
+    switch (op1.type) {
+        case OP_FLOAT_CONST:
+            return operand_float_value(op1) == operand_float_value(op2);
+        case OP_INT_CONST:
+        case OP_CHAR_CONST:
+        case OP_STRING_LITERAL:
+        case OP_IDENTIFIER:
+        case OP_TEMPORARY:
+        case OP_LABEL:
+            // Names are interned and temporaries/labels are numbered, so equal ids mean equal operands.
+            return op1.val.id == op2.val.id;
+        case OP_NONE:
+            return 1; // OP_NONE is always equal to OP_NONE
+        default:
+            return 0;
+    }
+}
+
+int is_constant_operand(Operand op) {
+    return op.type == OP_INT_CONST || op.type == OP_CHAR_CONST || op.type == OP_FLOAT_CONST;
+}
+
+// Integer operations wrap around like the target's 32-bit int.
+static int fold_int_operation(OpCode opcode, int a, int b, int *out) {
+    unsigned int ua = (unsigned int) a, ub = (unsigned int) b;
+    switch (opcode) {
+        case IR_ADD: *out = (int) (ua + ub); return 1;
+        case IR_SUB: *out = (int) (ua - ub); return 1;
+        case IR_MUL: *out = (int) (ua * ub); return 1;
+        case IR_DIV: case IR_MOD:
+            if (b == 0 || (a == INT_MIN && b == -1)) return 0; // Leave the trap to run time
+            *out = (opcode == IR_DIV) ? a / b : a % b;
+            return 1;
+        case IR_EQ: *out = a == b; return 1;
+        case IR_NE: *out = a != b; return 1;
+        case IR_LT: *out = a < b; return 1;
+        case IR_GT: *out = a > b; return 1;
+        case IR_LE: *out = a <= b; return 1;
+        case IR_GE: *out = a >= b; return 1;
+        case IR_AND: *out = a && b; return 1;
+        case IR_OR: *out = a || b; return 1;
+        case IR_BIT_AND: *out = a & b; return 1;
+        case IR_BIT_OR: *out = a | b; return 1;
+        case IR_XOR: *out = a ^ b; return 1;
+        case IR_SHL: case IR_SHR:
+            if (b < 0 || b >= 32) return 0;
+            *out = (opcode == IR_SHL) ? (int) (ua << b) : a >> b;
+            return 1;
+        case IR_UNARY_MINUS: *out = (int) (0u - ua); return 1;
+        case IR_NOT: *out = !a; return 1;
+        case IR_BIT_NOT: *out = ~a; return 1;
+        default: return 0;
+    }
+}
+
+static int fold_float_operation(OpCode opcode, double a, double b, Operand *result) {
+    switch (opcode) {
+        case IR_ADD: *result = create_operand_float(a + b); return 1;
+        case IR_SUB: *result = create_operand_float(a - b); return 1;
+        case IR_MUL: *result = create_operand_float(a * b); return 1;
+        case IR_DIV:
+            if (b == 0.0) return 0;
+            *result = create_operand_float(a / b);
+            return 1;
+        case IR_EQ: *result = create_operand_int(a == b); return 1;
+        case IR_NE: *result = create_operand_int(a != b); return 1;
+        case IR_LT: *result = create_operand_int(a < b); return 1;
+        case IR_GT: *result = create_operand_int(a > b); return 1;
+        case IR_LE: *result = create_operand_int(a <= b); return 1;
+        case IR_GE: *result = create_operand_int(a >= b); return 1;
+        case IR_AND: *result = create_operand_int(a != 0.0 && b != 0.0); return 1;
+        case IR_OR: *result = create_operand_int(a != 0.0 || b != 0.0); return 1;
+        case IR_UNARY_MINUS: *result = create_operand_float(-a); return 1;
+        case IR_NOT: *result = create_operand_int(a == 0.0); return 1;
+        default: return 0; // MOD, shifts and bitwise operators need integers
+    }
+}
+
+int fold_constant_operation(OpCode opcode, Operand arg1, Operand arg2, Operand *result) {
+    int unary = (opcode == IR_UNARY_MINUS || opcode == IR_NOT || opcode == IR_BIT_NOT);
+    if (!is_constant_operand(arg1) || (!unary && !is_constant_operand(arg2))) {
+        return 0;
+    }
+    if (unary) {
+        arg2 = create_operand_int(0);
+    }
+    if (arg1.type == OP_FLOAT_CONST || arg2.type == OP_FLOAT_CONST) {
+        double a = (arg1.type == OP_FLOAT_CONST) ? operand_float_value(arg1) : arg1.val.int_val;
+        double b = (arg2.type == OP_FLOAT_CONST) ? operand_float_value(arg2) : arg2.val.int_val;
+        return fold_float_operation(opcode, a, b, result);
+    }
+    // Char constants promote to int, as in C.
+    int value;
+    if (!fold_int_operation(opcode, arg1.val.int_val, arg2.val.int_val, &value)) {
+        return 0;
+    }
+    *result = create_operand_int(value);
+    return 1;
+}
+
+// Returns 1 if the opcode writes its result operand.
+int ir_defines_result(OpCode opcode) {
+    switch (opcode) {
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+        case IR_ASSIGN:
+        case IR_EQ: case IR_NE: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+        case IR_AND: case IR_OR: case IR_BIT_AND: case IR_BIT_OR: case IR_XOR:
+        case IR_SHL: case IR_SHR:
+        case IR_UNARY_MINUS: case IR_NOT: case IR_BIT_NOT: case IR_ADDR: case IR_DEREF:
+        case IR_ALLOC_HEAP: case IR_ALLOC_STACK: case IR_ADDR_OF: case IR_DEREF_LOAD: case IR_INDEX_LOAD:
+        case IR_RELOAD:
+        case IR_CALL:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Returns 1 if the opcode reads its result operand as a value (stores use it
+// as the destination address). Jumps and labels hold a label there instead.
+int ir_reads_result(OpCode opcode) {
+    return opcode == IR_INDEX_STORE || opcode == IR_DEREF_STORE;
+}
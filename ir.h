@@ -0,0 +1,162 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdio.h>
+#include "string_pool.h"
+
+/*
+ * The IR core: instructions, the module that holds them, and the helpers
+ * the passes, back ends and tools share. It does not depend on the front
+ * end; ir_generator.h builds the IR from the AST.
+ */
+
+/* --- Intermediate Representation (3-Address Code) --- */
+
+typedef enum {
+    IR_ADD, IR_SUB, IR_MUL, IR_DIV, IR_MOD,
+    IR_ASSIGN,
+    IR_EQ, IR_NE, IR_LT, IR_GT, IR_LE, IR_GE,
+    IR_AND, IR_OR, IR_BIT_AND, IR_BIT_OR, IR_XOR,
+    IR_SHL, IR_SHR,
+    IR_UNARY_MINUS, IR_NOT, IR_BIT_NOT, IR_ADDR, IR_DEREF,
+    IR_GOTO, IR_IF_FALSE_GOTO, IR_IF_TRUE_GOTO, 
+    IR_JUMP_TABLE, // Indexed goto: result = table number, arg1 = index into it
+    IR_ALLOC_HEAP, IR_FREE_HEAP,
+    IR_ALLOC_STACK, // Frame slot: result = name, arg1 = size, arg2 = offset in the frame
+    IR_ADDR_OF, IR_DEREF_LOAD, IR_DEREF_STORE,
+    IR_INDEX_LOAD, IR_INDEX_STORE,
+    IR_SPILL, IR_RELOAD, // Frame slot <-> register: SPILL offset, reg and RELOAD reg, offset
+    IR_CALL, IR_PARAM, IR_RETURN,
+    IR_TAILCALL, // Call in tail position, no result: arg1 = function, arg2 = argument count
+    IR_LABEL,
+    IR_NOP, // No operation
+    IR_HALT // Ends the program; arg1 is main's return value, if any
+} OpCode;
+
+typedef enum {
+    OP_NONE, OP_INT_CONST, OP_FLOAT_CONST, OP_CHAR_CONST, OP_STRING_LITERAL,
+    OP_IDENTIFIER, OP_TEMPORARY, OP_LABEL,
+    OP_REGISTER // Only after register allocation (see regalloc.h)
+} OperandType;
+
+// Operands are a type tag plus a 32-bit payload. Names are StringIds from the
+// string pool, temporaries and labels are dense integers (printed as t<n> and
+// L<n>), and floating-point constants live in the module's constant table.
+typedef struct {
+    OperandType type;
+    union {
+        int int_val;     // OP_INT_CONST
+        int char_val;    // OP_CHAR_CONST
+        int float_index; // OP_FLOAT_CONST: index into ir_module.float_consts
+        StringId str_id; // OP_STRING_LITERAL
+        StringId name;   // OP_IDENTIFIER
+        int temp;        // OP_TEMPORARY
+        int label;       // OP_LABEL
+        int reg;         // OP_REGISTER
+        int id;          // Any of the above, for generic comparisons
+    } val;
+} Operand;
+
+typedef struct {
+    OpCode opcode;
+    Operand result;
+    Operand arg1;
+    Operand arg2;
+} Instruction;
+
+// The code of one function, or of the top-level declarations, stored as a
+// contiguous array in emission order.
+typedef struct {
+    StringId name;          // Function name, or -1 for the global declarations
+    Instruction *instrs;
+    int num_instrs;
+    int capacity;
+    struct BasicBlock **blocks; // Control-flow graph (see cfg.h), or NULL
+    int num_blocks;
+    int blocks_capacity;
+    int in_ssa;             // The blocks are in SSA form (see ssa.h)
+    int frame_size;         // Bytes of ALLOC_STACK and spill slots (see frame.h)
+} IRFunction;
+
+// Targets of an IR_JUMP_TABLE: the instruction jumps to labels[index]. The
+// index must be in range; the code in front of the jump checks it.
+typedef struct {
+    int *labels;
+    int num_labels;
+} JumpTable;
+
+// All IR of a translation unit.
+typedef struct {
+    IRFunction globals;     // Code emitted outside any function
+    IRFunction *functions;  // In source order
+    int num_functions;
+    int functions_capacity;
+    double *float_consts;
+    int num_float_consts;
+    int float_consts_capacity;
+    JumpTable *jump_tables;
+    int num_jump_tables;
+    int jump_tables_capacity;
+    int num_temps;          // Temporaries are numbered 0 .. num_temps-1
+    int num_labels;         // Labels are numbered 0 .. num_labels-1
+} IRModule;
+
+/* --- The IR module --- */
+extern IRModule ir_module;
+
+// Operand constructors, shared by IR generation and the optimizer
+Operand create_operand_none();
+Operand create_operand_int(int val);
+Operand create_operand_float(double val);
+Operand create_operand_char(char val);
+Operand create_operand_string(const char *val);
+Operand create_operand_identifier(const char *name);
+Operand create_operand_temp();
+Operand create_operand_label();
+Operand create_operand_register(int reg);
+
+// Returns n for the parameter name ARGn under which a function receives its
+// n-th argument, or -1 for any other name
+int ir_param_index(StringId name);
+
+// Registers a jump table with a copy of 'labels'; returns its number
+int add_jump_table(const int *labels, int num_labels);
+
+// Prints an operand the way it appears in the 3AC listing
+void print_operand(FILE *fp, Operand op);
+
+// Value of an OP_FLOAT_CONST operand
+double operand_float_value(Operand op);
+
+// Returns 1 if the two operands denote the same value or location
+int are_operands_equal(Operand op1, Operand op2);
+
+// Returns 1 for integer, character and floating-point constants
+int is_constant_operand(Operand op);
+
+// Folds an operation whose operands are constants. Returns 1 and stores the
+// value in *result, or 0 if an operand is not constant or the operation
+// cannot be folded (division by zero, out-of-range shift, ...).
+int fold_constant_operation(OpCode opcode, Operand arg1, Operand arg2, Operand *result);
+
+// Operand roles of an opcode: whether 'result' is written, or read as a value
+int ir_defines_result(OpCode opcode);
+int ir_reads_result(OpCode opcode);
+
+// Appends an instruction to the end of a function's instruction array
+void ir_append(IRFunction *fn, Instruction instr);
+
+// Looks up a function by name; returns NULL if it has no IR
+IRFunction* find_ir_function(const char *name);
+
+// Appends an empty function to the module (for IR read back from a file)
+IRFunction* add_ir_function(const char *name);
+
+
+// Prints the generated IR to a file
+void print_ir_to_file(const char *filename);
+
+// Frees all memory associated with the IR module
+void free_ir_module();
+
+#endif // IR_H
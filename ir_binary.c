@@ -0,0 +1,329 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ir_binary.h"
+#include "string_pool.h"
+#include "alloc.h"
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t) 7;
+}
+
+static int names_a_string(int type) {
+    return type == OP_IDENTIFIER || type == OP_STRING_LITERAL;
+}
+
+/* --- Writing --- */
+
+typedef struct {
+    int *index_of;          // StringId -> string index, or -1
+    StringId *strings;      // String index -> StringId
+    int num_strings;
+    size_t data_size;
+} StringTable;
+
+static void add_string(StringTable *table, StringId id) {
+    if (table->index_of[id] >= 0) return;
+    table->index_of[id] = table->num_strings;
+    table->strings[table->num_strings++] = id;
+    table->data_size += strlen(string_from_id(id)) + 1;
+}
+
+static void collect_strings(StringTable *table, const IRFunction *fn) {
+    if (fn->name >= 0) add_string(table, fn->name);
+    for (int i = 0; i < fn->num_instrs; i++) {
+        const Operand *ops[3] = { &fn->instrs[i].result, &fn->instrs[i].arg1, &fn->instrs[i].arg2 };
+        for (int k = 0; k < 3; k++) {
+            if (names_a_string(ops[k]->type)) add_string(table, ops[k]->val.id);
+        }
+    }
+}
+
+static void write_function(unsigned char *image, const IRBinaryHeader *header, const StringTable *table,
+                           const IRFunction *fn, int number, uint32_t *next_instr) {
+    IRBinaryFunction *record = (IRBinaryFunction*) (image + header->functions_offset) + number;
+    record->name = fn->name >= 0 ? (uint32_t) table->index_of[fn->name] : IR_BINARY_NO_NAME;
+    record->first_instr = *next_instr;
+    record->num_instrs = fn->num_instrs;
+    record->frame_size = fn->frame_size;
+    IRBinaryInstr *out = (IRBinaryInstr*) (image + header->instrs_offset) + *next_instr;
+    for (int i = 0; i < fn->num_instrs; i++, out++) {
+        const Operand *ops[3] = { &fn->instrs[i].result, &fn->instrs[i].arg1, &fn->instrs[i].arg2 };
+        out->opcode = (uint8_t) fn->instrs[i].opcode;
+        for (int k = 0; k < 3; k++) {
+            out->types[k] = (uint8_t) ops[k]->type;
+            out->values[k] = names_a_string(ops[k]->type) ? table->index_of[ops[k]->val.id] : ops[k]->val.id;
+        }
+    }
+    *next_instr += fn->num_instrs;
+}
+
+int write_ir_binary(const char *filename, const IRModule *module) {
+    StringTable table;
+    memset(&table, 0, sizeof(table));
+    int pool_size = string_pool_size();
+    table.index_of = (int*) checked_calloc(pool_size, sizeof(int));
+    table.strings = (StringId*) checked_calloc(pool_size, sizeof(StringId));
+    memset(table.index_of, -1, pool_size * sizeof(int));
+    collect_strings(&table, &module->globals);
+    for (int f = 0; f < module->num_functions; f++) collect_strings(&table, &module->functions[f]);
+
+    IRBinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = IR_BINARY_MAGIC;
+    header.version = IR_BINARY_VERSION;
+    header.num_strings = table.num_strings;
+    header.string_data_size = table.data_size;
+    header.num_functions = module->num_functions + 1;
+    header.num_instrs = module->globals.num_instrs;
+    for (int f = 0; f < module->num_functions; f++) header.num_instrs += module->functions[f].num_instrs;
+    header.num_floats = module->num_float_consts;
+    header.num_tables = module->num_jump_tables;
+    for (int t = 0; t < module->num_jump_tables; t++) header.num_table_labels += module->jump_tables[t].num_labels;
+    header.num_temps = module->num_temps;
+    header.num_labels = module->num_labels;
+
+    size_t size = align8(sizeof(IRBinaryHeader));
+    header.strings_offset = size;
+    size = align8(size + header.num_strings * sizeof(uint32_t));
+    header.string_data_offset = size;
+    size = align8(size + header.string_data_size);
+    header.functions_offset = size;
+    size = align8(size + header.num_functions * sizeof(IRBinaryFunction));
+    header.instrs_offset = size;
+    size = align8(size + (size_t) header.num_instrs * sizeof(IRBinaryInstr));
+    header.floats_offset = size;
+    size = align8(size + header.num_floats * sizeof(double));
+    header.tables_offset = size;
+    size = align8(size + header.num_tables * sizeof(IRBinaryTable));
+    header.table_labels_offset = size;
+    size = align8(size + header.num_table_labels * sizeof(uint32_t));
+    header.file_size = size;
+
+    unsigned char *image = (unsigned char*) checked_calloc(size, 1);
+    memcpy(image, &header, sizeof(header));
+    uint32_t *offsets = (uint32_t*) (image + header.strings_offset);
+    char *data = (char*) image + header.string_data_offset;
+    size_t at = 0;
+    for (int i = 0; i < table.num_strings; i++) {
+        const char *s = string_from_id(table.strings[i]);
+        offsets[i] = at;
+        memcpy(data + at, s, strlen(s) + 1);
+        at += strlen(s) + 1;
+    }
+    uint32_t next_instr = 0;
+    write_function(image, &header, &table, &module->globals, 0, &next_instr);
+    for (int f = 0; f < module->num_functions; f++) {
+        write_function(image, &header, &table, &module->functions[f], f + 1, &next_instr);
+    }
+    if (header.num_floats) {
+        memcpy(image + header.floats_offset, module->float_consts, header.num_floats * sizeof(double));
+    }
+    IRBinaryTable *tables = (IRBinaryTable*) (image + header.tables_offset);
+    uint32_t *labels = (uint32_t*) (image + header.table_labels_offset);
+    uint32_t next_label = 0;
+    for (int t = 0; t < module->num_jump_tables; t++) {
+        tables[t].first_label = next_label;
+        tables[t].num_labels = module->jump_tables[t].num_labels;
+        for (int l = 0; l < module->jump_tables[t].num_labels; l++) labels[next_label++] = module->jump_tables[t].labels[l];
+    }
+
+    int result = 0;
+    FILE *fp = fopen(filename, "wb");
+    if (!fp || fwrite(image, 1, size, fp) != size) {
+        perror("Could not write binary IR");
+        result = -1;
+    }
+    if (fp && fclose(fp) != 0 && result == 0) {
+        perror("Could not write binary IR");
+        result = -1;
+    }
+    free(image);
+    free(table.index_of);
+    free(table.strings);
+    return result;
+}
+
+/* --- Reading --- */
+
+static int section_fits(const IRBinaryHeader *h, uint32_t offset, size_t count, size_t record) {
+    return offset % 8 == 0 && offset <= h->file_size && count <= (h->file_size - offset) / (record ? record : 1);
+}
+
+// Checks that the header describes sections inside the file.
+static const char* check_header(const IRBinaryView *view) {
+    const IRBinaryHeader *h = view->header;
+    if (view->size < sizeof(IRBinaryHeader) || h->magic != IR_BINARY_MAGIC) return "not a binary IR file";
+    if (h->version != IR_BINARY_VERSION) return "unsupported binary IR version";
+    if (h->file_size != view->size) return "truncated file";
+    if (!section_fits(h, h->strings_offset, h->num_strings, sizeof(uint32_t)) ||
+        !section_fits(h, h->string_data_offset, h->string_data_size, 1) ||
+        !section_fits(h, h->functions_offset, h->num_functions, sizeof(IRBinaryFunction)) ||
+        !section_fits(h, h->instrs_offset, h->num_instrs, sizeof(IRBinaryInstr)) ||
+        !section_fits(h, h->floats_offset, h->num_floats, sizeof(double)) ||
+        !section_fits(h, h->tables_offset, h->num_tables, sizeof(IRBinaryTable)) ||
+        !section_fits(h, h->table_labels_offset, h->num_table_labels, sizeof(uint32_t))) {
+        return "section out of bounds";
+    }
+    return NULL;
+}
+
+// Checks that everything the sections refer to is inside them.
+static const char* check_contents(const IRBinaryView *view) {
+    const IRBinaryHeader *h = view->header;
+    if (h->num_functions < 1) return "missing global initializers";
+    if (h->num_strings && view->string_data[h->string_data_size - 1] != '\0') return "unterminated string";
+    for (uint32_t i = 0; i < h->num_strings; i++) {
+        if (view->string_offsets[i] >= h->string_data_size) return "string out of bounds";
+    }
+    for (uint32_t f = 0; f < h->num_functions; f++) {
+        const IRBinaryFunction *fn = &view->functions[f];
+        if ((f == 0) != (fn->name == IR_BINARY_NO_NAME)) return "bad function name";
+        if (f > 0 && fn->name >= h->num_strings) return "bad function name";
+        if (fn->first_instr > h->num_instrs || fn->num_instrs > h->num_instrs - fn->first_instr) {
+            return "function out of bounds";
+        }
+    }
+    for (uint32_t t = 0; t < h->num_tables; t++) {
+        const IRBinaryTable *table = &view->tables[t];
+        if (table->first_label > h->num_table_labels || table->num_labels > h->num_table_labels - table->first_label) {
+            return "jump table out of bounds";
+        }
+    }
+    for (uint32_t l = 0; l < h->num_table_labels; l++) {
+        if (view->table_labels[l] >= h->num_labels) return "bad label in jump table";
+    }
+    for (uint32_t i = 0; i < h->num_instrs; i++) {
+        const IRBinaryInstr *in = &view->instrs[i];
+        if (in->opcode > IR_HALT) return "bad opcode";
+        for (int k = 0; k < 3; k++) {
+            uint32_t value = (uint32_t) in->values[k];
+            switch (in->types[k]) {
+                case OP_NONE: case OP_INT_CONST: case OP_CHAR_CONST: break;
+                case OP_FLOAT_CONST: if (value >= h->num_floats) return "bad float index"; break;
+                case OP_STRING_LITERAL: case OP_IDENTIFIER: if (value >= h->num_strings) return "bad string index"; break;
+                case OP_TEMPORARY: if (value >= h->num_temps) return "bad temporary"; break;
+                case OP_LABEL: if (value >= h->num_labels) return "bad label"; break;
+                case OP_REGISTER: if (in->values[k] < 0) return "bad register"; break;
+                default: return "bad operand type";
+            }
+        }
+        // Operands that the passes take to be of one type without looking.
+        switch (in->opcode) {
+            case IR_LABEL: case IR_GOTO: case IR_IF_FALSE_GOTO: case IR_IF_TRUE_GOTO:
+                if (in->types[0] != OP_LABEL) return "branch to a non-label";
+                break;
+            case IR_JUMP_TABLE:
+                if (in->types[0] != OP_INT_CONST || (uint32_t) in->values[0] >= h->num_tables) return "bad jump table";
+                break;
+            case IR_CALL: case IR_TAILCALL:
+                if (in->types[1] != OP_IDENTIFIER) return "call of a non-function";
+                break;
+            default:
+                break;
+        }
+    }
+    return NULL;
+}
+
+int open_ir_binary(const char *filename, IRBinaryView *view) {
+    memset(view, 0, sizeof(*view));
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror("Could not open binary IR");
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    if (st.st_size < (off_t) sizeof(IRBinaryHeader)) {
+        fprintf(stderr, "Error: %s: not a binary IR file.\n", filename);
+        close(fd);
+        return -1;
+    }
+    view->size = st.st_size;
+    view->map = mmap(NULL, view->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view->map == MAP_FAILED) {
+        perror("Could not map binary IR");
+        view->map = NULL;
+        return -1;
+    }
+    const unsigned char *base = (const unsigned char*) view->map;
+    view->header = (const IRBinaryHeader*) base;
+    const char *problem = check_header(view);
+    if (!problem) {
+        const IRBinaryHeader *h = view->header;
+        view->string_offsets = (const uint32_t*) (base + h->strings_offset);
+        view->string_data = (const char*) base + h->string_data_offset;
+        view->functions = (const IRBinaryFunction*) (base + h->functions_offset);
+        view->instrs = (const IRBinaryInstr*) (base + h->instrs_offset);
+        view->floats = (const double*) (base + h->floats_offset);
+        view->tables = (const IRBinaryTable*) (base + h->tables_offset);
+        view->table_labels = (const uint32_t*) (base + h->table_labels_offset);
+        problem = check_contents(view);
+    }
+    if (problem) {
+        fprintf(stderr, "Error: %s: %s.\n", filename, problem);
+        close_ir_binary(view);
+        return -1;
+    }
+    return 0;
+}
+
+void close_ir_binary(IRBinaryView *view) {
+    if (view->map) munmap(view->map, view->size);
+    memset(view, 0, sizeof(*view));
+}
+
+const char* ir_binary_string(const IRBinaryView *view, uint32_t id) {
+    return view->string_data + view->string_offsets[id];
+}
+
+void load_ir_binary(const IRBinaryView *view) {
+    const IRBinaryHeader *h = view->header;
+    for (uint32_t i = 0; i < h->num_floats; i++) create_operand_float(view->floats[i]);
+    for (uint32_t t = 0; t < h->num_tables; t++) {
+        int *labels = (int*) checked_calloc(view->tables[t].num_labels, sizeof(int));
+        for (uint32_t l = 0; l < view->tables[t].num_labels; l++) {
+            labels[l] = view->table_labels[view->tables[t].first_label + l];
+        }
+        add_jump_table(labels, view->tables[t].num_labels);
+        free(labels);
+    }
+    // Strings are interned once each, not once per use.
+    StringId *ids = (StringId*) checked_calloc(h->num_strings, sizeof(StringId));
+    for (uint32_t i = 0; i < h->num_strings; i++) ids[i] = string_id(intern_string(ir_binary_string(view, i)));
+    // The counters cover the temporaries and labels in use, rather than the
+    // header's, so a damaged header cannot make the passes allocate for more.
+    int max_temp = -1, max_label = -1;
+    for (uint32_t l = 0; l < h->num_table_labels; l++) {
+        if ((int) view->table_labels[l] > max_label) max_label = view->table_labels[l];
+    }
+
+    for (uint32_t f = 0; f < h->num_functions; f++) {
+        const IRBinaryFunction *record = &view->functions[f];
+        IRFunction *fn = f == 0 ? &ir_module.globals : add_ir_function(ir_binary_string(view, record->name));
+        fn->frame_size = record->frame_size;
+        for (uint32_t i = 0; i < record->num_instrs; i++) {
+            const IRBinaryInstr *in = &view->instrs[record->first_instr + i];
+            Instruction instr;
+            Operand *ops[3] = { &instr.result, &instr.arg1, &instr.arg2 };
+            instr.opcode = (OpCode) in->opcode;
+            for (int k = 0; k < 3; k++) {
+                ops[k]->type = (OperandType) in->types[k];
+                ops[k]->val.id = names_a_string(in->types[k]) ? ids[in->values[k]] : in->values[k];
+                if (in->types[k] == OP_TEMPORARY && in->values[k] > max_temp) max_temp = in->values[k];
+                if (in->types[k] == OP_LABEL && in->values[k] > max_label) max_label = in->values[k];
+            }
+            ir_append(fn, instr);
+        }
+    }
+    free(ids);
+    if (max_temp >= ir_module.num_temps) ir_module.num_temps = max_temp + 1;
+    if (max_label >= ir_module.num_labels) ir_module.num_labels = max_label + 1;
+}
@@ -0,0 +1,95 @@
+#ifndef IR_BINARY_H
+#define IR_BINARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ir.h"
+
+/*
+ * Binary 3AC. A file is a header followed by sections, each 8-byte
+ * aligned and located by the header:
+ *
+ *   strings    uint32 offsets into a blob of NUL-terminated names and
+ *              literals; operands refer to them by index
+ *   functions  one IRBinaryFunction per unit, the global initializers first
+ *   instrs     fixed-width IRBinaryInstr records, each function's in a run
+ *   floats     the module's floating-point constants
+ *   tables     jump tables, as runs in the table_labels array
+ *
+ * Integers are stored in the byte order of the machine that wrote the file,
+ * little-endian on every target the compiler supports; the magic number
+ * reads differently otherwise. Opcodes and operand types are the numeric
+ * values of OpCode and OperandType, so changing either enum must bump
+ * IR_BINARY_VERSION.
+ */
+
+#define IR_BINARY_MAGIC 0x42434133u   // "3ACB" in a little-endian file
+#define IR_BINARY_VERSION 1
+#define IR_BINARY_NO_NAME 0xffffffffu // Name of the global initializers
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t file_size;
+    uint32_t num_strings, strings_offset;    // Offsets into the string data
+    uint32_t string_data_size, string_data_offset;
+    uint32_t num_functions, functions_offset;
+    uint32_t num_instrs, instrs_offset;
+    uint32_t num_floats, floats_offset;
+    uint32_t num_tables, tables_offset;
+    uint32_t num_table_labels, table_labels_offset;
+    uint32_t num_temps, num_labels;         // Numbering of the module
+} IRBinaryHeader;
+
+typedef struct {
+    uint32_t name;          // String index, or IR_BINARY_NO_NAME
+    uint32_t first_instr;
+    uint32_t num_instrs;
+    uint32_t frame_size;
+} IRBinaryFunction;
+
+// Operand i is (types[i], values[i]). Values are the operand's payload,
+// except that names and string literals are string indices.
+typedef struct {
+    uint8_t opcode;
+    uint8_t types[3];       // result, arg1, arg2
+    int32_t values[3];
+} IRBinaryInstr;
+
+typedef struct {
+    uint32_t first_label;   // Index into the table_labels section
+    uint32_t num_labels;
+} IRBinaryTable;
+
+// A file mapped into memory; the section pointers point into the mapping.
+typedef struct {
+    void *map;
+    size_t size;
+    const IRBinaryHeader *header;
+    const uint32_t *string_offsets;
+    const char *string_data;
+    const IRBinaryFunction *functions;
+    const IRBinaryInstr *instrs;
+    const double *floats;
+    const IRBinaryTable *tables;
+    const uint32_t *table_labels;
+} IRBinaryView;
+
+// Serializes the module into one buffer and writes it with a single write.
+// Returns 0, or -1 after reporting an error.
+int write_ir_binary(const char *filename, const IRModule *module);
+
+// Maps a file and checks its header, that every section, string and jump
+// table lies inside it, and that every operand refers to a string, float,
+// temporary or label the file declares. Returns 0, or -1 after reporting why.
+int open_ir_binary(const char *filename, IRBinaryView *view);
+
+void close_ir_binary(IRBinaryView *view);
+
+// The string with index 'id'.
+const char* ir_binary_string(const IRBinaryView *view, uint32_t id);
+
+// Rebuilds the IR of a mapped file into ir_module, which must be empty.
+void load_ir_binary(const IRBinaryView *view);
+
+#endif // IR_BINARY_H
@@ -5,1108 +5,1297 @@
 
 #include "ir_generator.h"
 #include "symbol_table.h" // Needed for get_type_size, lookup_symbol, etc.
+#include "string_pool.h"  // Operand names are interned
+#include "alloc.h"
 
 /* --- Global Variables for IR --- */
-Instruction *main_ir_head = NULL;
-Instruction *main_ir_tail = NULL;
-Instruction *other_funcs_ir_head = NULL;
-Instruction *other_funcs_ir_tail = NULL;
-Instruction *global_declarations_head=NULL;
-Instruction *global_declarations_tail=NULL;
-
-int temp_counter = 0;
-int label_counter = 0;
+// Function whose body is being generated; NULL while emitting top-level code.
+static IRFunction *current_function = NULL;
 
 Operand current_break_label;    // To store the break label for loops
 Operand current_continue_label; // To store the continue label for loops
 
-int is_in_main_function = 0; // Flag to direct emit() to output in main list
-int is_global_declaration=1; // Flag to direct emit() to output in global declarations list
+int is_in_main_function = 0; // Flag to turn 'return' into HALT inside main
+
+// Heap-allocated locals whose scope is open, innermost last. Leaving a scope
+// frees the ones it declared; break, continue and return free every scope
+// they jump out of.
+static Operand *heap_locals = NULL;
+static int num_heap_locals = 0;
+static int heap_locals_capacity = 0;
+static int break_depth = 0;    // num_heap_locals where current_break_label is
+static int continue_depth = 0; // Likewise for current_continue_label
+
+// Variables in scope, innermost last, with the IR operand each stands for.
+// The IR has one namespace for a function's locals and the globals, so a
+// declaration that shadows an outer variable gets a name of its own.
+typedef struct {
+    StringId name;  // Name in the source
+    Operand var;    // Its IR operand: the same name, or name.s<n> if it shadows
+} ScopedName;
+
+static ScopedName *scoped_names = NULL;
+static int num_scoped_names = 0;
+static int scoped_names_capacity = 0;
+static int scope_start = 0;    // First entry of the innermost scope
+static int num_shadowing = 0;  // Numbers the renamed declarations
 /* --- Helper functions for IR generation --- */
 
-Operand create_operand_none() {
-    Operand op;
-    op.type = OP_NONE;
-    // No need to initialize val for OP_NONE
-    return op;
+Operand create_operand_argument(int index) {
+    char arg_name[32];
+    sprintf(arg_name, "ARG%d", index); // Treat ARGx as a special kind of identifier
+    return create_operand_identifier(arg_name);
 }
 
-Operand create_operand_int(int val) {
-    Operand op;
-    op.type = OP_INT_CONST;
-    op.val.int_val = val;
-    return op;
+// Starts a new function; emit() appends to it until end_ir_function().
+static IRFunction* begin_ir_function(const char *name) {
+    current_function = add_ir_function(name);
+    return current_function;
 }
 
-Operand create_operand_float(double val) {
-    //printf("DEBUG: Float constant: %f\n", val);
-    Operand op;
-    op.type = OP_FLOAT_CONST;
-    op.val.float_val = val;
-    return op;
+static void end_ir_function() {
+    current_function = NULL;
 }
 
-Operand create_operand_char(char val) {
-    Operand op;
-    op.type = OP_CHAR_CONST;
-    op.val.char_val = val;
-    return op;
+void emit(OpCode opcode, Operand result, Operand arg1, Operand arg2) {
+    Instruction instr;
+    instr.opcode = opcode;
+    instr.result = result;
+    instr.arg1 = arg1;
+    instr.arg2 = arg2;
+    // Code outside a function body (global initializers) goes to the globals unit.
+    ir_append(current_function ? current_function : &ir_module.globals, instr);
 }
 
-Operand create_operand_string(const char *val) {
-    Operand op;
-    op.type = OP_STRING_LITERAL;
-    op.val.str_val = strdup(val);
-    return op;
-}
+// Helper function to recursively process argument list and emit PARAMs
+// This will emit PARAMs in the correct order (left to right)
+static void emit_params_for_call(ASTNode* current_arg_list_node, int* count) {
+    if (!current_arg_list_node || current_arg_list_node->kind == AST_EMPTY_EXPRESSION) {
+        return;
+    }
 
-Operand create_operand_identifier(const char *name) {
-    Operand op;
-    op.type = OP_IDENTIFIER;
-    op.val.name = strdup(name);
-    return op;
-}
+    if (current_arg_list_node->kind == AST_ARGUMENT_LIST) {
+        // The AST is left-recursive: ArgumentList -> ArgumentList, assignment_expression
+        // We must process the list (left child) first to maintain left-to-right order.
+        emit_params_for_call(current_arg_list_node->children[0], count);
 
-Operand create_operand_temp() {
-    Operand op;
-    op.type = OP_TEMPORARY;
-    char temp_name[32];
-    sprintf(temp_name, "t%d", temp_counter++);
-    op.val.name = strdup(temp_name);
-    return op;
-}
+        // Then process the actual argument on the right.
+        if (current_arg_list_node->num_children > 1) {
+            Operand param_op = Generate_IR(current_arg_list_node->children[1]);
+            emit(IR_PARAM, create_operand_none(), param_op, create_operand_none());
+            (*count)++;
+        }
 
-Operand create_operand_label() {
-    Operand op;
-    op.type = OP_LABEL;
-    char label_name[32];
-    sprintf(label_name, "L%d", label_counter++);
-    op.val.name = strdup(label_name);
-    return op;
+    } else {
+        // This is the base case: a single assignment_expression.
+        Operand param_op = Generate_IR(current_arg_list_node);
+        emit(IR_PARAM, create_operand_none(), param_op, create_operand_none());
+        (*count)++;
+    }
 }
 
-Operand create_operand_argument(int index) {
-    Operand op;
-    op.type = OP_IDENTIFIER; // Treat ARGx as a special kind of identifier
-    char arg_name[32];
-    sprintf(arg_name, "ARG%d", index);
-    op.val.name = strdup(arg_name);
-    return op;
-}
+/* --- Tail calls --- */
+
+/*
+ * 'return f(...)' outside main records where its arguments start and where
+ * its CALL is; when the function is complete, eliminate_tail_calls rewrites
+ * them. A call of the function itself with all of its parameters becomes a
+ * loop: the arguments are copied into the parameters and control jumps back
+ * to a label after the prologue. Any other call becomes TAILCALL, which a
+ * backend can implement as a jump reusing the caller's frame, and the
+ * RETURN after it goes away.
+ *
+ * A function that takes an address (ADDR_OF, ADDR) or allocates local
+ * arrays keeps its plain calls, since the callee may still point into the
+ * frame.
+ */
 
-Operand create_operand_label_named(const char *name) {
-    Operand op;
-    op.type = OP_LABEL;
-    op.val.name = strdup(name);
-    return op;
+typedef struct {
+    int first;  // Index of the first instruction computing the arguments
+    int call;   // Index of the CALL; its RETURN follows
+} TailCall;
+
+static TailCall *tail_calls = NULL;
+static int num_tail_calls = 0;
+static int tail_calls_capacity = 0;
+
+static void record_tail_call(int first, int call) {
+    if (num_tail_calls == tail_calls_capacity) {
+        tail_calls_capacity = tail_calls_capacity ? tail_calls_capacity * 2 : 8;
+        tail_calls = (TailCall*) checked_realloc(tail_calls, tail_calls_capacity, sizeof(TailCall));
+    }
+    tail_calls[num_tail_calls].first = first;
+    tail_calls[num_tail_calls].call = call;
+    num_tail_calls++;
 }
 
-void emit(OpCode opcode, Operand result, Operand arg1, Operand arg2) {
-    Instruction *instr = (Instruction*) malloc(sizeof(Instruction));
-    if (!instr) {
-        fprintf(stderr, "Out of memory for IR instruction.\n");
-        exit(1);
+static int frame_may_escape(const IRFunction *fn) {
+    for (int i = 0; i < fn->num_instrs; i++) {
+        OpCode opcode = fn->instrs[i].opcode;
+        if (opcode == IR_ADDR_OF || opcode == IR_ADDR || opcode == IR_ALLOC_HEAP || opcode == IR_ALLOC_STACK) return 1;
     }
-    instr->opcode = opcode;
-    instr->result = result;
-    instr->arg1 = arg1;
-    instr->arg2 = arg2;
-    instr->next = NULL;
-    // printf(is_global_declaration?"In Global":"Not Global");
-    // printf(is_in_main_function?" In Main\n":" In Other Func\n");
-    // printf("DEBUG: Emitting global declaration IR instruction.\n");
-    // printf("DEBUG: Opcode: %d\n", opcode);
-    // printf("DEBUG: Result Operand Type: %d\n", result.type);
-    // printf("DEBUG: Arg1 Operand Type: %d\n", arg1.type);
-    // printf("DEBUG: Arg2 Operand Type: %d\n", arg2.type);
-    if (is_global_declaration){
-        if (global_declarations_head == NULL) {
-            global_declarations_head = instr;
-            global_declarations_tail = instr;
-        } else {
-            global_declarations_tail->next = instr;
-            global_declarations_tail = instr;
-        }
-    }else{
-        if (is_in_main_function) {
-            if (main_ir_head == NULL) {
-                main_ir_head = instr;
-                main_ir_tail = instr;
-            } else {
-                main_ir_tail->next = instr;
-                main_ir_tail = instr;
-            }
-        } else {
-            if (other_funcs_ir_head == NULL) {
-                other_funcs_ir_head = instr;
-                other_funcs_ir_tail = instr;
-            } else {
-                other_funcs_ir_tail->next = instr;
-                other_funcs_ir_tail = instr;
-            }
+    return 0;
+}
+
+// Whether an instruction in (from, to) assigns the named variable.
+static int assigned_between(const IRFunction *fn, int from, int to, StringId name) {
+    for (int i = from + 1; i < to; i++) {
+        const Instruction *instr = &fn->instrs[i];
+        if (ir_defines_result(instr->opcode) && instr->result.type == OP_IDENTIFIER &&
+            instr->result.val.name == name) {
+            return 1;
         }
     }
+    return 0;
 }
 
-// Function to print an operand
-void print_operand(FILE *fp, Operand op) {
-    switch (op.type) {
-        case OP_NONE: break;
-        case OP_INT_CONST: fprintf(fp, "%d", op.val.int_val); break;
-        case OP_FLOAT_CONST: fprintf(fp, "%f", op.val.float_val); break;
-        case OP_CHAR_CONST: fprintf(fp, "%d", op.val.char_val); break;
-        case OP_STRING_LITERAL: fprintf(fp, "\"%s\"", op.val.str_val); break;
-        case OP_IDENTIFIER:
-        case OP_TEMPORARY:
-        case OP_LABEL: fprintf(fp, "%s", op.val.name); break;
+// The function's first num_params instructions are its prologue,
+// 'ASSIGN p, ARGk' for every parameter p.
+static void eliminate_tail_calls(IRFunction *fn, int num_params) {
+    if (num_tail_calls == 0 || frame_may_escape(fn)) return;
+    enum { KEEP, DROP, COPY_ARGUMENT, SELF_CALL, TAIL_CALL };
+    int n = fn->num_instrs;
+    char *action = (char*) checked_calloc(n, sizeof(char));
+    Operand *copy = (Operand*) checked_calloc(n, sizeof(Operand));      // COPY_ARGUMENT -> its temporary
+    int *first_arg = (int*) checked_calloc(n, sizeof(int));             // SELF_CALL -> its values in 'args'
+    Operand *args = (Operand*) checked_calloc(n + 1, sizeof(Operand));  // New parameter values, OP_NONE if unchanged
+    int *stack = (int*) checked_calloc(n + 1, sizeof(int));
+    int num_args = 0, loops = 0;
+    for (int t = 0; t < num_tail_calls; t++) {
+        int call = tail_calls[t].call;
+        const Instruction *instr = &fn->instrs[call];
+        int k = instr->arg2.val.int_val;
+        // Pair the PARAMs with this CALL; nested calls take theirs first.
+        int stack_size = 0;
+        for (int i = tail_calls[t].first; i < call; i++) {
+            if (fn->instrs[i].opcode == IR_PARAM) {
+                stack[stack_size++] = i;
+            } else if (fn->instrs[i].opcode == IR_CALL) {
+                int used = fn->instrs[i].arg2.val.int_val;
+                stack_size = used <= stack_size ? stack_size - used : 0;
+            }
+        }
+        if (k < 0 || k > stack_size) continue;
+
+        action[call + 1] = DROP; // The RETURN
+        if (instr->arg1.val.name != fn->name || k != num_params) {
+            action[call] = TAIL_CALL;
+            continue;
+        }
+        action[call] = SELF_CALL;
+        first_arg[call] = num_args;
+        loops = 1;
+        for (int j = 0; j < k; j++) {
+            int p = stack[stack_size - k + j];
+            Operand value = fn->instrs[p].arg1;
+            StringId param = fn->instrs[j].result.val.name;
+            action[p] = DROP;
+            if (value.type == OP_IDENTIFIER) {
+                if (value.val.name == param && !assigned_between(fn, p, call, param)) {
+                    value = create_operand_none();
+                } else {
+                    // Variables are read where the PARAM was, before any
+                    // parameter is overwritten.
+                    action[p] = COPY_ARGUMENT;
+                    copy[p] = create_operand_temp();
+                    value = copy[p];
+                }
+            }
+            args[num_args++] = value;
+        }
     }
-}
 
-// Helper to print a single IR list
-void print_ir_list(FILE *fp, Instruction *head) {
-    Instruction *current = head;
-    while (current) {
-        switch (current->opcode) {
-            case IR_HALT:
-                fprintf(fp,"\tHALT\n");
-                break;
-            case IR_LABEL:
-                fprintf(fp, "%s:\n", current->result.val.name);
-                break;
-            case IR_ASSIGN:
-                fprintf(fp, "\tASSIGN ");
-                print_operand(fp, current->result);
-                fprintf(fp, ", ");
-                print_operand(fp, current->arg1);
-                fprintf(fp, "\n");
-                break;
-            case IR_ADD:
-            case IR_SUB:
-            case IR_MUL:
-            case IR_DIV:
-            case IR_MOD:
-            case IR_SHL:
-            case IR_SHR:
-            case IR_EQ:
-            case IR_NE:
-            case IR_LT:
-            case IR_GT:
-            case IR_LE:
-            case IR_GE:
-            case IR_AND:
-            case IR_OR:
-            case IR_BIT_AND:
-            case IR_BIT_OR:
-            case IR_XOR:
-                fprintf(fp, "\t%s ",
-                        current->opcode == IR_ADD ? "ADD" :
-                        current->opcode == IR_SUB ? "SUB" :
-                        current->opcode == IR_MUL ? "MUL" :
-                        current->opcode == IR_DIV ? "DIV" :
-                        current->opcode == IR_MOD ? "MOD" :
-                        current->opcode == IR_SHL ? "SHL" :
-                        current->opcode == IR_SHR ? "SHR" :
-                        current->opcode == IR_EQ ? "EQ" :
-                        current->opcode == IR_NE ? "NE" :
-                        current->opcode == IR_LT ? "LT" :
-                        current->opcode == IR_GT ? "GT" :
-                        current->opcode == IR_LE ? "LE" :
-                        current->opcode == IR_GE ? "GE" :
-                        current->opcode == IR_AND ? "AND" :
-                        current->opcode == IR_OR ? "OR" :
-                        current->opcode == IR_BIT_AND ? "BIT_AND" :
-                        current->opcode == IR_BIT_OR ? "BIT_OR" : "XOR");
-                print_operand(fp, current->result);
-                fprintf(fp, ", ");
-                print_operand(fp, current->arg1);
-                fprintf(fp, ", ");
-                print_operand(fp, current->arg2);
-                fprintf(fp, "\n");
-                break;
-            case IR_UNARY_MINUS:
-            case IR_NOT:
-            case IR_BIT_NOT:
-            case IR_ADDR:
-            case IR_DEREF:
-                fprintf(fp, "\t%s ",
-                        current->opcode == IR_UNARY_MINUS ? "UMINUS" :
-                        current->opcode == IR_NOT ? "NOT" :
-                        current->opcode == IR_BIT_NOT ? "BIT_NOT" :
-                        current->opcode == IR_ADDR ? "ADDR" : "DEREF_LOAD");
-                print_operand(fp, current->result);
-                fprintf(fp, ", ");
-                print_operand(fp, current->arg1);
-                fprintf(fp, "\n");
-                break;
-            case IR_ALLOC_HEAP:
-                fprintf(fp, "\tALLOC_HEAP ");
-                print_operand(fp, current->result);
-                fprintf(fp, ", ");
-                print_operand(fp, current->arg1);
-                fprintf(fp, "\n");
-                break;
-            case IR_FREE_HEAP:
-                fprintf(fp, "\tFREE_HEAP ");
-                print_operand(fp, current->arg1);
-                fprintf(fp, "\n");
+    Instruction *old = fn->instrs;
+    fn->instrs = NULL;
+    fn->num_instrs = fn->capacity = 0;
+    Operand none = create_operand_none();
+    Operand entry = loops ? create_operand_label() : none;
+    for (int i = 0; i < n; i++) {
+        if (loops && i == num_params) emit(IR_LABEL, entry, none, none);
+        switch (action[i]) {
+            case KEEP:
+                ir_append(fn, old[i]);
                 break;
-            case IR_ADDR_OF:
-                fprintf(fp, "\tADDR_OF ");
-                print_operand(fp, current->result);
-                fprintf(fp, ", ");
-                print_operand(fp, current->arg1);
-                fprintf(fp, "\n");
+            case COPY_ARGUMENT:
+                emit(IR_ASSIGN, copy[i], old[i].arg1, none);
                 break;
-            case IR_DEREF_LOAD:
-                fprintf(fp, "\tDEREF_LOAD ");
-                print_operand(fp, current->result);
-                fprintf(fp, ", ");
-                print_operand(fp, current->arg1);
-                fprintf(fp, "\n");
+            case TAIL_CALL:
+                emit(IR_TAILCALL, none, old[i].arg1, old[i].arg2);
                 break;
-            case IR_DEREF_STORE:
-                fprintf(fp, "\tDEREF_STORE ");
-                print_operand(fp, current->result);
-                fprintf(fp, ", ");
-                print_operand(fp, current->arg1);
-                fprintf(fp, "\n");
-                break;
-            case IR_INDEX_LOAD:
-            case IR_INDEX_STORE:
-                fprintf(fp, "\t%s ", current->opcode == IR_INDEX_LOAD ? "INDEX_LOAD" : "INDEX_STORE");
-                print_operand(fp, current->result);
-                fprintf(fp, ", ");
-                print_operand(fp, current->arg1);
-                fprintf(fp, ", ");
-                print_operand(fp, current->arg2);
-                fprintf(fp, "\n");
-                break;
-            case IR_GOTO:
-                fprintf(fp, "\tJUMP %s\n", current->result.val.name);
-                break;
-            case IR_IF_FALSE_GOTO:
-                fprintf(fp, "\tJUMPF %s, ", current->result.val.name);
-                print_operand(fp, current->arg1);
-                fprintf(fp, "\n");
-                break;
-            case IR_IF_TRUE_GOTO:
-                fprintf(fp, "\tJUMPT %s, ", current->result.val.name);
-                print_operand(fp, current->arg1);
-                fprintf(fp, "\n");
-                break;
-            case IR_CALL:
-                fprintf(fp, "\tCALL ");
-                fprintf(fp, "%s, %d,", current->arg1.val.name, current->arg2.val.int_val);
-                print_operand(fp, current->result);
-                fprintf(fp, "\n");
-                break;
-            case IR_PARAM:
-                fprintf(fp, "\tPARAM ");
-                print_operand(fp, current->arg1);
-                fprintf(fp, "\n");
-                break;
-            case IR_RETURN:
-                fprintf(fp, "\tRETURN ");
-                print_operand(fp, current->arg1);
-                fprintf(fp, "\n");
-                break;
-            case IR_NOP:
-                fprintf(fp, "\tNOP\n");
+            case SELF_CALL:
+                for (int j = 0; j < num_params; j++) {
+                    Operand value = args[first_arg[i] + j];
+                    if (value.type != OP_NONE) emit(IR_ASSIGN, old[j].result, value, none);
+                }
+                emit(IR_GOTO, entry, none, none);
                 break;
             default:
                 break;
         }
-        current = current->next;
     }
+    free(old);
+    free(action);
+    free(copy);
+    free(first_arg);
+    free(args);
+    free(stack);
 }
 
-// Function to print the IR to a file
-void print_ir_to_file(const char *filename) {
-    FILE *fp = fopen(filename, "w");
-    if (!fp) {
-        perror("Could not open 3AC output file");
-        return;
+/* --- Scopes of variable names --- */
+
+// Binds a declared name in the innermost scope and returns its operand.
+static Operand declare_variable(const char *name) {
+    StringId id = string_id(intern_string(name));
+    Operand var = create_operand_identifier(name);
+    for (int i = num_scoped_names - 1; i >= 0; i--) {
+        if (scoped_names[i].name != id) continue;
+        if (i >= scope_start) return scoped_names[i].var; // Already declared here
+        char renamed[256];
+        snprintf(renamed, sizeof(renamed), "%s.s%d", name, ++num_shadowing);
+        var = create_operand_identifier(renamed);
+        break;
     }
-    // First, print the main function's instructions
-    fprintf(fp, "# --- Global DECLARATIONS ---\n");
-    print_ir_list(fp, global_declarations_head);
-    
-    // Second, print the main function's instructions
-    fprintf(fp, "# --- MAIN FUNCTION ---\n");
-    print_ir_list(fp, main_ir_head);
-
-    // Finaly, print the other functions' instructions
-    fprintf(fp, "\n# --- OTHER FUNCTIONS ---\n");
-    print_ir_list(fp, other_funcs_ir_head);
-    fclose(fp);
-}
-
-// Helper to free a single operand's dynamically allocated name/string
-void free_operand(Operand op) {
-    switch (op.type) {
-        case OP_STRING_LITERAL:
-        case OP_IDENTIFIER:
-        case OP_TEMPORARY:
-        case OP_LABEL:
-            if (op.val.name) {
-                free(op.val.name);
-            }
-            break;
-        default:
-            // No dynamic memory for other operand types
-            break;
+    if (num_scoped_names == scoped_names_capacity) {
+        scoped_names_capacity = scoped_names_capacity ? scoped_names_capacity * 2 : 16;
+        scoped_names = (ScopedName*) checked_realloc(scoped_names, scoped_names_capacity, sizeof(ScopedName));
+    }
+    scoped_names[num_scoped_names].name = id;
+    scoped_names[num_scoped_names].var = var;
+    num_scoped_names++;
+    return var;
+}
+
+// The operand of the innermost variable called 'name'. Functions and names
+// not declared as variables keep their own name.
+static Operand variable_operand(const char *name) {
+    const char *interned = find_interned_string(name);
+    if (interned) {
+        StringId id = string_id(interned);
+        for (int i = num_scoped_names - 1; i >= 0; i--) {
+            if (scoped_names[i].name == id) return scoped_names[i].var;
+        }
     }
+    return create_operand_identifier(name);
+}
+
+// Opens a scope; returns what close_name_scope() needs to restore.
+static int open_name_scope() {
+    int outer_start = scope_start;
+    scope_start = num_scoped_names;
+    return outer_start;
+}
+
+static void close_name_scope(int outer_start) {
+    num_scoped_names = scope_start;
+    scope_start = outer_start;
 }
 
-// Helper to free a list of instructions
-void free_ir_list(Instruction *head) {
-    Instruction *current = head;
-    while (current) {
-        Instruction *temp = current;
-        current = current->next;
+/* --- Lifetimes of heap-allocated locals --- */
 
-        free_operand(temp->result);
-        free_operand(temp->arg1);
-        free_operand(temp->arg2);
-        free(temp);
+static void emit_alloc_heap(Operand local, int size) {
+    emit(IR_ALLOC_HEAP, local, create_operand_int(size), create_operand_none());
+    if (!current_function) return; // Globals live as long as the program
+    if (num_heap_locals == heap_locals_capacity) {
+        heap_locals_capacity = heap_locals_capacity ? heap_locals_capacity * 2 : 8;
+        heap_locals = (Operand*) checked_realloc(heap_locals, heap_locals_capacity, sizeof(Operand));
     }
+    heap_locals[num_heap_locals++] = local;
 }
 
-// Main cleanup function for all IR lists
-void free_ir_lists() {
-    free_ir_list(main_ir_head);
-    main_ir_head = main_ir_tail = NULL;
-    free_ir_list(other_funcs_ir_head);
-    other_funcs_ir_head = other_funcs_ir_tail = NULL;
-    free_ir_list(global_declarations_head);
-    global_declarations_head=global_declarations_tail=NULL;
+// Frees the locals allocated since the scope depth 'depth', innermost first.
+static void free_heap_locals(int depth) {
+    if (current_function->num_instrs > 0) {
+        OpCode last = current_function->instrs[current_function->num_instrs - 1].opcode;
+        if (last == IR_GOTO || last == IR_RETURN || last == IR_HALT) return; // Unreachable
+    }
+    for (int i = num_heap_locals - 1; i >= depth; i--) {
+        emit(IR_FREE_HEAP, create_operand_none(), heap_locals[i], create_operand_none());
+    }
 }
 
-/* --- Peephole Optimizer --- */
+// Closes the scopes opened since 'depth'.
+static void close_heap_scope(int depth) {
+    free_heap_locals(depth);
+    num_heap_locals = depth;
+}
 
-/**
- * @brief Compares two operands to see if they are identical.
- * This is crucial for matching addresses in the peephole optimizer.
- */
-int are_operands_equal(Operand op1, Operand op2) {
-    if (op1.type != op2.type) {
-        return 0; // Not equal if types differ
+// An aggregate's name holds the address of its block, so copying the name
+// (struct assignment, returning a struct, storing a call's result) shares
+// the block instead of copying it. Such blocks are never freed.
+static void keep_shared_blocks(IRFunction *fn) {
+    int num_names = string_pool_size();
+    char *shared = (char*) checked_calloc(num_names, sizeof(char));
+    for (int i = 0; i < fn->num_instrs; i++) {
+        const Instruction *instr = &fn->instrs[i];
+        if ((instr->opcode == IR_ASSIGN || instr->opcode == IR_RETURN) && instr->arg1.type == OP_IDENTIFIER) {
+            shared[instr->arg1.val.name] = 1;
+        }
+        if (ir_defines_result(instr->opcode) && instr->opcode != IR_ALLOC_HEAP &&
+            instr->result.type == OP_IDENTIFIER) {
+            shared[instr->result.val.name] = 1;
+        }
     }
-    switch (op1.type) {
-        case OP_INT_CONST:
-            return op1.val.int_val == op2.val.int_val;
-        case OP_CHAR_CONST:
-            return op1.val.char_val == op2.val.char_val;
-        case OP_FLOAT_CONST:
-            return op1.val.float_val==op2.val.float_val;
-        case OP_IDENTIFIER:
-        case OP_TEMPORARY:
-        case OP_LABEL:
-            // Assumes names are properly managed (e.g., strdup'd)
-            return strcmp(op1.val.name, op2.val.name) == 0;
-        case OP_NONE:
-            return 1; // OP_NONE is always equal to OP_NONE
-        // Add other types (float, char, etc.) if needed for comparison
-        default:
-            return 0;
+    int kept = 0;
+    for (int i = 0; i < fn->num_instrs; i++) {
+        if (fn->instrs[i].opcode == IR_FREE_HEAP && shared[fn->instrs[i].arg1.val.name]) continue;
+        fn->instrs[kept++] = fn->instrs[i];
     }
+    fn->num_instrs = kept;
+    free(shared);
 }
 
-/**
- * @brief Performs peephole optimization on a list of IR instructions.
- * Currently, it optimizes the pattern:
- *   INDEX_LOAD temp, base, offset
- *   INDEX_STORE base, offset, value
- * by removing the redundant INDEX_LOAD.
- * @param head A pointer to the head of the instruction list.
- * @return The head of the new, optimized instruction list.
- */
-Instruction* optimize_ir(Instruction *head) {
-    if (!head) {
-        return NULL;
+/* --- IR generation handlers, one per AST node kind --- */
+
+// IR opcode for each AST operator. Operators with no single IR instruction
+// (the comma operator, unary plus) map to IR_NOP.
+static const OpCode ast_op_opcodes[AST_OP_COUNT] = {
+    [AST_OP_NONE] = IR_NOP,
+    [AST_OP_ADD] = IR_ADD,
+    [AST_OP_SUB] = IR_SUB,
+    [AST_OP_MUL] = IR_MUL,
+    [AST_OP_DIV] = IR_DIV,
+    [AST_OP_MOD] = IR_MOD,
+    [AST_OP_EQ] = IR_EQ,
+    [AST_OP_NE] = IR_NE,
+    [AST_OP_LT] = IR_LT,
+    [AST_OP_GT] = IR_GT,
+    [AST_OP_LE] = IR_LE,
+    [AST_OP_GE] = IR_GE,
+    [AST_OP_LOGICAL_AND] = IR_AND,
+    [AST_OP_LOGICAL_OR] = IR_OR,
+    [AST_OP_BIT_AND] = IR_BIT_AND,
+    [AST_OP_BIT_OR] = IR_BIT_OR,
+    [AST_OP_XOR] = IR_XOR,
+    [AST_OP_SHL] = IR_SHL,
+    [AST_OP_SHR] = IR_SHR,
+    [AST_OP_COMMA] = IR_NOP,
+    [AST_OP_ADDR] = IR_ADDR_OF,
+    [AST_OP_DEREF] = IR_DEREF,
+    [AST_OP_PLUS] = IR_NOP,
+    [AST_OP_NEG] = IR_UNARY_MINUS,
+    [AST_OP_BIT_NOT] = IR_BIT_NOT,
+    [AST_OP_LOGICAL_NOT] = IR_NOT,
+    [AST_OP_ASSIGN] = IR_ASSIGN,
+    [AST_OP_MUL_ASSIGN] = IR_MUL,
+    [AST_OP_DIV_ASSIGN] = IR_DIV,
+    [AST_OP_MOD_ASSIGN] = IR_MOD,
+    [AST_OP_ADD_ASSIGN] = IR_ADD,
+    [AST_OP_SUB_ASSIGN] = IR_SUB,
+};
+
+// Nodes that are program structure or pure type information. They produce
+// no value, but their children might produce code.
+static Operand ir_children(ASTNode *node) {
+    for (int i = 0; i < node->num_children; i++) {
+        Generate_IR(node->children[i]);
     }
+    return create_operand_none(); // These nodes don't produce a value
+}
 
-    Instruction *current = head;
-
-    while (current && current->next) {
-        Instruction *next_instr = current->next;
-
-        // Pattern: Redundant Load-Store
-        // Look for an INDEX_LOAD followed by an INDEX_STORE to the same location.
-        if (current->opcode == IR_INDEX_LOAD && next_instr->opcode == IR_INDEX_STORE) {
-            // For INDEX_LOAD, the base is arg1 and offset is arg2.
-            Operand load_base = current->arg1;
-            Operand load_offset = current->arg2;
-
-            // For INDEX_STORE, the base is result and offset is arg1.
-            Operand store_base = next_instr->result;
-            Operand store_offset = next_instr->arg1;
-
-            // Check if the base and offset operands are the same.
-            if (are_operands_equal(load_base, store_base) && are_operands_equal(load_offset, store_offset)) {
-                Instruction *to_remove = current;
-                
-                // Find the instruction before 'current' to relink the list.
-                Instruction *prev = head;
-                if (to_remove == head) {
-                    head = next_instr;
-                } else {
-                    while (prev->next != to_remove) {
-                        prev = prev->next;
-                    }
-                    prev->next = next_instr;
-                }
-                current = next_instr; // Continue from the next instruction
+static Operand ir_declaration(ASTNode *node) {
+    // This is the correct place to handle allocation for declared variables.
+    ASTNode* declarator_list = node->children[1];
+    while (declarator_list) {
+        // The actual declarator can be inside an InitDeclarator or be the node itself.
+        ASTNode* current_decl = declarator_list->children[0];
+        if (current_decl->kind == AST_INIT_DECLARATOR) {
+            // Case: int x = 5;
+            Generate_IR(current_decl); // Handle the assignment part
+        }else {
+            // Case for uninitialized declarations: int x; struct Point p; etc.
+            const char* var_name = get_declarator_name(current_decl);
+            if (var_name) {
+                Type* type = current_decl->type; // Set by check_semantics
+                Operand var = declare_variable(var_name);
+                // If it's a struct, union, or array, allocate heap memory
+                if (type && (type->kind == TYPE_STRUCT || type->kind == TYPE_UNION || type->kind == TYPE_ARRAY)) {
+                    int total_size = get_type_size(type);
+                    emit_alloc_heap(var, total_size);
+                }else{
+                    // For basic types, no heap allocation needed; stack allocation assumed.
+                    if(type && type->kind == TYPE_BASE){
+                        if(strcmp(type->data.base_name,"int")==0){
+                            // Initialize int to 0
+                            emit(IR_ASSIGN, var, create_operand_int(0), create_operand_none());
+                        }else if(strcmp(type->data.base_name,"char")==0){
+                            // Initialize char to 0
+                            emit(IR_ASSIGN, var, create_operand_char(0), create_operand_none());
+                        }else if((strcmp(type->data.base_name,"float")==0)||(strcmp(type->data.base_name,"double")==0)){
+                            // Initialize float to 0.0
+                            emit(IR_ASSIGN, var, create_operand_float(0.0), create_operand_none());
+                        }else {
+                            // Other basic types can be handled here
 
-                if(to_remove->result.type == OP_TEMPORARY) free(to_remove->result.val.name);
-                free(to_remove);
-                continue; // Restart loop to check for new patterns
-            }
-        }
+                        }
+                    }
 
-        // Pattern: Redundant MUL -> INDEX_LOAD -> MUL -> INDEX_STORE for array assignments
-        // Example: a[i] = val;
-        //   MUL t0, i, 4
-        //   INDEX_LOAD t1, a, t0  <-- Redundant load
-        //   MUL t2, i, 4          <-- Redundant multiplication
-        //   INDEX_STORE a, t2, val
-        if (current->opcode == IR_MUL && current->next && current->next->opcode == IR_INDEX_LOAD &&
-            current->next->next && current->next->next->opcode == IR_MUL &&
-            current->next->next->next && current->next->next->next->opcode == IR_INDEX_STORE) {
-
-            Instruction *mul1 = current;
-            Instruction *load = current->next;
-            Instruction *mul2 = current->next->next;
-            Instruction *store = current->next->next->next;
-            //printf("DEBUG: Found potential redundant MUL-LOAD-MUL-STORE pattern.\n");
-            // Check if the pattern matches
-            //printf("DEBUG: Comparing MUL1 result '%s' with LOAD result '%s'\n", mul1->result.val.name, load->result.val.name);
-            //printf("DEBUG: Comparing STORE arg1 '%s' with MUL2 result '%s'\n", store->arg1.val.name, mul2->result.val.name);
-            //printf("DEBUG: Comparing LOAD base '%s' with STORE result '%s'\n", load->arg1.val.name, store->result.val.name);
-            if (are_operands_equal(mul1->arg1, mul2->arg1) && are_operands_equal(mul1->arg2, mul2->arg2) && // MULs are identical
-                are_operands_equal(load->arg2, mul1->result) && // load uses result of mul1
-                are_operands_equal(store->arg1, mul2->result) && // store uses result of mul2
-                are_operands_equal(load->arg1, store->result)) { // load and store have same base
-                // This is our redundant pattern. Remove the first two instructions.
-                //printf("DEBUG: Optimizing redundant MUL-LOAD-MUL-STORE pattern.\n");
-                current = mul2; // The next instruction to check will be mul2
-                if (mul1 == head) head = mul2;
-                
-                // Free the removed instructions and their temporary results
-                if(mul1->result.type == OP_TEMPORARY) free(mul1->result.val.name);
-                if(load->result.type == OP_TEMPORARY) free(load->result.val.name);
-                free(mul1);
-                free(load);
-                continue; // Restart loop
+                }
             }
         }
-
-        current = current->next;
+        declarator_list = (declarator_list->num_children > 1) ? declarator_list->children[1] : NULL;
     }
-    return head;
+    return create_operand_none();
 }
 
-// Helper function to recursively process argument list and emit PARAMs
-// This will emit PARAMs in the correct order (left to right)
-static void emit_params_for_call(ASTNode* current_arg_list_node, int* count) {
-    if (!current_arg_list_node || strcmp(current_arg_list_node->node_type, "EmptyExpression") == 0) {
-        return;
+static Operand ir_init_declarator_list(ASTNode *node) {
+    // The list is reversed in the AST, so process children[1] then children[0]
+    if (node->num_children > 1) {
+        Generate_IR(node->children[1]);
     }
+    Generate_IR(node->children[0]);
+    return create_operand_none();
+}
 
-    if (strcmp(current_arg_list_node->node_type, "ArgumentList") == 0) {
-        // The AST is left-recursive: ArgumentList -> ArgumentList, assignment_expression
-        // We must process the list (left child) first to maintain left-to-right order.
-        emit_params_for_call(current_arg_list_node->children[0], count);
-
-        // Then process the actual argument on the right.
-        if (current_arg_list_node->num_children > 1) {
-            Operand param_op = Generate_IR(current_arg_list_node->children[1]);
-            emit(IR_PARAM, create_operand_none(), param_op, create_operand_none());
-            (*count)++;
+static Operand ir_init_declarator(ASTNode *node) {
+    // This node only exists for declarations with an initializer, e.g., `int x = 5;`
+    ASTNode* declarator = node->children[0];
+    ASTNode* initializer = node->children[1];
+    const char* var_name = get_declarator_name(declarator);
+    if (var_name) {
+        Type* type = declarator->type; // Set by check_semantics
+        if (type && (type->kind == TYPE_STRUCT || type->kind == TYPE_UNION || type->kind == TYPE_ARRAY)) {
+            int total_size = get_type_size(type);
+            emit_alloc_heap(declare_variable(var_name), total_size);
         }
-
-    } else {
-        // This is the base case: a single assignment_expression.
-        Operand param_op = Generate_IR(current_arg_list_node);
-        emit(IR_PARAM, create_operand_none(), param_op, create_operand_none());
-        (*count)++;
+        // Now handle the assignment part of the initialization
+        // This requires creating a temporary assignment AST node and processing it.
+        // For now, we assume simple assignment.
+        Operand rhs_op = Generate_IR(initializer);
+        emit(IR_ASSIGN, declare_variable(var_name), rhs_op, create_operand_none());
     }
+    return create_operand_none(); // The assignment is handled here.
 }
 
-// Main IR generation function
-Operand Generate_IR(ASTNode *node) {
-    if (!node) return create_operand_none();
+static Operand ir_array_declarator(ASTNode *node) {
+    // This node is part of a declaration. We need to allocate memory.
+    const char* array_name = get_declarator_name(node);
+    Type* type = node->type; // Set by check_semantics
+    if (type && type->kind == TYPE_ARRAY && type->data.array_info.size > 0) {
+        int total_size = get_type_size(type);
+        emit_alloc_heap(declare_variable(array_name), total_size);
+    }
+    return create_operand_none();
+}
 
-    Operand result_op = create_operand_none();
-    Operand arg1_op, arg2_op;
-
-    // Handle nodes that are primarily statements or program structure
-    // These nodes typically don't produce a value, but their children might.
-    if (strcmp(node->node_type, "Program") == 0 ||
-        strcmp(node->node_type, "ExternalDeclaration") == 0 ||
-        strcmp(node->node_type, "BlockItemList") == 0 ||
-        strcmp(node->node_type, "BlockItem") == 0 ||
-        strcmp(node->node_type, "Statement") == 0 ||
-        strcmp(node->node_type, "EmptyStatement") == 0 ||
-        strcmp(node->node_type, "DeclarationSpecifiers") == 0 ||
-        strcmp(node->node_type, "TypeSpecifier") == 0 ||
-        strcmp(node->node_type, "TypeName") == 0 ||
-        strcmp(node->node_type, "StorageClassSpecifier") == 0 ||
-        strcmp(node->node_type, "TypeQualifier") == 0 ||
-        strcmp(node->node_type, "StructSpecifier") == 0 ||
-        strcmp(node->node_type, "StructToken") == 0 ||
-        strcmp(node->node_type, "UnionToken") == 0 ||
-        strcmp(node->node_type, "StructDeclarationList") == 0 ||
-        strcmp(node->node_type, "StructDeclaration") == 0 ||
-        strcmp(node->node_type, "SpecifierQualifierList") == 0 ||
-        strcmp(node->node_type, "StructDeclaratorList") == 0 ||
-        strcmp(node->node_type, "StructDeclarator") == 0 ||
-        strcmp(node->node_type, "EnumSpecifier") == 0 ||
-        strcmp(node->node_type, "EnumeratorList") == 0 ||
-        strcmp(node->node_type, "Enumerator") == 0 ||
-        strcmp(node->node_type, "Initializer") == 0 ||
-        strcmp(node->node_type, "InitializerList") == 0 ||
-        strcmp(node->node_type, "InitValues") == 0 ||
-        strcmp(node->node_type, "PointerDeclarator") == 0 ||
-        strcmp(node->node_type, "ParameterList") == 0 ||
-        strcmp(node->node_type, "ParameterDeclaration") == 0 ||
-        strcmp(node->node_type, "EmptyParameterList") == 0 ||
-        strcmp(node->node_type, "Pointer") == 0 ||
-        strcmp(node->node_type, "ParenthesizedAbstractDeclarator") == 0 ||
-        strcmp(node->node_type, "AbstractArraySuffix") == 0 ||
-        strcmp(node->node_type, "AbstractFunctionSuffix") == 0 ||
-        strcmp(node->node_type, "EmptyExpression") == 0 
-        ) {
-        for (int i = 0; i < node->num_children; i++) {
-            Generate_IR(node->children[i]);
-        }
-        return create_operand_none(); // These nodes don't produce a value
+static Operand ir_function_definition(ASTNode *node) {
+    const char* func_name = get_declarator_name(node->children[1]);
+    if (strcmp(func_name, "main") == 0) {
+        is_in_main_function = 1;
+    } else {
+        is_in_main_function = 0;
     }
+    begin_ir_function(func_name);
+    num_heap_locals = 0;
+    int outer_start = open_name_scope();
+
+    // Handle parameter assignments from arguments
+    ASTNode* declarator_node = node->children[1];
+    ASTNode* params_ast_node = get_function_parameters_node(declarator_node);
+    Symbol* params_list = build_parameter_list_from_ast(params_ast_node);
+    Symbol* current_param = params_list;
+    int arg_index = 0;
+    while (current_param) {
+        emit(IR_ASSIGN, declare_variable(current_param->name), create_operand_argument(arg_index), create_operand_none());
+        current_param = current_param->next;
+        arg_index++;
+    }
+    Generate_IR(node->children[2]); // CompoundStatement
+    //If the return is void insert a return explicity at the end of the function.
+    Symbol* function_entry=lookup_symbol(func_name);
+    const char* return_type=function_entry->type->data.function_info.return_type->data.base_name;
+    if(strcmp(return_type,"void") == 0 ){
+        emit(IR_RETURN,create_operand_none(),create_operand_none(),create_operand_none());
+    }
+    keep_shared_blocks(current_function);
+    eliminate_tail_calls(current_function, arg_index);
+    num_tail_calls = 0;
+    close_name_scope(outer_start);
+    end_ir_function();
+    return create_operand_none();
+}
 
-    if (strcmp(node->node_type, "Declaration") == 0) {
-        // This is the correct place to handle allocation for declared variables.
-        ASTNode* declarator_list = node->children[1];
-        while (declarator_list) {
-            // The actual declarator can be inside an InitDeclarator or be the node itself.
-            ASTNode* current_decl = declarator_list->children[0];
-            if (strcmp(current_decl->node_type, "InitDeclarator") == 0) {
-                // Case: int x = 5;
-                Generate_IR(current_decl); // Handle the assignment part
-            }else {
-                // Case for uninitialized declarations: int x; struct Point p; etc.
-                char* var_name = get_declarator_name(current_decl);
-                if (var_name) {
-                    Symbol* sym = lookup_symbol(var_name);
-                    // If it's a struct, union, or array, allocate heap memory
-                    if (sym && (sym->type->kind == TYPE_STRUCT || sym->type->kind == TYPE_UNION || sym->type->kind == TYPE_ARRAY)) {
-                        int total_size = get_type_size(sym->type);
-                        emit(IR_ALLOC_HEAP, create_operand_identifier(var_name), create_operand_int(total_size), create_operand_none());
-                    }else{
-                        // For basic types, no heap allocation needed; stack allocation assumed.
-                        if(sym->type->kind == TYPE_BASE){
-                            if(strcmp(sym->type->data.base_name,"int")==0){
-                                // Initialize int to 0
-                                emit(IR_ASSIGN, create_operand_identifier(var_name), create_operand_int(0), create_operand_none());
-                            }else if(strcmp(sym->type->data.base_name,"char")==0){
-                                // Initialize char to 0
-                                emit(IR_ASSIGN, create_operand_identifier(var_name), create_operand_char(0), create_operand_none());
-                            }else if((strcmp(sym->type->data.base_name,"float")==0)||(strcmp(sym->type->data.base_name,"double")==0)){
-                                // Initialize float to 0.0  
-                                emit(IR_ASSIGN, create_operand_identifier(var_name), create_operand_float(0.0), create_operand_none());
-                            }else {
-                                // Other basic types can be handled here
-
-                            }
-                        }
-                        
-                    }
-                    free(var_name);
-                }
-            }
-            declarator_list = (declarator_list->num_children > 1) ? declarator_list->children[1] : NULL;
-        }
-        return create_operand_none();
+static Operand ir_compound_statement(ASTNode *node) {
+    int depth = num_heap_locals;
+    int outer_start = open_name_scope();
+    if (node->num_children > 0) { // block_item_list
+        Generate_IR(node->children[0]);
     }
+    close_heap_scope(depth);
+    close_name_scope(outer_start);
+    return create_operand_none();
+}
 
-    if (strcmp(node->node_type, "InitDeclaratorList") == 0) {
-        // The list is reversed in the AST, so process children[1] then children[0]
-        if (node->num_children > 1) {
-            Generate_IR(node->children[1]);
-        }
+static Operand ir_expression_statement(ASTNode *node) {
+    if (node->num_children > 0) { // expression
         Generate_IR(node->children[0]);
-        return create_operand_none();
     }
+    return create_operand_none();
+}
 
-    if (strcmp(node->node_type, "InitDeclarator") == 0) {
-        // This node only exists for declarations with an initializer, e.g., `int x = 5;`
-        ASTNode* declarator = node->children[0];
-        ASTNode* initializer = node->children[1];
-        char* var_name = get_declarator_name(declarator);
-        if (var_name) {
-            Symbol* sym = lookup_symbol(var_name);
-            if (sym && (sym->type->kind == TYPE_STRUCT || sym->type->kind == TYPE_UNION || sym->type->kind == TYPE_ARRAY)) {
-                int total_size = get_type_size(sym->type);
-                emit(IR_ALLOC_HEAP, create_operand_identifier(var_name), create_operand_int(total_size), create_operand_none());
+static Operand ir_return(ASTNode *node) {
+    if (node->num_children > 0) { // expression
+        if(!is_in_main_function){
+            if(node->children[0]->kind == AST_EMPTY_EXPRESSION){
+                free_heap_locals(0);
+                emit(IR_RETURN, create_operand_none(), create_operand_none(), create_operand_none());
+                return create_operand_none();
+            }
+            int first = current_function->num_instrs;
+            Operand arg1_op = Generate_IR(node->children[0]);
+            if (node->children[0]->kind == AST_FUNCTION_CALL && num_heap_locals == 0 &&
+                current_function->instrs[current_function->num_instrs - 1].opcode == IR_CALL) {
+                record_tail_call(first, current_function->num_instrs - 1);
             }
-            // Now handle the assignment part of the initialization
-            // This requires creating a temporary assignment AST node and processing it.
-            // For now, we assume simple assignment.
-            Operand rhs_op = Generate_IR(initializer);
-            emit(IR_ASSIGN, create_operand_identifier(var_name), rhs_op, create_operand_none());
-            free(var_name);
+            free_heap_locals(0);
+            emit(IR_RETURN, create_operand_none(), arg1_op, create_operand_none());
+        }else{
+            // main's return value is the program's exit status.
+            Operand status_op = create_operand_none();
+            if (node->children[0]->kind != AST_EMPTY_EXPRESSION) status_op = Generate_IR(node->children[0]);
+            emit(IR_HALT, create_operand_none(), status_op, create_operand_none());
         }
-        return create_operand_none(); // The assignment is handled here.
+    } else {
+        free_heap_locals(0);
+        emit(IR_RETURN, create_operand_none(), create_operand_none(), create_operand_none());
     }
+    return create_operand_none();
+}
 
-    if (strcmp(node->node_type, "ArrayDeclarator") == 0) {
-        // This node is part of a declaration. We need to allocate memory.
-        char* array_name = get_declarator_name(node);
-        Symbol* sym = lookup_symbol(array_name);
-        if (sym && sym->type->kind == TYPE_ARRAY && sym->type->data.array_info.size > 0) {
-            int total_size = get_type_size(sym->type);
-            emit(IR_ALLOC_HEAP, create_operand_identifier(array_name), create_operand_int(total_size), create_operand_none());
-        }
-        free(array_name);
+static Operand ir_identifier(ASTNode *node) {
+    return variable_operand(node->value);
+}
+
+static Operand ir_int_constant(ASTNode *node) {
+    return create_operand_int(atoi(node->value));
+}
+
+static Operand ir_float_constant(ASTNode *node) {
+    return create_operand_float(atof(node->value));
+}
+
+static Operand ir_char_constant(ASTNode *node) {
+    return create_operand_char(node->value[1]); // Assuming node->value is "'c'"
+}
+
+static Operand ir_string_literal(ASTNode *node) {
+    return create_operand_string(node->value);
+}
+
+// Byte offset of the element at index_op; a constant index needs no code.
+static Operand element_offset(Operand index_op, int element_size) {
+    Operand offset_op;
+    if (fold_constant_operation(IR_MUL, index_op, create_operand_int(element_size), &offset_op)) {
+        return offset_op;
     }
+    offset_op = create_operand_temp();
+    emit(IR_MUL, offset_op, index_op, create_operand_int(element_size));
+    return offset_op;
+}
 
-    if (strcmp(node->node_type, "FunctionDefinition") == 0) {
-        char* func_name = get_declarator_name(node->children[1]);
-        is_global_declaration=0;
-        if (strcmp(func_name, "main") == 0) {
-            is_in_main_function = 1;
+static Operand ir_assignment(ASTNode *node) {
+    Operand arg1_op = Generate_IR(node->children[1]); // RHS
+    Operand result_op = Generate_IR(node->children[0]); // LHS (identifier or dereference)
+    ASTNode* lhs = node->children[0];
+    if (lhs->kind == AST_ARRAY_ACCESS) { // arr[i] = value
+        //printf("DEBUG: Array assignment detected: %s\n", lhs->value);
+        Operand array_op = Generate_IR(lhs->children[0]);
+        Operand index_op = Generate_IR(lhs->children[1]);
+        Type* element_type = lhs->type; // The type of the element
+
+        if (element_type) {
+            Operand offset_op = element_offset(index_op, get_type_size(element_type));
+            emit(IR_INDEX_STORE, array_op, offset_op, arg1_op);
         } else {
-            is_in_main_function = 0;
-        }
-        emit(IR_LABEL, create_operand_label_named(func_name), create_operand_none(), create_operand_none());
-
-        // Handle parameter assignments from arguments
-        ASTNode* declarator_node = node->children[1];
-        ASTNode* params_ast_node = get_function_parameters_node(declarator_node);
-        Symbol* params_list = build_parameter_list_from_ast(params_ast_node);
-        Symbol* current_param = params_list;
-        int arg_index = 0;
-        while (current_param) {
-            emit(IR_ASSIGN, create_operand_identifier(current_param->name), create_operand_argument(arg_index), create_operand_none());
-            current_param = current_param->next;
-            arg_index++;
+            fprintf(stderr, "IR Generation Error: Attempting to index a non-array/pointer type for assignment.\n");
         }
-        Generate_IR(node->children[2]); // CompoundStatement
-        //If the return is void insert a return explicity at the end of the function.
-        Symbol* function_entry=lookup_symbol(func_name);
-        char* return_type=function_entry->type->data.function_info.return_type->data.base_name;
-        if(strcmp(return_type,"void") == 0 ){
-            emit(IR_RETURN,create_operand_none(),create_operand_none(),create_operand_none());
-        }   
-        free(func_name); // Free the strdup from get_declarator_name
-        return create_operand_none();
-    } else if (strcmp(node->node_type, "CompoundStatement") == 0) {
-        if (node->num_children > 0) { // block_item_list
-            Generate_IR(node->children[0]);
-        }
-        return create_operand_none();
-    } else if (strcmp(node->node_type, "ExpressionStatement") == 0) {
-        if (node->num_children > 0) { // expression
-            Generate_IR(node->children[0]);
-        }
-        return create_operand_none();
-    } else if (strcmp(node->node_type, "Return") == 0) {
-        if (node->num_children > 0) { // expression
-            if(!is_in_main_function){
-                if(strcmp(node->children[0]->node_type, "EmptyExpression") == 0){
-                    emit(IR_RETURN, create_operand_none(), create_operand_none(), create_operand_none());
-                    is_global_declaration=1;
-                    return create_operand_none();
-                }
-                arg1_op = Generate_IR(node->children[0]);
-                emit(IR_RETURN, create_operand_none(), arg1_op, create_operand_none());
-            }else{
-                emit(IR_HALT, create_operand_none(), create_operand_none(), create_operand_none());
-            }
+        result_op = arg1_op; // The result of an assignment expression is the assigned value
+    } else if (lhs->kind == AST_POINTER_MEMBER_ACCESS) { // p->m = value
+        //printf("DEBUG: Pointer to struct member assignment detected: %s\n", lhs->value);
+        Operand struct_ptr_op = Generate_IR(lhs->children[0]);
+        const char* member_name = lhs->value;
+        int offset = get_member_offset(lhs->children[0]->type, member_name);
+
+        if (offset != -1) {
+            // Use INDEX_STORE: base_ptr, index, value_to_store
+            emit(IR_INDEX_STORE, struct_ptr_op, create_operand_int(offset), arg1_op);
         } else {
-            emit(IR_RETURN, create_operand_none(), create_operand_none(), create_operand_none());
+            fprintf(stderr, "IR Generation Error: Member '%s' not found for pointer assignment.\n", member_name);
         }
-        is_global_declaration=1;
-        return create_operand_none();
-    } else if (strcmp(node->node_type, "Identifier") == 0) {
-        result_op = create_operand_identifier(node->value);
-    } else if (strcmp(node->node_type, "IntConstant") == 0) {
-        result_op = create_operand_int(atoi(node->value));
-    } else if (strcmp(node->node_type, "FloatConstant") == 0) {
-        result_op = create_operand_float(atof(node->value));
-    } else if (strcmp(node->node_type, "CharConstant") == 0) {
-        result_op = create_operand_char(node->value[1]); // Assuming node->value is "'c'"
-    } else if (strcmp(node->node_type, "StringLiteral") == 0) {
-        result_op = create_operand_string(node->value);
-    } else if (strcmp(node->node_type, "Assignment") == 0) {
-        arg1_op = Generate_IR(node->children[1]); // RHS
-        result_op = Generate_IR(node->children[0]); // LHS (identifier or dereference)
-        ASTNode* lhs = node->children[0];
-        if (strcmp(lhs->node_type, "ArrayAccess") == 0) { // arr[i] = value
-            //printf("DEBUG: Array assignment detected: %s\n", lhs->value);
-            Operand array_op = Generate_IR(lhs->children[0]);
-            Operand index_op = Generate_IR(lhs->children[1]);
-            Type* element_type = lhs->type; // The type of the element
-
-            if (element_type) {
-                int element_size = get_type_size(element_type);
-                Operand offset_op = create_operand_temp();
-                emit(IR_MUL, offset_op, index_op, create_operand_int(element_size));
-                emit(IR_INDEX_STORE, array_op, offset_op, arg1_op);
-            } else {
-                fprintf(stderr, "IR Generation Error: Attempting to index a non-array/pointer type for assignment.\n");
-            }
-            result_op = arg1_op; // The result of an assignment expression is the assigned value
-        } else if (strcmp(lhs->node_type, "PointerMemberAccess") == 0) { // p->m = value
-            //printf("DEBUG: Pointer to struct member assignment detected: %s\n", lhs->value);
-            Operand struct_ptr_op = Generate_IR(lhs->children[0]);
-            char* member_name = lhs->value;
-            int offset = get_member_offset(lhs->children[0]->type, member_name);
-
-            if (offset != -1) {
-                // Use INDEX_STORE: base_ptr, index, value_to_store
-                emit(IR_INDEX_STORE, struct_ptr_op, create_operand_int(offset), arg1_op);
-            } else {
-                fprintf(stderr, "IR Generation Error: Member '%s' not found for pointer assignment.\n", member_name);
-            }
-            result_op = arg1_op;
-        } else if (strcmp(lhs->node_type, "MemberAccess") == 0) { // s.m = value
-            //printf("DEBUG: Struct member assignment detected: %s\n", lhs->value);   
-            // Get the base address of the struct variable 's'
-            Operand struct_op = Generate_IR(lhs->children[0]);
-            char* member_name = lhs->value;
-            // Get the offset of member 'm'
-            int offset = get_member_offset(lhs->children[0]->type, member_name);
-            if (offset != -1) {
-                // We need the address of the struct variable to use as a base.
-                //Operand base_addr_op = create_operand_temp();
-                //emit(IR_ADDR_OF, base_addr_op, struct_op, create_operand_none());
-                // Use INDEX_STORE: base_addr, offset, value_to_store
-                emit(IR_INDEX_STORE, struct_op, create_operand_int(offset), arg1_op);
-            } else {
-                fprintf(stderr, "IR Generation Error: Member '%s' not found for struct assignment.\n", member_name);
-            }
-            result_op = arg1_op;
-        } else if((strcmp(lhs->node_type, "UnaryOp") == 0)&& (strcmp(lhs->value,"*")==0)){ // *ptr = value
-            Operand ptr_op = Generate_IR(lhs->children[0]);
-            emit(IR_DEREF_STORE, ptr_op, arg1_op, create_operand_none());
+        result_op = arg1_op;
+    } else if (lhs->kind == AST_MEMBER_ACCESS) { // s.m = value
+        //printf("DEBUG: Struct member assignment detected: %s\n", lhs->value);
+        // Get the base address of the struct variable 's'
+        Operand struct_op = Generate_IR(lhs->children[0]);
+        const char* member_name = lhs->value;
+        // Get the offset of member 'm'
+        int offset = get_member_offset(lhs->children[0]->type, member_name);
+        if (offset != -1) {
+            // We need the address of the struct variable to use as a base.
+            //Operand base_addr_op = create_operand_temp();
+            //emit(IR_ADDR_OF, base_addr_op, struct_op, create_operand_none());
+            // Use INDEX_STORE: base_addr, offset, value_to_store
+            emit(IR_INDEX_STORE, struct_op, create_operand_int(offset), arg1_op);
         } else {
-
-            // Default case for simple variables: a = value
-            result_op = Generate_IR(lhs); // LHS (identifier)
-            emit(IR_ASSIGN, result_op, arg1_op, create_operand_none());
+            fprintf(stderr, "IR Generation Error: Member '%s' not found for struct assignment.\n", member_name);
         }
-    } else if (strcmp(node->node_type, "BinaryOp") == 0) {
-        arg1_op = Generate_IR(node->children[0]);
-        arg2_op = Generate_IR(node->children[1]);
-        result_op = create_operand_temp();
+        result_op = arg1_op;
+    } else if (lhs->kind == AST_UNARY_OP && lhs->op == AST_OP_DEREF) { // *ptr = value
+        Operand ptr_op = Generate_IR(lhs->children[0]);
+        emit(IR_DEREF_STORE, ptr_op, arg1_op, create_operand_none());
+    } else {
 
-        OpCode op_code;
-        if (strcmp(node->value, "+") == 0) op_code = IR_ADD;
-        else if (strcmp(node->value, "-") == 0) op_code = IR_SUB;
-        else if (strcmp(node->value, "*") == 0) op_code = IR_MUL;
-        else if (strcmp(node->value, "/") == 0) op_code = IR_DIV;
-        else if (strcmp(node->value, "%") == 0) op_code = IR_MOD;
-        else if (strcmp(node->value, "==") == 0) op_code = IR_EQ;
-        else if (strcmp(node->value, "!=") == 0) op_code = IR_NE;
-        else if (strcmp(node->value, "<") == 0) op_code = IR_LT;
-        else if (strcmp(node->value, ">") == 0) op_code = IR_GT;
-        else if (strcmp(node->value, "<=") == 0) op_code = IR_LE;
-        else if (strcmp(node->value, ">=") == 0) op_code = IR_GE;
-        else if (strcmp(node->value, "&&") == 0) op_code = IR_AND;
-        else if (strcmp(node->value, "||") == 0) op_code = IR_OR;
-        else if (strcmp(node->value, "&") == 0) op_code = IR_BIT_AND;
-        else if (strcmp(node->value, "|") == 0) op_code = IR_BIT_OR;
-        else if (strcmp(node->value, "^") == 0) op_code = IR_XOR;
-        else if (strcmp(node->value, "<<") == 0) op_code = IR_SHL;
-        else if (strcmp(node->value, ">>") == 0) op_code = IR_SHR;
-        else if (strcmp(node->value, ",") == 0) { // Comma operator
-            // Evaluate left, then right, result is right.
-            // IR for left is already generated by arg1_op.
-            result_op = arg2_op; // The result of the comma operator is the right operand's value
-            return result_op;
+        // Default case for simple variables: a = value
+        result_op = Generate_IR(lhs); // LHS (identifier)
+        emit(IR_ASSIGN, result_op, arg1_op, create_operand_none());
+    }
+    return result_op;
+}
+
+/* --- Short-circuit evaluation --- */
+
+static int is_logical_op(ASTNode *node) {
+    return node->kind == AST_BINARY_OP &&
+           (node->op == AST_OP_LOGICAL_AND || node->op == AST_OP_LOGICAL_OR);
+}
+
+// Returns 1 for expressions whose value is always 0 or 1.
+static int is_truth_valued(ASTNode *node) {
+    if (node->kind == AST_UNARY_OP) return node->op == AST_OP_LOGICAL_NOT;
+    if (node->kind != AST_BINARY_OP) return 0;
+    switch (node->op) {
+        case AST_OP_EQ: case AST_OP_NE: case AST_OP_LT: case AST_OP_GT: case AST_OP_LE: case AST_OP_GE:
+        case AST_OP_LOGICAL_AND: case AST_OP_LOGICAL_OR:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int constant_is_true(Operand op) {
+    return op.type == OP_FLOAT_CONST ? operand_float_value(op) != 0.0 : op.val.int_val != 0;
+}
+
+// Jumps to 'true_label' if 'value' is nonzero and to 'false_label' if it is
+// zero. Either label may be OP_NONE, meaning fall through in that case. An
+// empty condition (as in 'for (;;)') is true.
+static void emit_branch(Operand value, Operand true_label, Operand false_label) {
+    if (value.type == OP_NONE || is_constant_operand(value)) {
+        Operand target = (value.type == OP_NONE || constant_is_true(value)) ? true_label : false_label;
+        if (target.type != OP_NONE) emit(IR_GOTO, target, create_operand_none(), create_operand_none());
+        return;
+    }
+    if (true_label.type != OP_NONE) {
+        emit(IR_IF_TRUE_GOTO, true_label, value, create_operand_none());
+        if (false_label.type != OP_NONE) emit(IR_GOTO, false_label, create_operand_none(), create_operand_none());
+    } else if (false_label.type != OP_NONE) {
+        emit(IR_IF_FALSE_GOTO, false_label, value, create_operand_none());
+    }
+}
+
+// Generates a condition as jumping code: control reaches 'true_label' or
+// 'false_label' (OP_NONE: falls through) without materializing a 0/1 value
+// for '&&', '||' and '!'. The right side of '&&' and '||' is only evaluated
+// when the left side does not decide the outcome.
+static void ir_condition(ASTNode *node, Operand true_label, Operand false_label) {
+    if (is_logical_op(node)) {
+        int is_and = node->op == AST_OP_LOGICAL_AND;
+        // The left side exits early on false for '&&' and on true for '||';
+        // otherwise it falls through to the right side.
+        Operand early = is_and ? false_label : true_label;
+        Operand skip = create_operand_none();
+        if (early.type == OP_NONE) early = skip = create_operand_label();
+        if (is_and) {
+            ir_condition(node->children[0], create_operand_none(), early);
+        } else {
+            ir_condition(node->children[0], early, create_operand_none());
         }
-        else {
-            fprintf(stderr, "IR Generation Error: Unknown binary operator '%s'\n", node->value);
-            op_code = IR_NOP;
+        ir_condition(node->children[1], true_label, false_label);
+        if (skip.type != OP_NONE) emit(IR_LABEL, skip, create_operand_none(), create_operand_none());
+    } else if (node->kind == AST_UNARY_OP && node->op == AST_OP_LOGICAL_NOT) {
+        ir_condition(node->children[0], false_label, true_label);
+    } else {
+        emit_branch(Generate_IR(node), true_label, false_label);
+    }
+}
+
+// Generates an expression and returns its truth value (0 or 1).
+static Operand ir_truth_value(ASTNode *node) {
+    Operand value = Generate_IR(node);
+    if (is_constant_operand(value)) return create_operand_int(constant_is_true(value));
+    if (is_truth_valued(node)) return value;
+    Operand result = create_operand_temp();
+    emit(IR_NE, result, value, create_operand_int(0));
+    return result;
+}
+
+static int is_jumping_condition(ASTNode *node) {
+    return is_logical_op(node) || (node->kind == AST_UNARY_OP && node->op == AST_OP_LOGICAL_NOT);
+}
+
+// '&&' and '||' used as a value:
+//         <left side, jumping to Ldecided when it decides the result>
+//         result = truth value of the right side
+//         JUMP Lend
+// Ldecided:
+//         result = 0 for '&&', 1 for '||'
+// Lend:
+// A right side that is itself a logical operation jumps to Ldecided as well,
+// and the fall-through path assigns the other constant.
+static Operand ir_logical_op(ASTNode *node) {
+    int is_and = node->op == AST_OP_LOGICAL_AND;
+    Operand none = create_operand_none();
+    Operand decided;
+    if (is_jumping_condition(node->children[0])) {
+        decided = create_operand_label();
+        ir_condition(node->children[0], is_and ? none : decided, is_and ? decided : none);
+    } else {
+        Operand left = Generate_IR(node->children[0]);
+        if (is_constant_operand(left)) {
+            // A constant left side either decides the result or leaves it to the right side.
+            if (constant_is_true(left) != is_and) return create_operand_int(!is_and);
+            return ir_truth_value(node->children[1]);
         }
-        emit(op_code, result_op, arg1_op, arg2_op);
-    } else if (strcmp(node->node_type, "UnaryOp") == 0) {
-        //printf("DEBUG: Unary operator found!!");
-        arg1_op = Generate_IR(node->children[0]);
+        decided = create_operand_label();
+        emit_branch(left, is_and ? none : decided, is_and ? decided : none);
+    }
+    Operand result = create_operand_temp();
+    Operand end = create_operand_label();
+    if (is_jumping_condition(node->children[1])) {
+        ir_condition(node->children[1], is_and ? none : decided, is_and ? decided : none);
+        emit(IR_ASSIGN, result, create_operand_int(is_and), none);
+    } else {
+        emit(IR_ASSIGN, result, ir_truth_value(node->children[1]), none);
+    }
+    emit(IR_GOTO, end, none, none);
+    emit(IR_LABEL, decided, none, none);
+    emit(IR_ASSIGN, result, create_operand_int(!is_and), none);
+    emit(IR_LABEL, end, none, none);
+    return result;
+}
+
+static Operand ir_binary_op(ASTNode *node) {
+    if (is_logical_op(node)) {
+        return ir_logical_op(node);
+    }
+    Operand arg1_op = Generate_IR(node->children[0]);
+    Operand arg2_op = Generate_IR(node->children[1]);
+    if (node->op == AST_OP_COMMA) {
+        // Evaluate left, then right, result is right.
+        // IR for left is already generated by arg1_op.
+        return arg2_op; // The result of the comma operator is the right operand's value
+    }
+
+    OpCode op_code = ast_op_opcodes[node->op];
+    if (op_code == IR_NOP) {
+        fprintf(stderr, "IR Generation Error: Unknown binary operator '%s'\n", node->value);
+    }
+    Operand folded;
+    if (fold_constant_operation(op_code, arg1_op, arg2_op, &folded)) {
+        return folded; // Both operands are constants: no code needed
+    }
+    Operand result_op = create_operand_temp();
+    emit(op_code, result_op, arg1_op, arg2_op);
+    return result_op;
+}
+
+static Operand ir_unary_op(ASTNode *node) {
+    //printf("DEBUG: Unary operator found!!");
+    Operand arg1_op = Generate_IR(node->children[0]);
+    OpCode op_code = ast_op_opcodes[node->op];
+    if (op_code == IR_NOP) {
+        fprintf(stderr, "IR Generation Error: Unknown unary operator '%s'\n", node->value);
+    }
+    Operand folded;
+    if (fold_constant_operation(op_code, arg1_op, create_operand_none(), &folded)) {
+        return folded;
+    }
+    Operand result_op = create_operand_temp();
+    emit(op_code, result_op, arg1_op, create_operand_none());
+    return result_op;
+}
+
+static Operand ir_prefix_step(ASTNode *node) {
+    Operand target_op = Generate_IR(node->children[0]);
+    Operand result_op = create_operand_temp();
+    OpCode op_code = (node->kind == AST_PREFIX_INCREMENT) ? IR_ADD : IR_SUB;
+    emit(op_code, result_op, target_op, create_operand_int(1)); // t1 = x + 1
+    emit(IR_ASSIGN, target_op, result_op, create_operand_none()); // x = t1
+    return result_op;
+}
+
+static Operand ir_postfix_step(ASTNode *node) {
+    Operand target_op = Generate_IR(node->children[0]);
+    Operand result_op = create_operand_temp(); // Result is the value *before* increment/decrement
+    emit(IR_ASSIGN, result_op, target_op, create_operand_none()); // t1 = x
+    OpCode op_code = (node->kind == AST_POSTFIX_INCREMENT) ? IR_ADD : IR_SUB;
+    Operand temp_val_op = create_operand_temp();
+    emit(op_code, temp_val_op, target_op, create_operand_int(1)); // t2 = x + 1
+    emit(IR_ASSIGN, target_op, temp_val_op, create_operand_none()); // x = t2
+    return result_op;
+}
+
+static Operand ir_function_call(ASTNode *node) {
+    ASTNode* func_ident_node = node->children[0];
+    const char* func_name = func_ident_node->value; // Assuming func_ident_node is an Identifier
+    ASTNode* arg_list_node = (node->num_children > 1) ? node->children[1] : NULL;
+    int num_args = 0;
+
+    emit_params_for_call(arg_list_node, &num_args);
+
+    Operand result_op = create_operand_temp();
+    emit(IR_CALL, result_op, create_operand_identifier(func_name), create_operand_int(num_args));
+    return result_op;
+}
+
+static Operand ir_array_access(ASTNode *node) { // arr[i]
+    Operand result_op;
+    Operand array_op = Generate_IR(node->children[0]);
+    Operand index_op = Generate_IR(node->children[1]);
+    Type* array_type = node->children[0]->type; // Type of 'arr'
+
+    // After semantic analysis, the node's type is the element type.
+    Type* element_type = node->type;
+
+    if (array_type && (array_type->kind == TYPE_ARRAY || array_type->kind == TYPE_POINTER) && element_type) {
+        Operand offset_op = element_offset(index_op, get_type_size(element_type));
         result_op = create_operand_temp();
-        OpCode op_code;
-        if (strcmp(node->value, "-") == 0) op_code = IR_UNARY_MINUS;
-        else if (strcmp(node->value, "!") == 0) op_code = IR_NOT;
-        else if (strcmp(node->value, "~") == 0) op_code = IR_BIT_NOT;
-        else if (strcmp(node->value, "&") == 0) op_code = IR_ADDR_OF;
-        else if (strcmp(node->value, "*") == 0) op_code = IR_DEREF;
-        else {
-            fprintf(stderr, "IR Generation Error: Unknown unary operator '%s'\n", node->value);
-            op_code = IR_NOP;
-        }
-        emit(op_code, result_op, arg1_op, create_operand_none());
-    } else if (strcmp(node->node_type, "PrefixIncrement") == 0 || strcmp(node->node_type, "PrefixDecrement") == 0) {
-        Operand target_op = Generate_IR(node->children[0]);
+        emit(IR_INDEX_LOAD, result_op, array_op, offset_op);
+    } else {
+        fprintf(stderr, "IR Generation Error: Attempting to index a non-array/pointer type.\n");
+        // Return a NOP or default value to avoid cascading errors
+        result_op = create_operand_int(0);
+    }
+    return result_op;
+}
+
+static Operand ir_member_access(ASTNode *node) { // s.m
+    Operand result_op = create_operand_none();
+    Operand struct_op = Generate_IR(node->children[0]);
+    const char* member_name = node->value;
+    // The type of the struct is on the AST node from the semantic analysis phase.
+    int offset = get_member_offset(node->children[0]->type, member_name);
+    if (offset != -1) {
+        //Operand base_addr_op = create_operand_temp();
+        //emit(IR_ADDR_OF, base_addr_op, struct_op, create_operand_none());
+
         result_op = create_operand_temp();
-        OpCode op_code = (strcmp(node->node_type, "PrefixIncrement") == 0) ? IR_ADD : IR_SUB;
-        emit(op_code, result_op, target_op, create_operand_int(1)); // t1 = x + 1
-        emit(IR_ASSIGN, target_op, result_op, create_operand_none()); // x = t1
-    } else if (strcmp(node->node_type, "PostfixIncrement") == 0 || strcmp(node->node_type, "PostfixDecrement") == 0) {
-        Operand target_op = Generate_IR(node->children[0]);
-        result_op = create_operand_temp(); // Result is the value *before* increment/decrement
-        emit(IR_ASSIGN, result_op, target_op, create_operand_none()); // t1 = x
-        OpCode op_code = (strcmp(node->node_type, "PostfixIncrement") == 0) ? IR_ADD : IR_SUB;
-        Operand temp_val_op = create_operand_temp();
-        emit(op_code, temp_val_op, target_op, create_operand_int(1)); // t2 = x + 1
-        emit(IR_ASSIGN, target_op, temp_val_op, create_operand_none()); // x = t2
-    } else if (strcmp(node->node_type, "FunctionCall") == 0) {
-        ASTNode* func_ident_node = node->children[0];
-        char* func_name = func_ident_node->value; // Assuming func_ident_node is an Identifier
-        ASTNode* arg_list_node = (node->num_children > 1) ? node->children[1] : NULL;
-        int num_args = 0;
-
-        emit_params_for_call(arg_list_node, &num_args);
+        emit(IR_INDEX_LOAD, result_op, struct_op, create_operand_int(offset));
+    } else {
+        fprintf(stderr, "IR Generation Error: Member '%s' not found in struct.\n", member_name);
+        // Handle error, maybe return a NOP or default value
+    }
+    return result_op;
+}
 
+static Operand ir_pointer_member_access(ASTNode *node) { // s->m
+    Operand result_op;
+    Operand struct_ptr_op = Generate_IR(node->children[0]);
+    const char* member_name = node->value;
+    // The type of the pointer is on the child node from the semantic analysis phase.
+    int offset = get_member_offset(node->children[0]->type, member_name);
+
+    if (offset != -1) {
         result_op = create_operand_temp();
-        emit(IR_CALL, result_op, create_operand_identifier(func_name), create_operand_int(num_args));
-    } //else if(strcmp(node->node_type, "ArgumentList") == 0){
-      //  int num_args = 0;
-      //  emit_params_for_call(node, &num_args);
-      //  result_op = create_operand_none();
-    //} 
-    else if (strcmp(node->node_type, "ArrayAccess") == 0) { // arr[i]
-        Operand array_op = Generate_IR(node->children[0]);
-        Operand index_op = Generate_IR(node->children[1]);
-        Type* array_type = node->children[0]->type; // Type of 'arr'
-        
-        // After semantic analysis, the node's type is the element type.
-        Type* element_type = node->type; 
-
-        if (array_type && (array_type->kind == TYPE_ARRAY || array_type->kind == TYPE_POINTER) && element_type) {
-            int element_size = get_type_size(element_type); // Get size of element
-
-            Operand offset_op = create_operand_temp();
-            emit(IR_MUL, offset_op, index_op, create_operand_int(element_size));
-
-            result_op = create_operand_temp();
-            emit(IR_INDEX_LOAD, result_op, array_op, offset_op);
-        } else {
-            fprintf(stderr, "IR Generation Error: Attempting to index a non-array/pointer type.\n");
-            // Return a NOP or default value to avoid cascading errors
-            result_op = create_operand_int(0);
-        }
-    } else if (strcmp(node->node_type, "MemberAccess") == 0) { // s.m
-        Operand struct_op = Generate_IR(node->children[0]);
-        char* member_name = node->value;
-        // The type of the struct is on the AST node from the semantic analysis phase.
-        int offset = get_member_offset(node->children[0]->type, member_name);
-        if (offset != -1) {
-            //Operand base_addr_op = create_operand_temp();
-            //emit(IR_ADDR_OF, base_addr_op, struct_op, create_operand_none());
+        // The struct_ptr_op already holds the base address of the struct.
+        // We emit: result = *(struct_ptr + offset)
+        emit(IR_INDEX_LOAD, result_op, struct_ptr_op, create_operand_int(offset));
+    } else {
+        fprintf(stderr, "IR Generation Error: Member '%s' not found in struct pointed to.\n", member_name);
+        result_op = create_operand_int(0); // Error recovery
+    }
+    return result_op;
+}
 
-            result_op = create_operand_temp();
-            emit(IR_INDEX_LOAD, result_op, struct_op, create_operand_int(offset));
-        } else {
-            fprintf(stderr, "IR Generation Error: Member '%s' not found in struct.\n", member_name);
-            // Handle error, maybe return a NOP or default value
-        }
+static Operand ir_if_statement(ASTNode *node) {
+    Operand label_end = create_operand_label();
 
-    } else if (strcmp(node->node_type, "PointerMemberAccess") == 0) { // s->m
-        Operand struct_ptr_op = Generate_IR(node->children[0]);
-        char* member_name = node->value; 
-        // The type of the pointer is on the child node from the semantic analysis phase.
-        int offset = get_member_offset(node->children[0]->type, member_name);
+    ir_condition(node->children[0], create_operand_none(), label_end);
+    Generate_IR(node->children[1]); // Then statement
+    emit(IR_LABEL, label_end, create_operand_none(), create_operand_none());
+    return create_operand_none();
+}
 
-        if (offset != -1) {
-            result_op = create_operand_temp();
-            // The struct_ptr_op already holds the base address of the struct.
-            // We emit: result = *(struct_ptr + offset)
-            emit(IR_INDEX_LOAD, result_op, struct_ptr_op, create_operand_int(offset));
-        } else {
-            fprintf(stderr, "IR Generation Error: Member '%s' not found in struct pointed to.\n", member_name);
-            result_op = create_operand_int(0); // Error recovery
-        }
+static Operand ir_if_else_statement(ASTNode *node) {
+    Operand label_else = create_operand_label();
+    Operand label_end = create_operand_label();
+
+    ir_condition(node->children[0], create_operand_none(), label_else);
+    Generate_IR(node->children[1]); // Then statement
+    emit(IR_GOTO, label_end, create_operand_none(), create_operand_none());
+    emit(IR_LABEL, label_else, create_operand_none(), create_operand_none());
+    Generate_IR(node->children[2]); // Else statement
+    emit(IR_LABEL, label_end, create_operand_none(), create_operand_none());
+    return create_operand_none();
+}
 
-    } else if (strcmp(node->node_type, "IfStatement") == 0) {
-        Operand cond_op = Generate_IR(node->children[0]);
-        Operand label_end = create_operand_label();
-
-        emit(IR_IF_FALSE_GOTO, label_end, cond_op, create_operand_none());
-        Generate_IR(node->children[1]); // Then statement
-        emit(IR_LABEL, label_end, create_operand_none(), create_operand_none());
-        return create_operand_none();
-    } else if (strcmp(node->node_type, "IfElseStatement") == 0) {
-        Operand cond_op = Generate_IR(node->children[0]);
-        Operand label_else = create_operand_label();
-        Operand label_end = create_operand_label();
-
-        emit(IR_IF_FALSE_GOTO, label_else, cond_op, create_operand_none());
-        Generate_IR(node->children[1]); // Then statement
-        emit(IR_GOTO, label_end, create_operand_none(), create_operand_none());
-        emit(IR_LABEL, label_else, create_operand_none(), create_operand_none());
-        Generate_IR(node->children[2]); // Else statement
-        emit(IR_LABEL, label_end, create_operand_none(), create_operand_none());
-        return create_operand_none();
-    } else if (strcmp(node->node_type, "WhileStatement") == 0) {
-        Operand label_loop_cond = create_operand_label();
-        Operand label_loop_body = create_operand_label();
-        Operand label_loop_end = create_operand_label();
-
-        emit(IR_GOTO, label_loop_cond, create_operand_none(), create_operand_none());
-        emit(IR_LABEL, label_loop_body, create_operand_none(), create_operand_none());
-        Generate_IR(node->children[1]); // Loop body
-        emit(IR_LABEL, label_loop_cond, create_operand_none(), create_operand_none());
-        Operand cond_op = Generate_IR(node->children[0]); // Condition
-        emit(IR_IF_FALSE_GOTO, label_loop_end, cond_op, create_operand_none());
-        emit(IR_GOTO, label_loop_body, create_operand_none(), create_operand_none());
-        emit(IR_LABEL, label_loop_end, create_operand_none(), create_operand_none());
-        return create_operand_none();
-    } else if (strcmp(node->node_type, "DoWhileStatement") == 0) {
-        Operand label_loop_start = create_operand_label();
-        Operand label_loop_end = create_operand_label();
-
-        emit(IR_LABEL, label_loop_start, create_operand_none(), create_operand_none());
-        Generate_IR(node->children[0]); // Loop body
-        Operand cond_op = Generate_IR(node->children[1]); // Condition
-        emit(IR_IF_FALSE_GOTO, label_loop_end, cond_op, create_operand_none());
-        emit(IR_GOTO, label_loop_start, create_operand_none(), create_operand_none());
-        emit(IR_LABEL, label_loop_end, create_operand_none(), create_operand_none());
-        return create_operand_none();
-    } else if (strcmp(node->node_type, "ForStatement") == 0) {
-        // ForStatement: init_expr, cond_expr, update_expr, body
-        Operand label_loop_cond = create_operand_label();
-        Operand label_loop_incr = create_operand_label();
-        Operand label_loop_body = create_operand_label();
-        Operand label_loop_end = create_operand_label();
-        current_continue_label = label_loop_incr;
-        current_break_label = label_loop_end;
-
-        Generate_IR(node->children[0]); // Initialization expression (expression_opt)
-        emit(IR_GOTO, label_loop_cond, create_operand_none(), create_operand_none());
-        emit(IR_LABEL, label_loop_body, create_operand_none(), create_operand_none());
-        Generate_IR(node->children[3]); // Loop body (statement)
-        emit(IR_LABEL, label_loop_incr, create_operand_none(), create_operand_none());
-        Generate_IR(node->children[2]); // Update expression (expression_opt)
-        emit(IR_LABEL, label_loop_cond, create_operand_none(), create_operand_none());
-        Operand cond_op = Generate_IR(node->children[1]); // Condition (expression_opt)
-        emit(IR_IF_FALSE_GOTO, label_loop_end, cond_op, create_operand_none());
-        emit(IR_GOTO, label_loop_body, create_operand_none(), create_operand_none());
-        current_continue_label.type = OP_NONE;
-        current_break_label.type = OP_NONE;
-        emit(IR_LABEL, label_loop_end, create_operand_none(), create_operand_none());
-        return create_operand_none();
-    } else if (strcmp(node->node_type, "ForDeclStatement") == 0) {
-        // ForDeclStatement: declaration, cond_expr, update_expr, body
-        Operand label_loop_cond = create_operand_label();
-        Operand label_loop_body = create_operand_label();
-        Operand label_loop_end = create_operand_label();
-        current_continue_label = label_loop_cond;
-        current_break_label = label_loop_end;
-
-        Generate_IR(node->children[0]); // Declaration
-        emit(IR_GOTO, label_loop_cond, create_operand_none(), create_operand_none());
-        emit(IR_LABEL, label_loop_body, create_operand_none(), create_operand_none());
-        Generate_IR(node->children[3]); // Loop body (statement)
-        Generate_IR(node->children[2]); // Update expression (expression_opt)
-        emit(IR_LABEL, label_loop_cond, create_operand_none(), create_operand_none());
-        Operand cond_op = Generate_IR(node->children[1]); // Condition (expression_opt)
-        emit(IR_IF_FALSE_GOTO, label_loop_end, cond_op, create_operand_none());
-        emit(IR_GOTO, label_loop_body, create_operand_none(), create_operand_none());
-        current_continue_label.type = OP_NONE;
-        current_break_label.type = OP_NONE;
-        emit(IR_LABEL, label_loop_end, create_operand_none(), create_operand_none());
-        return create_operand_none();
-    } else if (strcmp(node->node_type, "BreakStatement") == 0) {
-        if (current_break_label.type == OP_NONE) {
-            fprintf(stderr, "Error: Break statement outside of loop or switch.\n");
-        } else {
-            // Emit a GOTO to the break label
-            emit(IR_GOTO, current_break_label, create_operand_none(), create_operand_none());
-        }
-        return create_operand_none();
-    } else if (strcmp(node->node_type, "ContinueStatement") == 0) {
-        if (current_continue_label.type == OP_NONE) {
-            fprintf(stderr, "Error: Continue statement outside of loop.\n");
-        } else {
-            // Emit a GOTO to the continue label
-            emit(IR_GOTO, current_continue_label, create_operand_none(), create_operand_none());
-        }
-        return create_operand_none();
-    } else if (strcmp(node->node_type, "CaseStatement") == 0) {
-        // This is a labeled statement. First, emit the label.
-        // The label was created and stored on the node's type field during the SwitchStatement pass.
-        if (node->type) {
-            emit(IR_LABEL, create_operand_label_named((char*)node->type), create_operand_none(), create_operand_none());
-        }
-        // Then, generate code for the statement that follows the label.
-        Generate_IR(node->children[1]);
-        return create_operand_none();
-    } else if (strcmp(node->node_type, "DefaultStatement") == 0) {
-        if (node->type) {
-            emit(IR_LABEL, create_operand_label_named((char*)node->type), create_operand_none(), create_operand_none());
-        }
-        Generate_IR(node->children[0]);
-        return create_operand_none();
-    } else if (strcmp(node->node_type, "SwitchStatement") == 0) {
-        Operand switch_val = Generate_IR(node->children[0]);
-        Operand end_label = create_operand_label();
-        Operand default_label = create_operand_none();
-        Operand old_break_label = current_break_label;
-        current_break_label = end_label;
-
-        ASTNode* body = node->children[1]; // This is a CompoundStatement
-        ASTNode* block_item_list_node = (body->num_children > 0) ? body->children[0] : NULL;
-
-        // Pass 1: Find all case/default statements and create IR labels for them.
-        // We store the label's name string in the AST node's `type` field for later retrieval.
-        if (block_item_list_node) {
-            for (int i = 0; i < block_item_list_node->num_children; i++) {
-                ASTNode* stmt = block_item_list_node->children[i];
-                if (strcmp(stmt->node_type, "CaseStatement") == 0) {
-                    stmt->type = (Type*)create_operand_label().val.name;
-                } else if (strcmp(stmt->node_type, "DefaultStatement") == 0) {
-                    default_label = create_operand_label();
-                    stmt->type = (Type*)default_label.val.name;
-                }
-            }
-        }
+static Operand ir_while_statement(ASTNode *node) {
+    Operand label_loop_cond = create_operand_label();
+    Operand label_loop_body = create_operand_label();
+    Operand label_loop_end = create_operand_label();
+
+    emit(IR_GOTO, label_loop_cond, create_operand_none(), create_operand_none());
+    emit(IR_LABEL, label_loop_body, create_operand_none(), create_operand_none());
+    Generate_IR(node->children[1]); // Loop body
+    emit(IR_LABEL, label_loop_cond, create_operand_none(), create_operand_none());
+    ir_condition(node->children[0], label_loop_body, create_operand_none()); // Condition
+    emit(IR_LABEL, label_loop_end, create_operand_none(), create_operand_none());
+    return create_operand_none();
+}
 
-        // Pass 2: Generate the series of conditional jumps (the "switch" logic).
-        if (block_item_list_node) {
-            for (int i = 0; i < block_item_list_node->num_children; i++) {
-                ASTNode* stmt = block_item_list_node->children[i];
-                if (strcmp(stmt->node_type, "CaseStatement") == 0) {
-                    Operand case_val = Generate_IR(stmt->children[0]);
-                    Operand case_label = create_operand_label_named((char*)stmt->type);
-                    Operand condition = create_operand_temp();
-                    emit(IR_EQ, condition, switch_val, case_val);
-                    // If the condition is true, jump to the case label.
-                    emit(IR_IF_TRUE_GOTO, case_label, condition, create_operand_none());
-                }
+static Operand ir_do_while_statement(ASTNode *node) {
+    Operand label_loop_start = create_operand_label();
+    Operand label_loop_end = create_operand_label();
+
+    emit(IR_LABEL, label_loop_start, create_operand_none(), create_operand_none());
+    Generate_IR(node->children[0]); // Loop body
+    ir_condition(node->children[1], label_loop_start, create_operand_none()); // Condition
+    emit(IR_LABEL, label_loop_end, create_operand_none(), create_operand_none());
+    return create_operand_none();
+}
+
+static Operand ir_for_statement(ASTNode *node) {
+    // ForStatement: init_expr, cond_expr, update_expr, body
+    Operand label_loop_cond = create_operand_label();
+    Operand label_loop_incr = create_operand_label();
+    Operand label_loop_body = create_operand_label();
+    Operand label_loop_end = create_operand_label();
+    current_continue_label = label_loop_incr;
+    current_break_label = label_loop_end;
+    continue_depth = break_depth = num_heap_locals;
+
+    Generate_IR(node->children[0]); // Initialization expression (expression_opt)
+    emit(IR_GOTO, label_loop_cond, create_operand_none(), create_operand_none());
+    emit(IR_LABEL, label_loop_body, create_operand_none(), create_operand_none());
+    Generate_IR(node->children[3]); // Loop body (statement)
+    emit(IR_LABEL, label_loop_incr, create_operand_none(), create_operand_none());
+    Generate_IR(node->children[2]); // Update expression (expression_opt)
+    emit(IR_LABEL, label_loop_cond, create_operand_none(), create_operand_none());
+    ir_condition(node->children[1], label_loop_body, create_operand_none()); // Condition (expression_opt)
+    current_continue_label.type = OP_NONE;
+    current_break_label.type = OP_NONE;
+    emit(IR_LABEL, label_loop_end, create_operand_none(), create_operand_none());
+    return create_operand_none();
+}
+
+static Operand ir_for_decl_statement(ASTNode *node) {
+    // ForDeclStatement: declaration, cond_expr, update_expr, body
+    Operand label_loop_cond = create_operand_label();
+    Operand label_loop_body = create_operand_label();
+    Operand label_loop_end = create_operand_label();
+    current_continue_label = label_loop_cond;
+    current_break_label = label_loop_end;
+    int depth = num_heap_locals;
+    int outer_start = open_name_scope();
+
+    Generate_IR(node->children[0]); // Declaration
+    continue_depth = break_depth = num_heap_locals;
+    emit(IR_GOTO, label_loop_cond, create_operand_none(), create_operand_none());
+    emit(IR_LABEL, label_loop_body, create_operand_none(), create_operand_none());
+    Generate_IR(node->children[3]); // Loop body (statement)
+    Generate_IR(node->children[2]); // Update expression (expression_opt)
+    emit(IR_LABEL, label_loop_cond, create_operand_none(), create_operand_none());
+    ir_condition(node->children[1], label_loop_body, create_operand_none()); // Condition (expression_opt)
+    current_continue_label.type = OP_NONE;
+    current_break_label.type = OP_NONE;
+    emit(IR_LABEL, label_loop_end, create_operand_none(), create_operand_none());
+    close_heap_scope(depth);
+    close_name_scope(outer_start);
+    return create_operand_none();
+}
+
+static Operand ir_break_statement(ASTNode *node) {
+    if (current_break_label.type == OP_NONE) {
+        fprintf(stderr, "Error: Break statement outside of loop or switch.\n");
+    } else {
+        // Emit a GOTO to the break label
+        free_heap_locals(break_depth);
+        emit(IR_GOTO, current_break_label, create_operand_none(), create_operand_none());
+    }
+    return create_operand_none();
+}
+
+static Operand ir_continue_statement(ASTNode *node) {
+    if (current_continue_label.type == OP_NONE) {
+        fprintf(stderr, "Error: Continue statement outside of loop.\n");
+    } else {
+        // Emit a GOTO to the continue label
+        free_heap_locals(continue_depth);
+        emit(IR_GOTO, current_continue_label, create_operand_none(), create_operand_none());
+    }
+    return create_operand_none();
+}
+
+// The label a SwitchStatement assigned to one of its case/default statements.
+static Operand case_label_operand(ASTNode *stmt) {
+    Operand op;
+    op.type = OP_LABEL;
+    op.val.label = stmt->ir_label;
+    return op;
+}
+
+static Operand ir_case_statement(ASTNode *node) {
+    // This is a labeled statement. First, emit the label.
+    // The label was created and stored on the node during the SwitchStatement pass.
+    if (node->ir_label >= 0) {
+        emit(IR_LABEL, case_label_operand(node), create_operand_none(), create_operand_none());
+    }
+    // Then, generate code for the statement that follows the label.
+    Generate_IR(node->children[1]);
+    return create_operand_none();
+}
+
+static Operand ir_default_statement(ASTNode *node) {
+    if (node->ir_label >= 0) {
+        emit(IR_LABEL, case_label_operand(node), create_operand_none(), create_operand_none());
+    }
+    Generate_IR(node->children[0]);
+    return create_operand_none();
+}
+
+/* --- Switch lowering --- */
+
+// Switches with at most this many cases, and the leaves of a binary
+// decision tree, compare against each value in turn.
+#define SWITCH_LINEAR_MAX 3
+// A jump table is used when the cases fill at least this percentage of the
+// slots between the lowest and the highest value.
+#define SWITCH_TABLE_MIN_DENSITY 40
+
+typedef struct {
+    Operand value;    // Integer or character constant, except in a fallback chain
+    Operand label;
+} SwitchCase;
+
+static int case_value(const SwitchCase *c) {
+    return c->value.type == OP_CHAR_CONST ? c->value.val.char_val : c->value.val.int_val;
+}
+
+static int compare_switch_cases(const void *a, const void *b) {
+    const SwitchCase *x = (const SwitchCase*) a, *y = (const SwitchCase*) b;
+    int vx = case_value(x), vy = case_value(y);
+    if (vx != vy) return (vx > vy) - (vx < vy);
+    return x->label.val.label - y->label.val.label;
+}
+
+// Generates the case values of a switch body, in source order. Sets
+// *all_constant to 0 if one of them did not fold to a constant.
+static SwitchCase* collect_switch_cases(ASTNode *block_item_list_node, int *num_cases, int *all_constant) {
+    int capacity = block_item_list_node ? block_item_list_node->num_children : 0;
+    SwitchCase *cases = (SwitchCase*) checked_calloc(capacity + 1, sizeof(SwitchCase));
+    *num_cases = 0;
+    *all_constant = 1;
+    for (int i = 0; i < capacity; i++) {
+        ASTNode* stmt = block_item_list_node->children[i];
+        if (stmt->kind != AST_CASE_STATEMENT) continue;
+        SwitchCase *c = &cases[(*num_cases)++];
+        c->value = Generate_IR(stmt->children[0]);
+        c->label = case_label_operand(stmt);
+        if (c->value.type != OP_INT_CONST && c->value.type != OP_CHAR_CONST) *all_constant = 0;
+    }
+    return cases;
+}
+
+// Sorts constant cases by value and drops duplicates, keeping the first in
+// source order (labels are created in source order). Returns the new count.
+static int sort_switch_cases(SwitchCase *cases, int num_cases) {
+    if (num_cases == 0) return 0;
+    qsort(cases, num_cases, sizeof(SwitchCase), compare_switch_cases);
+    int kept = 1;
+    for (int i = 1; i < num_cases; i++) {
+        if (case_value(&cases[i]) != case_value(&cases[kept - 1])) cases[kept++] = cases[i];
+    }
+    return kept;
+}
+
+static void emit_jump_if(OpCode compare, Operand target, Operand value, Operand other) {
+    Operand condition = create_operand_temp();
+    emit(compare, condition, value, other);
+    emit(IR_IF_TRUE_GOTO, target, condition, create_operand_none());
+}
+
+// Compares against each case in turn, then jumps to 'miss_label'.
+static void emit_switch_chain(Operand value, SwitchCase *cases, int num_cases, Operand miss_label) {
+    for (int i = 0; i < num_cases; i++) {
+        emit_jump_if(IR_EQ, cases[i].label, value, cases[i].value);
+    }
+    emit(IR_GOTO, miss_label, create_operand_none(), create_operand_none());
+}
+
+// Jumps through a table indexed by value - low, after checking the range.
+static void emit_switch_table(Operand value, SwitchCase *cases, int num_cases, Operand miss_label) {
+    int low = case_value(&cases[0]), high = case_value(&cases[num_cases - 1]);
+    int size = (int) ((long long) high - low + 1);
+    int *labels = (int*) checked_calloc(size, sizeof(int));
+    for (int i = 0; i < size; i++) labels[i] = miss_label.val.label;
+    for (int i = 0; i < num_cases; i++) labels[case_value(&cases[i]) - low] = cases[i].label.val.label;
+    int table = add_jump_table(labels, size);
+    free(labels);
+
+    emit_jump_if(IR_LT, miss_label, value, create_operand_int(low));
+    emit_jump_if(IR_GT, miss_label, value, create_operand_int(high));
+    Operand index = value;
+    if (low != 0) {
+        index = create_operand_temp();
+        emit(IR_SUB, index, value, create_operand_int(low));
+    }
+    emit(IR_JUMP_TABLE, create_operand_int(table), index, create_operand_none());
+}
+
+// Dispatches on 'value' over cases sorted by value: a jump table where the
+// values are dense, otherwise a balanced binary search that ends in short
+// compare chains. Control never falls out of the emitted code.
+static void lower_switch_cases(Operand value, SwitchCase *cases, int num_cases, Operand miss_label) {
+    if (num_cases <= SWITCH_LINEAR_MAX) {
+        emit_switch_chain(value, cases, num_cases, miss_label);
+        return;
+    }
+    long long range = (long long) case_value(&cases[num_cases - 1]) - case_value(&cases[0]) + 1;
+    if (num_cases * 100LL >= range * SWITCH_TABLE_MIN_DENSITY) {
+        emit_switch_table(value, cases, num_cases, miss_label);
+        return;
+    }
+    int mid = num_cases / 2;
+    Operand low_half = create_operand_label();
+    emit_jump_if(IR_LT, low_half, value, create_operand_int(case_value(&cases[mid])));
+    lower_switch_cases(value, cases + mid, num_cases - mid, miss_label);
+    emit(IR_LABEL, low_half, create_operand_none(), create_operand_none());
+    lower_switch_cases(value, cases, mid, miss_label);
+}
+
+static Operand ir_switch_statement(ASTNode *node) {
+    Operand switch_val = Generate_IR(node->children[0]);
+    Operand end_label = create_operand_label();
+    Operand default_label = create_operand_none();
+    Operand old_break_label = current_break_label;
+    int old_break_depth = break_depth;
+    current_break_label = end_label;
+    break_depth = num_heap_locals;
+
+    ASTNode* body = node->children[1]; // This is a CompoundStatement
+    ASTNode* block_item_list_node = (body->num_children > 0) ? body->children[0] : NULL;
+
+    // Pass 1: Find all case/default statements and create IR labels for them.
+    // We store the label number in the AST node's `ir_label` field for later retrieval.
+    if (block_item_list_node) {
+        for (int i = 0; i < block_item_list_node->num_children; i++) {
+            ASTNode* stmt = block_item_list_node->children[i];
+            if (stmt->kind == AST_CASE_STATEMENT) {
+                stmt->ir_label = create_operand_label().val.label;
+            } else if (stmt->kind == AST_DEFAULT_STATEMENT) {
+                default_label = create_operand_label();
+                stmt->ir_label = default_label.val.label;
             }
         }
+    }
 
-        // After all case comparisons, jump to the default label or the end.
-        if (default_label.type != OP_NONE) {
-            emit(IR_GOTO, default_label, create_operand_none(), create_operand_none());
-        } else {
-            emit(IR_GOTO, end_label, create_operand_none(), create_operand_none());
-        }
+    // Pass 2: Generate the dispatch to the case labels (the "switch" logic).
+    // Case values that check_semantics reported as not constant get a plain
+    // compare chain.
+    Operand miss_label = default_label.type != OP_NONE ? default_label : end_label;
+    int num_cases, all_constant;
+    SwitchCase *cases = collect_switch_cases(block_item_list_node, &num_cases, &all_constant);
+    if (all_constant) {
+        num_cases = sort_switch_cases(cases, num_cases);
+        lower_switch_cases(switch_val, cases, num_cases, miss_label);
+    } else {
+        emit_switch_chain(switch_val, cases, num_cases, miss_label);
+    }
+    free(cases);
+
+    // Pass 3: Generate the IR for the switch body. This will emit the labels and statements in order.
+    Generate_IR(body);
+    emit(IR_LABEL, end_label, create_operand_none(), create_operand_none());
+    current_break_label = old_break_label; // Restore old break label
+    break_depth = old_break_depth;
+    return create_operand_none();
+}
+
+typedef Operand (*IRHandler)(ASTNode *node);
+
+// Dispatch table for Generate_IR, indexed by ASTNodeKind. Kinds without an
+// entry are reported as unhandled and their children are still visited.
+static const IRHandler ir_handlers[AST_KIND_COUNT] = {
+    [AST_PROGRAM] = ir_children,
+    [AST_BLOCK_ITEM_LIST] = ir_children,
+    [AST_EMPTY_STATEMENT] = ir_children,
+    [AST_DECLARATION_SPECIFIERS] = ir_children,
+    [AST_TYPE_SPECIFIER] = ir_children,
+    [AST_TYPE_NAME] = ir_children,
+    [AST_STORAGE_CLASS_SPECIFIER] = ir_children,
+    [AST_TYPE_QUALIFIER] = ir_children,
+    [AST_STRUCT_SPECIFIER] = ir_children,
+    [AST_STRUCT_TOKEN] = ir_children,
+    [AST_UNION_TOKEN] = ir_children,
+    [AST_STRUCT_DECLARATION_LIST] = ir_children,
+    [AST_STRUCT_DECLARATION] = ir_children,
+    [AST_SPECIFIER_QUALIFIER_LIST] = ir_children,
+    [AST_STRUCT_DECLARATOR_LIST] = ir_children,
+    [AST_ENUM_SPECIFIER] = ir_children,
+    [AST_ENUMERATOR_LIST] = ir_children,
+    [AST_ENUMERATOR] = ir_children,
+    [AST_INITIALIZER_LIST] = ir_children,
+    [AST_INIT_VALUES] = ir_children,
+    [AST_POINTER_DECLARATOR] = ir_children,
+    [AST_PARAMETER_LIST] = ir_children,
+    [AST_PARAMETER_DECLARATION] = ir_children,
+    [AST_EMPTY_PARAMETER_LIST] = ir_children,
+    [AST_POINTER] = ir_children,
+    [AST_PARENTHESIZED_ABSTRACT_DECLARATOR] = ir_children,
+    [AST_ABSTRACT_ARRAY_SUFFIX] = ir_children,
+    [AST_ABSTRACT_FUNCTION_SUFFIX] = ir_children,
+    [AST_EMPTY_EXPRESSION] = ir_children,
+
+    [AST_DECLARATION] = ir_declaration,
+    [AST_INIT_DECLARATOR_LIST] = ir_init_declarator_list,
+    [AST_INIT_DECLARATOR] = ir_init_declarator,
+    [AST_ARRAY_DECLARATOR] = ir_array_declarator,
+    [AST_FUNCTION_DEFINITION] = ir_function_definition,
+
+    [AST_COMPOUND_STATEMENT] = ir_compound_statement,
+    [AST_EXPRESSION_STATEMENT] = ir_expression_statement,
+    [AST_RETURN] = ir_return,
+    [AST_IF_STATEMENT] = ir_if_statement,
+    [AST_IF_ELSE_STATEMENT] = ir_if_else_statement,
+    [AST_WHILE_STATEMENT] = ir_while_statement,
+    [AST_DO_WHILE_STATEMENT] = ir_do_while_statement,
+    [AST_FOR_STATEMENT] = ir_for_statement,
+    [AST_FOR_DECL_STATEMENT] = ir_for_decl_statement,
+    [AST_BREAK_STATEMENT] = ir_break_statement,
+    [AST_CONTINUE_STATEMENT] = ir_continue_statement,
+    [AST_SWITCH_STATEMENT] = ir_switch_statement,
+    [AST_CASE_STATEMENT] = ir_case_statement,
+    [AST_DEFAULT_STATEMENT] = ir_default_statement,
+
+    [AST_IDENTIFIER] = ir_identifier,
+    [AST_INT_CONSTANT] = ir_int_constant,
+    [AST_FLOAT_CONSTANT] = ir_float_constant,
+    [AST_CHAR_CONSTANT] = ir_char_constant,
+    [AST_STRING_LITERAL] = ir_string_literal,
+    [AST_ASSIGNMENT] = ir_assignment,
+    [AST_BINARY_OP] = ir_binary_op,
+    [AST_UNARY_OP] = ir_unary_op,
+    [AST_PREFIX_INCREMENT] = ir_prefix_step,
+    [AST_PREFIX_DECREMENT] = ir_prefix_step,
+    [AST_POSTFIX_INCREMENT] = ir_postfix_step,
+    [AST_POSTFIX_DECREMENT] = ir_postfix_step,
+    [AST_FUNCTION_CALL] = ir_function_call,
+    [AST_ARRAY_ACCESS] = ir_array_access,
+    [AST_MEMBER_ACCESS] = ir_member_access,
+    [AST_POINTER_MEMBER_ACCESS] = ir_pointer_member_access,
+};
 
-        // Pass 3: Generate the IR for the switch body. This will emit the labels and statements in order.
-        Generate_IR(body);
-        emit(IR_LABEL, end_label, create_operand_none(), create_operand_none());
-        current_break_label = old_break_label; // Restore old break label
-        return create_operand_none();
+// Main IR generation function
+Operand Generate_IR(ASTNode *node) {
+    if (!node) return create_operand_none();
+
+    IRHandler handler = ir_handlers[node->kind];
+    if (handler) {
+        return handler(node);
     }
     // Default: If a node type is not explicitly handled, recursively process its children.
-    else {
-        fprintf(stderr, "Warning: Unhandled AST node type for IR generation: %s\n", node->node_type);
-        for (int i = 0; i < node->num_children; i++) {
-            Generate_IR(node->children[i]);
-        }
-        return create_operand_none();
+    fprintf(stderr, "Warning: Unhandled AST node type for IR generation: %s\n", ast_kind_names[node->kind]);
+    for (int i = 0; i < node->num_children; i++) {
+        Generate_IR(node->children[i]);
     }
-
-    return result_op;
-}
\ No newline at end of file
+    return create_operand_none();
+}
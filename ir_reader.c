@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "ir_reader.h"
+#include "frame.h"
+#include "string_pool.h"
+#include "alloc.h"
+
+/*
+ * The operands of each mnemonic, in the order they are printed:
+ *   r result, a arg1, b arg2, n arg1 as a function name,
+ *   j the bracketed label list of a jump table (its number goes in result)
+ */
+typedef struct {
+    const char *mnemonic;
+    OpCode opcode;
+    const char *operands;
+} Mnemonic;
+
+static const Mnemonic mnemonics[] = {
+    { "ADD", IR_ADD, "rab" },           { "SUB", IR_SUB, "rab" },
+    { "MUL", IR_MUL, "rab" },           { "DIV", IR_DIV, "rab" },
+    { "MOD", IR_MOD, "rab" },           { "SHL", IR_SHL, "rab" },
+    { "SHR", IR_SHR, "rab" },           { "EQ", IR_EQ, "rab" },
+    { "NE", IR_NE, "rab" },             { "LT", IR_LT, "rab" },
+    { "GT", IR_GT, "rab" },             { "LE", IR_LE, "rab" },
+    { "GE", IR_GE, "rab" },             { "AND", IR_AND, "rab" },
+    { "OR", IR_OR, "rab" },             { "BIT_AND", IR_BIT_AND, "rab" },
+    { "BIT_OR", IR_BIT_OR, "rab" },     { "XOR", IR_XOR, "rab" },
+    { "ASSIGN", IR_ASSIGN, "ra" },      { "UMINUS", IR_UNARY_MINUS, "ra" },
+    { "NOT", IR_NOT, "ra" },            { "BIT_NOT", IR_BIT_NOT, "ra" },
+    { "ADDR", IR_ADDR, "ra" },          { "DEREF_LOAD", IR_DEREF_LOAD, "ra" },
+    { "ALLOC_HEAP", IR_ALLOC_HEAP, "ra" }, { "ALLOC_STACK", IR_ALLOC_STACK, "rab" },
+    { "SPILL", IR_SPILL, "ra" },        { "RELOAD", IR_RELOAD, "ra" },
+    { "FREE_HEAP", IR_FREE_HEAP, "a" }, { "ADDR_OF", IR_ADDR_OF, "ra" },
+    { "DEREF_STORE", IR_DEREF_STORE, "ra" },
+    { "INDEX_LOAD", IR_INDEX_LOAD, "rab" }, { "INDEX_STORE", IR_INDEX_STORE, "rab" },
+    { "JUMP", IR_GOTO, "r" },           { "JUMPF", IR_IF_FALSE_GOTO, "ra" },
+    { "JUMPT", IR_IF_TRUE_GOTO, "ra" }, { "JUMP_TABLE", IR_JUMP_TABLE, "aj" },
+    { "CALL", IR_CALL, "nbr" },         { "TAILCALL", IR_TAILCALL, "nb" },
+    { "PARAM", IR_PARAM, "a" },         { "RETURN", IR_RETURN, "a" },
+    { "NOP", IR_NOP, "" },              { "HALT", IR_HALT, "a" },
+};
+
+#define MAX_OPERAND_TEXTS 4
+
+typedef struct {
+    const char *filename;
+    int line;
+    IRFunction *function;   // Where instructions go
+    int max_temp, max_label;
+} Reader;
+
+static int reader_error(Reader *reader, const char *message, const char *text) {
+    fprintf(stderr, "%s:%d: %s", reader->filename, reader->line, message);
+    if (text) fprintf(stderr, " '%s'", text);
+    fprintf(stderr, "\n");
+    return -1;
+}
+
+static char* trim(char *s) {
+    while (isspace((unsigned char) *s)) s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char) end[-1])) end--;
+    *end = '\0';
+    return s;
+}
+
+// Splits 's' in place at the commas outside string literals and brackets.
+// Returns the number of pieces, or -1 if there are more than 'max' or a
+// literal or bracket is not closed.
+static int split_operands(char *s, char **pieces, int max) {
+    int count = 0, depth = 0, quoted = 0;
+    pieces[count++] = s;
+    for (char *p = s; *p; p++) {
+        if (quoted) {
+            if (*p == '\\' && p[1]) p++;
+            else if (*p == '"') quoted = 0;
+        } else if (*p == '"') {
+            quoted = 1;
+        } else if (*p == '[') {
+            depth++;
+        } else if (*p == ']') {
+            depth--;
+        } else if (*p == ',' && depth == 0) {
+            if (count == max) return -1;
+            *p = '\0';
+            pieces[count++] = p + 1;
+        }
+    }
+    if (quoted || depth != 0) return -1;
+    for (int i = 0; i < count; i++) pieces[i] = trim(pieces[i]);
+    return count;
+}
+
+// Parses the digits after a one-letter prefix (t12, L3, r0); -1 if not of that form.
+static int prefixed_number(const char *text, char prefix) {
+    if (text[0] != prefix || !isdigit((unsigned char) text[1])) return -1;
+    char *end;
+    errno = 0;
+    long n = strtol(text + 1, &end, 10);
+    if (*end || errno || n > INT_MAX) return -1;
+    return (int) n;
+}
+
+// C names, and the names passes derive from them ('v.f4' from SROA, 'x.2'
+// from the inliner).
+static int is_identifier(const char *text) {
+    if (!isalpha((unsigned char) *text) && *text != '_') return 0;
+    for (text++; *text; text++) {
+        if (!isalnum((unsigned char) *text) && *text != '_' && *text != '.') return 0;
+    }
+    return 1;
+}
+
+static void note_label(Reader *reader, int label) {
+    if (label > reader->max_label) reader->max_label = label;
+}
+
+static int parse_operand(Reader *reader, char *text, Operand *op) {
+    size_t len = strlen(text);
+    int n;
+    char *end;
+    if (len == 0) {
+        *op = create_operand_none();
+    } else if (text[0] == '"') {
+        if (len < 2 || text[len - 1] != '"') return reader_error(reader, "unterminated string", text);
+        *op = create_operand_string(intern_string_len(text + 1, len - 2));
+    } else if (isdigit((unsigned char) text[0]) || text[0] == '-') {
+        errno = 0;
+        long value = strtol(text, &end, 10);
+        if (*end == '\0' && errno == 0 && value >= INT_MIN && value <= INT_MAX) {
+            *op = create_operand_int((int) value);
+            return 0;
+        }
+        double f = strtod(text, &end);
+        if (*end != '\0') return reader_error(reader, "bad number", text);
+        *op = create_operand_float(f);
+    } else if ((n = prefixed_number(text, 't')) >= 0) {
+        op->type = OP_TEMPORARY;
+        op->val.temp = n;
+        if (n > reader->max_temp) reader->max_temp = n;
+    } else if ((n = prefixed_number(text, 'L')) >= 0) {
+        op->type = OP_LABEL;
+        op->val.label = n;
+        note_label(reader, n);
+    } else if ((n = prefixed_number(text, 'r')) >= 0) {
+        *op = create_operand_register(n);
+    } else if (is_identifier(text)) {
+        *op = create_operand_identifier(text);
+    } else {
+        return reader_error(reader, "bad operand", text);
+    }
+    return 0;
+}
+
+// Parses "[L1, L2, ...]" and registers it as a jump table.
+static int parse_jump_table(Reader *reader, char *text, Operand *table) {
+    size_t len = strlen(text);
+    if (len < 2 || text[0] != '[' || text[len - 1] != ']') return reader_error(reader, "bad jump table", text);
+    text[len - 1] = '\0';
+    int num_labels = 0, capacity = 8;
+    int *labels = (int*) checked_calloc(capacity, sizeof(int));
+    char *item = trim(text + 1);
+    while (*item) {
+        char *comma = strchr(item, ',');
+        if (comma) *comma = '\0';
+        int label = prefixed_number(trim(item), 'L');
+        if (label < 0) {
+            free(labels);
+            return reader_error(reader, "bad jump table label", item);
+        }
+        note_label(reader, label);
+        if (num_labels == capacity) {
+            capacity *= 2;
+            labels = (int*) checked_realloc(labels, capacity, sizeof(int));
+        }
+        labels[num_labels++] = label;
+        item = comma ? trim(comma + 1) : item + strlen(item);
+    }
+    *table = create_operand_int(add_jump_table(labels, num_labels));
+    free(labels);
+    return 0;
+}
+
+static int parse_instruction(Reader *reader, char *text) {
+    char *rest = text;
+    while (*rest && !isspace((unsigned char) *rest)) rest++;
+    if (*rest) *rest++ = '\0';
+    const Mnemonic *mnemonic = NULL;
+    for (size_t i = 0; i < sizeof(mnemonics) / sizeof(mnemonics[0]); i++) {
+        if (strcmp(mnemonics[i].mnemonic, text) == 0) mnemonic = &mnemonics[i];
+    }
+    if (!mnemonic) return reader_error(reader, "unknown instruction", text);
+
+    char *pieces[MAX_OPERAND_TEXTS];
+    int expected = (int) strlen(mnemonic->operands);
+    int count = split_operands(rest, pieces, MAX_OPERAND_TEXTS);
+    if (expected == 0 && count == 1 && pieces[0][0] == '\0') count = 0;
+    if (count != expected) {
+        return reader_error(reader, "wrong number of operands for", mnemonic->mnemonic);
+    }
+
+    Instruction instr;
+    instr.opcode = mnemonic->opcode;
+    instr.result = instr.arg1 = instr.arg2 = create_operand_none();
+    for (int i = 0; i < count; i++) {
+        int status = 0;
+        switch (mnemonic->operands[i]) {
+            case 'r': status = parse_operand(reader, pieces[i], &instr.result); break;
+            case 'a': status = parse_operand(reader, pieces[i], &instr.arg1); break;
+            case 'b': status = parse_operand(reader, pieces[i], &instr.arg2); break;
+            case 'j': status = parse_jump_table(reader, pieces[i], &instr.result); break;
+            case 'n':
+                if (!is_identifier(pieces[i])) return reader_error(reader, "bad function name", pieces[i]);
+                instr.arg1 = create_operand_identifier(pieces[i]);
+                break;
+        }
+        if (status) return status;
+    }
+    // The text has no frame sizes; a frame ends after its last slot.
+    if (instr.opcode == IR_ALLOC_STACK && instr.arg1.type == OP_INT_CONST && instr.arg2.type == OP_INT_CONST) {
+        int end = instr.arg2.val.int_val + instr.arg1.val.int_val;
+        end = (end + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT * FRAME_ALIGNMENT;
+        if (end > reader->function->frame_size) reader->function->frame_size = end;
+    }
+    ir_append(reader->function, instr);
+    return 0;
+}
+
+// A line "name:" outside any instruction: a label or the start of a function.
+static int parse_heading(Reader *reader, char *text) {
+    size_t len = strlen(text);
+    if (len < 2 || text[len - 1] != ':') return reader_error(reader, "expected a label or function", text);
+    text[len - 1] = '\0';
+    int label = prefixed_number(text, 'L');
+    if (label >= 0) {
+        Instruction instr;
+        instr.opcode = IR_LABEL;
+        instr.result.type = OP_LABEL;
+        instr.result.val.label = label;
+        instr.arg1 = instr.arg2 = create_operand_none();
+        note_label(reader, label);
+        ir_append(reader->function, instr);
+    } else if (is_identifier(text)) {
+        if (find_ir_function(text)) return reader_error(reader, "function defined twice:", text);
+        reader->function = add_ir_function(text);
+    } else {
+        return reader_error(reader, "bad function name", text);
+    }
+    return 0;
+}
+
+int read_ir_file(const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        perror("Could not open 3AC input file");
+        return -1;
+    }
+    Reader reader = { filename, 0, &ir_module.globals, -1, -1 };
+    char *line = NULL;
+    size_t line_capacity = 0;
+    int status = 0;
+    while (status == 0 && getline(&line, &line_capacity, fp) != -1) {
+        reader.line++;
+        char *text = trim(line);
+        if (*text == '\0' || *text == '#') continue;
+        if (isspace((unsigned char) line[0])) {
+            status = parse_instruction(&reader, text);
+        } else {
+            status = parse_heading(&reader, text);
+        }
+    }
+    free(line);
+    fclose(fp);
+    // Temporaries and labels made by later passes must not collide with these.
+    if (reader.max_temp >= ir_module.num_temps) ir_module.num_temps = reader.max_temp + 1;
+    if (reader.max_label >= ir_module.num_labels) ir_module.num_labels = reader.max_label + 1;
+    return status;
+}
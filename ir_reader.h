@@ -0,0 +1,26 @@
+#ifndef IR_READER_H
+#define IR_READER_H
+
+#include "ir.h"
+
+/*
+ * Reader for the textual 3AC that print_ir_to_file writes. Lines starting
+ * with '#' and blank lines are skipped; 'name:' starts a function, 'L<n>:'
+ * is a label, and tab-indented lines are instructions in the printed
+ * syntax. Instructions before the first function are the global
+ * initializers.
+ *
+ * The text loses some detail, so a round trip is not always exact:
+ *   - operands spelled t<n>, r<n> and L<n> read back as temporaries,
+ *     registers and labels, even if they were identifiers of that name;
+ *   - character constants read back as integers, and floating-point
+ *     constants with the six decimals that "%f" printed;
+ *   - IR_DEREF is printed as DEREF_LOAD, and reads back as IR_DEREF_LOAD.
+ * The binary format (see ir_binary.h) keeps everything.
+ */
+
+// Parses a 3AC file into ir_module, which must be empty. Returns 0, or -1
+// after reporting the file and line of the first error.
+int read_ir_file(const char *filename);
+
+#endif // IR_READER_H
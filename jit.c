@@ -0,0 +1,712 @@
+#define _GNU_SOURCE // RTLD_DEFAULT, open_memstream
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <setjmp.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "jit.h"
+#include "x86_64.h"
+#include "alloc.h"
+
+#define STUB_SIZE 16 // jmp *0(%rip) followed by the 8-byte target
+
+typedef enum { SEC_TEXT, SEC_RODATA, SEC_BSS, SEC_EXTERNAL, SEC_INIT, SEC_IGNORED } SectionId;
+
+typedef enum { A_REG, A_IMM, A_MEM, A_SYM, A_INDIRECT } AsmOperandKind;
+
+enum { WIDTH_BYTE = 1, WIDTH_LONG = 4, WIDTH_QUAD = 8, WIDTH_XMM = 16 };
+
+typedef struct {
+    int kind;                   // AsmOperandKind
+    int reg;                    // A_REG, A_INDIRECT: register number
+    int width;                  // A_REG: WIDTH_*
+    long long imm;              // A_IMM
+    int base, index, scale;     // A_MEM: -1 when absent
+    long long disp;
+    int rip;                    // A_MEM: RIP-relative to 'sym'
+    char sym[128];              // A_MEM with rip, A_SYM
+} AsmOperand;
+
+typedef struct {
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+typedef enum { FIX_REL32, FIX_DIFF32, FIX_ABS64 } FixupKind;
+
+typedef struct {
+    int kind;                   // FixupKind
+    int section;
+    size_t offset;              // Of the field to patch
+    size_t end;                 // FIX_REL32: end of the instruction
+    char *symbol;
+    char *minus;                // FIX_DIFF32: symbol - minus
+} Fixup;
+
+typedef struct {
+    char *name;
+    int section;
+    size_t offset;              // SEC_EXTERNAL: stub number
+} AsmSymbol;
+
+typedef struct {
+    Buffer text, rodata;
+    size_t bss_size;
+    int section;
+    AsmSymbol *symbols;         // Open addressing
+    int symbols_capacity;
+    int num_symbols;
+    Fixup *fixups;
+    int num_fixups;
+    int fixups_capacity;
+    int instruction_fixups;     // First fixup of the instruction being encoded
+    void **externals;           // Stub targets
+    int num_externals;
+    char **init;                // .init_array entries
+    int num_init;
+    int line;
+    int failed;
+} Assembler;
+
+static jmp_buf jit_exit_point;
+static int jit_exit_status;
+
+static char* jit_strdup(const char *s) {
+    char *copy = (char*) checked_calloc(strlen(s) + 1, sizeof(char));
+    strcpy(copy, s);
+    return copy;
+}
+
+static void asm_error(Assembler *as, const char *message, const char *text) {
+    if (!as->failed) fprintf(stderr, "JIT error on assembly line %d: %s: %s\n", as->line, message, text);
+    as->failed = 1;
+}
+
+// The program's exit() comes back here.
+static void jit_exit(int status) {
+    fflush(stdout);
+    jit_exit_status = status;
+    longjmp(jit_exit_point, 1);
+}
+
+/* --- Buffers and symbols --- */
+
+static Buffer* current_buffer(Assembler *as) {
+    return as->section == SEC_RODATA ? &as->rodata : &as->text;
+}
+
+static void put_byte(Assembler *as, int byte) {
+    Buffer *b = current_buffer(as);
+    if (b->size == b->capacity) {
+        b->capacity = b->capacity ? b->capacity * 2 : 4096;
+        b->data = (unsigned char*) checked_realloc(b->data, b->capacity, 1);
+    }
+    b->data[b->size++] = (unsigned char) byte;
+}
+
+static void put_bytes(Assembler *as, long long value, int count) {
+    for (int i = 0; i < count; i++) put_byte(as, (int) ((value >> (8 * i)) & 0xff));
+}
+
+static size_t position(Assembler *as) {
+    return as->section == SEC_BSS ? as->bss_size : current_buffer(as)->size;
+}
+
+static unsigned int hash_name(const char *s) {
+    unsigned int h = 2166136261u;
+    while (*s) h = (h ^ (unsigned char) *s++) * 16777619u;
+    return h;
+}
+
+static AsmSymbol* find_symbol(Assembler *as, const char *name) {
+    if (as->symbols_capacity == 0) return NULL;
+    unsigned int mask = as->symbols_capacity - 1;
+    for (unsigned int i = hash_name(name) & mask; as->symbols[i].name; i = (i + 1) & mask) {
+        if (strcmp(as->symbols[i].name, name) == 0) return &as->symbols[i];
+    }
+    return NULL;
+}
+
+static void define_symbol(Assembler *as, const char *name, int section, size_t offset) {
+    if (find_symbol(as, name)) {
+        asm_error(as, "symbol defined twice", name);
+        return;
+    }
+    if (2 * (as->num_symbols + 1) > as->symbols_capacity) {
+        AsmSymbol *old = as->symbols;
+        int old_capacity = as->symbols_capacity;
+        as->symbols_capacity = old_capacity ? old_capacity * 2 : 256;
+        as->symbols = (AsmSymbol*) checked_calloc(as->symbols_capacity, sizeof(AsmSymbol));
+        as->num_symbols = 0;
+        for (int i = 0; i < old_capacity; i++) {
+            if (old[i].name) {
+                unsigned int mask = as->symbols_capacity - 1, k = hash_name(old[i].name) & mask;
+                while (as->symbols[k].name) k = (k + 1) & mask;
+                as->symbols[k] = old[i];
+                as->num_symbols++;
+            }
+        }
+        free(old);
+    }
+    unsigned int mask = as->symbols_capacity - 1, k = hash_name(name) & mask;
+    while (as->symbols[k].name) k = (k + 1) & mask;
+    as->symbols[k].name = jit_strdup(name);
+    as->symbols[k].section = section;
+    as->symbols[k].offset = offset;
+    as->num_symbols++;
+}
+
+static void add_fixup(Assembler *as, int kind, const char *symbol, const char *minus) {
+    if (as->num_fixups == as->fixups_capacity) {
+        as->fixups_capacity = as->fixups_capacity ? as->fixups_capacity * 2 : 256;
+        as->fixups = (Fixup*) checked_realloc(as->fixups, as->fixups_capacity, sizeof(Fixup));
+    }
+    Fixup *f = &as->fixups[as->num_fixups++];
+    memset(f, 0, sizeof(*f));
+    f->kind = kind;
+    f->section = as->section;
+    f->offset = position(as);
+    f->symbol = jit_strdup(symbol);
+    char *plt = strstr(f->symbol, "@PLT");
+    if (plt) *plt = '\0';
+    f->minus = minus ? jit_strdup(minus) : NULL;
+}
+
+/* --- Operands --- */
+
+static int register_number(const char *name, int *width) {
+    static const char *quads[] = { "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+                                   "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15" };
+    static const char *longs[] = { "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi" };
+    static const char *bytes[] = { "al", "cl", "dl", "bl" };
+    for (int i = 0; i < 16; i++) {
+        if (strcmp(name, quads[i]) == 0) { *width = WIDTH_QUAD; return i; }
+    }
+    for (int i = 0; i < 8; i++) {
+        if (strcmp(name, longs[i]) == 0) { *width = WIDTH_LONG; return i; }
+    }
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, bytes[i]) == 0) { *width = WIDTH_BYTE; return i; }
+    }
+    if (strncmp(name, "xmm", 3) == 0 && isdigit((unsigned char) name[3])) {
+        *width = WIDTH_XMM;
+        return atoi(name + 3);
+    }
+    if (strcmp(name, "rip") == 0) { *width = WIDTH_QUAD; return 16; }
+    return -1;
+}
+
+static int parse_operand(Assembler *as, char *text, AsmOperand *op) {
+    memset(op, 0, sizeof(*op));
+    op->base = op->index = -1;
+    while (isspace((unsigned char) *text)) text++;
+    char *end = text + strlen(text);
+    while (end > text && isspace((unsigned char) end[-1])) *--end = '\0';
+    int width;
+    if (*text == '%') {
+        op->kind = A_REG;
+        op->reg = register_number(text + 1, &op->width);
+    } else if (*text == '*' && text[1] == '%') {
+        op->kind = A_INDIRECT;
+        op->reg = register_number(text + 2, &width);
+    } else if (*text == '$') {
+        op->kind = A_IMM;
+        op->imm = strtoll(text + 1, NULL, 0);
+        return 1;
+    } else if (strchr(text, '(')) {
+        op->kind = A_MEM;
+        char *paren = strchr(text, '(');
+        *paren = '\0';
+        if (*text && (isdigit((unsigned char) *text) || *text == '-')) op->disp = strtoll(text, NULL, 0);
+        else if (*text) snprintf(op->sym, sizeof(op->sym), "%s", text);
+        char *parts = paren + 1, *close = strchr(parts, ')');
+        if (close) *close = '\0';
+        char *base = strtok(parts, ","), *index = strtok(NULL, ","), *scale = strtok(NULL, ",");
+        if (base && *base == '%') op->base = register_number(base + 1, &width);
+        if (index && *index == '%') op->index = register_number(index + 1, &width);
+        op->scale = scale ? atoi(scale) : 1;
+        if (op->base == 16) {
+            op->rip = 1;
+            op->base = -1;
+        }
+        return op->base >= 0 || op->rip;
+    } else {
+        op->kind = A_SYM;
+        snprintf(op->sym, sizeof(op->sym), "%s", text);
+        return *text != '\0';
+    }
+    if (op->reg < 0) {
+        asm_error(as, "unknown register", text);
+        return 0;
+    }
+    return 1;
+}
+
+// Splits "a, b(c,d), e" at the commas outside parentheses.
+static int split_operands(char *text, char **parts, int max) {
+    int count = 0, depth = 0;
+    char *start = text;
+    if (!*text) return 0;
+    for (char *p = text; ; p++) {
+        if (*p == '(') depth++;
+        if (*p == ')') depth--;
+        if ((*p == ',' && depth == 0) || *p == '\0') {
+            int last = *p == '\0';
+            *p = '\0';
+            if (count < max) parts[count++] = start;
+            if (last) break;
+            start = p + 1;
+        }
+    }
+    return count;
+}
+
+/* --- Encoding --- */
+
+static int is_reg(const AsmOperand *op, int width) {
+    return op->kind == A_REG && op->width == width;
+}
+
+static int is_gpr(const AsmOperand *op) {
+    return op->kind == A_REG && op->width != WIDTH_XMM;
+}
+
+// Legacy prefix, REX, opcode bytes and the ModRM (+ SIB, displacement) of
+// an instruction whose ModRM reg field is 'reg' and r/m operand is 'rm'.
+static void encode(Assembler *as, int prefix, int wide, const unsigned char *opcode, int opcode_length,
+                   int reg, const AsmOperand *rm) {
+    int r = (reg >> 3) & 1, x = 0, b = 0;
+    if (rm->kind == A_REG || rm->kind == A_INDIRECT) b = (rm->reg >> 3) & 1;
+    if (rm->kind == A_MEM && !rm->rip) {
+        b = (rm->base >> 3) & 1;
+        if (rm->index >= 0) x = (rm->index >> 3) & 1;
+    }
+    if (prefix) put_byte(as, prefix);
+    if (wide || r || x || b) put_byte(as, 0x40 | (wide << 3) | (r << 2) | (x << 1) | b);
+    for (int i = 0; i < opcode_length; i++) put_byte(as, opcode[i]);
+
+    if (rm->kind == A_REG || rm->kind == A_INDIRECT) {
+        put_byte(as, 0xc0 | ((reg & 7) << 3) | (rm->reg & 7));
+        return;
+    }
+    if (rm->rip) {
+        put_byte(as, 0x05 | ((reg & 7) << 3));
+        add_fixup(as, FIX_REL32, rm->sym, NULL);
+        put_bytes(as, 0, 4);
+        return;
+    }
+    int sib = rm->index >= 0 || (rm->base & 7) == 4;
+    int mod = rm->disp == 0 && (rm->base & 7) != 5 ? 0 : (rm->disp >= -128 && rm->disp <= 127 ? 1 : 2);
+    put_byte(as, (mod << 6) | ((reg & 7) << 3) | (sib ? 4 : (rm->base & 7)));
+    if (sib) {
+        int scale = rm->scale == 8 ? 3 : rm->scale == 4 ? 2 : rm->scale == 2 ? 1 : 0;
+        put_byte(as, (scale << 6) | ((rm->index >= 0 ? rm->index & 7 : 4) << 3) | (rm->base & 7));
+    }
+    if (mod == 1) put_byte(as, (int) rm->disp);
+    if (mod == 2) put_bytes(as, rm->disp, 4);
+}
+
+static void encode1(Assembler *as, int prefix, int wide, int opcode, int reg, const AsmOperand *rm) {
+    unsigned char bytes[1] = { (unsigned char) opcode };
+    encode(as, prefix, wide, bytes, 1, reg, rm);
+}
+
+static void encode2(Assembler *as, int prefix, int wide, int opcode, int reg, const AsmOperand *rm) {
+    unsigned char bytes[2] = { 0x0f, (unsigned char) opcode };
+    encode(as, prefix, wide, bytes, 2, reg, rm);
+}
+
+static int condition_number(const char *cc) {
+    static const struct { const char *name; int code; } codes[] = {
+        { "o", 0 }, { "no", 1 }, { "b", 2 }, { "ae", 3 }, { "e", 4 }, { "z", 4 }, { "ne", 5 }, { "nz", 5 },
+        { "be", 6 }, { "a", 7 }, { "s", 8 }, { "ns", 9 }, { "p", 10 }, { "np", 11 },
+        { "l", 12 }, { "ge", 13 }, { "le", 14 }, { "g", 15 },
+    };
+    for (int i = 0; i < (int) (sizeof(codes) / sizeof(codes[0])); i++) {
+        if (strcmp(codes[i].name, cc) == 0) return codes[i].code;
+    }
+    return -1;
+}
+
+static void encode_branch(Assembler *as, const unsigned char *opcode, int length, const char *target) {
+    for (int i = 0; i < length; i++) put_byte(as, opcode[i]);
+    add_fixup(as, FIX_REL32, target, NULL);
+    put_bytes(as, 0, 4);
+}
+
+static int encode_instruction(Assembler *as, const char *m, AsmOperand *ops, int n) {
+    AsmOperand *a = &ops[0], *b = &ops[1];
+    static const struct { const char *name; int opcode; int extension; } alu[] = {
+        { "addq", 0x01, 0 }, { "orq", 0x09, 1 }, { "andq", 0x21, 4 }, { "subq", 0x29, 5 },
+        { "xorq", 0x31, 6 }, { "cmpq", 0x39, 7 }, { "testq", 0x85, -1 },
+    };
+    static const struct { const char *name; int opcode; } sse[] = {
+        { "addsd", 0x58 }, { "mulsd", 0x59 }, { "subsd", 0x5c }, { "divsd", 0x5e },
+    };
+    if (n == 0) {
+        if (strcmp(m, "ret") == 0) { put_byte(as, 0xc3); return 1; }
+        if (strcmp(m, "cqto") == 0) { put_byte(as, 0x48); put_byte(as, 0x99); return 1; }
+        return 0;
+    }
+    if (strcmp(m, "movq") == 0 && n == 2) {
+        if (is_gpr(a) && b->kind == A_REG && b->width == WIDTH_XMM) encode2(as, 0x66, 1, 0x6e, b->reg, a);
+        else if (a->kind == A_REG && a->width == WIDTH_XMM && is_gpr(b)) encode2(as, 0x66, 1, 0x7e, a->reg, b);
+        else if (a->kind == A_MEM && is_reg(b, WIDTH_XMM)) encode2(as, 0xf3, 0, 0x7e, b->reg, a);
+        else if (a->kind == A_IMM && is_gpr(b)) { encode1(as, 0, 1, 0xc7, 0, b); put_bytes(as, a->imm, 4); }
+        else if (is_gpr(a) && (is_gpr(b) || b->kind == A_MEM)) encode1(as, 0, 1, 0x89, a->reg, b);
+        else if (a->kind == A_MEM && is_gpr(b)) encode1(as, 0, 1, 0x8b, b->reg, a);
+        else return 0;
+        return 1;
+    }
+    if (strcmp(m, "leaq") == 0 && n == 2 && a->kind == A_MEM && is_gpr(b)) {
+        encode1(as, 0, 1, 0x8d, b->reg, a);
+        return 1;
+    }
+    if (strcmp(m, "pushq") == 0 || strcmp(m, "popq") == 0) {
+        if (a->kind == A_REG) {
+            if (a->reg >= 8) put_byte(as, 0x41);
+            put_byte(as, (m[1] == 'u' ? 0x50 : 0x58) + (a->reg & 7));
+        } else if (a->kind == A_MEM && m[1] == 'u') {
+            encode1(as, 0, 0, 0xff, 6, a);
+        } else {
+            return 0;
+        }
+        return 1;
+    }
+    for (int i = 0; i < (int) (sizeof(alu) / sizeof(alu[0])); i++) {
+        if (strcmp(m, alu[i].name) != 0 || n != 2) continue;
+        if (a->kind == A_IMM && alu[i].extension >= 0) {
+            encode1(as, 0, 1, 0x81, alu[i].extension, b);
+            put_bytes(as, a->imm, 4);
+        } else if (is_gpr(a)) {
+            encode1(as, 0, 1, alu[i].opcode, a->reg, b);
+        } else {
+            return 0;
+        }
+        return 1;
+    }
+    if (strcmp(m, "imulq") == 0 && n == 2) { encode2(as, 0, 1, 0xaf, b->reg, a); return 1; }
+    if ((strncmp(m, "sal", 3) == 0 || strncmp(m, "sar", 3) == 0) && (m[3] == 'q' || m[3] == 'l') && !m[4] && n == 2) {
+        int extension = m[2] == 'l' ? 4 : 7, wide = m[3] == 'q';
+        if (a->kind == A_IMM) { encode1(as, 0, wide, 0xc1, extension, b); put_byte(as, (int) a->imm); }
+        else encode1(as, 0, wide, 0xd3, extension, b); // Count in %cl
+        return 1;
+    }
+    if (strcmp(m, "btcq") == 0 && n == 2) { encode2(as, 0, 1, 0xba, 7, b); put_byte(as, (int) a->imm); return 1; }
+    if (strcmp(m, "negq") == 0) { encode1(as, 0, 1, 0xf7, 3, a); return 1; }
+    if (strcmp(m, "notq") == 0) { encode1(as, 0, 1, 0xf7, 2, a); return 1; }
+    if (strcmp(m, "idivq") == 0) { encode1(as, 0, 1, 0xf7, 7, a); return 1; }
+    if (strncmp(m, "set", 3) == 0 && condition_number(m + 3) >= 0) {
+        encode2(as, 0, 0, 0x90 + condition_number(m + 3), 0, a);
+        return 1;
+    }
+    if (strcmp(m, "movzbq") == 0 && n == 2) { encode2(as, 0, 1, 0xb6, b->reg, a); return 1; }
+    if (strcmp(m, "movslq") == 0 && n == 2) { encode1(as, 0, 1, 0x63, b->reg, a); return 1; }
+    if (strcmp(m, "andb") == 0 && n == 2) { encode1(as, 0, 0, 0x20, a->reg, b); return 1; }
+    if (strcmp(m, "orb") == 0 && n == 2) { encode1(as, 0, 0, 0x08, a->reg, b); return 1; }
+    if (strcmp(m, "movl") == 0 && n == 2 && a->kind == A_IMM && is_reg(b, WIDTH_LONG)) {
+        if (b->reg >= 8) put_byte(as, 0x41);
+        put_byte(as, 0xb8 + (b->reg & 7));
+        put_bytes(as, a->imm, 4);
+        return 1;
+    }
+    if (strcmp(m, "xorl") == 0 && n == 2) { encode1(as, 0, 0, 0x31, a->reg, b); return 1; }
+    if (strcmp(m, "cvtsi2sdq") == 0 && n == 2) { encode2(as, 0xf2, 1, 0x2a, b->reg, a); return 1; }
+    if (strcmp(m, "ucomisd") == 0 && n == 2) { encode2(as, 0x66, 0, 0x2e, b->reg, a); return 1; }
+    for (int i = 0; i < (int) (sizeof(sse) / sizeof(sse[0])); i++) {
+        if (strcmp(m, sse[i].name) == 0 && n == 2) { encode2(as, 0xf2, 0, sse[i].opcode, b->reg, a); return 1; }
+    }
+    if (strcmp(m, "jmp") == 0 && a->kind == A_INDIRECT) { encode1(as, 0, 0, 0xff, 4, a); return 1; }
+    if (strcmp(m, "jmp") == 0 && a->kind == A_SYM) {
+        unsigned char opcode[1] = { 0xe9 };
+        encode_branch(as, opcode, 1, a->sym);
+        return 1;
+    }
+    if (strcmp(m, "call") == 0 && a->kind == A_SYM) {
+        unsigned char opcode[1] = { 0xe8 };
+        encode_branch(as, opcode, 1, a->sym);
+        return 1;
+    }
+    if (m[0] == 'j' && condition_number(m + 1) >= 0 && a->kind == A_SYM) {
+        unsigned char opcode[2] = { 0x0f, (unsigned char) (0x80 + condition_number(m + 1)) };
+        encode_branch(as, opcode, 2, a->sym);
+        return 1;
+    }
+    return 0;
+}
+
+/* --- Directives and lines --- */
+
+static void align_to(Assembler *as, size_t alignment) {
+    if (as->section == SEC_BSS) {
+        as->bss_size = (as->bss_size + alignment - 1) / alignment * alignment;
+        return;
+    }
+    while (current_buffer(as)->size % alignment) put_byte(as, as->section == SEC_TEXT ? 0x90 : 0);
+}
+
+// Bytes of a .string, decoding the escapes as does.
+static void put_string(Assembler *as, const char *s) {
+    const char *p = strchr(s, '"'), *end = strrchr(s, '"');
+    if (!p || p == end) {
+        asm_error(as, "bad string", s);
+        return;
+    }
+    for (p++; p < end; p++) {
+        int c = (unsigned char) *p;
+        if (c == '\\' && p + 1 < end) {
+            p++;
+            switch (*p) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case 'a': c = '\a'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'v': c = '\v'; break;
+                case 'x': c = (int) strtol(p + 1, (char**) &p, 16); p--; break;
+                default:
+                    if (*p >= '0' && *p <= '7') {
+                        c = 0;
+                        for (int k = 0; k < 3 && *p >= '0' && *p <= '7'; k++) c = c * 8 + (*p++ - '0');
+                        p--;
+                    } else {
+                        c = (unsigned char) *p;
+                    }
+                    break;
+            }
+        }
+        put_byte(as, c);
+    }
+    put_byte(as, 0);
+}
+
+static void directive(Assembler *as, char *name, char *args) {
+    if (strcmp(name, ".text") == 0) {
+        as->section = SEC_TEXT;
+    } else if (strcmp(name, ".bss") == 0) {
+        as->section = SEC_BSS;
+    } else if (strcmp(name, ".section") == 0) {
+        if (strncmp(args, ".rodata", 7) == 0) as->section = SEC_RODATA;
+        else if (strncmp(args, ".init_array", 11) == 0) as->section = SEC_INIT;
+        else as->section = SEC_IGNORED;
+    } else if (strcmp(name, ".p2align") == 0) {
+        if (as->section != SEC_INIT && as->section != SEC_IGNORED) align_to(as, (size_t) 1 << atoi(args));
+    } else if (strcmp(name, ".comm") == 0) {
+        char *parts[3];
+        int n = split_operands(args, parts, 3);
+        while (n > 0 && isspace((unsigned char) *parts[0])) parts[0]++;
+        size_t size = n > 1 ? strtoul(parts[1], NULL, 0) : 8, alignment = n > 2 ? strtoul(parts[2], NULL, 0) : 8;
+        int saved = as->section;
+        as->section = SEC_BSS;
+        align_to(as, alignment ? alignment : 1);
+        define_symbol(as, parts[0], SEC_BSS, as->bss_size);
+        as->bss_size += size;
+        as->section = saved;
+    } else if (strcmp(name, ".quad") == 0) {
+        if (as->section == SEC_INIT) {
+            as->init = (char**) checked_realloc(as->init, (as->num_init + 1), sizeof(char*));
+            as->init[as->num_init++] = jit_strdup(args);
+        } else if (isdigit((unsigned char) *args) || *args == '-') {
+            put_bytes(as, strtoll(args, NULL, 0), 8);
+        } else {
+            add_fixup(as, FIX_ABS64, args, NULL);
+            put_bytes(as, 0, 8);
+        }
+    } else if (strcmp(name, ".long") == 0) {
+        char *minus = strchr(args, '-');
+        if (minus) {
+            *minus = '\0';
+            add_fixup(as, FIX_DIFF32, args, minus + 1);
+            put_bytes(as, 0, 4);
+        } else {
+            put_bytes(as, strtoll(args, NULL, 0), 4);
+        }
+    } else if (strcmp(name, ".string") == 0) {
+        put_string(as, args);
+    }
+    // .file, .globl, .local, .type and .size carry nothing the JIT needs.
+}
+
+static void assemble_line(Assembler *as, char *line) {
+    while (isspace((unsigned char) *line)) line++;
+    char *end = line + strlen(line);
+    while (end > line && isspace((unsigned char) end[-1])) *--end = '\0';
+    if (!*line || *line == '#') return;
+    if (end[-1] == ':' && !strchr(line, ' ') && !strchr(line, '\t')) {
+        end[-1] = '\0';
+        define_symbol(as, line, as->section, position(as));
+        return;
+    }
+    char *args = line;
+    while (*args && !isspace((unsigned char) *args)) args++;
+    if (*args) *args++ = '\0';
+    while (isspace((unsigned char) *args)) args++;
+    if (*line == '.') {
+        directive(as, line, args);
+        return;
+    }
+    if (as->section != SEC_TEXT) {
+        asm_error(as, "instruction outside .text", line);
+        return;
+    }
+    char *parts[3];
+    AsmOperand ops[3];
+    int n = split_operands(args, parts, 3);
+    for (int i = 0; i < n; i++) {
+        if (!parse_operand(as, parts[i], &ops[i])) {
+            asm_error(as, "bad operand", parts[i]);
+            return;
+        }
+    }
+    as->instruction_fixups = as->num_fixups;
+    if (!encode_instruction(as, line, ops, n)) {
+        asm_error(as, "unsupported instruction", line);
+        return;
+    }
+    for (int i = as->instruction_fixups; i < as->num_fixups; i++) as->fixups[i].end = as->text.size;
+}
+
+/* --- Layout and execution --- */
+
+static size_t round_to_page(size_t size, size_t page) {
+    return (size + page - 1) / page * page;
+}
+
+// Address of a symbol once the image is at 'base'; library functions get
+// a stub. Returns 0 for a symbol nobody defines.
+static unsigned char* symbol_address(Assembler *as, const char *name, unsigned char *base,
+                                     const size_t *offsets, size_t stub_offset) {
+    AsmSymbol *symbol = find_symbol(as, name);
+    if (!symbol) {
+        void *target = strcmp(name, "exit") == 0 ? (void*) jit_exit : dlsym(RTLD_DEFAULT, name);
+        if (!target) return NULL;
+        as->externals = (void**) checked_realloc(as->externals, (as->num_externals + 1), sizeof(void*));
+        as->externals[as->num_externals] = target;
+        define_symbol(as, name, SEC_EXTERNAL, as->num_externals++);
+        symbol = find_symbol(as, name);
+    }
+    if (symbol->section == SEC_EXTERNAL) return base + stub_offset + STUB_SIZE * symbol->offset;
+    return base + offsets[symbol->section] + symbol->offset;
+}
+
+static void free_assembler(Assembler *as) {
+    for (int i = 0; i < as->symbols_capacity; i++) free(as->symbols[i].name);
+    for (int i = 0; i < as->num_fixups; i++) {
+        free(as->fixups[i].symbol);
+        free(as->fixups[i].minus);
+    }
+    for (int i = 0; i < as->num_init; i++) free(as->init[i]);
+    free(as->symbols);
+    free(as->fixups);
+    free(as->init);
+    free(as->externals);
+    free(as->text.data);
+    free(as->rodata.data);
+}
+
+int jit_run(const IRModule *module, int *exit_status) {
+    char *assembly = NULL;
+    size_t length = 0;
+    FILE *stream = open_memstream(&assembly, &length);
+    if (!stream) {
+        perror("JIT");
+        return -1;
+    }
+    int errors = emit_x86_64(stream, module);
+    fclose(stream);
+    if (errors > 0) {
+        free(assembly);
+        return -1;
+    }
+
+    Assembler as;
+    memset(&as, 0, sizeof(as));
+    for (char *line = assembly, *next; line && *line && !as.failed; line = next) {
+        next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        as.line++;
+        assemble_line(&as, line);
+    }
+    free(assembly);
+    if (!find_symbol(&as, "main")) asm_error(&as, "no function", "main");
+
+    // Image: code and stubs, read-only data, zeroed globals; each starts on
+    // a page of its own. Stubs are counted generously before resolution.
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t stub_offset = (as.text.size + STUB_SIZE - 1) / STUB_SIZE * STUB_SIZE;
+    size_t offsets[3];
+    offsets[SEC_TEXT] = 0;
+    offsets[SEC_RODATA] = round_to_page(stub_offset + STUB_SIZE * (size_t) as.num_fixups, page);
+    offsets[SEC_BSS] = offsets[SEC_RODATA] + round_to_page(as.rodata.size, page);
+    size_t image_size = offsets[SEC_BSS] + round_to_page(as.bss_size, page);
+    unsigned char *base = NULL;
+    if (!as.failed) {
+        base = (unsigned char*) mmap(NULL, image_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            perror("JIT");
+            base = NULL;
+            as.failed = 1;
+        }
+    }
+    if (base) {
+        memcpy(base, as.text.data, as.text.size);
+        if (as.rodata.size) memcpy(base + offsets[SEC_RODATA], as.rodata.data, as.rodata.size);
+    }
+    for (int i = 0; base && i < as.num_fixups && !as.failed; i++) {
+        const Fixup *f = &as.fixups[i];
+        unsigned char *field = base + offsets[f->section] + f->offset;
+        unsigned char *target = symbol_address(&as, f->symbol, base, offsets, stub_offset);
+        if (!target) {
+            asm_error(&as, "undefined symbol", f->symbol);
+            break;
+        }
+        long long value;
+        if (f->kind == FIX_REL32) {
+            value = target - (base + offsets[f->section] + f->end);
+        } else if (f->kind == FIX_DIFF32) {
+            value = target - symbol_address(&as, f->minus, base, offsets, stub_offset);
+        } else {
+            value = (long long) target;
+        }
+        for (int k = 0; k < (f->kind == FIX_ABS64 ? 8 : 4); k++) field[k] = (unsigned char) (value >> (8 * k));
+    }
+    for (int i = 0; base && i < as.num_externals; i++) {
+        unsigned char *stub = base + stub_offset + STUB_SIZE * i;
+        static const unsigned char jump[6] = { 0xff, 0x25, 0, 0, 0, 0 }; // jmp *0(%rip)
+        memcpy(stub, jump, sizeof(jump));
+        memcpy(stub + sizeof(jump), &as.externals[i], sizeof(void*));
+    }
+    if (!as.failed && (mprotect(base, offsets[SEC_RODATA], PROT_READ | PROT_EXEC) != 0 ||
+                       mprotect(base + offsets[SEC_RODATA], offsets[SEC_BSS] - offsets[SEC_RODATA], PROT_READ) != 0)) {
+        perror("JIT");
+        as.failed = 1;
+    }
+
+    int result = -1;
+    if (!as.failed) {
+        typedef long (*EntryPoint)(void);
+        EntryPoint main_entry = (EntryPoint) symbol_address(&as, "main", base, offsets, stub_offset);
+        EntryPoint *init = (EntryPoint*) checked_calloc(as.num_init, sizeof(EntryPoint));
+        for (int i = 0; i < as.num_init; i++) {
+            init[i] = (EntryPoint) symbol_address(&as, as.init[i], base, offsets, stub_offset);
+        }
+        fflush(stdout);
+        if (setjmp(jit_exit_point) == 0) {
+            for (int i = 0; i < as.num_init; i++) init[i]();
+            jit_exit_status = (int) main_entry();
+        }
+        fflush(stdout);
+        *exit_status = jit_exit_status;
+        free(init);
+        result = 0;
+    }
+    if (base) munmap(base, image_size);
+    free_assembler(&as);
+    return result;
+}
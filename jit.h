@@ -0,0 +1,23 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "ir.h"
+
+/*
+ * In-process JIT. The module is lowered by the x86-64 backend (see
+ * x86_64.h) into a memory buffer, and a small assembler for the forms that
+ * backend emits encodes it straight into mmap'd pages: code, read-only data
+ * and zeroed globals, each page-protected once filled. Branches and
+ * RIP-relative references are patched after layout. Library functions are
+ * found with dlsym and called through stubs next to the code, so the pages
+ * can live anywhere. A call to exit() returns to jit_run() instead of
+ * ending the compiler.
+ *
+ * The global initializers run first, then main.
+ */
+
+// Compiles and runs the module. Stores the program's exit status and
+// returns 0, or returns -1 after reporting why it could not run.
+int jit_run(const IRModule *module, int *exit_status);
+
+#endif // JIT_H
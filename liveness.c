@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "liveness.h"
+#include "cfg.h"
+#include "alloc.h"
+
+int instruction_uses(const Instruction *instr, Operand *uses) {
+    int count = 0;
+    if (instr->arg1.type != OP_NONE) uses[count++] = instr->arg1;
+    if (instr->arg2.type != OP_NONE) uses[count++] = instr->arg2;
+    if (ir_reads_result(instr->opcode)) uses[count++] = instr->result;
+    return count;
+}
+
+int liveness_index(const Liveness *lv, Operand op) {
+    if (op.type != OP_TEMPORARY) return -1;
+    int slot = op.val.temp - lv->index_base;
+    if (slot < 0 || slot >= lv->index_size) return -1;
+    return lv->index[slot];
+}
+
+static int set_temps(const Liveness *lv, const LiveWord *set, int *out) {
+    int count = 0;
+    for (int w = 0; w < lv->words; w++) {
+        for (LiveWord bits = set[w]; bits; bits &= bits - 1) {
+            out[count++] = lv->globals[w * LIVE_WORD_BITS + __builtin_ctz(bits)];
+        }
+    }
+    return count;
+}
+
+int live_in_temps(const Liveness *lv, int block, int *out) {
+    return set_temps(lv, lv->live_in + (size_t) block * lv->words, out);
+}
+
+int live_out_temps(const Liveness *lv, int block, int *out) {
+    return set_temps(lv, lv->live_out + (size_t) block * lv->words, out);
+}
+
+static void widen_range(int *lo, int *hi, Operand op) {
+    if (op.type != OP_TEMPORARY) return;
+    if (op.val.temp < *lo) *lo = op.val.temp;
+    if (op.val.temp > *hi) *hi = op.val.temp;
+}
+
+static void number_temp(Liveness *lv, Operand op) {
+    if (op.type != OP_TEMPORARY || lv->index[op.val.temp - lv->index_base] >= 0) return;
+    lv->index[op.val.temp - lv->index_base] = lv->num_temps;
+    lv->temps[lv->num_temps++] = op.val.temp;
+}
+
+// Marks the temporaries a block reads before writing them as global and,
+// when 'gen' and 'kill' are given, fills in the block's sets.
+static void scan_block(Liveness *lv, BasicBlock *block, int *global_of, int *written_in,
+                       LiveWord *gen, LiveWord *kill) {
+    for (int i = 0; i < block->num_instrs; i++) {
+        Instruction *instr = &block->instrs[i];
+        Operand uses[3];
+        int num_uses = instruction_uses(instr, uses);
+        for (int u = 0; u < num_uses; u++) {
+            int t = liveness_index(lv, uses[u]);
+            if (t < 0 || written_in[t] == block->id + 1) continue;
+            if (global_of[t] < 0) {
+                global_of[t] = lv->num_globals;
+                lv->globals[lv->num_globals++] = t;
+            }
+            if (gen) LIVE_SET(gen, global_of[t]);
+        }
+        if (ir_defines_result(instr->opcode)) {
+            int t = liveness_index(lv, instr->result);
+            if (t < 0) continue;
+            written_in[t] = block->id + 1;
+            if (kill && global_of[t] >= 0) LIVE_SET(kill, global_of[t]);
+        }
+    }
+}
+
+Liveness* compute_liveness(IRFunction *fn) {
+    Liveness *lv = (Liveness*) checked_calloc(1, sizeof(Liveness));
+    int lo = INT_MAX, hi = -1;
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        for (int i = 0; i < block->num_instrs; i++) {
+            widen_range(&lo, &hi, block->instrs[i].result);
+            widen_range(&lo, &hi, block->instrs[i].arg1);
+            widen_range(&lo, &hi, block->instrs[i].arg2);
+        }
+    }
+    lv->index_base = hi >= 0 ? lo : 0;
+    lv->index_size = hi >= 0 ? hi - lo + 1 : 0;
+    lv->index = (int*) checked_calloc(lv->index_size, sizeof(int));
+    lv->temps = (int*) checked_calloc(lv->index_size, sizeof(int));
+    memset(lv->index, -1, lv->index_size * sizeof(int));
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        for (int i = 0; i < block->num_instrs; i++) {
+            Instruction *instr = &block->instrs[i];
+            number_temp(lv, instr->result);
+            number_temp(lv, instr->arg1);
+            number_temp(lv, instr->arg2);
+        }
+    }
+
+    // First sweep: find the global temporaries. Second sweep: gen and kill
+    // sets over them (gen: read before any write in the block).
+    int nb = fn->num_blocks;
+    int *global_of = (int*) checked_calloc(lv->num_temps, sizeof(int));
+    int *written_in = (int*) checked_calloc(lv->num_temps, sizeof(int)); // Block id + 1
+    memset(global_of, -1, lv->num_temps * sizeof(int));
+    lv->globals = (int*) checked_calloc(lv->num_temps, sizeof(int));
+    for (int b = 0; b < nb; b++) {
+        scan_block(lv, fn->blocks[b], global_of, written_in, NULL, NULL);
+    }
+    int words = lv->words = (lv->num_globals + LIVE_WORD_BITS - 1) / LIVE_WORD_BITS;
+    lv->live_in = (LiveWord*) checked_calloc((size_t) nb * words, sizeof(LiveWord));
+    lv->live_out = (LiveWord*) checked_calloc((size_t) nb * words, sizeof(LiveWord));
+    LiveWord *gen = (LiveWord*) checked_calloc((size_t) nb * words, sizeof(LiveWord));
+    LiveWord *kill = (LiveWord*) checked_calloc((size_t) nb * words, sizeof(LiveWord));
+    memset(written_in, 0, lv->num_temps * sizeof(int));
+    for (int b = 0; b < nb; b++) {
+        scan_block(lv, fn->blocks[b], global_of, written_in,
+                   gen + (size_t) b * words, kill + (size_t) b * words);
+    }
+    free(global_of);
+    free(written_in);
+
+    // Visiting blocks in postorder lets most information flow in one sweep.
+    BasicBlock **order = (BasicBlock**) checked_calloc(nb, sizeof(BasicBlock*));
+    int num_reachable = compute_reverse_postorder(fn, order);
+    int changed = words > 0;
+    while (changed) {
+        changed = 0;
+        for (int o = num_reachable - 1; o >= 0; o--) {
+            BasicBlock *block = order[o];
+            LiveWord *in = lv->live_in + (size_t) block->id * words;
+            LiveWord *out = lv->live_out + (size_t) block->id * words;
+            LiveWord *g = gen + (size_t) block->id * words, *k = kill + (size_t) block->id * words;
+            for (int s = 0; s < block->num_succs; s++) {
+                LiveWord *succ_in = lv->live_in + (size_t) block->succs[s]->id * words;
+                for (int w = 0; w < words; w++) out[w] |= succ_in[w];
+            }
+            for (int w = 0; w < words; w++) {
+                LiveWord updated = g[w] | (out[w] & ~k[w]);
+                if (updated != in[w]) {
+                    in[w] = updated;
+                    changed = 1;
+                }
+            }
+        }
+    }
+    free(order);
+    free(gen);
+    free(kill);
+    return lv;
+}
+
+void free_liveness(Liveness *lv) {
+    if (!lv) return;
+    free(lv->temps);
+    free(lv->index);
+    free(lv->globals);
+    free(lv->live_in);
+    free(lv->live_out);
+    free(lv);
+}
@@ -0,0 +1,54 @@
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include "ir.h"
+
+/*
+ * Live temporaries at the boundaries of each basic block, found by the
+ * usual backward dataflow over the CFG. Only temporaries are tracked:
+ * identifiers name memory. The function must have a CFG and must not be in
+ * SSA form.
+ *
+ * The temporaries a function mentions are numbered densely from 0, so the
+ * cost follows the size of the function, not of the module. Most of
+ * them live inside a single block, so the per-block sets only cover the
+ * "global" ones: those some block reads before writing them.
+ */
+
+typedef unsigned int LiveWord;
+
+#define LIVE_WORD_BITS ((int) (8 * sizeof(LiveWord)))
+#define LIVE_TEST(set, i) (((set)[(i) / LIVE_WORD_BITS] >> ((i) % LIVE_WORD_BITS)) & 1u)
+#define LIVE_SET(set, i)  ((set)[(i) / LIVE_WORD_BITS] |= 1u << ((i) % LIVE_WORD_BITS))
+
+typedef struct {
+    int num_temps;         // Temporaries mentioned in the function
+    int *temps;            // Dense number -> IR temporary
+    int *index;            // IR temporary - index_base -> dense number, or -1
+    int index_base;        // Lowest temporary the function mentions
+    int index_size;        // Span up to the highest one
+    int num_globals;       // Temporaries that are live across some block boundary
+    int *globals;          // Global number -> dense number
+    int words;             // LiveWords per set
+    LiveWord *live_in;     // Sets of global numbers, 'words' per block, by block id
+    LiveWord *live_out;
+} Liveness;
+
+// Computes live-in and live-out sets for every block of 'fn'.
+Liveness* compute_liveness(IRFunction *fn);
+
+void free_liveness(Liveness *lv);
+
+// Dense number of a temporary operand, or -1 for anything else.
+int liveness_index(const Liveness *lv, Operand op);
+
+// Store the dense numbers of the temporaries live into or out of a block in
+// 'out' and return how many there are.
+int live_in_temps(const Liveness *lv, int block, int *out);
+int live_out_temps(const Liveness *lv, int block, int *out);
+
+// Collects the operands an instruction reads. Returns how many were stored
+// in 'uses' (at most 3).
+int instruction_uses(const Instruction *instr, Operand *uses);
+
+#endif // LIVENESS_H
@@ -0,0 +1,400 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "passes.h"
+#include "cfg.h"
+#include "loops.h"
+#include "alloc.h"
+
+/*
+ * Loop optimizations on SSA form. Both passes first give every loop a
+ * preheader (see loops.h).
+ *
+ * "licm" moves loop-invariant computations into the preheader: pure
+ * operations whose operands are constants or temporaries defined outside
+ * the loop. Loops are visited innermost first, so an expression can climb
+ * out of a nest one preheader at a time.
+ *
+ * "loop-reduce" finds basic induction variables, header phis that step
+ * by a constant each iteration (i = phi(init, i + c)), and the values
+ * derived from them linearly (a*i + b). A multiplication producing such a
+ * value becomes a new induction variable of its own: it starts at a*init + b
+ * in the preheader and grows by a*c at the end of each iteration. Array indexing
+ * 'MUL t, j, 4' thus turns into an offset that is bumped by 4.
+ */
+
+static int int_constant(Operand op, int *value) {
+    if (op.type == OP_INT_CONST) *value = op.val.int_val;
+    else if (op.type == OP_CHAR_CONST) *value = op.val.char_val;
+    else return 0;
+    return 1;
+}
+
+static Instruction make_instr(OpCode opcode, Operand result, Operand arg1, Operand arg2) {
+    Instruction instr;
+    instr.opcode = opcode;
+    instr.result = result;
+    instr.arg1 = arg1;
+    instr.arg2 = arg2;
+    return instr;
+}
+
+// Block id of each temporary's definition, or -1.
+static int* find_def_blocks(IRFunction *fn) {
+    int *def_block = (int*) checked_calloc(ir_module.num_temps, sizeof(int));
+    memset(def_block, -1, ir_module.num_temps * sizeof(int));
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        for (int i = 0; i < block->num_phis; i++) {
+            def_block[block->phis[i].result.val.temp] = b;
+        }
+        for (int i = 0; i < block->num_instrs; i++) {
+            Instruction *instr = &block->instrs[i];
+            if (ir_defines_result(instr->opcode) && instr->result.type == OP_TEMPORARY) {
+                def_block[instr->result.val.temp] = b;
+            }
+        }
+    }
+    return def_block;
+}
+
+static LoopForest* prepare_loops(IRFunction *fn) {
+    // insert_preheaders computes dominators; only new blocks make them stale.
+    if (insert_preheaders(fn) > 0) compute_dominators(fn);
+    return find_loops(fn);
+}
+
+/* --- Loop-invariant code motion --- */
+
+static int is_invariant_operand(IRFunction *fn, Loop *loop, int *def_block, Operand op) {
+    if (op.type == OP_NONE || is_constant_operand(op)) return 1;
+    if (op.type != OP_TEMPORARY) return 0;
+    int b = op.val.temp < ir_module.num_temps ? def_block[op.val.temp] : -1;
+    return b < 0 || !loop_contains(loop, fn->blocks[b]);
+}
+
+// Pure operations that cannot trap, wherever they are executed.
+static int is_hoistable(IRFunction *fn, Loop *loop, int *def_block, Instruction *instr) {
+    if (instr->result.type != OP_TEMPORARY) return 0;
+    switch (instr->opcode) {
+        case IR_ADD: case IR_SUB: case IR_MUL:
+        case IR_EQ: case IR_NE: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+        case IR_AND: case IR_OR: case IR_BIT_AND: case IR_BIT_OR: case IR_XOR:
+        case IR_SHL: case IR_SHR:
+        case IR_UNARY_MINUS: case IR_NOT: case IR_BIT_NOT: case IR_ASSIGN:
+            break;
+        case IR_DIV: case IR_MOD: {
+            int divisor;
+            if (instr->arg2.type == OP_FLOAT_CONST && operand_float_value(instr->arg2) != 0.0) break;
+            if (int_constant(instr->arg2, &divisor) && divisor != 0 && divisor != -1) break;
+            return 0;
+        }
+        case IR_ADDR_OF:
+            return instr->arg1.type == OP_IDENTIFIER; // The address of a variable never changes
+        default:
+            return 0;
+    }
+    return is_invariant_operand(fn, loop, def_block, instr->arg1) &&
+           is_invariant_operand(fn, loop, def_block, instr->arg2);
+}
+
+int run_licm(IRFunction *fn) {
+    LoopForest *forest = prepare_loops(fn);
+    int *def_block = find_def_blocks(fn);
+    int hoisted = 0;
+    for (int l = 0; l < forest->num_loops; l++) {
+        Loop *loop = &forest->loops[l];
+        BasicBlock *pre = loop->preheader;
+        if (!pre) continue;
+        // Hoisting one instruction can make the ones reading it invariant.
+        int changed = 1;
+        while (changed) {
+            changed = 0;
+            for (int b = 0; b < loop->num_blocks; b++) {
+                BasicBlock *block = loop->blocks[b];
+                int kept = 0;
+                for (int i = 0; i < block->num_instrs; i++) {
+                    Instruction instr = block->instrs[i];
+                    if (is_hoistable(fn, loop, def_block, &instr)) {
+                        block_insert_before_terminator(pre, instr);
+                        def_block[instr.result.val.temp] = pre->id;
+                        hoisted++;
+                        changed = 1;
+                    } else {
+                        block->instrs[kept++] = instr;
+                    }
+                }
+                block->num_instrs = kept;
+            }
+        }
+    }
+    free(def_block);
+    free_loops(forest);
+    return hoisted;
+}
+
+/* --- Induction-variable strength reduction --- */
+
+typedef struct {
+    Operand phi;       // The variable's value in the current iteration
+    Operand init;      // Value on entry
+    int step;
+    Operand next;      // phi + step, fed back along the latch
+} BasicIV;
+
+typedef struct {
+    int iv;            // Index into the loop's basic induction variables
+    int scale, offset; // Value is scale * iv + offset
+    Operand value;     // Header phi of the reduced variable
+} ReducedIV;
+
+typedef struct {
+    IRFunction *fn;
+    int num_temps;     // Temporaries when the pass started; the arrays cover these
+    int *def_block;
+    // Linear form of each temporary in the current loop: scale * iv + offset.
+    int *form_stamp;   // Loop number + 1 when the entry is valid
+    int *form_iv;
+    int *form_scale;
+    int *form_offset;
+    BasicIV *ivs;
+    int num_ivs;
+    ReducedIV *reduced;
+    int num_reduced;
+} Reducer;
+
+static int slot_of(BasicBlock *block, BasicBlock *pred) {
+    for (int p = 0; p < block->num_preds; p++) {
+        if (block->preds[p] == pred) return p;
+    }
+    return -1;
+}
+
+static Instruction* find_definition(BasicBlock *block, Operand temp, int *index) {
+    for (int i = 0; i < block->num_instrs; i++) {
+        if (ir_defines_result(block->instrs[i].opcode) && are_operands_equal(block->instrs[i].result, temp)) {
+            *index = i;
+            return &block->instrs[i];
+        }
+    }
+    return NULL;
+}
+
+static void set_form(Reducer *rd, int stamp, Operand op, int iv, int scale, int offset) {
+    int t = op.val.temp;
+    rd->form_stamp[t] = stamp;
+    rd->form_iv[t] = iv;
+    rd->form_scale[t] = scale;
+    rd->form_offset[t] = offset;
+}
+
+static int has_form(Reducer *rd, int stamp, Operand op) {
+    return op.type == OP_TEMPORARY && op.val.temp < rd->num_temps && rd->form_stamp[op.val.temp] == stamp;
+}
+
+// Finds header phis of the form i = phi(init, i + c).
+static void find_basic_ivs(Reducer *rd, Loop *loop, int pre_slot, int latch_slot) {
+    BasicBlock *header = loop->header;
+    rd->num_ivs = 0;
+    rd->ivs = (BasicIV*) checked_calloc(header->num_phis, sizeof(BasicIV));
+    for (int i = 0; i < header->num_phis; i++) {
+        PhiNode *phi = &header->phis[i];
+        Operand next = phi->args[latch_slot];
+        if (phi->args[pre_slot].type == OP_NONE) continue;
+        if (next.type != OP_TEMPORARY || next.val.temp >= rd->num_temps) continue;
+        int b = rd->def_block[next.val.temp], index;
+        if (b < 0 || !loop_contains(loop, rd->fn->blocks[b])) continue;
+        Instruction *def = find_definition(rd->fn->blocks[b], next, &index);
+        if (!def) continue;
+        int c;
+        int step_found = 0, step = 0;
+        if (def->opcode == IR_ADD && are_operands_equal(def->arg1, phi->result) && int_constant(def->arg2, &c)) {
+            step = c; step_found = 1;
+        } else if (def->opcode == IR_ADD && are_operands_equal(def->arg2, phi->result) && int_constant(def->arg1, &c)) {
+            step = c; step_found = 1;
+        } else if (def->opcode == IR_SUB && are_operands_equal(def->arg1, phi->result) && int_constant(def->arg2, &c)) {
+            step = (int) (0u - (unsigned int) c); step_found = 1;
+        }
+        if (!step_found) continue;
+        BasicIV *iv = &rd->ivs[rd->num_ivs++];
+        iv->phi = phi->result;
+        iv->init = phi->args[pre_slot];
+        iv->step = step;
+        iv->next = next;
+    }
+}
+
+// Emits 'scale * init + offset' at the end of the preheader.
+static Operand initial_value(BasicBlock *pre, Operand init, int scale, int offset) {
+    Operand value = init;
+    Operand folded;
+    if (scale != 1) {
+        if (fold_constant_operation(IR_MUL, value, create_operand_int(scale), &folded)) {
+            value = folded;
+        } else {
+            Operand product = create_operand_temp();
+            block_insert_before_terminator(pre, make_instr(IR_MUL, product, value, create_operand_int(scale)));
+            value = product;
+        }
+    }
+    if (offset != 0) {
+        if (fold_constant_operation(IR_ADD, value, create_operand_int(offset), &folded)) {
+            value = folded;
+        } else {
+            Operand sum = create_operand_temp();
+            block_insert_before_terminator(pre, make_instr(IR_ADD, sum, value, create_operand_int(offset)));
+            value = sum;
+        }
+    }
+    return value;
+}
+
+// Returns the header phi carrying scale * iv + offset, creating it on first
+// use.
+static Operand reduced_value(Reducer *rd, Loop *loop, int pre_slot, int latch_slot,
+                             int iv, int scale, int offset) {
+    for (int r = 0; r < rd->num_reduced; r++) {
+        ReducedIV *red = &rd->reduced[r];
+        if (red->iv == iv && red->scale == scale && red->offset == offset) return red->value;
+    }
+    BasicIV *basic = &rd->ivs[iv];
+    Operand value = create_operand_temp();
+    Operand next = create_operand_temp();
+    Operand init = initial_value(loop->preheader, basic->init, scale, offset);
+    PhiNode *phi = block_add_phi(loop->header, value);
+    phi->args[pre_slot] = init;
+    phi->args[latch_slot] = next;
+
+    // The update goes at the end of the latch, so the old and new values
+    // barely overlap and can share a temporary after SSA destruction.
+    int increment = (int) ((unsigned int) scale * (unsigned int) basic->step);
+    block_insert_before_terminator(loop->latches[0], make_instr(IR_ADD, next, value, create_operand_int(increment)));
+
+    ReducedIV *red = &rd->reduced[rd->num_reduced++];
+    red->iv = iv;
+    red->scale = scale;
+    red->offset = offset;
+    red->value = value;
+    return value;
+}
+
+static int compare_rpo(const void *a, const void *b) {
+    return (*(BasicBlock* const*) a)->rpo - (*(BasicBlock* const*) b)->rpo;
+}
+
+static int reduce_loop(Reducer *rd, Loop *loop, int stamp) {
+    BasicBlock *header = loop->header;
+    if (!loop->preheader || loop->num_latches != 1 || header->num_preds != 2) return 0;
+    int pre_slot = slot_of(header, loop->preheader);
+    int latch_slot = slot_of(header, loop->latches[0]);
+    find_basic_ivs(rd, loop, pre_slot, latch_slot);
+    if (rd->num_ivs == 0) {
+        free(rd->ivs);
+        return 0;
+    }
+    for (int i = 0; i < rd->num_ivs; i++) set_form(rd, stamp, rd->ivs[i].phi, i, 1, 0);
+
+    // Visit definitions before uses: in SSA form a definition dominates its
+    // uses, and dominators come first in reverse postorder.
+    BasicBlock **order = (BasicBlock**) checked_calloc(loop->num_blocks, sizeof(BasicBlock*));
+    memcpy(order, loop->blocks, loop->num_blocks * sizeof(BasicBlock*));
+    qsort(order, loop->num_blocks, sizeof(BasicBlock*), compare_rpo);
+
+    // Candidates are rewritten once the walk is over, because creating a
+    // reduced variable inserts code into the loop.
+    int capacity = 16, num_candidates = 0;
+    Instruction **candidates = (Instruction**) checked_calloc(capacity, sizeof(Instruction*));
+    for (int b = 0; b < loop->num_blocks; b++) {
+        BasicBlock *block = order[b];
+        for (int i = 0; i < block->num_instrs; i++) {
+            Instruction *instr = &block->instrs[i];
+            if (instr->result.type != OP_TEMPORARY || instr->result.val.temp >= rd->num_temps) continue;
+            Operand var = instr->arg1;
+            int c = 0;
+            int have_const = int_constant(instr->arg2, &c);
+            if (!has_form(rd, stamp, var) || (!have_const && instr->opcode != IR_ASSIGN)) {
+                // Commutative operations may have the constant first.
+                if ((instr->opcode == IR_ADD || instr->opcode == IR_MUL) &&
+                    has_form(rd, stamp, instr->arg2) && int_constant(instr->arg1, &c)) {
+                    var = instr->arg2;
+                } else {
+                    continue;
+                }
+            }
+            int t = var.val.temp;
+            unsigned int scale = (unsigned int) rd->form_scale[t];
+            unsigned int offset = (unsigned int) rd->form_offset[t];
+            switch (instr->opcode) {
+                case IR_ASSIGN: break;
+                case IR_ADD: offset += (unsigned int) c; break;
+                case IR_SUB: offset -= (unsigned int) c; break;
+                case IR_MUL: scale *= (unsigned int) c; offset *= (unsigned int) c; break;
+                case IR_SHL:
+                    if (c < 0 || c > 31) continue;
+                    scale <<= c;
+                    offset <<= c;
+                    break;
+                default:
+                    continue;
+            }
+            set_form(rd, stamp, instr->result, rd->form_iv[t], (int) scale, (int) offset);
+            if (instr->opcode == IR_MUL || instr->opcode == IR_SHL) {
+                if (num_candidates == capacity) {
+                    capacity *= 2;
+                    candidates = (Instruction**) checked_realloc(candidates, capacity, sizeof(Instruction*));
+                }
+                candidates[num_candidates++] = instr;
+            }
+        }
+    }
+
+    // Replace each multiplication with a copy of its reduced variable. The
+    // copies are rewritten in place first, so the instruction pointers stay
+    // valid until the new variables insert their updates.
+    Operand *results = (Operand*) checked_calloc(num_candidates, sizeof(Operand));
+    for (int i = 0; i < num_candidates; i++) {
+        Instruction *instr = candidates[i];
+        results[i] = instr->result;
+        *instr = make_instr(IR_ASSIGN, instr->result, create_operand_none(), create_operand_none());
+    }
+    rd->reduced = (ReducedIV*) checked_calloc(num_candidates, sizeof(ReducedIV));
+    rd->num_reduced = 0;
+    for (int i = 0; i < num_candidates; i++) {
+        int t = results[i].val.temp;
+        Operand value = reduced_value(rd, loop, pre_slot, latch_slot,
+                                      rd->form_iv[t], rd->form_scale[t], rd->form_offset[t]);
+        int b = rd->def_block[t], index;
+        find_definition(rd->fn->blocks[b], results[i], &index)->arg1 = value;
+    }
+    free(results);
+    free(rd->reduced);
+    free(candidates);
+    free(order);
+    free(rd->ivs);
+    return num_candidates;
+}
+
+int run_strength_reduction(IRFunction *fn) {
+    LoopForest *forest = prepare_loops(fn);
+    Reducer rd;
+    memset(&rd, 0, sizeof(rd));
+    rd.fn = fn;
+    rd.def_block = find_def_blocks(fn);
+    int num_temps = rd.num_temps = ir_module.num_temps;
+    rd.form_stamp = (int*) checked_calloc(num_temps, sizeof(int));
+    rd.form_iv = (int*) checked_calloc(num_temps, sizeof(int));
+    rd.form_scale = (int*) checked_calloc(num_temps, sizeof(int));
+    rd.form_offset = (int*) checked_calloc(num_temps, sizeof(int));
+    int reduced = 0;
+    for (int l = 0; l < forest->num_loops; l++) {
+        reduced += reduce_loop(&rd, &forest->loops[l], l + 1);
+    }
+    free(rd.def_block);
+    free(rd.form_stamp);
+    free(rd.form_iv);
+    free(rd.form_scale);
+    free(rd.form_offset);
+    free_loops(forest);
+    return reduced;
+}
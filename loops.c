@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "loops.h"
+#include "alloc.h"
+
+int loop_contains(const Loop *loop, const BasicBlock *block) {
+    if (block->id >= loop->forest->num_block_ids) return 0;
+    // Only the loops enclosing the block's innermost loop can hold it.
+    const Loop *l = loop->forest->innermost[block->id];
+    while (l && l->depth > loop->depth) l = l->parent;
+    return l == loop;
+}
+
+// Collects the loop body: everything that reaches a latch backwards without
+// crossing the header. A block is in the body once its 'mark' is 'stamp';
+// 'body' and 'worklist' have room for every block of the function.
+static void collect_body(Loop *loop, int *mark, int stamp, BasicBlock **body, BasicBlock **worklist) {
+    int num_body = 0, size = 0;
+    mark[loop->header->id] = stamp;
+    body[num_body++] = loop->header;
+    for (int l = 0; l < loop->num_latches; l++) {
+        if (mark[loop->latches[l]->id] != stamp) {
+            mark[loop->latches[l]->id] = stamp;
+            body[num_body++] = loop->latches[l];
+            worklist[size++] = loop->latches[l];
+        }
+    }
+    while (size > 0) {
+        BasicBlock *block = worklist[--size];
+        for (int p = 0; p < block->num_preds; p++) {
+            BasicBlock *pred = block->preds[p];
+            if (pred->rpo < 0 || mark[pred->id] == stamp) continue;
+            mark[pred->id] = stamp;
+            body[num_body++] = pred;
+            worklist[size++] = pred;
+        }
+    }
+    loop->num_blocks = num_body;
+    loop->blocks = (BasicBlock**) checked_calloc(num_body, sizeof(BasicBlock*));
+    memcpy(loop->blocks, body, num_body * sizeof(BasicBlock*));
+}
+
+static BasicBlock* find_preheader(Loop *loop) {
+    BasicBlock *outside = NULL;
+    for (int p = 0; p < loop->header->num_preds; p++) {
+        BasicBlock *pred = loop->header->preds[p];
+        if (loop_contains(loop, pred)) continue;
+        if (outside) return NULL;
+        outside = pred;
+    }
+    if (!outside || outside->id == CFG_ENTRY || outside->num_succs != 1) return NULL;
+    return outside;
+}
+
+static int compare_loop_size(const void *a, const void *b) {
+    return ((const Loop*) a)->num_blocks - ((const Loop*) b)->num_blocks;
+}
+
+LoopForest* find_loops(IRFunction *fn) {
+    LoopForest *forest = (LoopForest*) checked_calloc(1, sizeof(LoopForest));
+    int *loop_of = (int*) checked_calloc(fn->num_blocks, sizeof(int)); // Header id -> loop + 1
+    forest->loops = (Loop*) checked_calloc(fn->num_blocks, sizeof(Loop));
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        if (block->rpo < 0) continue;
+        for (int s = 0; s < block->num_succs; s++) {
+            BasicBlock *header = block->succs[s];
+            if (!block_dominates(header, block)) continue;
+            if (!loop_of[header->id]) {
+                Loop *loop = &forest->loops[forest->num_loops++];
+                loop->header = header;
+                loop->latches = (BasicBlock**) checked_calloc(header->num_preds, sizeof(BasicBlock*));
+                loop_of[header->id] = forest->num_loops;
+            }
+            Loop *loop = &forest->loops[loop_of[header->id] - 1];
+            loop->latches[loop->num_latches++] = block;
+        }
+    }
+    free(loop_of);
+
+    int *mark = (int*) checked_calloc(fn->num_blocks, sizeof(int));
+    BasicBlock **body = (BasicBlock**) checked_calloc(fn->num_blocks, sizeof(BasicBlock*));
+    BasicBlock **worklist = (BasicBlock**) checked_calloc(fn->num_blocks, sizeof(BasicBlock*));
+    for (int i = 0; i < forest->num_loops; i++) {
+        collect_body(&forest->loops[i], mark, i + 1, body, worklist);
+    }
+    free(mark);
+    free(body);
+    free(worklist);
+    // A loop nested in another has fewer blocks, so sorting by size puts
+    // inner loops first and the enclosing loop of each one after it.
+    qsort(forest->loops, forest->num_loops, sizeof(Loop), compare_loop_size);
+    // Mapping the outermost loops first leaves each block with its innermost
+    // loop. When a loop is reached, its header maps to the enclosing loop.
+    forest->num_block_ids = fn->num_blocks;
+    forest->innermost = (Loop**) checked_calloc(fn->num_blocks, sizeof(Loop*));
+    for (int i = forest->num_loops - 1; i >= 0; i--) {
+        Loop *loop = &forest->loops[i];
+        loop->forest = forest;
+        loop->parent = forest->innermost[loop->header->id];
+        loop->depth = loop->parent ? loop->parent->depth + 1 : 1;
+        for (int b = 0; b < loop->num_blocks; b++) {
+            forest->innermost[loop->blocks[b]->id] = loop;
+        }
+    }
+    for (int i = 0; i < forest->num_loops; i++) {
+        forest->loops[i].preheader = find_preheader(&forest->loops[i]);
+    }
+    return forest;
+}
+
+void free_loops(LoopForest *forest) {
+    if (!forest) return;
+    for (int i = 0; i < forest->num_loops; i++) {
+        free(forest->loops[i].blocks);
+        free(forest->loops[i].latches);
+    }
+    free(forest->loops);
+    free(forest->innermost);
+    free(forest);
+}
+
+// Routes the edges entering the loop through a new block. With several
+// entering edges, each header phi gets a phi in the new block that merges
+// their arguments.
+static BasicBlock* create_preheader(IRFunction *fn, Loop *loop) {
+    BasicBlock *header = loop->header;
+    int num_outside = 0;
+    for (int p = 0; p < header->num_preds; p++) {
+        if (!loop_contains(loop, header->preds[p])) num_outside++;
+    }
+    if (num_outside == 0) return NULL;
+
+    BasicBlock *pre = new_basic_block(fn, -1);
+    for (int i = 0; num_outside > 1 && i < header->num_phis; i++) {
+        PhiNode *phi = block_add_phi(pre, header->phis[i].origin);
+        phi->result = create_operand_temp();
+    }
+    Operand *values = (Operand*) checked_calloc(header->num_phis, sizeof(Operand));
+    int p = 0;
+    while (p < header->num_preds) {
+        BasicBlock *pred = header->preds[p];
+        if (loop_contains(loop, pred)) {
+            p++;
+            continue;
+        }
+        for (int i = 0; i < header->num_phis; i++) values[i] = header->phis[i].args[p];
+        redirect_cfg_edge(pred, header, pre);
+        for (int i = 0; i < pre->num_phis; i++) pre->phis[i].args[pre->num_preds - 1] = values[i];
+    }
+    add_cfg_edge(pre, header);
+    for (int i = 0; i < header->num_phis; i++) {
+        header->phis[i].args[header->num_preds - 1] = num_outside > 1 ? pre->phis[i].result : values[i];
+    }
+    free(values);
+    return pre;
+}
+
+int insert_preheaders(IRFunction *fn) {
+    compute_dominators(fn);
+    LoopForest *forest = find_loops(fn);
+    BasicBlock **created = (BasicBlock**) checked_calloc(forest->num_loops, sizeof(BasicBlock*));
+    BasicBlock **headers = (BasicBlock**) checked_calloc(forest->num_loops, sizeof(BasicBlock*));
+    int num_created = 0;
+    for (int i = 0; i < forest->num_loops; i++) {
+        Loop *loop = &forest->loops[i];
+        if (loop->preheader) continue;
+        BasicBlock *pre = create_preheader(fn, loop);
+        if (!pre) continue;
+        created[num_created] = pre;
+        headers[num_created++] = loop->header;
+    }
+    // New blocks were appended to keep the ids the loops refer to valid; now
+    // put each one just before its header, where the entering code usually
+    // falls through.
+    for (int i = 0; i < num_created; i++) {
+        move_basic_block(fn, created[i], headers[i]->id);
+    }
+    free(created);
+    free(headers);
+    free_loops(forest);
+    return num_created;
+}
@@ -0,0 +1,52 @@
+#ifndef LOOPS_H
+#define LOOPS_H
+
+#include "ir.h"
+#include "cfg.h"
+
+/*
+ * Natural loops of a CFG. An edge latch -> header is a back edge when the
+ * header dominates the latch; the loop is the header plus every block that
+ * reaches a latch without passing through the header. Back edges to the same
+ * header make up one loop.
+ *
+ * A preheader is a block outside the loop whose only successor is the
+ * header and which is the header's only predecessor from outside the loop.
+ * Code placed there runs once, before the loop is entered.
+ */
+
+typedef struct Loop {
+    BasicBlock *header;
+    BasicBlock *preheader;     // NULL if the loop has none (see insert_preheaders)
+    BasicBlock **blocks;       // Header first, then in no particular order
+    int num_blocks;
+    BasicBlock **latches;      // Sources of the back edges
+    int num_latches;
+    struct Loop *parent;       // Innermost enclosing loop, or NULL
+    int depth;                 // 1 for an outermost loop
+    const struct LoopForest *forest;
+} Loop;
+
+typedef struct LoopForest {
+    Loop *loops;               // Inner loops come before the loops enclosing them
+    int num_loops;
+    Loop **innermost;          // By block id: the innermost loop holding the block, or NULL
+    int num_block_ids;         // Blocks that existed when the loops were found
+} LoopForest;
+
+// Finds the natural loops of 'fn'. Needs compute_dominators().
+LoopForest* find_loops(IRFunction *fn);
+
+void free_loops(LoopForest *forest);
+
+// Returns 1 if the block belongs to the loop. Blocks created after the loops
+// were found belong to none.
+int loop_contains(const Loop *loop, const BasicBlock *block);
+
+// Gives every loop a preheader, creating an empty block in front of the
+// header where needed. Phis of the header are split so the new block merges
+// the values from outside the loop. Returns the number of blocks created;
+// dominators and loops must be recomputed afterwards.
+int insert_preheaders(IRFunction *fn);
+
+#endif // LOOPS_H
@@ -6,12 +6,22 @@
 #include "symbol_table.h" // Include our new symbol table header
 #include "semantics.h"    // Include our new semantics header
 #include "ir_generator.h" // Include our new IR generator header
+#include "cfg.h"          // Basic blocks and control-flow edges
+#include "frame.h"        // Stack frame layout of local aggregates
+#include "driver.h"       // Options, pipeline and output shared with c99-opt
+#include "vm.h"           // Bytecode virtual machine
+#include "x86_64.h"       // x86-64 assembly backend
+#include "jit.h"          // In-process compile and run
+#include "string_pool.h"  // Interned identifiers and literals
+#include "arena.h"        // Region allocator that owns the AST
 
 
 /* Function Prototypes */
-ASTNode* create_node(const char *node_type, const char *value, int num_children, ...);
+ASTNode* create_node(ASTNodeKind kind, const char *value, int num_children, ...);
+ASTNode* create_op_node(ASTNodeKind kind, ASTOperator op, int num_children, ...);
+void append_child(ASTNode *parent, ASTNode *child);
 void print_ast(ASTNode *node, int level);
-void free_ast(ASTNode *node);
+void free_ast();
 
 /* External declarations from the lexer */
 extern int yylex();
@@ -21,16 +31,19 @@ extern FILE* yyin;
 
 void yyerror(const char *s);
 
-/* Root of the AST */
+/* Root of the AST. Every node of the translation unit lives in ast_arena. */
 ASTNode *ast_root = NULL;
-int is_typedef_declaration = 0; // Flag to track typedef context
+Arena ast_arena;
+int parse_error_count = 0; // Syntax errors reported by yyerror
+int block_depth = 0; // Nesting depth of the compound statement being parsed; 0 at file scope
 
 %}
 
 /* Yacc/Bison Union for semantic values */
 %union {
-    char *str;
+    const char *str; /* Interned by the lexer */
     struct ASTNode *node;
+    int op;          /* ASTOperator */
 }
 
 /* Token Definitions */
@@ -78,7 +91,8 @@ int is_typedef_declaration = 0; // Flag to track typedef context
 %type <node> equality_expression relational_expression shift_expression
 %type <node> additive_expression multiplicative_expression cast_expression
 %type <node> unary_expression postfix_expression primary_expression argument_expression_list 
-%type <str> type_specifier unary_operator assignment_operator
+%type <str> type_specifier
+%type <op> unary_operator assignment_operator
 %type <node> init_declarator_list
 
 %nonassoc LOWER_THAN_ELSE
@@ -89,12 +103,10 @@ int is_typedef_declaration = 0; // Flag to track typedef context
 /* Grammar Rules */
 
 program
-    : external_declaration { $$ = create_node("Program", NULL, 1, $1); ast_root = $$; }
+    : external_declaration { $$ = create_node(AST_PROGRAM, NULL, 1, $1); ast_root = $$; }
     | program external_declaration {
         // Append the new external_declaration to the existing Program node's flat list of children.
-        $1->children = (ASTNode**) realloc($1->children, ($1->num_children + 1) * sizeof(ASTNode*));
-        $1->children[$1->num_children] = $2;
-        $1->num_children++;
+        append_child($1, $2);
         $$ = $1; // The root Program node remains the same.
       }
     ;
@@ -107,22 +119,21 @@ external_declaration
 function_definition
     : declaration_specifiers declarator compound_statement
       {
-        char* func_name = get_declarator_name($2);
+        const char* func_name = get_declarator_name($2);
         if (func_name) {
             Type* return_type = get_base_type_from_specifiers($1);
             ASTNode* params_node = get_function_parameters_node($2);
             Symbol* params_list = build_parameter_list_from_ast(params_node);
             Type* func_type = create_function_type(return_type, params_list);
             // Insert function into the *current* (likely global) scope
-            insert_symbol(func_name, func_type, SYM_FUNCTION);
+            declare_function(func_name, func_type);
             // The scope for the body will be handled during semantic analysis.
             if (params_list) {
                 // Parameters will also be added to the scope during semantic analysis.
                 
             }
-            free(func_name);
         }
-        $$ = create_node("FunctionDefinition", NULL, 3, $1, $2, $3);
+        $$ = create_node(AST_FUNCTION_DEFINITION, NULL, 3, $1, $2, $3);
       }
     ;
 
@@ -130,46 +141,19 @@ function_definition
 declaration
     : declaration_specifiers init_declarator_list ';'
       { 
-        //printf("DEBUG: Processing declaration.\n");
-        // This is now the central point for variable insertion.
-        // We have both the type specifiers ($1) and the list of declarators ($2).
-        Type* base_type = get_base_type_from_specifiers($1);
-        ASTNode* declarator_list = $2;
-        // The list is built backwards, so we traverse it to insert symbols.
-        //printf("DEBUG: Base type determined for declaration.\n");
-        while(declarator_list) {
-            ASTNode* declarator = declarator_list->children[0];
-            char* name = get_declarator_name(declarator);
-            //printf("DEBUG: Found declarator for '%s'.\n", name ? name : "unnamed");
-            if (name) {
-                 if (is_function_declarator(declarator)) {
-                    // It's a function declaration (prototype)
-                    ASTNode* params_node = get_function_parameters_node(declarator);
-                    Symbol* params_list = build_parameter_list_from_ast(params_node);
-                    Type* func_type = create_function_type(base_type, params_list);
-                    insert_symbol(name, func_type, SYM_FUNCTION);
-                    // The symbol table takes ownership of func_type, so we don't free it here.
-                } else {
-                    //printf("DEBUG: Inserting variable '%s' into symbol table.\n", name);
-                    // It's a variable, pointer, or array declaration.
-                    // Build the full type from the base and the declarator structure.
-                    Type* full_type = build_declarator_type(base_type, declarator);
-                    insert_symbol(name, full_type, is_typedef_declaration ? SYM_TYPENAME : SYM_VARIABLE);
-                    // The symbol table now owns the 'full_type' structure. 
-                    // We should not free it here. If base_type was copied inside
-                    // build_declarator_type, we might need to free the original base_type
-                    // after the loop, but since it's shared, we don't.
-                }
-                free(name);
-            }
-            if (declarator_list->num_children > 1) {
-                declarator_list = declarator_list->children[1];
-            } else {
-                break;
+        // File-scope names and typedef names are declared as soon as they are
+        // parsed; the lexer needs typedef names to tell them from identifiers.
+        // Block-scope variables are declared by check_semantics, inside the
+        // scope of their block.
+        int is_typedef = is_typedef_specifiers($1);
+        if (block_depth == 0 || is_typedef) {
+            Type* base_type = get_base_type_from_specifiers($1);
+            // Declarators that share one base type (int a, *b;) share its Type too.
+            for (ASTNode* list = $2; list; list = (list->num_children > 1) ? list->children[1] : NULL) {
+                declare_declarator(base_type, list->children[0], is_typedef ? SYM_TYPENAME : SYM_VARIABLE);
             }
         }
-        // Note: We don't free base_type here because multiple variables might share it.
-        $$ = create_node("Declaration", NULL, 2, $1, $2);
+        $$ = create_node(AST_DECLARATION, NULL, 2, $1, $2);
       }
     ;
 
@@ -178,14 +162,14 @@ declaration_specifiers
     : storage_class_specifier { $$ = $1; }
     | type_specifier_node { $$ = $1; }
     | type_qualifier { $$ = $1; }
-    | storage_class_specifier declaration_specifiers { is_typedef_declaration = 1; $$ = create_node("DeclarationSpecifiers", NULL, 2, $1, $2); }
-    | type_specifier_node declaration_specifiers { if (strcmp($1->node_type, "TypeName") != 0) is_typedef_declaration = 0; $$ = create_node("DeclarationSpecifiers", NULL, 2, $1, $2); }
-    | type_qualifier declaration_specifiers { $$ = create_node("DeclarationSpecifiers", NULL, 2, $1, $2); }
+    | storage_class_specifier declaration_specifiers { $$ = create_node(AST_DECLARATION_SPECIFIERS, NULL, 2, $1, $2); }
+    | type_specifier_node declaration_specifiers { $$ = create_node(AST_DECLARATION_SPECIFIERS, NULL, 2, $1, $2); }
+    | type_qualifier declaration_specifiers { $$ = create_node(AST_DECLARATION_SPECIFIERS, NULL, 2, $1, $2); }
     ;
  
 
 storage_class_specifier
-    : KEYWORD_TYPEDEF { $$ = create_node("StorageClassSpecifier", "typedef", 0); }
+    : KEYWORD_TYPEDEF { $$ = create_node(AST_STORAGE_CLASS_SPECIFIER, "typedef", 0); }
     ;
 
 
@@ -203,16 +187,16 @@ type_specifier
 
 
 type_specifier_node
-    : type_specifier { $$ = create_node("TypeSpecifier", $1, 0); }
-    | TYPENAME { $$ = create_node("TypeName", $1, 0); }
+    : type_specifier { $$ = create_node(AST_TYPE_SPECIFIER, $1, 0); }
+    | TYPENAME { $$ = create_node(AST_TYPE_NAME, $1, 0); }
     | struct_or_union_specifier { $$ = $1; }
     | enum_specifier { $$ = $1; }
     ;
 
 
 init_declarator_list
-    : init_declarator { $$ = create_node("InitDeclaratorList", NULL, 1, $1); }
-    | init_declarator_list ',' init_declarator { $$ = create_node("InitDeclaratorList", NULL, 2, $3, $1); }
+    : init_declarator { $$ = create_node(AST_INIT_DECLARATOR_LIST, NULL, 1, $1); }
+    | init_declarator_list ',' init_declarator { $$ = create_node(AST_INIT_DECLARATOR_LIST, NULL, 2, $3, $1); }
     ;
 
 init_declarator
@@ -220,46 +204,46 @@ init_declarator
         // Simply pass the declarator up. Insertion is handled in the 'declaration' rule.
         $$ = $1;
     }
-    | declarator '=' initializer { $$ = create_node("InitDeclarator", "=", 2, $1, $3); }
+    | declarator '=' initializer { $$ = create_node(AST_INIT_DECLARATOR, "=", 2, $1, $3); }
     ;
 
 
 declarator
-    : pointer direct_declarator { $$ = create_node("PointerDeclarator", NULL, 2, $1, $2); }
+    : pointer direct_declarator { $$ = create_node(AST_POINTER_DECLARATOR, NULL, 2, $1, $2); }
     | direct_declarator { $$ = $1; }
     ;
 
 
 type_name
-   : specifier_qualifier_list { $$ = create_node("TypeName", NULL, 1, $1); }
-    | specifier_qualifier_list abstract_declarator { $$ = create_node("TypeName", NULL, 2, $1, $2); }
+   : specifier_qualifier_list { $$ = create_node(AST_TYPE_NAME, NULL, 1, $1); }
+    | specifier_qualifier_list abstract_declarator { $$ = create_node(AST_TYPE_NAME, NULL, 2, $1, $2); }
     ;
 
 abstract_declarator
     : pointer { $$ = $1; }
     | direct_abstract_declarator { $$ = $1; }
-    | pointer direct_abstract_declarator { $$ = create_node("PointerAbstractDeclarator", NULL, 2, $1, $2); }
+    | pointer direct_abstract_declarator { $$ = create_node(AST_POINTER_ABSTRACT_DECLARATOR, NULL, 2, $1, $2); }
     ;
 
 
 direct_abstract_declarator
-    : '(' abstract_declarator ')' { $$ = create_node("ParenthesizedAbstractDeclarator", NULL, 1, $2); }
-    | direct_abstract_declarator '[' assignment_expression_opt ']' { $$ = create_node("AbstractArraySuffix", NULL, 2, $1, $3); }
-    | '[' assignment_expression_opt ']' { $$ = create_node("AbstractArraySuffix", NULL, 1, $2); } // Base case for array suffix
-    | direct_abstract_declarator '(' parameter_type_list_opt ')' { $$ = create_node("AbstractFunctionSuffix", NULL, 2, $1, $3); }
-    | '(' parameter_type_list_opt ')' { $$ = create_node("AbstractFunctionSuffix", NULL, 1, $2); } // Base case for function suffix
+    : '(' abstract_declarator ')' { $$ = create_node(AST_PARENTHESIZED_ABSTRACT_DECLARATOR, NULL, 1, $2); }
+    | direct_abstract_declarator '[' assignment_expression_opt ']' { $$ = create_node(AST_ABSTRACT_ARRAY_SUFFIX, NULL, 2, $1, $3); }
+    | '[' assignment_expression_opt ']' { $$ = create_node(AST_ABSTRACT_ARRAY_SUFFIX, NULL, 1, $2); } // Base case for array suffix
+    | direct_abstract_declarator '(' parameter_type_list_opt ')' { $$ = create_node(AST_ABSTRACT_FUNCTION_SUFFIX, NULL, 2, $1, $3); }
+    | '(' parameter_type_list_opt ')' { $$ = create_node(AST_ABSTRACT_FUNCTION_SUFFIX, NULL, 1, $2); } // Base case for function suffix
     ;
 
 
 assignment_expression_opt
     : assignment_expression { $$ = $1; }
-    | /* empty */ { $$ = create_node("EmptyExpression", NULL, 0); }
+    | /* empty */ { $$ = create_node(AST_EMPTY_EXPRESSION, NULL, 0); }
     ;
 
 
 parameter_type_list_opt
     : parameter_type_list { $$ = $1; }
-    | /* empty */ { $$ = create_node("EmptyParameterList", NULL, 0); }
+    | /* empty */ { $$ = create_node(AST_EMPTY_PARAMETER_LIST, NULL, 0); }
     ;
 
 
@@ -268,11 +252,11 @@ parameter_type_list_opt
  */
 unary_expression
     : postfix_expression { $$ = $1; }
-    | OP_INCREMENT unary_expression { $$ = create_node("PrefixIncrement", "++", 1, $2); }
-    | OP_DECREMENT unary_expression { $$ = create_node("PrefixDecrement", "--", 1, $2); }
-    | unary_operator cast_expression { $$ = create_node("UnaryOp", $1, 1, $2); }
-    | KEYWORD_SIZEOF unary_expression { $$ = create_node("SizeofUnaryExpr", NULL, 1, $2); }
-    | KEYWORD_SIZEOF '(' type_name ')' { $$ = create_node("SizeofTypeExpr", NULL, 1, $3); }
+    | OP_INCREMENT unary_expression { $$ = create_node(AST_PREFIX_INCREMENT, "++", 1, $2); }
+    | OP_DECREMENT unary_expression { $$ = create_node(AST_PREFIX_DECREMENT, "--", 1, $2); }
+    | unary_operator cast_expression { $$ = create_op_node(AST_UNARY_OP, $1, 1, $2); }
+    | KEYWORD_SIZEOF unary_expression { $$ = create_node(AST_SIZEOF_UNARY_EXPR, NULL, 1, $2); }
+    | KEYWORD_SIZEOF '(' type_name ')' { $$ = create_node(AST_SIZEOF_TYPE_EXPR, NULL, 1, $3); }
     ;
 
 /*
@@ -280,8 +264,8 @@ unary_expression
  */
 
 pointer
-    : '*' { $$ = create_node("Pointer", "*", 0); }
-    | '*' pointer { $$ = create_node("Pointer", "*", 1, $2); }
+    : '*' { $$ = create_node(AST_POINTER, "*", 0); }
+    | '*' pointer { $$ = create_node(AST_POINTER, "*", 1, $2); }
     ;
 
 
@@ -302,7 +286,7 @@ struct_or_union_specifier
                 }
                 //printf("DEBUG: Found forward declaration for '%s'. Completing it.\n", type_name);
             } else { // No previous declaration found, create a new type.
-                struct_type = create_aggregate_type(($1->value[0] == 's') ? TYPE_STRUCT : TYPE_UNION, type_name);
+                struct_type = create_aggregate_type(($1->kind == AST_STRUCT_TOKEN) ? TYPE_STRUCT : TYPE_UNION, type_name);
                 insert_symbol(type_name, struct_type, SYM_TYPENAME);
                 //printf("DEBUG: Created new aggregate type for '%s'.\n", type_name);
             }
@@ -311,17 +295,17 @@ struct_or_union_specifier
             calculate_struct_layout(struct_type, $4);
             //printf("DEBUG: Calculated layout for '%s'. Size: %d\n", type_name, struct_type->size);
 
-            $$ = create_node("StructSpecifier", $2, 1, $1); 
+            $$ = create_node(AST_STRUCT_SPECIFIER, $2, 1, $1); 
             $$->type = struct_type; // Attach the type to the node.
         }
     | struct_or_union '{' struct_declaration_list '}'
         { 
             //printf("DEBUG: Parsing anonymous struct/union definition.\n");
             // Anonymous struct/union definition. Always create a new type.
-            Type* struct_type = create_aggregate_type(($1->value[0] == 's') ? TYPE_STRUCT : TYPE_UNION, "anonymous");
+            Type* struct_type = create_aggregate_type(($1->kind == AST_STRUCT_TOKEN) ? TYPE_STRUCT : TYPE_UNION, "anonymous");
             calculate_struct_layout(struct_type, $3);
             //printf("DEBUG: Calculated layout for anonymous struct. Size: %d\n", struct_type->size);
-            $$ = create_node("StructSpecifier", "anonymous", 1, $1); 
+            $$ = create_node(AST_STRUCT_SPECIFIER, "anonymous", 1, $1); 
             $$->type = struct_type;
             //printf("DEBUG: Anonymous struct node created and type attached.\n");
         }
@@ -334,45 +318,45 @@ struct_or_union_specifier
             //printf("DEBUG: Parsing usage of struct/union: %s\n", type_name);
             Type* struct_type = NULL;
             if (!sym) { // Not found, so this is a forward declaration.
-                struct_type = create_aggregate_type(($1->value[0] == 's') ? TYPE_STRUCT : TYPE_UNION, type_name);
+                struct_type = create_aggregate_type(($1->kind == AST_STRUCT_TOKEN) ? TYPE_STRUCT : TYPE_UNION, type_name);
                 insert_symbol(type_name, struct_type, SYM_TYPENAME);
                 // printf("DEBUG: Forward-declaring struct/union '%s'.\n", type_name);
             } else {
                 struct_type = sym->type;
                 // printf("DEBUG: Found existing struct/union type for '%s'.\n", type_name);
             }
-            $$ = create_node("StructSpecifier", $2, 1, $1); 
+            $$ = create_node(AST_STRUCT_SPECIFIER, $2, 1, $1); 
             $$->type = struct_type; // Attach the (possibly incomplete) type.
         }
     ;
 
 
 struct_or_union
-    : KEYWORD_STRUCT { $$ = create_node("StructToken", "struct", 0); }
-    | KEYWORD_UNION  { $$ = create_node("UnionToken", "union", 0); }
+    : KEYWORD_STRUCT { $$ = create_node(AST_STRUCT_TOKEN, "struct", 0); }
+    | KEYWORD_UNION  { $$ = create_node(AST_UNION_TOKEN, "union", 0); }
     ;
 
 
 struct_declaration_list
-    : struct_declaration { $$ = create_node("StructDeclarationList", NULL, 1, $1); }
-    | struct_declaration_list struct_declaration { $$ = create_node("StructDeclarationList", NULL, 2, $1, $2); }
+    : struct_declaration { $$ = create_node(AST_STRUCT_DECLARATION_LIST, NULL, 1, $1); }
+    | struct_declaration_list struct_declaration { $$ = create_node(AST_STRUCT_DECLARATION_LIST, NULL, 2, $1, $2); }
     ;
 
 struct_declaration
-    : specifier_qualifier_list struct_declarator_list ';' { $$ = create_node("StructDeclaration", NULL, 2, $1, $2); }
+    : specifier_qualifier_list struct_declarator_list ';' { $$ = create_node(AST_STRUCT_DECLARATION, NULL, 2, $1, $2); }
     ;
 
 specifier_qualifier_list
-    : type_specifier_node { $$ = create_node("SpecifierQualifierList", NULL, 1, $1); }
-    | type_qualifier { $$ = create_node("SpecifierQualifierList", NULL, 1, $1); }
-    | type_specifier_node specifier_qualifier_list { $$ = create_node("SpecifierQualifierList", NULL, 2, $1, $2); }
-    | type_qualifier specifier_qualifier_list { $$ = create_node("SpecifierQualifierList", NULL, 2, $1, $2); }
+    : type_specifier_node { $$ = create_node(AST_SPECIFIER_QUALIFIER_LIST, NULL, 1, $1); }
+    | type_qualifier { $$ = create_node(AST_SPECIFIER_QUALIFIER_LIST, NULL, 1, $1); }
+    | type_specifier_node specifier_qualifier_list { $$ = create_node(AST_SPECIFIER_QUALIFIER_LIST, NULL, 2, $1, $2); }
+    | type_qualifier specifier_qualifier_list { $$ = create_node(AST_SPECIFIER_QUALIFIER_LIST, NULL, 2, $1, $2); }
     ;
 
 
 struct_declarator_list
-    : struct_declarator { $$ = create_node("StructDeclaratorList", NULL, 1, $1); }
-    | struct_declarator_list ',' struct_declarator { $$ = create_node("StructDeclaratorList", NULL, 2, $1, $3); }
+    : struct_declarator { $$ = create_node(AST_STRUCT_DECLARATOR_LIST, NULL, 1, $1); }
+    | struct_declarator_list ',' struct_declarator { $$ = create_node(AST_STRUCT_DECLARATOR_LIST, NULL, 2, $1, $3); }
     ;
 
 struct_declarator
@@ -381,47 +365,47 @@ struct_declarator
 
 
 type_qualifier
-    : KEYWORD_CONST { $$ = create_node("TypeQualifier", "const", 0); }
-    | KEYWORD_VOLATILE { $$ = create_node("TypeQualifier", "volatile", 0); }
-    | KEYWORD_RESTRICT { $$ = create_node("TypeQualifier", "restrict", 0); }
+    : KEYWORD_CONST { $$ = create_node(AST_TYPE_QUALIFIER, "const", 0); }
+    | KEYWORD_VOLATILE { $$ = create_node(AST_TYPE_QUALIFIER, "volatile", 0); }
+    | KEYWORD_RESTRICT { $$ = create_node(AST_TYPE_QUALIFIER, "restrict", 0); }
     ;
 
 enum_specifier
-    : KEYWORD_ENUM IDENTIFIER '{' enumerator_list '}' { $$ = create_node("EnumSpecifier", $2, 1, $4); }
-    | KEYWORD_ENUM '{' enumerator_list '}' { $$ = create_node("EnumSpecifier", "anonymous", 1, $3); }
-    | KEYWORD_ENUM IDENTIFIER '{' enumerator_list ',' '}' { $$ = create_node("EnumSpecifier", $2, 1, $4); }
-    | KEYWORD_ENUM '{' enumerator_list ',' '}' { $$ = create_node("EnumSpecifier", "anonymous", 1, $3); }
-    | KEYWORD_ENUM IDENTIFIER { $$ = create_node("EnumSpecifier", $2, 0); }
+    : KEYWORD_ENUM IDENTIFIER '{' enumerator_list '}' { $$ = create_node(AST_ENUM_SPECIFIER, $2, 1, $4); }
+    | KEYWORD_ENUM '{' enumerator_list '}' { $$ = create_node(AST_ENUM_SPECIFIER, "anonymous", 1, $3); }
+    | KEYWORD_ENUM IDENTIFIER '{' enumerator_list ',' '}' { $$ = create_node(AST_ENUM_SPECIFIER, $2, 1, $4); }
+    | KEYWORD_ENUM '{' enumerator_list ',' '}' { $$ = create_node(AST_ENUM_SPECIFIER, "anonymous", 1, $3); }
+    | KEYWORD_ENUM IDENTIFIER { $$ = create_node(AST_ENUM_SPECIFIER, $2, 0); }
     ;
 
 enumerator_list
-    : enumerator { $$ = create_node("EnumeratorList", NULL, 1, $1); }
-    | enumerator_list ',' enumerator { $$ = create_node("EnumeratorList", NULL, 2, $1, $3); }
+    : enumerator { $$ = create_node(AST_ENUMERATOR_LIST, NULL, 1, $1); }
+    | enumerator_list ',' enumerator { $$ = create_node(AST_ENUMERATOR_LIST, NULL, 2, $1, $3); }
     ;
 
 enumerator
-    : IDENTIFIER { $$ = create_node("Enumerator", $1, 0); }
-    | IDENTIFIER '=' conditional_expression { $$ = create_node("Enumerator", $1, 1, $3); }
+    : IDENTIFIER { $$ = create_node(AST_ENUMERATOR, $1, 0); }
+    | IDENTIFIER '=' conditional_expression { $$ = create_node(AST_ENUMERATOR, $1, 1, $3); }
     ;
 
 initializer
     : assignment_expression { $$ = $1; }
-    | '{' initializer_list '}' { $$ = create_node("InitializerList", NULL, 1, $2); }
+    | '{' initializer_list '}' { $$ = create_node(AST_INITIALIZER_LIST, NULL, 1, $2); }
     ;
 
 
 initializer_list
-    : assignment_expression { $$ = create_node("InitValues", NULL, 1, $1); }
-    | initializer_list ',' assignment_expression { $$ = create_node("InitValues", NULL, 2, $1, $3); }
+    : assignment_expression { $$ = create_node(AST_INIT_VALUES, NULL, 1, $1); }
+    | initializer_list ',' assignment_expression { $$ = create_node(AST_INIT_VALUES, NULL, 2, $1, $3); }
     ;
 
 direct_declarator
-    : IDENTIFIER { $$ = create_node("Identifier", $1, 0); }
+    : IDENTIFIER { $$ = create_node(AST_IDENTIFIER, $1, 0); }
     | '(' declarator ')' { $$ = $2; }
-    | direct_declarator '(' parameter_type_list ')' { $$ = create_node("FunctionDeclarator", NULL, 2, $1, $3); }
-    | direct_declarator '(' ')' { $$ = create_node("FunctionDeclarator", "()", 1, $1); }
-    | direct_declarator '[' assignment_expression ']' { $$ = create_node("ArrayDeclarator", NULL, 2, $1, $3); }
-    | direct_declarator '[' ']' { $$ = create_node("ArrayDeclarator", "unspecified_size", 1, $1); }
+    | direct_declarator '(' parameter_type_list ')' { $$ = create_node(AST_FUNCTION_DECLARATOR, NULL, 2, $1, $3); }
+    | direct_declarator '(' ')' { $$ = create_node(AST_FUNCTION_DECLARATOR, "()", 1, $1); }
+    | direct_declarator '[' assignment_expression ']' { $$ = create_node(AST_ARRAY_DECLARATOR, NULL, 2, $1, $3); }
+    | direct_declarator '[' ']' { $$ = create_node(AST_ARRAY_DECLARATOR, "unspecified_size", 1, $1); }
     ;
 
 
@@ -432,31 +416,35 @@ parameter_type_list
 
 parameter_list
     : parameter_declaration { $$ = $1; }
-    | parameter_list ',' parameter_declaration { $$ = create_node("ParameterList", NULL, 2, $1, $3); }
+    | parameter_list ',' parameter_declaration { $$ = create_node(AST_PARAMETER_LIST, NULL, 2, $1, $3); }
     ;
  
 parameter_declaration
-    : declaration_specifiers declarator { $$ = create_node("ParameterDeclaration", NULL, 2, $1, $2); }
-    | declaration_specifiers { $$ = create_node("ParameterDeclaration", NULL, 1, $1); } /* For void */
+    : declaration_specifiers declarator { $$ = create_node(AST_PARAMETER_DECLARATION, NULL, 2, $1, $2); }
+    | declaration_specifiers { $$ = create_node(AST_PARAMETER_DECLARATION, NULL, 1, $1); } /* For void */
     ;
 
 compound_statement
-    : '{' '}' { 
-        $$ = create_node("CompoundStatement", "{}", 0); 
+    : block_open '}' { 
+        block_depth--;
+        $$ = create_node(AST_COMPOUND_STATEMENT, "{}", 0); 
       }
-    | '{' block_item_list '}' { 
-        $$ = create_node("CompoundStatement", NULL, 1, $2); 
+    | block_open block_item_list '}' { 
+        block_depth--;
+        $$ = create_node(AST_COMPOUND_STATEMENT, NULL, 1, $2); 
       }
     ;
 
+block_open
+    : '{' { block_depth++; }
+    ;
+
 
 block_item_list
-    : block_item { $$ = create_node("BlockItemList", NULL, 1, $1); }
+    : block_item { $$ = create_node(AST_BLOCK_ITEM_LIST, NULL, 1, $1); }
     | block_item_list block_item {
         // Append the new block_item to the existing flat list
-        $1->children = (ASTNode**) realloc($1->children, ($1->num_children + 1) * sizeof(ASTNode*));
-        $1->children[$1->num_children] = $2;
-        $1->num_children++;
+        append_child($1, $2);
         $$ = $1;
       }
     ;
@@ -476,59 +464,59 @@ statement
     ;
 
 expression_statement
-    : ';' { $$ = create_node("EmptyStatement", ";", 0); }
-    | expression ';' { $$ = create_node("ExpressionStatement", NULL, 1, $1); }
+    : ';' { $$ = create_node(AST_EMPTY_STATEMENT, ";", 0); }
+    | expression ';' { $$ = create_node(AST_EXPRESSION_STATEMENT, NULL, 1, $1); }
     ;
 
 expression_opt
     : expression { $$ = $1; }
-    | /* empty */ { $$ = create_node("EmptyExpression", NULL, 0); }
+    | /* empty */ { $$ = create_node(AST_EMPTY_EXPRESSION, NULL, 0); }
     ;
 
 
 iteration_statement
-    : KEYWORD_WHILE '(' expression ')' statement { $$ = create_node("WhileStatement", NULL, 2, $3, $5); }
-    | KEYWORD_DO statement KEYWORD_WHILE '(' expression ')' ';' { $$ = create_node("DoWhileStatement", NULL, 2, $2, $5); }
-    | KEYWORD_FOR '(' expression_opt ';' expression_opt ';' expression_opt ')' statement { $$ = create_node("ForStatement", NULL, 4, $3, $5, $7, $9); }
-    | KEYWORD_FOR '(' declaration expression_opt ';' expression_opt ')' statement { $$ = create_node("ForDeclStatement", NULL, 4, $3, $4, $6, $8); }
+    : KEYWORD_WHILE '(' expression ')' statement { $$ = create_node(AST_WHILE_STATEMENT, NULL, 2, $3, $5); }
+    | KEYWORD_DO statement KEYWORD_WHILE '(' expression ')' ';' { $$ = create_node(AST_DO_WHILE_STATEMENT, NULL, 2, $2, $5); }
+    | KEYWORD_FOR '(' expression_opt ';' expression_opt ';' expression_opt ')' statement { $$ = create_node(AST_FOR_STATEMENT, NULL, 4, $3, $5, $7, $9); }
+    | KEYWORD_FOR '(' declaration expression_opt ';' expression_opt ')' statement { $$ = create_node(AST_FOR_DECL_STATEMENT, NULL, 4, $3, $4, $6, $8); }
     | error statement { yyerror("Invalid iteration statement"); $$ = $2; }
     ;
 
 selection_statement
-    : KEYWORD_IF '(' expression ')' statement %prec LOWER_THAN_ELSE { $$ = create_node("IfStatement", NULL, 2, $3, $5); }
-    | KEYWORD_IF '(' expression ')' statement KEYWORD_ELSE statement { $$ = create_node("IfElseStatement", NULL, 3, $3, $5, $7); }
-    | KEYWORD_SWITCH '(' expression ')' statement { $$ = create_node("SwitchStatement", NULL, 2, $3, $5); }
+    : KEYWORD_IF '(' expression ')' statement %prec LOWER_THAN_ELSE { $$ = create_node(AST_IF_STATEMENT, NULL, 2, $3, $5); }
+    | KEYWORD_IF '(' expression ')' statement KEYWORD_ELSE statement { $$ = create_node(AST_IF_ELSE_STATEMENT, NULL, 3, $3, $5, $7); }
+    | KEYWORD_SWITCH '(' expression ')' statement { $$ = create_node(AST_SWITCH_STATEMENT, NULL, 2, $3, $5); }
     ;
 
 
 
 labeled_statement
-    : IDENTIFIER ':' statement { $$ = create_node("LabeledStatement", $1, 1, $3); }
-    | KEYWORD_CASE conditional_expression ':' statement { $$ = create_node("CaseStatement", NULL, 2, $2, $4); }
-    | KEYWORD_DEFAULT ':' statement { $$ = create_node("DefaultStatement", NULL, 1, $3); }
+    : IDENTIFIER ':' statement { $$ = create_node(AST_LABELED_STATEMENT, $1, 1, $3); }
+    | KEYWORD_CASE conditional_expression ':' statement { $$ = create_node(AST_CASE_STATEMENT, NULL, 2, $2, $4); }
+    | KEYWORD_DEFAULT ':' statement { $$ = create_node(AST_DEFAULT_STATEMENT, NULL, 1, $3); }
     ;
 
 jump_statement
-    : KEYWORD_RETURN ';' { $$ = create_node("Return", NULL, 0); }
-    | KEYWORD_RETURN expression ';' { $$ = create_node("Return", NULL, 1, $2); }
-    | KEYWORD_BREAK ';' { $$ = create_node("BreakStatement", NULL, 0); }
-    | KEYWORD_CONTINUE ';' { $$ = create_node("ContinueStatement", NULL, 0); }
+    : KEYWORD_RETURN ';' { $$ = create_node(AST_RETURN, NULL, 0); }
+    | KEYWORD_RETURN expression ';' { $$ = create_node(AST_RETURN, NULL, 1, $2); }
+    | KEYWORD_BREAK ';' { $$ = create_node(AST_BREAK_STATEMENT, NULL, 0); }
+    | KEYWORD_CONTINUE ';' { $$ = create_node(AST_CONTINUE_STATEMENT, NULL, 0); }
     ;
 
 expression
     : assignment_expression { $$ = $1; }
-    | expression ',' assignment_expression { $$ = create_node("BinaryOp", ",", 2, $1, $3); }
+    | expression ',' assignment_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_COMMA, 2, $1, $3); }
     ;
 
 assignment_expression
     : conditional_expression { $$ = $1; }
-    | unary_expression assignment_operator assignment_expression { $$ = create_node("Assignment",NULL, 2, $1,$3); }
+    | unary_expression assignment_operator assignment_expression { $$ = create_op_node(AST_ASSIGNMENT, $2, 2, $1, $3); }
     ;
 
 
 assignment_operator
-    : '=' { $$ = "="; } | OP_MUL_ASSIGN { $$ = "*="; } | OP_DIV_ASSIGN { $$ = "/="; }
-    | OP_MOD_ASSIGN { $$ = "%="; } | OP_ADD_ASSIGN { $$ = "+="; } | OP_SUB_ASSIGN { $$ = "-="; }
+    : '=' { $$ = AST_OP_ASSIGN; } | OP_MUL_ASSIGN { $$ = AST_OP_MUL_ASSIGN; } | OP_DIV_ASSIGN { $$ = AST_OP_DIV_ASSIGN; }
+    | OP_MOD_ASSIGN { $$ = AST_OP_MOD_ASSIGN; } | OP_ADD_ASSIGN { $$ = AST_OP_ADD_ASSIGN; } | OP_SUB_ASSIGN { $$ = AST_OP_SUB_ASSIGN; }
     ;
 
 conditional_expression
@@ -538,64 +526,64 @@ conditional_expression
 
 logical_or_expression
     : logical_and_expression { $$ = $1; }
-    | logical_or_expression OP_OR logical_and_expression { $$ = create_node("BinaryOp", "||", 2, $1, $3); }
+    | logical_or_expression OP_OR logical_and_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_LOGICAL_OR, 2, $1, $3); }
     ;
 
 
 logical_and_expression
     : inclusive_or_expression { $$ = $1; }
-    | logical_and_expression OP_AND inclusive_or_expression { $$ = create_node("BinaryOp", "&&", 2, $1, $3); }
+    | logical_and_expression OP_AND inclusive_or_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_LOGICAL_AND, 2, $1, $3); }
     ;
 
 
 inclusive_or_expression
     : exclusive_or_expression { $$ = $1; }
-    | inclusive_or_expression '|' exclusive_or_expression { $$ = create_node("BinaryOp", "|", 2, $1, $3); }
+    | inclusive_or_expression '|' exclusive_or_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_BIT_OR, 2, $1, $3); }
     ;
 
 exclusive_or_expression
     : and_expression { $$ = $1; }
-    | exclusive_or_expression '^' and_expression { $$ = create_node("BinaryOp", "^", 2, $1, $3); }
+    | exclusive_or_expression '^' and_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_XOR, 2, $1, $3); }
     ;
 
 and_expression
     : equality_expression { $$ = $1; }
-    | and_expression '&' equality_expression { $$ = create_node("BinaryOp", "&", 2, $1, $3); }
+    | and_expression '&' equality_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_BIT_AND, 2, $1, $3); }
     ;
 
 equality_expression
     : relational_expression { $$ = $1; }
-    | equality_expression OP_EQ relational_expression { $$ = create_node("BinaryOp", "==", 2, $1, $3); }
-    | equality_expression OP_NE relational_expression { $$ = create_node("BinaryOp", "!=", 2, $1, $3); }
+    | equality_expression OP_EQ relational_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_EQ, 2, $1, $3); }
+    | equality_expression OP_NE relational_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_NE, 2, $1, $3); }
     ;
 
 
 relational_expression
     : shift_expression { $$ = $1; }
-    | relational_expression '<' shift_expression { $$ = create_node("BinaryOp", "<", 2, $1, $3); }
-    | relational_expression '>' shift_expression { $$ = create_node("BinaryOp", ">", 2, $1, $3); }
-    | relational_expression OP_LE shift_expression { $$ = create_node("BinaryOp", "<=", 2, $1, $3); }
-    | relational_expression OP_GE shift_expression { $$ = create_node("BinaryOp", ">=", 2, $1, $3); }
+    | relational_expression '<' shift_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_LT, 2, $1, $3); }
+    | relational_expression '>' shift_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_GT, 2, $1, $3); }
+    | relational_expression OP_LE shift_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_LE, 2, $1, $3); }
+    | relational_expression OP_GE shift_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_GE, 2, $1, $3); }
     ;
 
 
 shift_expression
     : additive_expression { $$ = $1; }
-    | shift_expression OP_SHIFT_LEFT additive_expression { $$ = create_node("BinaryOp", "<<", 2, $1, $3); }
-    | shift_expression OP_SHIFT_RIGHT additive_expression { $$ = create_node("BinaryOp", ">>", 2, $1, $3); }
+    | shift_expression OP_SHIFT_LEFT additive_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_SHL, 2, $1, $3); }
+    | shift_expression OP_SHIFT_RIGHT additive_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_SHR, 2, $1, $3); }
     ;
 
 additive_expression
     : multiplicative_expression { $$ = $1; }
-    | additive_expression '+' multiplicative_expression { $$ = create_node("BinaryOp", "+", 2, $1, $3); }
-    | additive_expression '-' multiplicative_expression { $$ = create_node("BinaryOp", "-", 2, $1, $3); }
+    | additive_expression '+' multiplicative_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_ADD, 2, $1, $3); }
+    | additive_expression '-' multiplicative_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_SUB, 2, $1, $3); }
     ;
 
 multiplicative_expression
     : cast_expression { $$ = $1; }
-    | multiplicative_expression '*' cast_expression { $$ = create_node("BinaryOp", "*", 2, $1, $3); }
-    | multiplicative_expression '/' cast_expression { $$ = create_node("BinaryOp", "/", 2, $1, $3); }
-    | multiplicative_expression '%' cast_expression { $$ = create_node("BinaryOp", "%", 2, $1, $3); }
+    | multiplicative_expression '*' cast_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_MUL, 2, $1, $3); }
+    | multiplicative_expression '/' cast_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_DIV, 2, $1, $3); }
+    | multiplicative_expression '%' cast_expression { $$ = create_op_node(AST_BINARY_OP, AST_OP_MOD, 2, $1, $3); }
     ;
 
 
@@ -604,32 +592,33 @@ cast_expression
     ;
 
 unary_operator
-    : '&' { $$ = "&"; } | '*' { $$ = "*"; } | '+' { $$ = "+"; } | '-' { $$ = "-"; } | '~' { $$ = "~"; } | '!' { $$ = "!"; }
+    : '&' { $$ = AST_OP_ADDR; } | '*' { $$ = AST_OP_DEREF; } | '+' { $$ = AST_OP_PLUS; }
+    | '-' { $$ = AST_OP_NEG; } | '~' { $$ = AST_OP_BIT_NOT; } | '!' { $$ = AST_OP_LOGICAL_NOT; }
     ;
 
 postfix_expression
-    : postfix_expression '(' ')' { $$ = create_node("FunctionCall", NULL, 1, $1); }
-    | postfix_expression '(' argument_expression_list ')' { $$ = create_node("FunctionCall", NULL, 2, $1, $3); }
-    | postfix_expression OP_INCREMENT { $$ = create_node("PostfixIncrement", "++", 1, $1); }
-    | postfix_expression OP_DECREMENT { $$ = create_node("PostfixDecrement", "--", 1, $1); }
-    | postfix_expression '[' expression ']' { $$ = create_node("ArrayAccess", NULL, 2, $1, $3); }
-    | postfix_expression '.' IDENTIFIER { $$ = create_node("MemberAccess", $3, 1, $1); }
-    | postfix_expression OP_ARROW IDENTIFIER { $$ = create_node("PointerMemberAccess", $3, 1, $1); }
+    : postfix_expression '(' ')' { $$ = create_node(AST_FUNCTION_CALL, NULL, 1, $1); }
+    | postfix_expression '(' argument_expression_list ')' { $$ = create_node(AST_FUNCTION_CALL, NULL, 2, $1, $3); }
+    | postfix_expression OP_INCREMENT { $$ = create_node(AST_POSTFIX_INCREMENT, "++", 1, $1); }
+    | postfix_expression OP_DECREMENT { $$ = create_node(AST_POSTFIX_DECREMENT, "--", 1, $1); }
+    | postfix_expression '[' expression ']' { $$ = create_node(AST_ARRAY_ACCESS, NULL, 2, $1, $3); }
+    | postfix_expression '.' IDENTIFIER { $$ = create_node(AST_MEMBER_ACCESS, $3, 1, $1); }
+    | postfix_expression OP_ARROW IDENTIFIER { $$ = create_node(AST_POINTER_MEMBER_ACCESS, $3, 1, $1); }
     | primary_expression { $$ = $1; }
     ;
 
 
 argument_expression_list
     : assignment_expression { $$ = $1; }
-    | argument_expression_list ',' assignment_expression { $$ = create_node("ArgumentList", NULL, 2, $1, $3); }
+    | argument_expression_list ',' assignment_expression { $$ = create_node(AST_ARGUMENT_LIST, NULL, 2, $1, $3); }
     ;
 
 primary_expression
-    : IDENTIFIER { $$ = create_node("Identifier", $1, 0); }
-    | INT_CONST { $$ = create_node("IntConstant", $1, 0); }
-    | FLOAT_CONST { $$ = create_node("FloatConstant", $1, 0); }
-    | CHAR_CONST { $$ = create_node("CharConstant", $1, 0); }
-    | STRING_LITERAL { $$ = create_node("StringLiteral", $1, 0); }
+    : IDENTIFIER { $$ = create_node(AST_IDENTIFIER, $1, 0); }
+    | INT_CONST { $$ = create_node(AST_INT_CONSTANT, $1, 0); }
+    | FLOAT_CONST { $$ = create_node(AST_FLOAT_CONSTANT, $1, 0); }
+    | CHAR_CONST { $$ = create_node(AST_CHAR_CONSTANT, $1, 0); }
+    | STRING_LITERAL { $$ = create_node(AST_STRING_LITERAL, $1, 0); }
     | '(' expression ')' { $$ = $2; }
     ;
 
@@ -638,34 +627,65 @@ primary_expression
 /* C Code Section */
 #include <stdarg.h>
 
-ASTNode* create_node(const char *node_type, const char *value, int num_children, ...) {
-    ASTNode *node = (ASTNode*) malloc(sizeof(ASTNode));
-    if (!node) {
-        yyerror("Out of memory");
-        exit(1);
-    }
-    node->node_type = strdup(node_type);
-    node->value = value ? strdup(value) : NULL;
+static ASTNode* alloc_node(ASTNodeKind kind, ASTOperator op, const char *value, int num_children, va_list ap) {
+    // The node and its children array are carved out of the AST arena in one
+    // piece, so a node's child pointers sit right behind it in memory.
+    ASTNode *node = (ASTNode*) arena_alloc(&ast_arena, sizeof(ASTNode) + num_children * sizeof(ASTNode*));
+    node->kind = kind;
+    node->op = op;
+    node->value = value ? intern_string(value) : NULL;
+    node->type = NULL;
+    node->ir_label = -1;
     node->num_children = num_children;
+    node->children_capacity = num_children;
     if (num_children > 0) {
-        node->children = NULL; // Initialize to NULL
-        node->children = (ASTNode**) malloc(num_children * sizeof(ASTNode*));
-        va_list ap;
-        va_start(ap, num_children);
+        node->children = (ASTNode**) (node + 1);
         for (int i = 0; i < num_children; i++) {
             node->children[i] = va_arg(ap, ASTNode*);
         }
-        va_end(ap);
     } else {
         node->children = NULL;
     }
     return node;
 }
 
+ASTNode* create_node(ASTNodeKind kind, const char *value, int num_children, ...) {
+    va_list ap;
+    va_start(ap, num_children);
+    ASTNode *node = alloc_node(kind, AST_OP_NONE, value, num_children, ap);
+    va_end(ap);
+    return node;
+}
+
+// Creates a BinaryOp, UnaryOp or Assignment node. The operator's symbol is
+// kept as the node's value for printing.
+ASTNode* create_op_node(ASTNodeKind kind, ASTOperator op, int num_children, ...) {
+    va_list ap;
+    va_start(ap, num_children);
+    ASTNode *node = alloc_node(kind, op, ast_operator_symbols[op], num_children, ap);
+    va_end(ap);
+    return node;
+}
+
+// Appends a child to a list node (Program, BlockItemList), doubling the
+// children array inside the arena when it is full.
+void append_child(ASTNode *parent, ASTNode *child) {
+    if (parent->num_children == parent->children_capacity) {
+        int new_capacity = parent->children_capacity ? parent->children_capacity * 2 : 4;
+        ASTNode **children = (ASTNode**) arena_alloc(&ast_arena, new_capacity * sizeof(ASTNode*));
+        if (parent->num_children > 0) {
+            memcpy(children, parent->children, parent->num_children * sizeof(ASTNode*));
+        }
+        parent->children = children;
+        parent->children_capacity = new_capacity;
+    }
+    parent->children[parent->num_children++] = child;
+}
+
 void print_ast(ASTNode *node, int level) {
     if (!node) return;
     for (int i = 0; i < level; i++) printf("  ");
-    printf("%s", node->node_type);
+    printf("%s", ast_kind_names[node->kind]);
     if (node->value) {
         if(node->type)
             printf(" (%s,%s)", node->value, node->type->data.base_name);
@@ -679,28 +699,113 @@ void print_ast(ASTNode *node, int level) {
     }
 }
 
-void free_ast(ASTNode *node) {
-    if (!node) return;
-    for (int i = 0; i < node->num_children; i++) {
-        free_ast(node->children[i]);
-    }
-    // If the node has a type that was created just for it (e.g., for constants), free it.
-    if (node->type && (strcmp(node->node_type, "IntConstant") == 0 || strcmp(node->node_type, "FloatConstant") == 0 || strcmp(node->node_type, "CharConstant") == 0)) {
-        free_type(node->type);
-    }
-    free(node->node_type);
-    if (node->value) free(node->value);
-    if (node->children) free(node->children);
-    free(node);
+// Releases the whole AST at once. Types are owned by the symbol table, and
+// values are interned and owned by the string pool.
+void free_ast() {
+    arena_free(&ast_arena);
+    ast_root = NULL;
 }
 
 void yyerror(const char *s) {
+    parse_error_count++;
     fprintf(stderr, "Parse error on line %d near '%s': %s\n", line_count, yytext, s);
 }
 
+// Generates, optimizes and writes the IR of the checked AST, then runs it as
+// the options ask. Returns the process status.
+static int generate_and_run(DriverOptions *options, const char *asm_file, int vm_runs, int run) {
+    int status = 0;
+    printf("\n--- Generating 3-Address Code ---\n");
+    Generate_IR(ast_root); // Generate IR
+    printf("--- 3-Address Code Generated ---\n");
+    printf("\n--- Control-Flow Graphs ---\n");
+    for (int i = 0; i < ir_module.num_functions; i++) {
+        build_cfg(&ir_module.functions[i]);
+        print_cfg(stdout, &ir_module.functions[i]);
+        linearize_cfg(&ir_module.functions[i]);
+    }
+    printf("---------------------------\n");
+    optimize_module(&ir_module);
+    printf("--- Stack Frames ---\n");
+    for (int i = 0; i < ir_module.num_functions; i++) {
+        print_stack_frame(stdout, &ir_module.functions[i]);
+    }
+    printf("--------------------\n\n");
+    if (options->num_registers > 0) allocate_module_registers(&ir_module, options->num_registers);
+    if (write_module(&ir_module, options) != 0) status = 1;
+    if (asm_file) {
+        FILE *asm_out = fopen(asm_file, "w");
+        if (asm_out) {
+            int errors = emit_x86_64(asm_out, &ir_module);
+            fclose(asm_out);
+            if (errors > 0) {
+                remove(asm_file);
+                status = 1;
+            } else {
+                printf("--- x86-64 Assembly Generated to %s ---\n", asm_file);
+            }
+        } else {
+            perror("Could not open assembly output file");
+            status = 1;
+        }
+    }
+    if (vm_runs > 0) {
+        VMProgram *program = vm_load(&ir_module);
+        for (int run = 1; program && run <= vm_runs; run++) {
+            VMRunStats stats;
+            printf("\n--- VM run %d ---\n", run);
+            fflush(stdout);
+            if (vm_run(program, &stats) != 0) status = 1;
+            printf("--- VM run %d: exit status %d, %lld instructions retired, %.3f ms ---\n",
+                   run, stats.exit_status, stats.retired, stats.seconds * 1000.0);
+        }
+        if (!program) status = 1;
+        vm_free(program);
+    }
+    if (run) {
+        // The program's exit status becomes the compiler's, unless an
+        // earlier step has already failed.
+        int exit_status = 0;
+        printf("\n--- Running main ---\n");
+        fflush(stdout);
+        if (jit_run(&ir_module, &exit_status) != 0) {
+            status = 1;
+        } else {
+            printf("--- main exited with status %d ---\n", exit_status);
+            if (status == 0) status = exit_status;
+        }
+    }
+    free_ir_module(); // Free the IR
+    return status;
+}
+
 int main(int argc, char **argv) {
-    if (argc < 3) {
-        fprintf(stderr, "Usage: %s <sourcefile.c> <destinationfile.3ac>\n", argv[0]);
+    DriverOptions options = { NULL, NULL, 0 };
+    int vm_runs = 0;       // Times to run the program in the virtual machine
+    const char *asm_file = NULL;
+    int run = 0;           // Compile and run in this process
+    int status = 0;
+    if (driver_list_passes(argc, argv)) return 0;
+    for (int i = 2; i < argc; i++) {
+        int parsed = parse_driver_option(argv[i], &options);
+        if (parsed < 0) return 1;
+        if (parsed > 0) continue;
+        if (strncmp(argv[i], "--asm=", 6) == 0) {
+            asm_file = argv[i] + 6;
+        } else if (strcmp(argv[i], "--vm") == 0) {
+            vm_runs = 1;
+        } else if (strncmp(argv[i], "--vm=", 5) == 0) {
+            vm_runs = atoi(argv[i] + 5);
+        } else if (strcmp(argv[i], "--run") == 0) {
+            run = 1;
+        } else {
+            fprintf(stderr, "Unknown option '%s'.\n", argv[i]);
+            return 1;
+        }
+    }
+    if (argc < 2 || (!options.destination && !run)) {
+        fprintf(stderr, "Usage: %s <sourcefile.c> <destinationfile.3ac> [-O<level>] [--passes=a,b,...] [--inline-budget=N] [--registers=K] [--vm[=N]] [--asm=file.s] [--binary=file.3acb] [--list-passes]\n", argv[0]);
+        fprintf(stderr, "       %s <sourcefile.c> --run [options]\n", argv[0]);
         return 1;
     }
 
@@ -724,24 +829,22 @@ int main(int argc, char **argv) {
         printf("--- Semantic Analysis Complete ---\n\n");
         print_ast(ast_root, 0);
         printf("----------------------------\n");
-        printf("\n--- Generating 3-Address Code ---\n");
-        Generate_IR(ast_root); // Generate IR
-        printf("--- 3-Address Code Generated ---\n");
-        printf("\n--- Performing Peephole Optimization ---\n");
-        main_ir_head = optimize_ir(main_ir_head);
-        other_funcs_ir_head = optimize_ir(other_funcs_ir_head);
-        printf("--- Optimization Complete ---\n\n");
-
-        print_ir_to_file(argv[2]); // Save IR to file
-        printf("--- 3-Address Code Generated to %s ---\n", argv[2]);
-        printf("---------------------------\n");
-        //free_ir_lists(); // Free the IR lists
-        //free_ast(ast_root);
+        int errors = parse_error_count + semantic_error_count;
+        if (errors > 0) {
+            // The IR generator relies on a well-formed program, and a broken
+            // program must not run.
+            fprintf(stderr, "%d error%s; no code generated.\n", errors, errors == 1 ? "" : "s");
+            status = 1;
+        } else {
+            status = generate_and_run(&options, asm_file, vm_runs, run);
+        }
+        free_ast();
     } else {
         printf("Parsing failed, no AST generated.\n");
     }
     print_symbol_table(); // Print symbol table contents
     cleanup_symbol_table(); // Free all remaining symbols and types
+    free_string_pool(); // Free all interned names and literals
 
-    return 0;
+    return status;
 }
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "passes.h"
+#include "cfg.h"
+#include "ssa.h"
+
+/* --- Pass registry --- */
+
+static const IRPass all_passes[] = {
+    { "peephole", "Rewrite short instruction sequences using declarative patterns", IR_FORM_LINEAR, run_peephole },
+    { "ssa",      "Put functions in SSA form and report the phis placed", IR_FORM_SSA, count_phis },
+    { "sccp",     "Sparse conditional constant propagation and branch folding", IR_FORM_SSA, run_sccp },
+    { "lvn",      "Local value numbering: reuse expressions within a block", IR_FORM_SSA, run_lvn },
+    { "gvn",      "Dominator-based global value numbering", IR_FORM_SSA, run_gvn },
+    { "dce",      "Delete instructions whose results are never used", IR_FORM_SSA, run_dce },
+    { "simplify-cfg", "Delete unreachable blocks, bypass empty ones and merge straight-line blocks", IR_FORM_CFG, run_simplify_cfg },
+    { "licm",     "Hoist loop-invariant computations into loop preheaders", IR_FORM_SSA, run_licm },
+    { "loop-reduce", "Replace multiplications of induction variables with running sums", IR_FORM_SSA, run_strength_reduction },
+    { "copy-prop", "Replace copied temporaries by their source and delete the copies", IR_FORM_SSA, run_copy_propagation },
+    { "sroa",     "Split local aggregates accessed only at constant offsets into scalars", IR_FORM_LINEAR, run_sroa },
+    { "inline",   "Copy small non-recursive functions into their callers", IR_FORM_LINEAR, NULL, run_inliner },
+    { "coalesce", "Merge copy-related temporaries and reuse temporaries that are never live together", IR_FORM_NON_SSA, run_coalesce },
+};
+
+#define NUM_PASSES ((int) (sizeof(all_passes) / sizeof(all_passes[0])))
+
+// Default pipelines, indexed by optimization level.
+static const char *const level_pipelines[] = {
+    "",         // -O0
+    "sroa,peephole", // -O1
+    "inline,sroa,sccp,gvn,licm,loop-reduce,copy-prop,dce,simplify-cfg,coalesce,peephole", // -O2
+};
+
+#define MAX_LEVEL ((int) (sizeof(level_pipelines) / sizeof(level_pipelines[0])) - 1)
+
+static const IRPass *pipeline[MAX_PIPELINE_PASSES];
+static int pipeline_length = 0;
+static int pipeline_selected = 0;
+
+const IRPass* find_ir_pass(const char *name) {
+    for (int i = 0; i < NUM_PASSES; i++) {
+        if (strcmp(all_passes[i].name, name) == 0) {
+            return &all_passes[i];
+        }
+    }
+    return NULL;
+}
+
+void list_ir_passes(FILE *fp) {
+    for (int i = 0; i < NUM_PASSES; i++) {
+        fprintf(fp, "  %-14s %s\n", all_passes[i].name, all_passes[i].description);
+    }
+}
+
+int set_pass_pipeline(const char *spec) {
+    pipeline_length = 0;
+    pipeline_selected = 1;
+    const char *p = spec;
+    while (*p) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t) (end - p) : strlen(p);
+        if (len > 0) {
+            char name[64];
+            if (len >= sizeof(name)) len = sizeof(name) - 1;
+            memcpy(name, p, len);
+            name[len] = '\0';
+            const IRPass *pass = find_ir_pass(name);
+            if (!pass) {
+                fprintf(stderr, "Error: Unknown IR pass '%s'.\n", name);
+                return 0;
+            }
+            if (pipeline_length == MAX_PIPELINE_PASSES) {
+                fprintf(stderr, "Error: Too many IR passes in pipeline.\n");
+                return 0;
+            }
+            pipeline[pipeline_length++] = pass;
+        }
+        if (!end) break;
+        p = end + 1;
+    }
+    return 1;
+}
+
+void set_optimization_level(int level) {
+    if (level < 0) level = 0;
+    if (level > MAX_LEVEL) level = MAX_LEVEL;
+    set_pass_pipeline(level_pipelines[level]);
+}
+
+// Gives a function the representation a pass works on.
+static void convert_ir_form(IRFunction *fn, IRForm form) {
+    if (fn->in_ssa && (form == IR_FORM_LINEAR || form == IR_FORM_NON_SSA)) {
+        destroy_ssa(fn);
+    }
+    if (form == IR_FORM_LINEAR) {
+        linearize_cfg(fn);
+    } else if (form == IR_FORM_SSA) {
+        build_ssa(fn);
+    } else if (!fn->blocks) {
+        build_cfg(fn);
+    }
+}
+
+void run_pass_pipeline(IRModule *module) {
+    if (!pipeline_selected) {
+        set_optimization_level(1);
+    }
+    for (int p = 0; p < pipeline_length; p++) {
+        const IRPass *pass = pipeline[p];
+        int changes = 0;
+        // Index -1 stands for the global initializers.
+        for (int i = -1; i < module->num_functions; i++) {
+            IRFunction *fn = i < 0 ? &module->globals : &module->functions[i];
+            convert_ir_form(fn, pass->form);
+            if (pass->run) changes += pass->run(fn);
+        }
+        if (pass->run_module) changes += pass->run_module(module);
+        printf("Pass %-14s %d changes\n", pass->name, changes);
+    }
+    convert_ir_form(&module->globals, IR_FORM_LINEAR);
+    for (int i = 0; i < module->num_functions; i++) {
+        convert_ir_form(&module->functions[i], IR_FORM_LINEAR);
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef PASSES_H
+#define PASSES_H
+
+#include <stdio.h>
+#include "ir.h"
+
+/*
+ * The IR pass manager. Every optimization is an IRPass that runs over one
+ * IRFunction at a time. A pipeline is an ordered list of passes, chosen by
+ * optimization level (-O0, -O1, ...) or spelled out with --passes=a,b,c.
+ *
+ * Each pass declares the form of the IR it works on, and the manager builds
+ * or tears down the CFG and SSA form between passes as required.
+ */
+
+typedef enum {
+    IR_FORM_LINEAR, // fn->instrs
+    IR_FORM_CFG,    // fn->blocks, in SSA form or not: the pass keeps phis intact
+    IR_FORM_SSA,    // fn->blocks in SSA form (see ssa.h)
+    IR_FORM_NON_SSA // fn->blocks, with SSA form destroyed
+} IRForm;
+
+typedef struct {
+    const char *name;
+    const char *description;
+    IRForm form;                 // The representation the pass works on
+    int (*run)(IRFunction *fn);  // Returns the number of changes made
+    int (*run_module)(IRModule *module); // Instead of 'run', for passes across functions
+} IRPass;
+
+#define MAX_PIPELINE_PASSES 32
+
+// Selects the default pipeline for an optimization level (0 disables all passes).
+void set_optimization_level(int level);
+
+// Selects an explicit comma-separated pipeline. Returns 0 and reports the
+// offending name if a pass does not exist.
+int set_pass_pipeline(const char *spec);
+
+// Runs the selected pipeline over every function of the module.
+void run_pass_pipeline(IRModule *module);
+
+// Returns the registered pass with this name, or NULL.
+const IRPass* find_ir_pass(const char *name);
+
+// Prints every registered pass with its description.
+void list_ir_passes(FILE *fp);
+
+// Sets the size, in instructions, up to which the inliner copies a callee
+// into its callers (0 disables inlining).
+void set_inline_budget(int budget);
+
+/* --- Passes (one entry point per pass, registered in passes.c) --- */
+
+// peephole.c: worklist-driven rewriting of short instruction sequences
+int run_peephole(IRFunction *fn);
+
+// sccp.c: sparse conditional constant propagation (needs SSA form)
+int run_sccp(IRFunction *fn);
+
+// gvn.c: value numbering within blocks (lvn) or over the dominator tree (gvn)
+int run_lvn(IRFunction *fn);
+int run_gvn(IRFunction *fn);
+
+// dce.c: mark-and-sweep dead-code elimination (needs SSA form)
+int run_dce(IRFunction *fn);
+
+// simplify_cfg.c: unreachable and empty block removal, block merging
+int run_simplify_cfg(IRFunction *fn);
+
+// loop_opts.c: loop-invariant code motion and induction-variable strength
+// reduction (need SSA form)
+int run_licm(IRFunction *fn);
+int run_strength_reduction(IRFunction *fn);
+
+// coalesce.c: copy propagation (needs SSA form), and copy coalescing with
+// reuse of temporaries (needs SSA form destroyed)
+int run_copy_propagation(IRFunction *fn);
+int run_coalesce(IRFunction *fn);
+
+// sroa.c: scalar replacement of local aggregates
+int run_sroa(IRFunction *fn);
+
+// inline.c: copies small non-recursive callees into their callers, bottom-up
+// over the call graph (see callgraph.h)
+int run_inliner(IRModule *module);
+
+#endif // PASSES_H
@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "passes.h"
+#include "alloc.h"
+
+/*
+ * Peephole optimizer. Patterns are data: a short sequence of instruction
+ * templates to match and the instructions to put in their place. Pattern
+ * variables V(n) bind to an operand on first use and must be equal on every
+ * later use, K(k) matches the integer constant k, NIL matches an absent
+ * operand and ANY matches anything. Before the patterns, an operation on
+ * constants is folded into a copy of its value, which other passes can
+ * leave behind (the scaling of a constant array index, say).
+ *
+ * The engine keeps a worklist of instructions. Each rewrite either removes an
+ * instruction or turns one into a simpler one (an ASSIGN or an unconditional
+ * jump) that no pattern turns back, and only requeues a bounded number of
+ * neighbours, so the pass reaches its fixed point in linear time.
+ * To add a pattern, append an entry to the table below.
+ */
+
+#define MAX_PATTERN 4 // Longest pattern, in instructions
+#define MAX_VARS    8 // Pattern variables V(0) .. V(7)
+
+typedef enum { M_ANY, M_NIL, M_VAR, M_INT } OperandMatchKind;
+
+typedef struct {
+    OperandMatchKind kind;
+    int n; // Variable number for M_VAR, value for M_INT
+} OperandMatch;
+
+#define ANY  { M_ANY, 0 }
+#define NIL  { M_NIL, 0 }
+#define V(n) { M_VAR, (n) }
+#define K(k) { M_INT, (k) }
+
+#define OPC_DEF (-1) // Matches any opcode that writes its result
+
+typedef struct {
+    int opcode; // An OpCode, or OPC_DEF
+    OperandMatch result, arg1, arg2;
+} PatternInstr;
+
+typedef struct {
+    int copy;   // Index of a matched instruction to copy, or -1 for a new one
+    int opcode; // Opcode of a new instruction
+    // Operands of a new instruction. For a copy, a V(n) result replaces the copied result.
+    OperandMatch result, arg1, arg2;
+} PatternOutput;
+
+typedef struct {
+    const char *name;
+    int length;
+    PatternInstr match[MAX_PATTERN];
+    unsigned local_temps; // Variables that must be temporaries read only inside the match
+    int num_outputs;
+    PatternOutput output[MAX_PATTERN];
+} PeepholePattern;
+
+#define LOCAL(n)        (1u << (n))
+#define COPY(k)         { (k), 0, ANY, ANY, ANY }
+#define COPY_AS(k, res) { (k), 0, res, ANY, ANY }
+#define NEW(op, r, a, b) { -1, (op), r, a, b }
+
+static const PeepholePattern patterns[] = {
+    // A load whose value is never used, right before a store to the same place:
+    //   INDEX_LOAD t, b, o ; INDEX_STORE b, o, v  =>  INDEX_STORE b, o, v
+    { "dead-load-before-store", 2,
+      { { IR_INDEX_LOAD, V(0), V(1), V(2) }, { IR_INDEX_STORE, V(1), V(2), V(3) } },
+      LOCAL(0), 1, { COPY(1) } },
+
+    // The discarded element load of an array assignment a[i] = v:
+    //   MUL t0, i, s ; INDEX_LOAD t1, a, t0 ; MUL t2, i, s ; INDEX_STORE a, t2, v
+    //   =>  MUL t2, i, s ; INDEX_STORE a, t2, v
+    { "dead-element-load", 4,
+      { { IR_MUL, V(0), V(1), V(2) }, { IR_INDEX_LOAD, V(3), V(4), V(0) },
+        { IR_MUL, V(5), V(1), V(2) }, { IR_INDEX_STORE, V(4), V(5), V(6) } },
+      LOCAL(0) | LOCAL(3), 2, { COPY(2), COPY(3) } },
+
+    // Compute straight into the destination of a copy:
+    //   op t, a, b ; ASSIGN x, t  =>  op x, a, b
+    { "forward-into-assign", 2,
+      { { OPC_DEF, V(0), ANY, ANY }, { IR_ASSIGN, V(1), V(0), NIL } },
+      LOCAL(0), 1, { COPY_AS(0, V(1)) } },
+
+    // Conditional jumps on a constant condition.
+    { "jumpf-false", 1, { { IR_IF_FALSE_GOTO, V(0), K(0), NIL } }, 0, 1, { NEW(IR_GOTO, V(0), NIL, NIL) } },
+    { "jumpt-true",  1, { { IR_IF_TRUE_GOTO, V(0), K(1), NIL } }, 0, 1, { NEW(IR_GOTO, V(0), NIL, NIL) } },
+    { "jumpf-true",  1, { { IR_IF_FALSE_GOTO, ANY, K(1), NIL } }, 0, 0 },
+    { "jumpt-false", 1, { { IR_IF_TRUE_GOTO, ANY, K(0), NIL } }, 0, 0 },
+
+    // A jump to the label right after it.
+    { "jump-to-next", 2,
+      { { IR_GOTO, V(0), NIL, NIL }, { IR_LABEL, V(0), NIL, NIL } },
+      0, 1, { COPY(1) } },
+
+    // Algebraic identities.
+    { "add-zero",  1, { { IR_ADD, V(0), V(1), K(0) } }, 0, 1, { NEW(IR_ASSIGN, V(0), V(1), NIL) } },
+    { "zero-add",  1, { { IR_ADD, V(0), K(0), V(1) } }, 0, 1, { NEW(IR_ASSIGN, V(0), V(1), NIL) } },
+    { "sub-zero",  1, { { IR_SUB, V(0), V(1), K(0) } }, 0, 1, { NEW(IR_ASSIGN, V(0), V(1), NIL) } },
+    { "mul-one",   1, { { IR_MUL, V(0), V(1), K(1) } }, 0, 1, { NEW(IR_ASSIGN, V(0), V(1), NIL) } },
+    { "one-mul",   1, { { IR_MUL, V(0), K(1), V(1) } }, 0, 1, { NEW(IR_ASSIGN, V(0), V(1), NIL) } },
+    { "mul-zero",  1, { { IR_MUL, V(0), V(1), K(0) } }, 0, 1, { NEW(IR_ASSIGN, V(0), K(0), NIL) } },
+    { "zero-mul",  1, { { IR_MUL, V(0), K(0), V(1) } }, 0, 1, { NEW(IR_ASSIGN, V(0), K(0), NIL) } },
+    { "div-one",   1, { { IR_DIV, V(0), V(1), K(1) } }, 0, 1, { NEW(IR_ASSIGN, V(0), V(1), NIL) } },
+    { "shl-zero",  1, { { IR_SHL, V(0), V(1), K(0) } }, 0, 1, { NEW(IR_ASSIGN, V(0), V(1), NIL) } },
+    { "shr-zero",  1, { { IR_SHR, V(0), V(1), K(0) } }, 0, 1, { NEW(IR_ASSIGN, V(0), V(1), NIL) } },
+    { "or-zero",   1, { { IR_BIT_OR, V(0), V(1), K(0) } }, 0, 1, { NEW(IR_ASSIGN, V(0), V(1), NIL) } },
+    { "xor-zero",  1, { { IR_XOR, V(0), V(1), K(0) } }, 0, 1, { NEW(IR_ASSIGN, V(0), V(1), NIL) } },
+};
+
+#define NUM_PATTERNS ((int) (sizeof(patterns) / sizeof(patterns[0])))
+
+typedef struct {
+    Instruction *instrs;
+    int num_instrs;
+    int *next, *prev; // Live instructions in order; -1 at either end
+    char *dead;
+    int *uses;        // Number of reads of each temporary
+    int *def;         // Instruction defining each temporary, or -1
+    int *worklist;
+    int worklist_size;
+    char *queued;
+} Peephole;
+
+static void push(Peephole *ph, int index) {
+    if (index < 0 || ph->dead[index] || ph->queued[index]) return;
+    ph->queued[index] = 1;
+    ph->worklist[ph->worklist_size++] = index;
+}
+
+// Queues an instruction and the ones a pattern anchored before it could cover.
+static void push_with_predecessors(Peephole *ph, int index) {
+    for (int k = 0; k < MAX_PATTERN && index >= 0; k++) {
+        push(ph, index);
+        index = ph->prev[index];
+    }
+}
+
+static void count_reads(Peephole *ph, const Instruction *instr, int delta) {
+    const Operand *reads[3];
+    int n = 0;
+    if (ir_reads_result(instr->opcode)) reads[n++] = &instr->result;
+    reads[n++] = &instr->arg1;
+    reads[n++] = &instr->arg2;
+    for (int i = 0; i < n; i++) {
+        if (reads[i]->type != OP_TEMPORARY) continue;
+        int temp = reads[i]->val.temp;
+        ph->uses[temp] += delta;
+        // One fewer read may let a pattern fire at the definition.
+        if (delta < 0 && ph->def[temp] >= 0) {
+            push_with_predecessors(ph, ph->def[temp]);
+        }
+    }
+}
+
+static int match_operand(const OperandMatch *m, Operand op, Operand *vars, unsigned *bound) {
+    switch (m->kind) {
+        case M_ANY:
+            return 1;
+        case M_NIL:
+            return op.type == OP_NONE;
+        case M_INT:
+            return op.type == OP_INT_CONST && op.val.int_val == m->n;
+        case M_VAR:
+            if (op.type == OP_NONE) return 0;
+            if (*bound & (1u << m->n)) {
+                return are_operands_equal(vars[m->n], op);
+            }
+            vars[m->n] = op;
+            *bound |= 1u << m->n;
+            return 1;
+    }
+    return 0;
+}
+
+// Number of times the pattern reads variable n.
+static int pattern_reads(const PeepholePattern *pat, int n) {
+    int reads = 0;
+    for (int k = 0; k < pat->length; k++) {
+        const PatternInstr *p = &pat->match[k];
+        if (p->opcode != OPC_DEF && ir_reads_result((OpCode) p->opcode) &&
+            p->result.kind == M_VAR && p->result.n == n) reads++;
+        if (p->arg1.kind == M_VAR && p->arg1.n == n) reads++;
+        if (p->arg2.kind == M_VAR && p->arg2.n == n) reads++;
+    }
+    return reads;
+}
+
+static int match_pattern(Peephole *ph, const PeepholePattern *pat, int start, int *matched, Operand *vars) {
+    unsigned bound = 0;
+    int index = start;
+    for (int k = 0; k < pat->length; k++) {
+        if (index < 0) return 0;
+        const PatternInstr *p = &pat->match[k];
+        Instruction *instr = &ph->instrs[index];
+        if (p->opcode == OPC_DEF ? !ir_defines_result(instr->opcode) : (int) instr->opcode != p->opcode) {
+            return 0;
+        }
+        if (!match_operand(&p->result, instr->result, vars, &bound) ||
+            !match_operand(&p->arg1, instr->arg1, vars, &bound) ||
+            !match_operand(&p->arg2, instr->arg2, vars, &bound)) {
+            return 0;
+        }
+        matched[k] = index;
+        index = ph->next[index];
+    }
+    for (int n = 0; n < MAX_VARS; n++) {
+        if (!(pat->local_temps & (1u << n))) continue;
+        if (vars[n].type != OP_TEMPORARY || ph->uses[vars[n].val.temp] != pattern_reads(pat, n)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Replaces an operation on constants by an ASSIGN of its value.
+static int fold_instruction(Peephole *ph, int index) {
+    Instruction *instr = &ph->instrs[index];
+    Operand value;
+    if (instr->opcode == IR_ASSIGN || !ir_defines_result(instr->opcode) ||
+        !fold_constant_operation(instr->opcode, instr->arg1, instr->arg2, &value)) {
+        return 0;
+    }
+    instr->opcode = IR_ASSIGN;
+    instr->arg1 = value;
+    instr->arg2 = create_operand_none();
+    push(ph, index); // The copy may start a pattern, e.g. forward-into-assign
+    return 1;
+}
+
+static Operand instantiate(const OperandMatch *m, const Operand *vars) {
+    switch (m->kind) {
+        case M_VAR: return vars[m->n];
+        case M_INT: return create_operand_int(m->n);
+        default:    return create_operand_none();
+    }
+}
+
+static void apply_pattern(Peephole *ph, const PeepholePattern *pat, const int *matched, const Operand *vars) {
+    Instruction out[MAX_PATTERN];
+    for (int o = 0; o < pat->num_outputs; o++) {
+        const PatternOutput *po = &pat->output[o];
+        if (po->copy >= 0) {
+            out[o] = ph->instrs[matched[po->copy]];
+            if (po->result.kind == M_VAR) {
+                out[o].result = vars[po->result.n];
+            }
+        } else {
+            out[o].opcode = (OpCode) po->opcode;
+            out[o].result = instantiate(&po->result, vars);
+            out[o].arg1 = instantiate(&po->arg1, vars);
+            out[o].arg2 = instantiate(&po->arg2, vars);
+        }
+    }
+
+    for (int k = 0; k < pat->length; k++) {
+        Instruction *old = &ph->instrs[matched[k]];
+        if (ir_defines_result(old->opcode) && old->result.type == OP_TEMPORARY &&
+            ph->def[old->result.val.temp] == matched[k]) {
+            ph->def[old->result.val.temp] = -1;
+        }
+    }
+    for (int k = 0; k < pat->length; k++) {
+        count_reads(ph, &ph->instrs[matched[k]], -1);
+    }
+
+    // Outputs reuse the first slots of the match, so the order is preserved.
+    for (int o = 0; o < pat->num_outputs; o++) {
+        int slot = matched[o];
+        ph->instrs[slot] = out[o];
+        count_reads(ph, &out[o], +1);
+        if (ir_defines_result(out[o].opcode) && out[o].result.type == OP_TEMPORARY) {
+            ph->def[out[o].result.val.temp] = slot;
+        }
+    }
+    for (int k = pat->num_outputs; k < pat->length; k++) {
+        int slot = matched[k];
+        ph->dead[slot] = 1;
+        if (ph->prev[slot] >= 0) ph->next[ph->prev[slot]] = ph->next[slot];
+        if (ph->next[slot] >= 0) ph->prev[ph->next[slot]] = ph->prev[slot];
+    }
+
+    for (int o = 0; o < pat->num_outputs; o++) {
+        push(ph, matched[o]);
+    }
+    int before = ph->prev[matched[0]];
+    if (!ph->dead[matched[0]]) {
+        before = matched[0];
+    }
+    push_with_predecessors(ph, before);
+}
+
+int run_peephole(IRFunction *fn) {
+    int n = fn->num_instrs;
+    if (n == 0) return 0;
+
+    Peephole ph;
+    ph.instrs = fn->instrs;
+    ph.num_instrs = n;
+    ph.next = (int*) checked_calloc(n, sizeof(int));
+    ph.prev = (int*) checked_calloc(n, sizeof(int));
+    ph.dead = (char*) checked_calloc(n, sizeof(char));
+    ph.queued = (char*) checked_calloc(n, sizeof(char));
+    ph.worklist = (int*) checked_calloc(n, sizeof(int));
+    ph.worklist_size = 0;
+    ph.uses = (int*) checked_calloc(ir_module.num_temps, sizeof(int));
+    ph.def = (int*) checked_calloc(ir_module.num_temps, sizeof(int));
+    memset(ph.def, -1, (ir_module.num_temps ? ir_module.num_temps : 1) * sizeof(int));
+
+    for (int i = 0; i < n; i++) {
+        ph.next[i] = (i + 1 < n) ? i + 1 : -1;
+        ph.prev[i] = i - 1;
+        Instruction *instr = &fn->instrs[i];
+        if (ir_defines_result(instr->opcode) && instr->result.type == OP_TEMPORARY) {
+            ph.def[instr->result.val.temp] = i;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        count_reads(&ph, &fn->instrs[i], +1);
+    }
+    // Seed in reverse so instructions are popped in program order.
+    for (int i = n - 1; i >= 0; i--) {
+        push(&ph, i);
+    }
+
+    int rewrites = 0;
+    int matched[MAX_PATTERN];
+    Operand vars[MAX_VARS];
+    while (ph.worklist_size > 0) {
+        int index = ph.worklist[--ph.worklist_size];
+        ph.queued[index] = 0;
+        if (ph.dead[index]) continue;
+        if (fold_instruction(&ph, index)) {
+            rewrites++;
+            continue;
+        }
+        for (int p = 0; p < NUM_PATTERNS; p++) {
+            if (match_pattern(&ph, &patterns[p], index, matched, vars)) {
+                apply_pattern(&ph, &patterns[p], matched, vars);
+                rewrites++;
+                break;
+            }
+        }
+    }
+
+    // Rewrites never move instructions, so dropping the dead ones keeps the order.
+    int out = 0;
+    for (int i = 0; i < n; i++) {
+        if (!ph.dead[i]) fn->instrs[out++] = fn->instrs[i];
+    }
+    fn->num_instrs = out;
+
+    free(ph.next);
+    free(ph.prev);
+    free(ph.dead);
+    free(ph.queued);
+    free(ph.worklist);
+    free(ph.uses);
+    free(ph.def);
+    return rewrites;
+}
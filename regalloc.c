@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "regalloc.h"
+#include "liveness.h"
+#include "cfg.h"
+#include "frame.h"
+#include "alloc.h"
+
+typedef struct {
+    int temp;       // Dense number (see liveness.h)
+    int start;      // Positions: instruction k reads at 2k and writes at 2k+1
+    int end;
+    int reg;        // Register, or -1 if spilled
+    int slot;       // Frame offset of the spill slot
+} LiveInterval;
+
+static void extend_interval(LiveInterval *interval, int position) {
+    if (position < interval->start) interval->start = position;
+    if (position > interval->end) interval->end = position;
+}
+
+static int compare_starts(const void *a, const void *b) {
+    const LiveInterval *x = (const LiveInterval*) a, *y = (const LiveInterval*) b;
+    if (x->start != y->start) return x->start < y->start ? -1 : 1;
+    return x->temp - y->temp;
+}
+
+// One interval per temporary, over the blocks in layout order. Every block
+// also takes a position of its own so that empty blocks have a place.
+static LiveInterval* build_intervals(IRFunction *fn, const Liveness *lv) {
+    LiveInterval *intervals = (LiveInterval*) checked_calloc(lv->num_temps, sizeof(LiveInterval));
+    for (int t = 0; t < lv->num_temps; t++) {
+        intervals[t].temp = t;
+        intervals[t].start = INT_MAX;
+        intervals[t].end = -1;
+        intervals[t].reg = -1;
+    }
+    int *live = (int*) checked_calloc(lv->num_temps, sizeof(int));
+    int position = 0;
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        int block_start = 2 * position++;
+        for (int i = 0; i < block->num_instrs; i++) {
+            const Instruction *instr = &block->instrs[i];
+            Operand uses[3];
+            int num_uses = instruction_uses(instr, uses);
+            for (int u = 0; u < num_uses; u++) {
+                int t = liveness_index(lv, uses[u]);
+                if (t >= 0) extend_interval(&intervals[t], 2 * position);
+            }
+            int t = ir_defines_result(instr->opcode) ? liveness_index(lv, instr->result) : -1;
+            if (t >= 0) extend_interval(&intervals[t], 2 * position + 1);
+            position++;
+        }
+        int block_end = 2 * (position - 1) + 1;
+        int count = live_in_temps(lv, b, live);
+        for (int k = 0; k < count; k++) extend_interval(&intervals[live[k]], block_start);
+        count = live_out_temps(lv, b, live);
+        for (int k = 0; k < count; k++) extend_interval(&intervals[live[k]], block_end);
+    }
+    free(live);
+    return intervals;
+}
+
+// Assigns registers 0 .. num_registers-1 to the intervals (sorted by start),
+// spilling the interval that ends last whenever none is free.
+static void linear_scan(LiveInterval *intervals, int num_intervals, int num_registers) {
+    LiveInterval **active = (LiveInterval**) checked_calloc(num_registers, sizeof(LiveInterval*)); // By end
+    char *in_use = (char*) checked_calloc(num_registers, sizeof(char));
+    int num_active = 0;
+    for (int i = 0; i < num_intervals; i++) {
+        LiveInterval *current = &intervals[i];
+        if (current->end < 0) continue;
+        int expired = 0;
+        while (expired < num_active && active[expired]->end < current->start) {
+            in_use[active[expired]->reg] = 0;
+            expired++;
+        }
+        if (expired > 0) {
+            memmove(active, active + expired, (num_active - expired) * sizeof(LiveInterval*));
+            num_active -= expired;
+        }
+        if (num_active == num_registers) {
+            LiveInterval *last = active[num_active - 1];
+            if (last->end <= current->end) continue; // current stays spilled
+            current->reg = last->reg;
+            last->reg = -1;
+            num_active--;
+        } else {
+            int reg = 0;
+            while (in_use[reg]) reg++;
+            in_use[reg] = 1;
+            current->reg = reg;
+        }
+        int k = num_active++;
+        while (k > 0 && active[k - 1]->end > current->end) {
+            active[k] = active[k - 1];
+            k--;
+        }
+        active[k] = current;
+    }
+    free(active);
+    free(in_use);
+}
+
+typedef struct {
+    const Liveness *lv;
+    const LiveInterval *interval_of;  // By dense temporary number
+    int first_scratch;
+    BasicBlock *block;                // Block being rewritten
+    int reloaded[SCRATCH_REGISTERS];  // Dense temporaries in the scratch registers
+    int num_reloaded;
+} Rewriter;
+
+// Replaces a temporary the instruction reads, reloading it if spilled.
+static Operand rewrite_use(Rewriter *rw, Operand op) {
+    int t = liveness_index(rw->lv, op);
+    if (t < 0) return op;
+    const LiveInterval *interval = &rw->interval_of[t];
+    if (interval->reg >= 0) return create_operand_register(interval->reg);
+    for (int k = 0; k < rw->num_reloaded; k++) {
+        if (rw->reloaded[k] == t) return create_operand_register(rw->first_scratch + k);
+    }
+    int k = rw->num_reloaded++;
+    rw->reloaded[k] = t;
+    Operand scratch = create_operand_register(rw->first_scratch + k);
+    Instruction reload = { IR_RELOAD, scratch, create_operand_int(interval->slot), create_operand_none() };
+    block_append(rw->block, reload);
+    return scratch;
+}
+
+static void rewrite_block(Rewriter *rw, BasicBlock *block) {
+    Instruction *old = block->instrs;
+    int count = block->num_instrs;
+    block->instrs = NULL;
+    block->num_instrs = block->capacity = 0;
+    rw->block = block;
+    for (int i = 0; i < count; i++) {
+        Instruction instr = old[i];
+        rw->num_reloaded = 0;
+        instr.arg1 = rewrite_use(rw, instr.arg1);
+        instr.arg2 = rewrite_use(rw, instr.arg2);
+        const LiveInterval *spilled = NULL;
+        if (ir_defines_result(instr.opcode)) {
+            int t = liveness_index(rw->lv, instr.result);
+            if (t >= 0 && rw->interval_of[t].reg >= 0) {
+                instr.result = create_operand_register(rw->interval_of[t].reg);
+            } else if (t >= 0) {
+                // Written after the operands are read, so any scratch will do.
+                spilled = &rw->interval_of[t];
+                instr.result = create_operand_register(rw->first_scratch);
+            }
+        } else {
+            instr.result = rewrite_use(rw, instr.result);
+        }
+        block_append(block, instr);
+        if (spilled) {
+            Instruction spill = { IR_SPILL, create_operand_int(spilled->slot), instr.result, create_operand_none() };
+            block_append(block, spill);
+        }
+    }
+    free(old);
+}
+
+int allocate_registers(IRFunction *fn, int num_registers) {
+    build_cfg(fn);
+    Liveness *lv = compute_liveness(fn);
+    LiveInterval *intervals = build_intervals(fn, lv);
+    int n = lv->num_temps;
+    qsort(intervals, n, sizeof(LiveInterval), compare_starts);
+    linear_scan(intervals, n, num_registers - SCRATCH_REGISTERS);
+
+    LiveInterval *interval_of = (LiveInterval*) checked_calloc(n, sizeof(LiveInterval));
+    int spilled = 0;
+    for (int i = 0; i < n; i++) {
+        LiveInterval *interval = &intervals[i];
+        if (interval->reg < 0 && interval->end >= 0) {
+            interval->slot = fn->frame_size + spilled * SPILL_SLOT_SIZE;
+            spilled++;
+        }
+        interval_of[interval->temp] = *interval;
+    }
+    if (spilled > 0) {
+        int size = fn->frame_size + spilled * SPILL_SLOT_SIZE;
+        fn->frame_size = (size + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT * FRAME_ALIGNMENT;
+    }
+
+    Rewriter rw;
+    memset(&rw, 0, sizeof(rw));
+    rw.lv = lv;
+    rw.interval_of = interval_of;
+    rw.first_scratch = num_registers - SCRATCH_REGISTERS;
+    for (int b = 0; b < fn->num_blocks; b++) {
+        rewrite_block(&rw, fn->blocks[b]);
+    }
+    linearize_cfg(fn);
+    free(intervals);
+    free(interval_of);
+    free_liveness(lv);
+    return spilled;
+}
+
+int registers_used(const IRFunction *fn) {
+    int used = 0;
+    for (int i = 0; i < fn->num_instrs; i++) {
+        const Operand *ops[3] = { &fn->instrs[i].result, &fn->instrs[i].arg1, &fn->instrs[i].arg2 };
+        for (int k = 0; k < 3; k++) {
+            if (ops[k]->type == OP_REGISTER && ops[k]->val.reg >= used) used = ops[k]->val.reg + 1;
+        }
+    }
+    return used;
+}
@@ -0,0 +1,32 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include "ir.h"
+
+/*
+ * Linear-scan register allocation. Every temporary of a function is mapped
+ * onto one of K registers r0 .. rK-1, printed as r<n>. Named variables stay
+ * in memory. Registers belong to one activation of a function, so a CALL
+ * does not disturb the caller's.
+ *
+ * Each temporary gets a single live interval over the instruction layout,
+ * covering its definitions, its uses and the blocks it is live into or out
+ * of (see liveness.h). The intervals are scanned by start; when all
+ * registers are taken, the interval that ends last is spilled to an 8-byte
+ * slot appended to the function's frame. A spilled temporary is read with
+ * 'RELOAD reg, offset' into one of the last SCRATCH_REGISTERS registers,
+ * which are kept for this, and written back with 'SPILL offset, reg'.
+ */
+
+#define SCRATCH_REGISTERS 3 // An INDEX_STORE reads three operands
+#define MIN_REGISTERS (SCRATCH_REGISTERS + 1)
+#define SPILL_SLOT_SIZE 8
+
+// Allocates registers for a linear function, which afterwards has no
+// temporaries left. Returns the number of temporaries spilled.
+int allocate_registers(IRFunction *fn, int num_registers);
+
+// Highest register number a function uses, plus one.
+int registers_used(const IRFunction *fn);
+
+#endif // REGALLOC_H
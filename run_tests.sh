@@ -2,6 +2,7 @@
 
 # Path to your compiler executable
 COMPILER="./c99_compiler"
+OPTIMIZER="./c99-opt"
 
 # Directory containing the test files
 TEST_DIR="./tests"
@@ -60,4 +61,204 @@ else
     echo "$output"
 fi
 
+# A program with errors must not run: the compiler stops before generating
+# code and exits with status 1 rather than crashing.
+for mode in --vm --run; do
+    echo -n "Testing ${ERROR_TEST} with ${mode}... "
+    output=$($COMPILER "$ERROR_TEST" "${ERROR_TEST}.3ac" $mode 2>&1)
+    status=$?
+    if [ $status -eq 1 ] && echo "$output" | grep -q "3 errors; no code generated."; then
+        echo -e "${GREEN}PASS${NC}"
+    else
+        echo -e "${RED}FAIL - Expected exit status 1 and no code, got status ${status}.${NC}"
+        echo "$output"
+    fi
+done
+
+echo ""
+echo "--- Running Execution Tests ---"
+
+# Prints the exit status named by a test's "// Should return N" comment.
+expected_status() {
+    sed -n 's|.*// Should return \([0-9]*\).*|\1|p' "$1" | head -n 1
+}
+
+# Every test program's main states its exit status; it must be the same in
+# the VM and natively, with and without optimization.
+for test_file in ${TEST_DIR}/test_*.c; do
+    if [[ "$test_file" == *test_errors.c ]]; then
+        continue # Does not compile
+    fi
+    expected=$(expected_status "$test_file")
+    if [ -z "$expected" ]; then
+        echo -e "${RED}FAIL - ${test_file} has no '// Should return N' comment.${NC}"
+        continue
+    fi
+    for level in -O0 -O2; do
+        echo -n "Testing ${test_file} ${level} under --vm and --run... "
+        vm_status=$($COMPILER "$test_file" "${test_file}.3ac" $level --vm 2>&1 | \
+            sed -n 's/.*exit status \([-0-9]*\),.*/\1/p')
+        run_status=$($COMPILER "$test_file" "${test_file}.3ac" $level --run 2>&1 | \
+            sed -n 's/.*main exited with status \([-0-9]*\) .*/\1/p')
+        if [ "$vm_status" = "$expected" ] && [ "$run_status" = "$expected" ]; then
+            echo -e "${GREEN}PASS${NC}"
+        else
+            echo -e "${RED}FAIL - Expected ${expected}, --vm gave '${vm_status}', --run gave '${run_status}'.${NC}"
+        fi
+    done
+done
+
+echo ""
+echo "--- Running c99-opt Round-Trip Tests ---"
+
+# c99-opt with no passes must write back the 3AC the compiler saved, whether
+# it reads the text or the binary file.
+for test_file in ${TEST_DIR}/test_*.c; do
+    if [[ "$test_file" == *test_errors.c ]]; then
+        continue
+    fi
+    for level in -O0 -O2; do
+        echo -n "Testing ${test_file} ${level} through ${OPTIMIZER}... "
+        $COMPILER "$test_file" "${test_file}.3ac" $level --binary="${test_file}.3acb" > /dev/null 2>&1
+        text_output=$($OPTIMIZER "${test_file}.3ac" "${test_file}.text.3ac" -O0 2>&1) && \
+            binary_output=$($OPTIMIZER "${test_file}.3acb" "${test_file}.binary.3ac" -O0 2>&1)
+        if [ $? -eq 0 ] && cmp -s "${test_file}.3ac" "${test_file}.text.3ac" && \
+           cmp -s "${test_file}.3ac" "${test_file}.binary.3ac"; then
+            echo -e "${GREEN}PASS${NC}"
+        else
+            echo -e "${RED}FAIL - The 3AC changed on the way through ${OPTIMIZER}.${NC}"
+            echo "$text_output"
+            echo "$binary_output"
+        fi
+        rm -f "${test_file}.3acb" "${test_file}.text.3ac" "${test_file}.binary.3ac"
+    done
+done
+
+echo ""
+echo "--- Running Binary 3AC Tests ---"
+BINARY_TEST="${TEST_DIR}/test_switch_lowering.c"
+BINARY_FILE="${BINARY_TEST}.3acb"
+$COMPILER "$BINARY_TEST" "${BINARY_TEST}.3ac" --binary="$BINARY_FILE" > /dev/null 2>&1
+
+# Overwrites the 32-bit header field at byte offset $2 of file $1 with zero.
+clear_header_field() {
+    printf '\0\0\0\0' | dd of="$1" bs=1 seek="$2" conv=notrunc 2> /dev/null
+}
+
+# Header fields 17 and 18 are the number of temporaries and of labels;
+# with either cleared, every operand of that kind is out of range.
+for field in "68:bad temporary" "72:bad label"; do
+    offset="${field%%:*}"
+    message="${field#*:}"
+    echo -n "Testing ${BINARY_FILE} with '${message}'... "
+    cp "$BINARY_FILE" "${BINARY_FILE}.bad"
+    clear_header_field "${BINARY_FILE}.bad" "$offset"
+    output=$($OPTIMIZER "${BINARY_FILE}.bad" "${BINARY_TEST}.opt.3ac" 2>&1)
+    if [ $? -ne 0 ] && echo "$output" | grep -q "$message"; then
+        echo -e "${GREEN}PASS${NC}"
+    else
+        echo -e "${RED}FAIL - Corrupted file was not rejected.${NC}"
+        echo "$output"
+    fi
+done
+rm -f "$BINARY_FILE" "${BINARY_FILE}.bad" "${BINARY_TEST}.opt.3ac"
+
+echo ""
+echo "--- Running IR Dump Tests ---"
+
+# Matches a binary operation whose operands are both constants.
+CONSTANT_OPERATION="^	(ADD|SUB|MUL|DIV|MOD|EQ|NE|LT|GT|LE|GE|AND|OR|BIT_AND|BIT_OR|XOR|SHL|SHR) [^,]*, '?-?[0-9][^,]*, '?-?[0-9]"
+
+# Constant expressions, including the scaling of constant array indexes,
+# must not reach the 3AC at any level.
+FOLDING_TEST="${TEST_DIR}/test_constant_folding.c"
+for level in -O0 -O1 -O2; do
+    echo -n "Testing ${FOLDING_TEST} ${level} for operations on constants... "
+    $COMPILER "$FOLDING_TEST" "${FOLDING_TEST}.3ac" $level > /dev/null 2>&1
+    if [ $? -eq 0 ] && ! grep -qE "$CONSTANT_OPERATION" "${FOLDING_TEST}.3ac"; then
+        echo -e "${GREEN}PASS${NC}"
+    else
+        echo -e "${RED}FAIL - Operations on constants were left in the 3AC.${NC}"
+        grep -E "$CONSTANT_OPERATION" "${FOLDING_TEST}.3ac"
+    fi
+done
+
+# The peephole pass folds what other passes leave behind.
+PEEPHOLE_FILE="${TEST_DIR}/constant_operations.3ac"
+printf 'main:\n\tMUL t0, 6, 4\n\tSUB t1, t0, 4\n\tLT t2, 2, 3\n\tRETURN t1\n' > "$PEEPHOLE_FILE"
+echo -n "Testing peephole on operations on constants... "
+output=$($OPTIMIZER "$PEEPHOLE_FILE" "${PEEPHOLE_FILE}.opt" --passes=peephole 2>&1)
+if [ $? -eq 0 ] && ! grep -qE "$CONSTANT_OPERATION" "${PEEPHOLE_FILE}.opt" && \
+   grep -q "ASSIGN t0, 24" "${PEEPHOLE_FILE}.opt"; then
+    echo -e "${GREEN}PASS${NC}"
+else
+    echo -e "${RED}FAIL - The peephole pass left operations on constants.${NC}"
+    cat "${PEEPHOLE_FILE}.opt"
+fi
+rm -f "$PEEPHOLE_FILE" "${PEEPHOLE_FILE}.opt"
+
+echo ""
+echo "--- Running Native Backend Tests ---"
+
+# The native backend keeps each byte offset of an array in an 8-byte cell,
+# which a library function would misread, so handing it an array must fail
+# to compile rather than print garbage.
+LIBRARY_TEST="${TEST_DIR}/array_to_library.c"
+cat > "$LIBRARY_TEST" << 'EOF'
+int show(char text[]) {
+    return printf("%s\n", text);
+}
+
+int main() {
+    char word[3];
+    word[0] = 104;
+    word[1] = 105;
+    word[2] = 0;
+    return show(word);
+}
+EOF
+for mode in --run --asm="${LIBRARY_TEST}.s"; do
+    echo -n "Testing ${LIBRARY_TEST} with ${mode}... "
+    output=$($COMPILER "$LIBRARY_TEST" "${LIBRARY_TEST}.3ac" $mode 2>&1)
+    status=$?
+    if [ $status -eq 1 ] && echo "$output" | grep -q "argument 1 of 'printf' in 'show'" && \
+       [ ! -e "${LIBRARY_TEST}.s" ]; then
+        echo -e "${GREEN}PASS${NC}"
+    else
+        echo -e "${RED}FAIL - Expected exit status 1 and no code, got status ${status}.${NC}"
+        echo "$output" | grep "Error"
+    fi
+done
+rm -f "$LIBRARY_TEST" "${LIBRARY_TEST}.3ac" "${LIBRARY_TEST}.s"
+
+echo ""
+echo "--- Running Scaling Tests ---"
+
+# Writes a function whose n copies chain one value through n temporaries,
+# each also live alongside a temporary of its own.
+write_copy_chain() {
+    echo "main:"
+    echo "	ASSIGN t1, 0"
+    for ((k = 1; k <= $1; k++)); do
+        echo "	ASSIGN t$((3 * k + 2)), $k"
+        echo "	ASSIGN t$((3 * k + 1)), t$((3 * k - 2))"
+        echo "	ADD t$((3 * k + 3)), t$((3 * k + 2)), t$((3 * k + 1))"
+    done
+    echo "	RETURN t$((3 * $1 + 1))"
+}
+
+# Coalescing the chain takes a fraction of a second; if merging copies
+# turns quadratic again it takes minutes.
+CHAIN_FILE="${TEST_DIR}/copy_chain.3ac"
+echo -n "Testing coalesce on a chain of 30000 copies... "
+write_copy_chain 30000 > "$CHAIN_FILE"
+output=$(timeout 10 $OPTIMIZER "$CHAIN_FILE" "${CHAIN_FILE}.opt" --passes=coalesce 2>&1)
+if [ $? -eq 0 ] && ! grep -q "ASSIGN t[0-9]*, t" "${CHAIN_FILE}.opt"; then
+    echo -e "${GREEN}PASS${NC}"
+else
+    echo -e "${RED}FAIL - Coalescing timed out or left copies behind.${NC}"
+    echo "$output" | tail -n 5
+fi
+rm -f "$CHAIN_FILE" "${CHAIN_FILE}.opt"
+
 echo "--- All tests complete ---"
\ No newline at end of file
@@ -0,0 +1,424 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "passes.h"
+#include "cfg.h"
+#include "alloc.h"
+
+/*
+ * Sparse conditional constant propagation (Wegman and Zadeck) on SSA form.
+ * Every temporary starts at TOP (no value seen yet) and can only move down
+ * to a constant and then to BOTTOM (not constant). Blocks are only evaluated
+ * once an executable edge reaches them, and a conditional jump on a known
+ * constant only makes its taken edge executable, so constants flow through
+ * branches that fold away.
+ *
+ * Afterwards, uses of constant temporaries are replaced by the constant,
+ * their definitions are dropped, branches on constants become plain jumps
+ * and blocks that are no longer reachable are deleted.
+ */
+
+typedef enum { LATTICE_TOP, LATTICE_CONST, LATTICE_BOTTOM } LatticeLevel;
+
+typedef struct {
+    LatticeLevel level;
+    Operand value; // For LATTICE_CONST
+} LatticeCell;
+
+// Where a temporary is read: instruction 'index' of the block, or phi
+// -(index + 1) when index is negative.
+typedef struct {
+    int block;
+    int index;
+} UseSite;
+
+typedef struct {
+    IRFunction *fn;
+    int num_temps;
+    LatticeCell *cells;
+    int *use_start;       // Uses of temporary t are uses[use_start[t] .. use_start[t + 1] - 1]
+    UseSite *uses;
+    char *block_executable;
+    char **edge_executable; // Per block, per successor slot
+    int *edge_work;       // Pairs (block id, successor slot)
+    int edge_work_size;
+    int edge_work_capacity;
+    int *temp_work;
+    int temp_work_size;
+    int temp_work_capacity;
+} SCCP;
+
+static void push_int(int **items, int *size, int *capacity, int value) {
+    if (*size == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        *items = (int*) checked_realloc(*items, *capacity, sizeof(int));
+    }
+    (*items)[(*size)++] = value;
+}
+
+static LatticeCell bottom_cell() {
+    LatticeCell cell;
+    cell.level = LATTICE_BOTTOM;
+    cell.value = create_operand_none();
+    return cell;
+}
+
+static LatticeCell operand_cell(SCCP *sc, Operand op) {
+    if (is_constant_operand(op)) {
+        LatticeCell cell;
+        cell.level = LATTICE_CONST;
+        cell.value = op;
+        return cell;
+    }
+    if (op.type == OP_TEMPORARY && op.val.temp < sc->num_temps) {
+        return sc->cells[op.val.temp];
+    }
+    return bottom_cell(); // Memory, parameters, addresses: unknown
+}
+
+static LatticeCell meet(LatticeCell a, LatticeCell b) {
+    if (a.level == LATTICE_TOP) return b;
+    if (b.level == LATTICE_TOP) return a;
+    if (a.level == LATTICE_CONST && b.level == LATTICE_CONST && are_operands_equal(a.value, b.value)) {
+        return a;
+    }
+    return bottom_cell();
+}
+
+static void lower_cell(SCCP *sc, Operand result, LatticeCell cell) {
+    if (result.type != OP_TEMPORARY || result.val.temp >= sc->num_temps) return;
+    int t = result.val.temp;
+    LatticeCell merged = meet(sc->cells[t], cell);
+    if (merged.level == sc->cells[t].level) return; // Levels only go down, so equal means unchanged
+    sc->cells[t] = merged;
+    push_int(&sc->temp_work, &sc->temp_work_size, &sc->temp_work_capacity, t);
+}
+
+static void mark_edge(SCCP *sc, BasicBlock *block, int slot) {
+    if (sc->edge_executable[block->id][slot]) return;
+    sc->edge_executable[block->id][slot] = 1;
+    push_int(&sc->edge_work, &sc->edge_work_size, &sc->edge_work_capacity, block->id);
+    push_int(&sc->edge_work, &sc->edge_work_size, &sc->edge_work_capacity, slot);
+}
+
+static int is_conditional_jump(OpCode opcode) {
+    return opcode == IR_IF_FALSE_GOTO || opcode == IR_IF_TRUE_GOTO;
+}
+
+static int constant_is_true(Operand op) {
+    return op.type == OP_FLOAT_CONST ? operand_float_value(op) != 0.0 : op.val.int_val != 0;
+}
+
+// Slot of the successor a conditional jump goes to when taken.
+static int jump_target_slot(BasicBlock *block, Instruction *jump) {
+    for (int s = 0; s < block->num_succs; s++) {
+        if (block->succs[s]->label == jump->result.val.label) return s;
+    }
+    return 0;
+}
+
+// Slot of the successor a jump table goes to for a constant index, or -1 if
+// the index is not an integer in the table's range.
+static int table_target_slot(BasicBlock *block, Instruction *jump, Operand index) {
+    JumpTable *table = &ir_module.jump_tables[jump->result.val.int_val];
+    if (index.type != OP_INT_CONST && index.type != OP_CHAR_CONST) return -1;
+    if (index.val.int_val < 0 || index.val.int_val >= table->num_labels) return -1;
+    for (int s = 0; s < block->num_succs; s++) {
+        if (block->succs[s]->label == table->labels[index.val.int_val]) return s;
+    }
+    return -1;
+}
+
+static void visit_terminator(SCCP *sc, BasicBlock *block) {
+    Instruction *last = block_terminator(block);
+    if (last && last->opcode == IR_JUMP_TABLE) {
+        LatticeCell index = operand_cell(sc, last->arg1);
+        if (index.level == LATTICE_TOP) return;
+        int slot = index.level == LATTICE_CONST ? table_target_slot(block, last, index.value) : -1;
+        for (int s = 0; s < block->num_succs; s++) {
+            if (slot < 0 || s == slot) mark_edge(sc, block, s);
+        }
+        return;
+    }
+    if (!last || !is_conditional_jump(last->opcode) || block->num_succs < 2) {
+        for (int s = 0; s < block->num_succs; s++) mark_edge(sc, block, s);
+        return;
+    }
+    LatticeCell cond = operand_cell(sc, last->arg1);
+    if (cond.level == LATTICE_TOP) return;
+    int target = jump_target_slot(block, last);
+    if (cond.level == LATTICE_CONST) {
+        int taken = constant_is_true(cond.value) == (last->opcode == IR_IF_TRUE_GOTO);
+        mark_edge(sc, block, taken ? target : 1 - target);
+    } else {
+        mark_edge(sc, block, 0);
+        mark_edge(sc, block, 1);
+    }
+}
+
+static int is_foldable(OpCode opcode) {
+    switch (opcode) {
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+        case IR_EQ: case IR_NE: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+        case IR_AND: case IR_OR: case IR_BIT_AND: case IR_BIT_OR: case IR_XOR:
+        case IR_SHL: case IR_SHR:
+        case IR_UNARY_MINUS: case IR_NOT: case IR_BIT_NOT:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void visit_instruction(SCCP *sc, BasicBlock *block, Instruction *instr) {
+    if (is_block_terminator(instr->opcode)) {
+        visit_terminator(sc, block);
+        return;
+    }
+    if (!ir_defines_result(instr->opcode) || instr->result.type != OP_TEMPORARY) return;
+
+    LatticeCell cell = bottom_cell();
+    if (instr->opcode == IR_ASSIGN) {
+        cell = operand_cell(sc, instr->arg1);
+    } else if (is_foldable(instr->opcode)) {
+        int unary = instr->arg2.type == OP_NONE;
+        LatticeCell a = operand_cell(sc, instr->arg1);
+        LatticeCell b = unary ? a : operand_cell(sc, instr->arg2);
+        if (a.level == LATTICE_BOTTOM || b.level == LATTICE_BOTTOM) {
+            cell = bottom_cell();
+        } else if (a.level == LATTICE_TOP || b.level == LATTICE_TOP) {
+            cell.level = LATTICE_TOP;
+        } else if (fold_constant_operation(instr->opcode, a.value, unary ? instr->arg2 : b.value, &cell.value)) {
+            cell.level = LATTICE_CONST;
+        }
+    }
+    lower_cell(sc, instr->result, cell);
+}
+
+static void visit_phi(SCCP *sc, BasicBlock *block, PhiNode *phi) {
+    LatticeCell cell;
+    cell.level = LATTICE_TOP;
+    for (int p = 0; p < block->num_preds; p++) {
+        BasicBlock *pred = block->preds[p];
+        int slot = 0;
+        while (pred->succs[slot] != block) slot++;
+        if (sc->edge_executable[pred->id][slot]) {
+            cell = meet(cell, operand_cell(sc, phi->args[p]));
+        }
+    }
+    lower_cell(sc, phi->result, cell);
+}
+
+static void add_use(SCCP *sc, int *cursor, Operand op, int block, int index) {
+    if (op.type != OP_TEMPORARY || op.val.temp >= sc->num_temps) return;
+    if (cursor) {
+        UseSite *site = &sc->uses[cursor[op.val.temp]++];
+        site->block = block;
+        site->index = index;
+    } else {
+        sc->use_start[op.val.temp + 1]++;
+    }
+}
+
+// Two passes over the function: count the uses of each temporary, then fill
+// them into one array.
+static void build_use_lists(SCCP *sc) {
+    IRFunction *fn = sc->fn;
+    sc->use_start = (int*) checked_calloc(sc->num_temps + 1, sizeof(int));
+    int *cursor = NULL;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int b = 0; b < fn->num_blocks; b++) {
+            BasicBlock *block = fn->blocks[b];
+            for (int i = 0; i < block->num_phis; i++) {
+                for (int p = 0; p < block->num_preds; p++) {
+                    add_use(sc, cursor, block->phis[i].args[p], b, -(i + 1));
+                }
+            }
+            for (int i = 0; i < block->num_instrs; i++) {
+                Instruction *instr = &block->instrs[i];
+                add_use(sc, cursor, instr->arg1, b, i);
+                add_use(sc, cursor, instr->arg2, b, i);
+                if (ir_reads_result(instr->opcode)) add_use(sc, cursor, instr->result, b, i);
+            }
+        }
+        if (pass == 0) {
+            for (int t = 0; t < sc->num_temps; t++) {
+                sc->use_start[t + 1] += sc->use_start[t];
+            }
+            sc->uses = (UseSite*) checked_calloc(sc->use_start[sc->num_temps], sizeof(UseSite));
+            cursor = (int*) checked_calloc(sc->num_temps + 1, sizeof(int));
+            memcpy(cursor, sc->use_start, (sc->num_temps + 1) * sizeof(int));
+        }
+    }
+    free(cursor);
+}
+
+static void propagate(SCCP *sc) {
+    IRFunction *fn = sc->fn;
+    BasicBlock *entry = fn->blocks[CFG_ENTRY];
+    sc->block_executable[CFG_ENTRY] = 1;
+    for (int i = 0; i < entry->num_instrs; i++) {
+        visit_instruction(sc, entry, &entry->instrs[i]);
+    }
+    if (!block_terminator(entry)) visit_terminator(sc, entry);
+    while (sc->edge_work_size > 0 || sc->temp_work_size > 0) {
+        if (sc->edge_work_size > 0) {
+            int slot = sc->edge_work[--sc->edge_work_size];
+            BasicBlock *block = fn->blocks[sc->edge_work[--sc->edge_work_size]];
+            BasicBlock *dest = block->succs[slot];
+            for (int i = 0; i < dest->num_phis; i++) {
+                visit_phi(sc, dest, &dest->phis[i]);
+            }
+            if (!sc->block_executable[dest->id]) {
+                sc->block_executable[dest->id] = 1;
+                for (int i = 0; i < dest->num_instrs; i++) {
+                    visit_instruction(sc, dest, &dest->instrs[i]);
+                }
+                if (!block_terminator(dest)) visit_terminator(sc, dest);
+            }
+            continue;
+        }
+        int t = sc->temp_work[--sc->temp_work_size];
+        for (int u = sc->use_start[t]; u < sc->use_start[t + 1]; u++) {
+            BasicBlock *block = fn->blocks[sc->uses[u].block];
+            if (!sc->block_executable[block->id]) continue;
+            if (sc->uses[u].index < 0) {
+                visit_phi(sc, block, &block->phis[-sc->uses[u].index - 1]);
+            } else {
+                visit_instruction(sc, block, &block->instrs[sc->uses[u].index]);
+            }
+        }
+    }
+}
+
+static int is_constant_temp(SCCP *sc, Operand op) {
+    return op.type == OP_TEMPORARY && op.val.temp < sc->num_temps &&
+           sc->cells[op.val.temp].level == LATTICE_CONST;
+}
+
+static void replace_if_constant(SCCP *sc, Operand *op) {
+    if (is_constant_temp(sc, *op)) *op = sc->cells[op->val.temp].value;
+}
+
+static int rewrite_function(SCCP *sc) {
+    IRFunction *fn = sc->fn;
+    int changes = 0;
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        int kept = 0;
+        for (int i = 0; i < block->num_phis; i++) {
+            PhiNode *phi = &block->phis[i];
+            if (is_constant_temp(sc, phi->result)) {
+                free(phi->args);
+                changes++;
+                continue;
+            }
+            for (int p = 0; p < block->num_preds; p++) replace_if_constant(sc, &phi->args[p]);
+            block->phis[kept++] = *phi;
+        }
+        block->num_phis = kept;
+
+        kept = 0;
+        for (int i = 0; i < block->num_instrs; i++) {
+            Instruction instr = block->instrs[i];
+            if (ir_defines_result(instr.opcode) && is_constant_temp(sc, instr.result)) {
+                changes++; // Every use now reads the constant
+                continue;
+            }
+            replace_if_constant(sc, &instr.arg1);
+            replace_if_constant(sc, &instr.arg2);
+            if (ir_reads_result(instr.opcode)) replace_if_constant(sc, &instr.result);
+            block->instrs[kept++] = instr;
+        }
+        block->num_instrs = kept;
+
+        // Branches on a constant go one way only.
+        Instruction *last = block_terminator(block);
+        if (last && last->opcode == IR_JUMP_TABLE) {
+            int slot = table_target_slot(block, last, last->arg1);
+            if (slot < 0) continue;
+            BasicBlock *target = block->succs[slot];
+            last->opcode = IR_GOTO;
+            last->result.type = OP_LABEL;
+            last->result.val.label = block_label(target);
+            last->arg1 = create_operand_none();
+            while (block->num_succs > 1) {
+                remove_cfg_edge(block, block->succs[block->succs[0] == target ? 1 : 0]);
+            }
+            changes++;
+            continue;
+        }
+        if (!last || !is_conditional_jump(last->opcode) || !is_constant_operand(last->arg1)) continue;
+        int taken = constant_is_true(last->arg1) == (last->opcode == IR_IF_TRUE_GOTO);
+        int target = jump_target_slot(block, last);
+        BasicBlock *dropped = NULL;
+        if (block->num_succs == 2) dropped = block->succs[taken ? 1 - target : target];
+        if (taken) {
+            last->opcode = IR_GOTO;
+            last->arg1 = create_operand_none();
+        } else {
+            block->num_instrs--;
+        }
+        if (dropped) remove_cfg_edge(block, dropped);
+        changes++;
+    }
+
+    // Delete the blocks no path reaches any more.
+    BasicBlock **order = (BasicBlock**) checked_calloc(fn->num_blocks, sizeof(BasicBlock*));
+    compute_reverse_postorder(fn, order);
+    free(order);
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        if (block->rpo < 0 && b != CFG_ENTRY && b != CFG_EXIT) {
+            delete_basic_block(fn, block);
+            changes++;
+        }
+    }
+    compact_blocks(fn);
+    return changes;
+}
+
+int run_sccp(IRFunction *fn) {
+    SCCP sc;
+    memset(&sc, 0, sizeof(sc));
+    sc.fn = fn;
+    sc.num_temps = ir_module.num_temps;
+    sc.cells = (LatticeCell*) checked_calloc(sc.num_temps, sizeof(LatticeCell));
+
+    // Temporaries with no definition here hold unknown values.
+    for (int t = 0; t < sc.num_temps; t++) sc.cells[t] = bottom_cell();
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        for (int i = 0; i < block->num_phis; i++) {
+            sc.cells[block->phis[i].result.val.temp].level = LATTICE_TOP;
+        }
+        for (int i = 0; i < block->num_instrs; i++) {
+            Instruction *instr = &block->instrs[i];
+            if (ir_defines_result(instr->opcode) && instr->result.type == OP_TEMPORARY) {
+                sc.cells[instr->result.val.temp].level = LATTICE_TOP;
+            }
+        }
+    }
+
+    build_use_lists(&sc);
+    sc.block_executable = (char*) checked_calloc(fn->num_blocks, sizeof(char));
+    sc.edge_executable = (char**) checked_calloc(fn->num_blocks, sizeof(char*));
+    for (int b = 0; b < fn->num_blocks; b++) {
+        sc.edge_executable[b] = (char*) checked_calloc(fn->blocks[b]->num_succs, sizeof(char));
+    }
+
+    propagate(&sc);
+    for (int b = 0; b < fn->num_blocks; b++) {
+        free(sc.edge_executable[b]);
+    }
+    free(sc.edge_executable);
+    int changes = rewrite_function(&sc);
+
+    free(sc.cells);
+    free(sc.use_start);
+    free(sc.uses);
+    free(sc.block_executable);
+    free(sc.edge_work);
+    free(sc.temp_work);
+    return changes;
+}
@@ -1,10 +1,137 @@
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include "semantics.h"
+#include "string_pool.h"
+
+/* --- AST node kinds --- */
+
+const char *const ast_kind_names[AST_KIND_COUNT] = {
+    [AST_PROGRAM] = "Program",
+    [AST_FUNCTION_DEFINITION] = "FunctionDefinition",
+    [AST_DECLARATION] = "Declaration",
+    [AST_DECLARATION_SPECIFIERS] = "DeclarationSpecifiers",
+    [AST_STORAGE_CLASS_SPECIFIER] = "StorageClassSpecifier",
+    [AST_TYPE_SPECIFIER] = "TypeSpecifier",
+    [AST_TYPE_NAME] = "TypeName",
+    [AST_TYPE_QUALIFIER] = "TypeQualifier",
+    [AST_INIT_DECLARATOR_LIST] = "InitDeclaratorList",
+    [AST_INIT_DECLARATOR] = "InitDeclarator",
+    [AST_IDENTIFIER] = "Identifier",
+    [AST_POINTER_DECLARATOR] = "PointerDeclarator",
+    [AST_ARRAY_DECLARATOR] = "ArrayDeclarator",
+    [AST_FUNCTION_DECLARATOR] = "FunctionDeclarator",
+    [AST_POINTER] = "Pointer",
+    [AST_PARAMETER_LIST] = "ParameterList",
+    [AST_PARAMETER_DECLARATION] = "ParameterDeclaration",
+    [AST_EMPTY_PARAMETER_LIST] = "EmptyParameterList",
+    [AST_POINTER_ABSTRACT_DECLARATOR] = "PointerAbstractDeclarator",
+    [AST_PARENTHESIZED_ABSTRACT_DECLARATOR] = "ParenthesizedAbstractDeclarator",
+    [AST_ABSTRACT_ARRAY_SUFFIX] = "AbstractArraySuffix",
+    [AST_ABSTRACT_FUNCTION_SUFFIX] = "AbstractFunctionSuffix",
+    [AST_STRUCT_SPECIFIER] = "StructSpecifier",
+    [AST_STRUCT_TOKEN] = "StructToken",
+    [AST_UNION_TOKEN] = "UnionToken",
+    [AST_STRUCT_DECLARATION_LIST] = "StructDeclarationList",
+    [AST_STRUCT_DECLARATION] = "StructDeclaration",
+    [AST_SPECIFIER_QUALIFIER_LIST] = "SpecifierQualifierList",
+    [AST_STRUCT_DECLARATOR_LIST] = "StructDeclaratorList",
+    [AST_ENUM_SPECIFIER] = "EnumSpecifier",
+    [AST_ENUMERATOR_LIST] = "EnumeratorList",
+    [AST_ENUMERATOR] = "Enumerator",
+    [AST_INITIALIZER_LIST] = "InitializerList",
+    [AST_INIT_VALUES] = "InitValues",
+    [AST_COMPOUND_STATEMENT] = "CompoundStatement",
+    [AST_BLOCK_ITEM_LIST] = "BlockItemList",
+    [AST_EMPTY_STATEMENT] = "EmptyStatement",
+    [AST_EXPRESSION_STATEMENT] = "ExpressionStatement",
+    [AST_IF_STATEMENT] = "IfStatement",
+    [AST_IF_ELSE_STATEMENT] = "IfElseStatement",
+    [AST_SWITCH_STATEMENT] = "SwitchStatement",
+    [AST_WHILE_STATEMENT] = "WhileStatement",
+    [AST_DO_WHILE_STATEMENT] = "DoWhileStatement",
+    [AST_FOR_STATEMENT] = "ForStatement",
+    [AST_FOR_DECL_STATEMENT] = "ForDeclStatement",
+    [AST_LABELED_STATEMENT] = "LabeledStatement",
+    [AST_CASE_STATEMENT] = "CaseStatement",
+    [AST_DEFAULT_STATEMENT] = "DefaultStatement",
+    [AST_RETURN] = "Return",
+    [AST_BREAK_STATEMENT] = "BreakStatement",
+    [AST_CONTINUE_STATEMENT] = "ContinueStatement",
+    [AST_EMPTY_EXPRESSION] = "EmptyExpression",
+    [AST_ASSIGNMENT] = "Assignment",
+    [AST_BINARY_OP] = "BinaryOp",
+    [AST_UNARY_OP] = "UnaryOp",
+    [AST_PREFIX_INCREMENT] = "PrefixIncrement",
+    [AST_PREFIX_DECREMENT] = "PrefixDecrement",
+    [AST_POSTFIX_INCREMENT] = "PostfixIncrement",
+    [AST_POSTFIX_DECREMENT] = "PostfixDecrement",
+    [AST_SIZEOF_UNARY_EXPR] = "SizeofUnaryExpr",
+    [AST_SIZEOF_TYPE_EXPR] = "SizeofTypeExpr",
+    [AST_FUNCTION_CALL] = "FunctionCall",
+    [AST_ARGUMENT_LIST] = "ArgumentList",
+    [AST_ARRAY_ACCESS] = "ArrayAccess",
+    [AST_MEMBER_ACCESS] = "MemberAccess",
+    [AST_POINTER_MEMBER_ACCESS] = "PointerMemberAccess",
+    [AST_INT_CONSTANT] = "IntConstant",
+    [AST_FLOAT_CONSTANT] = "FloatConstant",
+    [AST_CHAR_CONSTANT] = "CharConstant",
+    [AST_STRING_LITERAL] = "StringLiteral",
+};
+
+const char *const ast_operator_symbols[AST_OP_COUNT] = {
+    [AST_OP_NONE] = "",
+    [AST_OP_ADD] = "+",
+    [AST_OP_SUB] = "-",
+    [AST_OP_MUL] = "*",
+    [AST_OP_DIV] = "/",
+    [AST_OP_MOD] = "%",
+    [AST_OP_EQ] = "==",
+    [AST_OP_NE] = "!=",
+    [AST_OP_LT] = "<",
+    [AST_OP_GT] = ">",
+    [AST_OP_LE] = "<=",
+    [AST_OP_GE] = ">=",
+    [AST_OP_LOGICAL_AND] = "&&",
+    [AST_OP_LOGICAL_OR] = "||",
+    [AST_OP_BIT_AND] = "&",
+    [AST_OP_BIT_OR] = "|",
+    [AST_OP_XOR] = "^",
+    [AST_OP_SHL] = "<<",
+    [AST_OP_SHR] = ">>",
+    [AST_OP_COMMA] = ",",
+    [AST_OP_ADDR] = "&",
+    [AST_OP_DEREF] = "*",
+    [AST_OP_PLUS] = "+",
+    [AST_OP_NEG] = "-",
+    [AST_OP_BIT_NOT] = "~",
+    [AST_OP_LOGICAL_NOT] = "!",
+    [AST_OP_ASSIGN] = "=",
+    [AST_OP_MUL_ASSIGN] = "*=",
+    [AST_OP_DIV_ASSIGN] = "/=",
+    [AST_OP_MOD_ASSIGN] = "%=",
+    [AST_OP_ADD_ASSIGN] = "+=",
+    [AST_OP_SUB_ASSIGN] = "-=",
+};
 
 /* --- Semantic Analysis --- */
 
+int semantic_error_count = 0;
+
+// Reports one semantic error. The driver generates no code for a program
+// that has any.
+static void semantic_error(const char* format, ...) {
+    va_list ap;
+    va_start(ap, format);
+    fprintf(stderr, "Semantic Error: ");
+    vfprintf(stderr, format, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    semantic_error_count++;
+}
+
 /**
  * @brief Extracts the base type name from a declaration_specifiers AST node.
  * This is a simplified implementation and assumes the first type specifier is the primary one.
@@ -22,22 +149,22 @@ Type* get_base_type_from_specifiers(ASTNode* specifiers_node) {
         ASTNode* specifier_to_check = current;
  
         // If we're looking at a list node, we need to inspect its first child, which holds the actual specifier.
-        if (strcmp(current->node_type, "DeclarationSpecifiers") == 0 ||
-            strcmp(current->node_type, "SpecifierQualifierList") == 0) {
+        if (current->kind == AST_DECLARATION_SPECIFIERS ||
+            current->kind == AST_SPECIFIER_QUALIFIER_LIST) {
             if (current->num_children > 0) {
                 specifier_to_check = current->children[0];
             }
         }
 
         // Now, check the actual specifier node (either the list item or the node itself)
-        if (strcmp(specifier_to_check->node_type, "TypeSpecifier") == 0) {
+        if (specifier_to_check->kind == AST_TYPE_SPECIFIER) {
             //printf("DEBUG: Found TypeSpecifier for type extraction.\n");
             //printf("DEBUG: Specifier value: %s\n", specifier_to_check->value);
             return create_base_type(specifier_to_check->value);
-        } else if (strcmp(specifier_to_check->node_type, "StructSpecifier") == 0) {
+        } else if (specifier_to_check->kind == AST_STRUCT_SPECIFIER) {
             // printf("DEBUG: Found StructSpecifier for type extraction.\n");
             return specifier_to_check->type; // Return the pre-built struct type
-        } else if (strcmp(specifier_to_check->node_type, "TypeName") == 0) {
+        } else if (specifier_to_check->kind == AST_TYPE_NAME) {
             // printf("DEBUG: Found TypeName for type extraction.\n");
             Symbol* sym = lookup_symbol(specifier_to_check->value);
             if (sym && sym->kind == SYM_TYPENAME) {
@@ -62,7 +189,7 @@ Type* get_base_type_from_specifiers(ASTNode* specifiers_node) {
 ASTNode* get_function_parameters_node(ASTNode* declarator_node) {
     if (!declarator_node) return NULL;
 
-    if (strcmp(declarator_node->node_type, "FunctionDeclarator") == 0) {
+    if (declarator_node->kind == AST_FUNCTION_DECLARATOR) {
         if (declarator_node->num_children > 1) {
             // The parameter list is the second child
             return declarator_node->children[1];
@@ -75,12 +202,12 @@ ASTNode* get_function_parameters_node(ASTNode* declarator_node) {
  * @brief Builds a linked list of Symbol structs from a ParameterList AST node.
  */
 Symbol* build_parameter_list_from_ast(ASTNode* param_list_node) {
-    if (!param_list_node || strcmp(param_list_node->node_type, "EmptyParameterList") == 0) {
+    if (!param_list_node || param_list_node->kind == AST_EMPTY_PARAMETER_LIST) {
         return NULL;
     }
 
     // Handle the base case: a single parameter declaration.
-    if (strcmp(param_list_node->node_type, "ParameterDeclaration") == 0) {
+    if (param_list_node->kind == AST_PARAMETER_DECLARATION) {
         //printf("DEBUG: Processing ParameterDeclaration\n");
         ASTNode* specifiers = param_list_node->children[0];
         Type* param_type = get_base_type_from_specifiers(specifiers);
@@ -88,17 +215,15 @@ Symbol* build_parameter_list_from_ast(ASTNode* param_list_node) {
         // Handle case like 'void' which has no declarator.
         if (param_list_node->num_children < 2) {
             //printf("DEBUG: Void Parameter");
-            free_type(param_type);
-            param_type = NULL;
             return NULL;
         }
 
         ASTNode* declarator = param_list_node->children[1];
-        char* param_name = get_declarator_name(declarator);
+        const char* param_name = get_declarator_name(declarator);
 
         Symbol* new_param = (Symbol*) malloc(sizeof(Symbol));
         Type* full_param_type = build_declarator_type(param_type, declarator);
-        new_param->name = param_name ? param_name : strdup("");
+        new_param->name = param_name ? param_name : intern_string("");
         new_param->type = full_param_type;
         new_param->kind = SYM_VARIABLE;
         new_param->next = NULL; // This is the end of a chain.
@@ -106,7 +231,7 @@ Symbol* build_parameter_list_from_ast(ASTNode* param_list_node) {
     }
 
     // Handle the recursive case: a list of parameters.
-    if (strcmp(param_list_node->node_type, "ParameterList") == 0) {
+    if (param_list_node->kind == AST_PARAMETER_LIST) {
         // Recursively build the list from the left side (the previous parameters).
         Symbol* head = build_parameter_list_from_ast(param_list_node->children[0]);
 
@@ -135,7 +260,7 @@ int is_function_declarator(ASTNode* declarator_node) {
     if (!declarator_node) return 0;
 
     // It's a function if the node type is "FunctionDeclarator"
-    if (strcmp(declarator_node->node_type, "FunctionDeclarator") == 0) {
+    if (declarator_node->kind == AST_FUNCTION_DECLARATOR) {
         return 1;
     }
     // Could be nested inside pointers, e.g. int (*f)();
@@ -144,38 +269,39 @@ int is_function_declarator(ASTNode* declarator_node) {
 
 /**
  * @brief Extracts the function name from a declarator AST node.
+ * The returned name is interned and must not be freed.
  */
-char* get_declarator_name(ASTNode* declarator_node) {
+const char* get_declarator_name(ASTNode* declarator_node) {
     if (!declarator_node) return NULL;
 
     // Case 1: It's a simple identifier (e.g., "int x;")
-    if (strcmp(declarator_node->node_type, "Identifier") == 0) {
-        return strdup(declarator_node->value);
+    if (declarator_node->kind == AST_IDENTIFIER) {
+        return declarator_node->value;
     }
 
     // Case 2: It's a function declarator (e.g., "int main(void)")
-    if (strcmp(declarator_node->node_type, "FunctionDeclarator") == 0 && declarator_node->num_children > 0) {
+    if (declarator_node->kind == AST_FUNCTION_DECLARATOR && declarator_node->num_children > 0) {
         ASTNode* direct_declarator = declarator_node->children[0];
         // Recursively find the name inside nested declarators
         return get_declarator_name(direct_declarator);
     }
     // Case 3: It's an array declarator (e.g., "int x[10]")
-    if (strcmp(declarator_node->node_type, "ArrayDeclarator") == 0 && declarator_node->num_children > 0) {
+    if (declarator_node->kind == AST_ARRAY_DECLARATOR && declarator_node->num_children > 0) {
         // The name is inside the direct_declarator part
         return get_declarator_name(declarator_node->children[0]);
     }
     // Case 4: It's a pointer declarator (e.g., "int *p")
-    if (strcmp(declarator_node->node_type, "PointerDeclarator") == 0 && declarator_node->num_children > 0) {
+    if (declarator_node->kind == AST_POINTER_DECLARATOR && declarator_node->num_children > 0) {
         // The name is inside the direct_declarator, which is the second child
         return get_declarator_name(declarator_node->children[1]);
     }
     // Case 5: It's an init declarator list
-    if(strcmp(declarator_node->node_type, "InitDeclaratorList") == 0 && declarator_node->num_children > 0) {
+    if(declarator_node->kind == AST_INIT_DECLARATOR_LIST && declarator_node->num_children > 0) {
         // The name is in the first child
         return get_declarator_name(declarator_node->children[0]);
     }
     // Case 6: It's an init declarator
-    if(strcmp(declarator_node->node_type, "InitDeclarator") == 0 && declarator_node->num_children > 0) {
+    if(declarator_node->kind == AST_INIT_DECLARATOR && declarator_node->num_children > 0) {
         // The name is in the first child
         return get_declarator_name(declarator_node->children[0]);
     }
@@ -183,16 +309,77 @@ char* get_declarator_name(ASTNode* declarator_node) {
 }
 
 /**
- * @brief Evaluates a constant expression AST node and returns its integer value.
- * This is a simplified version for array dimensions.
+ * @brief Computes the value of an integer constant expression.
+ * Returns 1 and stores the value in *value, or 0 if the expression is not
+ * constant or cannot be evaluated (for example, it divides by zero).
+ */
+static int fold_constant_ast(ASTNode* expr_node, int* value) {
+    int a, b;
+    switch (expr_node->kind) {
+        case AST_INT_CONSTANT:
+            *value = atoi(expr_node->value);
+            return 1;
+        case AST_CHAR_CONSTANT:
+            *value = expr_node->value[1]; // The value is spelled "'c'"
+            return 1;
+        case AST_UNARY_OP:
+            if (!fold_constant_ast(expr_node->children[0], &a)) return 0;
+            switch (expr_node->op) {
+                case AST_OP_PLUS: *value = a; return 1;
+                case AST_OP_NEG: *value = (int) (0u - (unsigned int) a); return 1;
+                case AST_OP_BIT_NOT: *value = ~a; return 1;
+                case AST_OP_LOGICAL_NOT: *value = !a; return 1;
+                default: return 0;
+            }
+        case AST_BINARY_OP:
+            if (!fold_constant_ast(expr_node->children[0], &a) ||
+                !fold_constant_ast(expr_node->children[1], &b)) return 0;
+            switch (expr_node->op) {
+                // Wrap around instead of overflowing, like the generated code
+                case AST_OP_ADD: *value = (int) ((unsigned int) a + (unsigned int) b); return 1;
+                case AST_OP_SUB: *value = (int) ((unsigned int) a - (unsigned int) b); return 1;
+                case AST_OP_MUL: *value = (int) ((unsigned int) a * (unsigned int) b); return 1;
+                case AST_OP_DIV:
+                case AST_OP_MOD:
+                    if (b == 0 || (a == INT_MIN && b == -1)) return 0;
+                    *value = (expr_node->op == AST_OP_DIV) ? a / b : a % b;
+                    return 1;
+                case AST_OP_EQ: *value = a == b; return 1;
+                case AST_OP_NE: *value = a != b; return 1;
+                case AST_OP_LT: *value = a < b; return 1;
+                case AST_OP_GT: *value = a > b; return 1;
+                case AST_OP_LE: *value = a <= b; return 1;
+                case AST_OP_GE: *value = a >= b; return 1;
+                case AST_OP_LOGICAL_AND: *value = a && b; return 1;
+                case AST_OP_LOGICAL_OR: *value = a || b; return 1;
+                case AST_OP_BIT_AND: *value = a & b; return 1;
+                case AST_OP_BIT_OR: *value = a | b; return 1;
+                case AST_OP_XOR: *value = a ^ b; return 1;
+                case AST_OP_SHL:
+                case AST_OP_SHR:
+                    if (b < 0 || b >= 32) return 0;
+                    *value = (expr_node->op == AST_OP_SHL) ? (int) ((unsigned int) a << b) : a >> b;
+                    return 1;
+                case AST_OP_COMMA: *value = b; return 1;
+                default: return 0;
+            }
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Evaluates an integer constant expression (array dimensions).
+ * Handles literals combined with the arithmetic, comparison, logical,
+ * bitwise and shift operators.
  */
 int evaluate_constant_expression(ASTNode* expr_node) {
     if (!expr_node) return 0;
-    if (strcmp(expr_node->node_type, "IntConstant") == 0) {
-        return atoi(expr_node->value);
+    int value;
+    if (fold_constant_ast(expr_node, &value)) {
+        return value;
     }
-    // Add more cases here for complex constant expressions if needed
-    fprintf(stderr, "Warning: Unsupported constant expression for array size. Only integer literals are supported.\n");
+    fprintf(stderr, "Warning: Unsupported constant expression for array size. Only integer constant expressions are supported.\n");
     return 0;
 }
 
@@ -203,7 +390,7 @@ int evaluate_constant_expression(ASTNode* expr_node) {
 Type* build_declarator_type(Type* base_type, ASTNode* declarator_node) {
     if (!declarator_node) return base_type;
     //printf("Building type for declarator node type: %s\n", declarator_node->node_type);
-    if (strcmp(declarator_node->node_type, "PointerDeclarator") == 0) {
+    if (declarator_node->kind == AST_POINTER_DECLARATOR) {
         // This is a pointer. The base_type is what the pointer *points to*.
         // We need to find the innermost declarator to apply the base type,
         // then wrap it with pointer types on the way out. The base_type is "consumed".
@@ -217,7 +404,7 @@ Type* build_declarator_type(Type* base_type, ASTNode* declarator_node) {
         }
         return current_type;
     }
-    if (strcmp(declarator_node->node_type, "ArrayDeclarator") == 0) {
+    if (declarator_node->kind == AST_ARRAY_DECLARATOR) {
         // It's an array. Recursively build the type of the element.
         // The base_type is "consumed" by the recursive call.
         Type* element_type = build_declarator_type(base_type, declarator_node->children[0]);
@@ -228,7 +415,7 @@ Type* build_declarator_type(Type* base_type, ASTNode* declarator_node) {
         }
         return create_array_type(element_type, size);
     }
-    if (strcmp(declarator_node->node_type, "Identifier") == 0) {
+    if (declarator_node->kind == AST_IDENTIFIER) {
         // Base case: we've reached the identifier. The type is just the base type.
         //printf("Reached identifier declarator type building.\n Base type kind: %d Base type name: %s \n", base_type->kind,base_type->data.base_name);
         return base_type;
@@ -238,6 +425,72 @@ Type* build_declarator_type(Type* base_type, ASTNode* declarator_node) {
     return base_type;
 }
 
+/**
+ * @brief Declares a function. Its prototype may be repeated and may precede
+ * its definition; the symbol keeps the latest of these types.
+ */
+void declare_function(const char* name, Type* func_type) {
+    Symbol* prior = lookup_symbol(name);
+    if (prior && prior->kind == SYM_FUNCTION) {
+        prior->type = func_type;
+    } else if (!insert_symbol(name, func_type, SYM_FUNCTION)) {
+        semantic_error_count++;
+    }
+}
+
+/**
+ * @brief Declares one declarator of a declaration in the current scope.
+ * The declarator node also gets the declared type, so the IR generator can
+ * size a block-scope variable after its scope has been left.
+ */
+void declare_declarator(Type* base_type, ASTNode* declarator, int kind) {
+    if (declarator->kind == AST_INIT_DECLARATOR) {
+        declarator = declarator->children[0];
+    }
+    const char* name = get_declarator_name(declarator);
+    if (!name) return;
+    if (is_function_declarator(declarator)) {
+        // It's a function declaration (prototype)
+        ASTNode* params_node = get_function_parameters_node(declarator);
+        Symbol* params_list = build_parameter_list_from_ast(params_node);
+        declarator->type = create_function_type(base_type, params_list);
+        declare_function(name, declarator->type);
+    } else {
+        // It's a variable, pointer, or array declaration.
+        declarator->type = build_declarator_type(base_type, declarator);
+        if (!insert_symbol(name, declarator->type, kind)) semantic_error_count++;
+    }
+}
+
+/**
+ * @brief Checks whether a declaration's specifiers start with 'typedef'.
+ */
+int is_typedef_specifiers(ASTNode* specifiers) {
+    if (specifiers->kind == AST_DECLARATION_SPECIFIERS) {
+        specifiers = specifiers->children[0];
+    }
+    return specifiers->kind == AST_STORAGE_CLASS_SPECIFIER;
+}
+
+/**
+ * @brief Ranks arithmetic base types for the usual arithmetic conversions:
+ * char < int (and the other integer types) < float < double.
+ * Returns 0 for anything that is not an arithmetic type.
+ */
+static int arithmetic_rank(Type* type) {
+    if (!type || type->kind != TYPE_BASE) return 0;
+    const char* name = type->data.base_name;
+    if (strcmp(name, "void") == 0) return 0;
+    if (strcmp(name, "char") == 0) return 1;
+    if (strcmp(name, "float") == 0) return 3;
+    if (strcmp(name, "double") == 0) return 4;
+    return 2;
+}
+
+static int is_void_type(Type* type) {
+    return type && type->kind == TYPE_BASE && strcmp(type->data.base_name, "void") == 0;
+}
+
 int are_types_compatible(Type* type1, Type* type2) {
     if (!type1 || !type2) return 0; // Incompatible if either is NULL
 
@@ -256,272 +509,372 @@ int are_types_compatible(Type* type1, Type* type2) {
         case TYPE_BASE:
             return strcmp(type1->data.base_name, type2->data.base_name) == 0;
         case TYPE_POINTER:
+            // void* converts to and from any other pointer.
+            if (is_void_type(type1->data.points_to) || is_void_type(type2->data.points_to)) return 1;
             return are_types_compatible(type1->data.points_to, type2->data.points_to);
-        // More complex cases for arrays, structs etc. would go here
+        case TYPE_STRUCT:
+        case TYPE_UNION:
+            return type1 == type2; // Each definition builds its own type
+        // More complex cases for arrays etc. would go here
         default:
             return 0;
     }
 }
 
+// Set while the body of a function definition is being checked.
+static int in_function_body = 0;
+
+// Checks a declaration's declarators in source order (the list holds the last
+// one first). Each initializer is checked before its own declarator is
+// declared; with a NULL base_type nothing is declared.
+static void check_init_declarators(ASTNode* list, Type* base_type) {
+    if (list->num_children > 1) {
+        check_init_declarators(list->children[1], base_type);
+    }
+    ASTNode* declarator = list->children[0];
+    if (declarator->kind == AST_INIT_DECLARATOR) {
+        check_semantics(declarator->children[1]);
+    }
+    if (base_type) {
+        declare_declarator(base_type, declarator, SYM_VARIABLE);
+    }
+}
+
+/**
+ * @brief Checks whether an argument can be passed for a parameter of the given
+ * type. Arithmetic types convert to each other, an array decays to a pointer
+ * to its first element, and 0 converts to any pointer.
+ */
+// Whether 'value' may be assigned to an object of type 'to' or passed for a
+// parameter of that type: integers convert into each other and into floating
+// types (but a floating value into an integer is a mismatch), arrays decay to
+// pointers, 0 is a null pointer and a parameter declared as an array is a
+// pointer.
+static int is_assignable(Type* to, ASTNode* value) {
+    Type* from = value->type;
+    int to_rank = arithmetic_rank(to), from_rank = arithmetic_rank(from);
+    if (to_rank && from_rank) return to_rank >= 3 || from_rank <= 2;
+    Type* element = NULL;
+    if (to->kind == TYPE_POINTER) element = to->data.points_to;
+    if (to->kind == TYPE_ARRAY) element = to->data.array_info.element_type;
+    if (element) {
+        if (from->kind == TYPE_ARRAY) {
+            return is_void_type(element) || are_types_compatible(element, from->data.array_info.element_type);
+        }
+        if (from->kind == TYPE_POINTER) {
+            return is_void_type(element) || is_void_type(from->data.points_to) ||
+                   are_types_compatible(element, from->data.points_to);
+        }
+        if (value->kind == AST_INT_CONSTANT && atoi(value->value) == 0) return 1;
+    }
+    return are_types_compatible(to, from);
+}
+
+// Checks a call's arguments from left to right against the parameters left in
+// *param, advancing *param past each one; index is the position of the first.
+// The list nests to the left: f(a, b, c) holds ((a, b), c). Returns the index
+// after the last argument.
+static int check_call_arguments(ASTNode* arg, Symbol** param, const char* func_name, int index) {
+    if (arg->kind == AST_ARGUMENT_LIST) {
+        index = check_call_arguments(arg->children[0], param, func_name, index);
+        return check_call_arguments(arg->children[1], param, func_name, index);
+    }
+    check_semantics(arg);
+    if (*param) {
+        if (arg->type && (*param)->type && !is_assignable((*param)->type, arg)) {
+            semantic_error("Type mismatch for argument %d in call to '%s'.", index, func_name);
+        }
+        *param = (*param)->next;
+    }
+    return index + 1;
+}
+
 void check_semantics(ASTNode *node) {
     if (!node) return;
 
-       if (strcmp(node->node_type, "DefaultStatement") == 0) {
-        // Nothing to check pre-order, the statement is handled by the loop
-    }
-    // Post-order traversal: process children first.
-    //for (int i = 0; i < node->num_children; i++) {
-    //     check_semantics(node->children[i]);
-    //}
-    // Special handling for function definitions to manage scope.
-    // This must be done *after* the children have been visited in a generic sense,
-    // but we will re-visit the body in the correct scope.
-    if (strcmp(node->node_type, "FunctionDefinition") == 0) {
-        //printf("DEBUG:Semantic Check: Entering function definition\n");
-         // The function signature has been checked. Now handle the body.
-         enter_scope();
-
-         // Find the parameters in the declarator and add them to the new scope.
-         ASTNode* declarator_node = node->children[1];
-         ASTNode* params_ast_node = get_function_parameters_node(declarator_node);
-         Symbol* params_list = build_parameter_list_from_ast(params_ast_node);
-         if (params_list) {
-            //printf("DEBUG:Semantic Check: Adding parameters to scope\n");
-             add_parameters_to_scope(params_list);
-         }
-
-         // Now, check the function body (child 2) within the new scope.
-         //printf("Semantic Check: Checking function body\n");
-         check_semantics(node->children[2]);
-
-         leave_scope();
-         return; // Stop further processing for this node.
-     }
-    // Pre-order actions for nodes that manage context, like Switch
-    if (strcmp(node->node_type, "SwitchStatement") == 0) {
-        // Check the controlling expression type
-        check_semantics(node->children[0]); // Check the expression first
-        Type* expr_type = node->children[0]->type;
-        if (!expr_type || expr_type->kind != TYPE_BASE || strcmp(expr_type->data.base_name, "int") != 0) {
-            fprintf(stderr, "Semantic Error: switch quantity not an integer.\n");
-        }
-    }
-
-    if (strcmp(node->node_type, "CaseStatement") == 0) {
-        // Check that the case expression is a constant integer
-        check_semantics(node->children[0]); // Check the expression
-        ASTNode* case_expr = node->children[0];
-        if (strcmp(case_expr->node_type, "IntConstant") != 0) {
-            fprintf(stderr, "Semantic Error: case label does not reduce to an integer constant.\n");
-        }
-        // The statement part of the case is handled by the loop below
-    }
-    // Post-order actions
-    
-    if (strcmp(node->node_type, "Identifier") == 0) {
-        Symbol *sym = lookup_symbol(node->value);
-        if (!sym) {
-            fprintf(stderr, "Semantic Error: Identifier '%s' is not declared.\n", node->value);
-        } else {
-            node->type = sym->type; // Assign the type from the symbol table to the AST node
-        }
-    } else if (strcmp(node->node_type, "IntConstant") == 0) {
-        node->type = create_base_type("int");
-    } else if (strcmp(node->node_type, "FloatConstant") == 0) {
-        node->type = create_base_type("double");
-    } else if (strcmp(node->node_type, "CharConstant") == 0) {
-        node->type = create_base_type("char");
-    } else if (strcmp(node->node_type, "MemberAccess") == 0) { // For s.m
-        // By this point, the child has been checked due to post-order traversal.
-        ASTNode* struct_node = node->children[0];
-        check_semantics(struct_node);
-        char* member_name = node->value;
-
-        if (!struct_node->type) {
-            // This can happen if the struct variable itself was not declared.
-            // The error for the undeclared identifier would have already been reported.
-            return;
-        }
-
-        if (struct_node->type->kind != TYPE_STRUCT && struct_node->type->kind != TYPE_UNION) {
-            fprintf(stderr, "Semantic Error: Request for member '%s' in something that is not a struct or union.\n", member_name);
-            return;
-        }
-
-        // Find the member in the struct's member list
-        StructMember* member = get_struct_member(struct_node->type, member_name);
-        if (member) {
-            // The type of the whole expression (e.g., v.x1) is the type of the member.
-            node->type = member->type;
-        } else {
-            fprintf(stderr, "Semantic Error: No member named '%s' in '%s %s'.\n",
-                    member_name, struct_node->type->kind == TYPE_STRUCT ? "struct" : "union", struct_node->type->data.record_info.name);
-        }
-    } else if (strcmp(node->node_type, "Assignment") == 0) {
-        ASTNode *lhs = node->children[0];
-        ASTNode *rhs = node->children[1];
-        //printf("DEBUG: Semantic Check: Checking assignment lhs\n");
-        check_semantics(lhs);
-        //printf("DEBUG: Semantic Check: Checking assignment rhs\n");
-        check_semantics(rhs);
-        //printf("DEBUG: Semantic Check: Checking assignment type\n");
-        //printf("DEBUG: %s %s\n", lhs->node_type, rhs->node_type);
-        if (lhs->type && rhs->type) {
-            if (!are_types_compatible(lhs->type, rhs->type)) {
-                // Safely get the name of the LHS. It might not be an identifier (e.g., *p).
-                char* lhs_name = get_declarator_name(lhs);
-                fprintf(stderr, "Semantic Error: Type mismatch in assignment to '%s'.\n", 
-                        lhs_name ? lhs_name : "expression");
-                if (lhs_name) free(lhs_name);
+    switch (node->kind) {
+        case AST_FUNCTION_DEFINITION: { // Enter a scope for the parameters and check the body in it.
+            //printf("DEBUG:Semantic Check: Entering function definition\n");
+            // The function signature has been checked. Now handle the body.
+            enter_scope();
+
+            // Find the parameters in the declarator and add them to the new scope.
+            ASTNode* declarator_node = node->children[1];
+            ASTNode* params_ast_node = get_function_parameters_node(declarator_node);
+            Symbol* params_list = build_parameter_list_from_ast(params_ast_node);
+            if (params_list) {
+                //printf("DEBUG:Semantic Check: Adding parameters to scope\n");
+                if (!add_parameters_to_scope(params_list)) semantic_error_count++;
             }
+
+            // Now, check the function body (child 2) within the new scope.
+            //printf("Semantic Check: Checking function body\n");
+            in_function_body = 1;
+            check_semantics(node->children[2]);
+            in_function_body = 0;
+
+            leave_scope();
+            break;
         }
-        node->type = lhs->type; // The type of an assignment is the type of the left-hand side
-    } else if (strcmp(node->node_type, "BinaryOp") == 0) {
-        ASTNode *left = node->children[0];
-        ASTNode *right = node->children[1];
-        if (left->type && right->type) {
-            if (!are_types_compatible(left->type, right->type)) {
-                 fprintf(stderr, "Semantic Error: Type mismatch in binary operation '%s'.\n", node->value);
+        case AST_COMPOUND_STATEMENT: // A block is a scope of its own,
+        case AST_FOR_DECL_STATEMENT: { // and so is a for loop that declares its counter.
+            enter_scope();
+            for (int i = 0; i < node->num_children; i++) {
+                check_semantics(node->children[i]);
             }
-            // Relational operators result in an int
-            if (strcmp(node->value, "==") == 0 || strcmp(node->value, "!=") == 0 ||
-                strcmp(node->value, "<") == 0 || strcmp(node->value, ">") == 0 ||
-                strcmp(node->value, "<=") == 0 || strcmp(node->value, ">=") == 0) {
-                node->type = create_base_type("int");
+            leave_scope();
+            break;
+        }
+        case AST_DECLARATION: {
+            // File-scope and typedef names were declared by the parser; block-scope
+            // variables are declared here, in the scope of the block being checked.
+            Type* base_type = NULL;
+            if (in_function_body && !is_typedef_specifiers(node->children[0])) {
+                base_type = get_base_type_from_specifiers(node->children[0]);
+            }
+            check_init_declarators(node->children[1], base_type);
+            break;
+        }
+        case AST_SWITCH_STATEMENT: {
+            // Check the controlling expression type
+            check_semantics(node->children[0]); // Check the expression first
+            Type* expr_type = node->children[0]->type;
+            if (!expr_type || expr_type->kind != TYPE_BASE || strcmp(expr_type->data.base_name, "int") != 0) {
+                semantic_error("switch quantity not an integer.");
+            }
+            // Post-order check for the switch body is implicitly handled by the traversal loop.
+            // Duplicate case checks would require passing state down, which is more complex.
+            // For now, we rely on the IR generation phase to handle the logic.
+            break;
+        }
+        case AST_CASE_STATEMENT: {
+            // Check that the case expression is a constant integer
+            check_semantics(node->children[0]); // Check the expression
+            ASTNode* case_expr = node->children[0];
+            if (case_expr->kind != AST_INT_CONSTANT) {
+                semantic_error("case label does not reduce to an integer constant.");
+            }
+            // The statement part of the case is checked with the other children
+            for (int i = 0; i < node->num_children; i++) {
+                check_semantics(node->children[i]);
+            }
+            break;
+        }
+        case AST_IDENTIFIER: {
+            Symbol *sym = lookup_symbol(node->value);
+            if (!sym) {
+                semantic_error("Identifier '%s' is not declared.", node->value);
+            } else {
+                node->type = sym->type; // Assign the type from the symbol table to the AST node
+            }
+            break;
+        }
+        case AST_INT_CONSTANT: {
+            node->type = create_base_type("int");
+            break;
+        }
+        case AST_FLOAT_CONSTANT: {
+            node->type = create_base_type("double");
+            break;
+        }
+        case AST_CHAR_CONSTANT: {
+            node->type = create_base_type("char");
+            break;
+        }
+        case AST_MEMBER_ACCESS: { // For s.m
+            // By this point, the child has been checked due to post-order traversal.
+            ASTNode* struct_node = node->children[0];
+            check_semantics(struct_node);
+            const char* member_name = node->value;
+
+            if (!struct_node->type) {
+                // This can happen if the struct variable itself was not declared.
+                // The error for the undeclared identifier would have already been reported.
+                return;
+            }
+
+            if (struct_node->type->kind != TYPE_STRUCT && struct_node->type->kind != TYPE_UNION) {
+                semantic_error("Request for member '%s' in something that is not a struct or union.", member_name);
+                return;
+            }
+
+            // Find the member in the struct's member list
+            StructMember* member = get_struct_member(struct_node->type, member_name);
+            if (member) {
+                // The type of the whole expression (e.g., v.x1) is the type of the member.
+                node->type = member->type;
             } else {
-                node->type = left->type; // Result type is the same as operands for now
+                semantic_error("No member named '%s' in '%s %s'.",
+                        member_name, struct_node->type->kind == TYPE_STRUCT ? "struct" : "union", struct_node->type->data.record_info.name);
             }
+            break;
         }
-    } else if (strcmp(node->node_type, "FunctionCall") == 0) {
-        ASTNode* func_ident = node->children[0];
-        Symbol* func_sym = lookup_symbol(func_ident->value);
-        printf("Semantic Check: Analyzing call to function '%s'\n", func_ident->value);
-
-        if (!func_sym || func_sym->kind != SYM_FUNCTION) {
-            fprintf(stderr, "Semantic Error: Calling '%s' which is not a function.\n", func_ident->value);
-            return;
-        }
-
-        node->type = func_sym->type->data.function_info.return_type;
-
-        // Check argument count and types
-        printf("Semantic Check: Checking argument count and types\n");
-        Symbol* expected_param = func_sym->type->data.function_info.params;
-        //printf("DEBUG: Obtained expected parameters from Symbol Table \n");
-        //printf("Number of children: %d\n", node->num_children );
-        ASTNode* arg_list = (node->num_children > 1) ? node->children[1] : NULL;
-        //printf("DEBUG: Obtained argument list from AST \n");
-
-        int arg_count = 0;
-        if((arg_list!= NULL) && (strcmp(arg_list->node_type, "ArgumentList") == 0)){
-            // This is a simplified traversal for an ArgumentList
-            while(arg_list) {
-                printf("Semantic Check: Checking argument %d\n", arg_count);
-                ASTNode* current_arg= arg_list->children[arg_count];
-                printf("Semantic Check: Checking argument type for argument %s\n",current_arg->value);
-                if (!expected_param) {
-                    fprintf(stderr, "Semantic Error: Too many arguments to function '%s'.\n", func_ident->value);
-                    break;
+        case AST_ASSIGNMENT: {
+            ASTNode *lhs = node->children[0];
+            ASTNode *rhs = node->children[1];
+            //printf("DEBUG: Semantic Check: Checking assignment lhs\n");
+            check_semantics(lhs);
+            //printf("DEBUG: Semantic Check: Checking assignment rhs\n");
+            check_semantics(rhs);
+            //printf("DEBUG: Semantic Check: Checking assignment type\n");
+            //printf("DEBUG: %s %s\n", lhs->node_type, rhs->node_type);
+            if (lhs->type && rhs->type) {
+                if (!is_assignable(lhs->type, rhs)) {
+                    // Safely get the name of the LHS. It might not be an identifier (e.g., *p).
+                    const char* lhs_name = get_declarator_name(lhs);
+                    semantic_error("Type mismatch in assignment to '%s'.", 
+                            lhs_name ? lhs_name : "expression");
                 }
-                if (!are_types_compatible(expected_param->type, current_arg->type)) {
-                    fprintf(stderr, "Semantic Check: Expected type for argument %d is '%s'.\n", arg_count, expected_param->type->data.base_name);
-                    fprintf(stderr, "Semantic Error: Type mismatch for argument %d in call to '%s'.\n", 
-                            arg_count, func_ident->value ? func_ident->value : "function");
+            }
+            node->type = lhs->type; // The type of an assignment is the type of the left-hand side
+            break;
+        }
+        case AST_BINARY_OP: {
+            ASTNode *left = node->children[0];
+            ASTNode *right = node->children[1];
+            check_semantics(left);
+            check_semantics(right);
+            if (left->type && right->type) {
+                int left_rank = arithmetic_rank(left->type);
+                int right_rank = arithmetic_rank(right->type);
+                // Mixed arithmetic operands are converted to the wider type.
+                if (!(left_rank && right_rank) && !are_types_compatible(left->type, right->type)) {
+                     semantic_error("Type mismatch in binary operation '%s'.", node->value);
                 }
-                printf("Semantic Check: Argument %d type matches expected type.\n", arg_count);
-                expected_param = expected_param->next;
-                if (arg_list->num_children > arg_count+1) {
-                    printf("Semantic Check: Moving to next argument\n");
-                    arg_count++;
-                    //arg_list = arg_list->children[1];
+                // Relational operators result in an int
+                if (node->op == AST_OP_EQ || node->op == AST_OP_NE ||
+                    node->op == AST_OP_LT || node->op == AST_OP_GT ||
+                    node->op == AST_OP_LE || node->op == AST_OP_GE) {
+                    node->type = create_base_type("int");
+                } else if (right_rank > left_rank && left_rank) {
+                    node->type = right->type;
                 } else {
-                    printf("Semantic Check: No more arguments\n");
-                    break;
+                    node->type = left->type; // Result type is the same as operands for now
                 }
             }
-        }else{
-            if (arg_list != NULL) {
-                //printf("DEBUG: arg_list is not NULL\n");
-                if (!expected_param) {
-                        fprintf(stderr, "Semantic Error: Too many arguments to function '%s'.\n", func_ident->value);
+            break;
+        }
+        case AST_FUNCTION_CALL: {
+            ASTNode* func_ident = node->children[0];
+            Symbol* func_sym = lookup_symbol(func_ident->value);
+            printf("Semantic Check: Analyzing call to function '%s'\n", func_ident->value);
+
+            Symbol* expected_param = NULL;
+            if (!func_sym) {
+                // An undeclared function is implicitly declared to return int
+                // and to take whatever arguments it is given (C89).
+                fprintf(stderr, "Warning: Implicit declaration of function '%s'.\n", func_ident->value);
+                node->type = create_base_type("int");
+            } else if (func_sym->kind != SYM_FUNCTION) {
+                semantic_error("Calling '%s' which is not a function.", func_ident->value);
+                return;
+            } else {
+                node->type = func_sym->type->data.function_info.return_type;
+                expected_param = func_sym->type->data.function_info.params;
+            }
+
+            // Check argument count and types
+            printf("Semantic Check: Checking argument count and types\n");
+            int arg_count = 0;
+            if (node->num_children > 1) {
+                arg_count = check_call_arguments(node->children[1], &expected_param, func_ident->value, 0);
+            }
+            if (func_sym) {
+                int param_count = 0;
+                for (Symbol* param = func_sym->type->data.function_info.params; param; param = param->next) {
+                    param_count++;
                 }
-                if (!are_types_compatible(expected_param->type, arg_list->type)) {
-                        //fprintf(stderr, "Semantic Check: Expected type for argument %d is '%s'.\n", arg_count, expected_param->type->data.base_name);
-                        fprintf(stderr, "Semantic Error: Type mismatch for argument %d in call to '%s'.\n", 
-                                arg_count, func_ident->value ? func_ident->value : "function");
+                if (arg_count > param_count) {
+                    semantic_error("Too many arguments to function '%s'.", func_ident->value);
+                } else if (arg_count < param_count) {
+                    semantic_error("Too few arguments to function '%s'.", func_ident->value);
                 }
-                expected_param = expected_param->next;
             }
+            break;
         }
-        if (expected_param != NULL) {
-            fprintf(stderr, "Semantic Error: Too few arguments to function '%s'.\n", func_ident->value);
-        }
-    } else if (strcmp(node->node_type, "ArrayAccess") == 0) {
-        ASTNode* array_node = node->children[0];
-        ASTNode* index_node = node->children[1];
-        check_semantics(array_node);
-        check_semantics(index_node);
-        if (array_node->type && array_node->type->kind == TYPE_ARRAY) {
-            // The type of the result of an array access is the element type.
-            node->type = array_node->type->data.array_info.element_type;
-
-            // Check for out-of-bounds access if the index is a constant.
-            if (strcmp(index_node->node_type, "IntConstant") == 0) {
-                int index_val = atoi(index_node->value);
-                int array_size = array_node->type->data.array_info.size;
-                if (index_val < 0 || index_val >= array_size) {
-                    char* array_name = get_declarator_name(array_node);
-                    fprintf(stderr, "Semantic Error: Array index %d is out of bounds for array '%s' of size %d.\n", 
-                            index_val, array_name ? array_name : "array", array_size);
-                    if (array_name) free(array_name);
-                }
+        case AST_UNARY_OP: {
+            ASTNode* operand = node->children[0];
+            check_semantics(operand);
+            Type* type = operand->type;
+            if (!type) break;
+            if (node->op == AST_OP_ADDR) {
+                node->type = create_pointer_type(type);
+            } else if (node->op == AST_OP_DEREF) {
+                if (type->kind == TYPE_POINTER) node->type = type->data.points_to;
+                else if (type->kind == TYPE_ARRAY) node->type = type->data.array_info.element_type;
+            } else if (node->op == AST_OP_LOGICAL_NOT) {
+                node->type = create_base_type("int");
+            } else {
+                node->type = type; // Unary +, - and ~ keep the operand's type
             }
-        } else {
-            fprintf(stderr, "Semantic Error: Attempting to index a non-array type.\n");
+            break;
         }
-    } else if (strcmp(node->node_type, "PointerMemberAccess") == 0) { // For p->m
-        ASTNode* ptr_node = node->children[0];
-        check_semantics(ptr_node);
-        char* member_name = node->value;
-
-        if (!ptr_node->type) {
-            // Error for undeclared identifier would have already been reported.
-            return;
+        case AST_ARRAY_ACCESS: {
+            ASTNode* array_node = node->children[0];
+            ASTNode* index_node = node->children[1];
+            check_semantics(array_node);
+            check_semantics(index_node);
+            if (array_node->type && array_node->type->kind == TYPE_ARRAY) {
+                // The type of the result of an array access is the element type.
+                node->type = array_node->type->data.array_info.element_type;
+
+                // Check for out-of-bounds access if the index is a constant.
+                if (index_node->kind == AST_INT_CONSTANT) {
+                    int index_val = atoi(index_node->value);
+                    int array_size = array_node->type->data.array_info.size;
+                    if (array_size > 0 && (index_val < 0 || index_val >= array_size)) { // Size 0: int a[]
+                        const char* array_name = get_declarator_name(array_node);
+                        semantic_error("Array index %d is out of bounds for array '%s' of size %d.", 
+                                index_val, array_name ? array_name : "array", array_size);
+                    }
+                }
+            } else if (array_node->type && array_node->type->kind == TYPE_POINTER) {
+                node->type = array_node->type->data.points_to;
+            } else if (array_node->type) {
+                semantic_error("Attempting to index a non-array type.");
+            }
+            break;
         }
+        case AST_POINTER_MEMBER_ACCESS: { // For p->m
+            ASTNode* ptr_node = node->children[0];
+            check_semantics(ptr_node);
+            const char* member_name = node->value;
+
+            if (!ptr_node->type) {
+                // Error for undeclared identifier would have already been reported.
+                return;
+            }
 
-        // 1. Check if the left side is a pointer.
-        if (ptr_node->type->kind != TYPE_POINTER) {
-            fprintf(stderr, "Semantic Error: Arrow operator -> applied to non-pointer type.\n");
-            return;
-        }
+            // 1. Check if the left side is a pointer.
+            if (ptr_node->type->kind != TYPE_POINTER) {
+                semantic_error("Arrow operator -> applied to non-pointer type.");
+                return;
+            }
 
-        Type* struct_type = ptr_node->type->data.points_to;
-        // 2. Check if it points to a struct or union.
-        if (struct_type->kind != TYPE_STRUCT && struct_type->kind != TYPE_UNION) {
-            fprintf(stderr, "Semantic Error: Arrow operator -> applied to pointer to non-struct/union type.\n");
-            return;
-        }
+            Type* struct_type = ptr_node->type->data.points_to;
+            // 2. Check if it points to a struct or union.
+            if (struct_type->kind != TYPE_STRUCT && struct_type->kind != TYPE_UNION) {
+                semantic_error("Arrow operator -> applied to pointer to non-struct/union type.");
+                return;
+            }
 
-        // 3. Find the member in the struct's member list.
-        StructMember* member = get_struct_member(struct_type, member_name);
-        if (member) {
-            // 4. The type of the whole expression is the type of the member.
-            node->type = member->type;
-        } else {
-            fprintf(stderr, "Semantic Error: No member named '%s' in '%s %s'.\n",
-                    member_name, struct_type->kind == TYPE_STRUCT ? "struct" : "union", struct_type->data.record_info.name);
-        }
-    } else if (strcmp(node->node_type, "SwitchStatement") == 0) {
-        // Post-order check for the switch body is implicitly handled by the traversal loop.
-        // Duplicate case checks would require passing state down, which is more complex.
-        // For now, we rely on the IR generation phase to handle the logic.
-    } else {
-        //printf("DEBUG: Processing Node: %s, %s, %d\n", node->node_type, node->value ? node->value : "no value" , node->num_children);
-        for(int i = 0; i < node->num_children; i++) {
-            check_semantics(node->children[i]);
+            // 3. Find the member in the struct's member list.
+            StructMember* member = get_struct_member(struct_type, member_name);
+            if (member) {
+                // 4. The type of the whole expression is the type of the member.
+                node->type = member->type;
+            } else {
+                semantic_error("No member named '%s' in '%s %s'.",
+                        member_name, struct_type->kind == TYPE_STRUCT ? "struct" : "union", struct_type->data.record_info.name);
+            }
+            break;
         }
+        default:
+            for (int i = 0; i < node->num_children; i++) {
+                check_semantics(node->children[i]);
+            }
+            break;
     }
-
 }
 
 // Helper function to calculate and store the layout of a struct/union.
@@ -537,7 +890,7 @@ void calculate_struct_layout(Type* struct_type, ASTNode* decl_list_node) {
     while (decl_list_node) {
         ASTNode* struct_decl;
         // The AST for a list is (list, item). The base case is just (item).
-        if (strcmp(decl_list_node->node_type, "StructDeclarationList") == 0) {
+        if (decl_list_node->kind == AST_STRUCT_DECLARATION_LIST) {
              struct_decl = (decl_list_node->num_children > 1) ? decl_list_node->children[1] : decl_list_node->children[0];
         } else { // Base case where the node is already a StructDeclaration
              struct_decl = decl_list_node;
@@ -550,7 +903,7 @@ void calculate_struct_layout(Type* struct_type, ASTNode* decl_list_node) {
         while (member_declarator_list) {
             ASTNode* declarator = member_declarator_list->children[0];
             // printf("DEBUG: Processing Member Declarator Node: %s, %s, %d\n", declarator->node_type, declarator->value ? declarator->value : "no value" , declarator->num_children);   
-            char* member_name = get_declarator_name(declarator);
+            const char* member_name = get_declarator_name(declarator);
             Type* member_type = build_declarator_type(base_member_type, declarator);
             // printf("DEBUG: Found Member: %s, Type: %s\n", member_name, member_type->data.base_name);
             StructMember* new_member = (StructMember*)malloc(sizeof(StructMember));
@@ -577,7 +930,7 @@ void calculate_struct_layout(Type* struct_type, ASTNode* decl_list_node) {
             member_declarator_list = (member_declarator_list->num_children > 1) ? member_declarator_list->children[1] : NULL;
         }
         // Move to the next item in the list.
-        if (strcmp(decl_list_node->node_type, "StructDeclarationList") == 0 && decl_list_node->num_children > 1) {
+        if (decl_list_node->kind == AST_STRUCT_DECLARATION_LIST && decl_list_node->num_children > 1) {
             decl_list_node = decl_list_node->children[0];
         } else {
             decl_list_node = NULL; // End of the list
@@ -593,6 +946,7 @@ void calculate_struct_layout(Type* struct_type, ASTNode* decl_list_node) {
 }
 
 // Improved function to get a member's offset from a struct/union type.
+// member_name must be interned (AST node values always are).
 int get_member_offset(Type* struct_type, const char* member_name) {
     //printf("DEBUG: Getting member offset for member '%s'\n", member_name);
     //printf("DEBUG: Struct type kind: %d\n", struct_type ? struct_type->kind : -1);
@@ -611,7 +965,7 @@ int get_member_offset(Type* struct_type, const char* member_name) {
 
     StructMember* member = struct_type->data.record_info.members;
     while (member) {
-        if (strcmp(member->name, member_name) == 0) {
+        if (member->name == member_name) {
             return member->offset;
         }
         member = member->next;
@@ -3,13 +3,72 @@
 
 #include "symbol_table.h"
 
+/* Kinds of AST nodes, assigned by create_node in parser.y.
+ * Passes dispatch on this with a switch or an indexed handler table. */
+typedef enum {
+    /* Program structure and declarations */
+    AST_PROGRAM, AST_FUNCTION_DEFINITION, AST_DECLARATION, AST_DECLARATION_SPECIFIERS,
+    AST_STORAGE_CLASS_SPECIFIER, AST_TYPE_SPECIFIER, AST_TYPE_NAME, AST_TYPE_QUALIFIER,
+    /* Declarators */
+    AST_INIT_DECLARATOR_LIST, AST_INIT_DECLARATOR, AST_IDENTIFIER, AST_POINTER_DECLARATOR,
+    AST_ARRAY_DECLARATOR, AST_FUNCTION_DECLARATOR, AST_POINTER, AST_PARAMETER_LIST,
+    AST_PARAMETER_DECLARATION, AST_EMPTY_PARAMETER_LIST,
+    /* Abstract declarators (type names) */
+    AST_POINTER_ABSTRACT_DECLARATOR, AST_PARENTHESIZED_ABSTRACT_DECLARATOR,
+    AST_ABSTRACT_ARRAY_SUFFIX, AST_ABSTRACT_FUNCTION_SUFFIX,
+    /* Struct, union and enum specifiers */
+    AST_STRUCT_SPECIFIER, AST_STRUCT_TOKEN, AST_UNION_TOKEN, AST_STRUCT_DECLARATION_LIST,
+    AST_STRUCT_DECLARATION, AST_SPECIFIER_QUALIFIER_LIST, AST_STRUCT_DECLARATOR_LIST,
+    AST_ENUM_SPECIFIER, AST_ENUMERATOR_LIST, AST_ENUMERATOR,
+    /* Initializers */
+    AST_INITIALIZER_LIST, AST_INIT_VALUES,
+    /* Statements */
+    AST_COMPOUND_STATEMENT, AST_BLOCK_ITEM_LIST, AST_EMPTY_STATEMENT,
+    AST_EXPRESSION_STATEMENT, AST_IF_STATEMENT, AST_IF_ELSE_STATEMENT,
+    AST_SWITCH_STATEMENT, AST_WHILE_STATEMENT, AST_DO_WHILE_STATEMENT, AST_FOR_STATEMENT,
+    AST_FOR_DECL_STATEMENT, AST_LABELED_STATEMENT, AST_CASE_STATEMENT,
+    AST_DEFAULT_STATEMENT, AST_RETURN, AST_BREAK_STATEMENT, AST_CONTINUE_STATEMENT,
+    /* Expressions */
+    AST_EMPTY_EXPRESSION, AST_ASSIGNMENT, AST_BINARY_OP, AST_UNARY_OP,
+    AST_PREFIX_INCREMENT, AST_PREFIX_DECREMENT, AST_POSTFIX_INCREMENT,
+    AST_POSTFIX_DECREMENT, AST_SIZEOF_UNARY_EXPR, AST_SIZEOF_TYPE_EXPR, AST_FUNCTION_CALL,
+    AST_ARGUMENT_LIST, AST_ARRAY_ACCESS, AST_MEMBER_ACCESS, AST_POINTER_MEMBER_ACCESS,
+    /* Constants and literals */
+    AST_INT_CONSTANT, AST_FLOAT_CONSTANT, AST_CHAR_CONSTANT, AST_STRING_LITERAL,
+    AST_KIND_COUNT
+} ASTNodeKind;
+
+/* Operators of BinaryOp, UnaryOp and Assignment nodes, assigned in parser.y. */
+typedef enum {
+    AST_OP_NONE,
+    /* Binary */
+    AST_OP_ADD, AST_OP_SUB, AST_OP_MUL, AST_OP_DIV, AST_OP_MOD,
+    AST_OP_EQ, AST_OP_NE, AST_OP_LT, AST_OP_GT, AST_OP_LE, AST_OP_GE,
+    AST_OP_LOGICAL_AND, AST_OP_LOGICAL_OR,
+    AST_OP_BIT_AND, AST_OP_BIT_OR, AST_OP_XOR, AST_OP_SHL, AST_OP_SHR,
+    AST_OP_COMMA,
+    /* Unary */
+    AST_OP_ADDR, AST_OP_DEREF, AST_OP_PLUS, AST_OP_NEG, AST_OP_BIT_NOT, AST_OP_LOGICAL_NOT,
+    /* Assignment */
+    AST_OP_ASSIGN, AST_OP_MUL_ASSIGN, AST_OP_DIV_ASSIGN, AST_OP_MOD_ASSIGN,
+    AST_OP_ADD_ASSIGN, AST_OP_SUB_ASSIGN,
+    AST_OP_COUNT
+} ASTOperator;
+
+/* Printable names, indexed by ASTNodeKind and ASTOperator. */
+extern const char *const ast_kind_names[AST_KIND_COUNT];
+extern const char *const ast_operator_symbols[AST_OP_COUNT];
+
 /* AST Node Structure */
 typedef struct ASTNode {
-    char *node_type;
-    char *value;
+    ASTNodeKind kind;
+    ASTOperator op;        // For BinaryOp, UnaryOp and Assignment; AST_OP_NONE otherwise
+    const char *value;     // Interned, or NULL
     int num_children;
+    int children_capacity; // Room in 'children' before append_child must grow it
     struct ASTNode **children;
     Type *type; // Add this field to carry type information
+    int ir_label;          // IR label of a case/default statement, or -1
 } ASTNode;
 
 /* Function Prototypes from parser.y that are needed by semantics.c */
@@ -19,8 +78,12 @@ void yyerror(const char *s);
 Type* get_base_type_from_specifiers(ASTNode* specifiers_node);
 int is_function_declarator(ASTNode* declarator_node);
 void check_semantics(ASTNode *node);
-char* get_declarator_name(ASTNode* declarator_node);
+extern int semantic_error_count; // Semantic errors reported so far
+const char* get_declarator_name(ASTNode* declarator_node);
 Type* build_declarator_type(Type* base_type, ASTNode* declarator_node);
+void declare_function(const char* name, Type* func_type);
+void declare_declarator(Type* base_type, ASTNode* declarator, int kind);
+int is_typedef_specifiers(ASTNode* specifiers);
 ASTNode* get_function_parameters_node(ASTNode* declarator_node);
 Symbol* build_parameter_list_from_ast(ASTNode* param_list_node);
 void calculate_struct_layout(Type* struct_type, ASTNode* decl_list_node);
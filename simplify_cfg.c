@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "passes.h"
+#include "cfg.h"
+#include "alloc.h"
+
+/*
+ * Control-flow graph cleanup, repeated until nothing changes:
+ *  - blocks that no path from the entry reaches are deleted;
+ *  - empty blocks (nothing but an optional GOTO) are bypassed: their
+ *    predecessors jump straight to the successor;
+ *  - a block whose only successor has no other predecessor absorbs it.
+ * Phis are kept consistent, so the pass works in and out of SSA form.
+ */
+
+static int pred_slot(BasicBlock *block, BasicBlock *pred) {
+    for (int p = 0; p < block->num_preds; p++) {
+        if (block->preds[p] == pred) return p;
+    }
+    return -1;
+}
+
+static int remove_unreachable_blocks(IRFunction *fn) {
+    BasicBlock **order = (BasicBlock**) checked_calloc(fn->num_blocks, sizeof(BasicBlock*));
+    compute_reverse_postorder(fn, order);
+    free(order);
+    int removed = 0;
+    for (int b = 0; b < fn->num_blocks; b++) {
+        if (fn->blocks[b]->rpo < 0 && b != CFG_ENTRY && b != CFG_EXIT) {
+            delete_basic_block(fn, fn->blocks[b]);
+            removed++;
+        }
+    }
+    compact_blocks(fn);
+    return removed;
+}
+
+static int is_empty_block(BasicBlock *block) {
+    if (block->num_phis > 0 || block->num_succs != 1) return 0;
+    return block->num_instrs == 0 ||
+           (block->num_instrs == 1 && block->instrs[0].opcode == IR_GOTO);
+}
+
+// Sends every predecessor of an empty block straight to its successor.
+static int bypass_empty_block(IRFunction *fn, BasicBlock *block) {
+    BasicBlock *succ = block->succs[0];
+    if (succ == block) return 0;
+    int slot = pred_slot(succ, block);
+    // A predecessor that already reaches the successor directly would need
+    // two different phi arguments on one edge.
+    if (succ->num_phis > 0) {
+        for (int p = 0; p < block->num_preds; p++) {
+            if (pred_slot(succ, block->preds[p]) >= 0) return 0;
+        }
+    }
+    while (block->num_preds > 0) {
+        BasicBlock *pred = block->preds[0];
+        redirect_cfg_edge(pred, block, succ);
+        int new_slot = pred_slot(succ, pred);
+        for (int i = 0; i < succ->num_phis; i++) {
+            succ->phis[i].args[new_slot] = succ->phis[i].args[slot];
+        }
+    }
+    delete_basic_block(fn, block);
+    return 1;
+}
+
+// Appends a block's only successor to it when nothing else reaches that
+// successor.
+static int merge_into_predecessor(IRFunction *fn, BasicBlock *block) {
+    if (block->num_succs != 1) return 0;
+    BasicBlock *succ = block->succs[0];
+    if (succ == block || succ->num_preds != 1 || succ->id == CFG_EXIT || succ->num_phis > 0) return 0;
+    Instruction *last = block_terminator(block);
+    if (last && last->opcode != IR_GOTO) return 0; // RETURN or HALT
+    if (last) block->num_instrs--;
+
+    remove_cfg_edge(block, succ);
+    for (int i = 0; i < succ->num_instrs; i++) {
+        block_append(block, succ->instrs[i]);
+    }
+    // Take over the successor's edges in order, keeping its fall-through first.
+    for (int s = 0; s < succ->num_succs; s++) {
+        BasicBlock *next = succ->succs[s];
+        int from_slot = pred_slot(next, succ);
+        add_cfg_edge(block, next);
+        int to_slot = pred_slot(next, block);
+        for (int i = 0; i < next->num_phis; i++) {
+            next->phis[i].args[to_slot] = next->phis[i].args[from_slot];
+        }
+    }
+    delete_basic_block(fn, succ);
+    return 1;
+}
+
+int run_simplify_cfg(IRFunction *fn) {
+    int changes = 0;
+    int changed = 1;
+    while (changed) {
+        changed = remove_unreachable_blocks(fn);
+        for (int b = 0; b < fn->num_blocks; b++) {
+            BasicBlock *block = fn->blocks[b];
+            if (!block || b == CFG_ENTRY || b == CFG_EXIT) continue;
+            if (is_empty_block(block)) {
+                changed += bypass_empty_block(fn, block);
+            } else {
+                while (fn->blocks[b] && merge_into_predecessor(fn, block)) changed++;
+            }
+        }
+        compact_blocks(fn);
+        changes += changed;
+    }
+    return changes;
+}
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "passes.h"
+#include "string_pool.h"
+#include "alloc.h"
+
+/*
+ * Scalar replacement of aggregates. A local struct (or array) that is only
+ * ever read and written at constant offsets, and whose name appears nowhere
+ * else, is split into one variable per offset:
+ *
+ *         ALLOC_HEAP p, 8
+ *         INDEX_STORE p, 4, 10        =>      ASSIGN p.f4, 10
+ *         INDEX_LOAD t0, p, 4                 ASSIGN t0, p.f4
+ *
+ * The new variables are plain scalars, so SSA construction renames them and
+ * the value-based passes see through them. A use of the name itself (its
+ * address taken, passed to a call, copied, indexed by a variable) keeps the
+ * aggregate in memory.
+ */
+
+typedef enum { NOT_AGGREGATE, SPLITTABLE, KEPT } AggregateState;
+
+static int is_allocation(OpCode opcode) {
+    return opcode == IR_ALLOC_HEAP || opcode == IR_ALLOC_STACK;
+}
+
+// Marks an aggregate named by 'op' as kept in memory.
+static void keep_aggregate(char *state, int num_names, Operand op) {
+    if (op.type == OP_IDENTIFIER && op.val.name < num_names && state[op.val.name] == SPLITTABLE) {
+        state[op.val.name] = KEPT;
+    }
+}
+
+static int is_split(const char *state, int num_names, Operand op) {
+    return op.type == OP_IDENTIFIER && op.val.name < num_names && state[op.val.name] == SPLITTABLE;
+}
+
+// The scalar for the field of 'aggregate' at 'offset', named <aggregate>.f<offset>.
+static Operand field_operand(StringId aggregate, int offset) {
+    const char *name = string_from_id(aggregate);
+    char *field = (char*) checked_calloc(strlen(name) + 16, sizeof(char));
+    sprintf(field, "%s.f%d", name, offset);
+    Operand op = create_operand_identifier(field);
+    free(field);
+    return op;
+}
+
+int run_sroa(IRFunction *fn) {
+    int num_names = string_pool_size();
+    char *state = (char*) checked_calloc(num_names, sizeof(char));
+    for (int i = 0; i < fn->num_instrs; i++) {
+        const Instruction *instr = &fn->instrs[i];
+        if (is_allocation(instr->opcode) && instr->result.type == OP_IDENTIFIER) {
+            state[instr->result.val.name] = SPLITTABLE;
+        }
+    }
+    // Globals live in memory shared with other functions.
+    for (int i = 0; i < ir_module.globals.num_instrs; i++) {
+        keep_aggregate(state, num_names, ir_module.globals.instrs[i].result);
+    }
+
+    for (int i = 0; i < fn->num_instrs; i++) {
+        const Instruction *instr = &fn->instrs[i];
+        switch (instr->opcode) {
+            case IR_ALLOC_HEAP: case IR_ALLOC_STACK:
+                keep_aggregate(state, num_names, instr->arg1);
+                keep_aggregate(state, num_names, instr->arg2);
+                break;
+            case IR_INDEX_LOAD:
+                keep_aggregate(state, num_names, instr->result);
+                if (instr->arg2.type != OP_INT_CONST) keep_aggregate(state, num_names, instr->arg1);
+                keep_aggregate(state, num_names, instr->arg2);
+                break;
+            case IR_INDEX_STORE:
+                if (instr->arg1.type != OP_INT_CONST) keep_aggregate(state, num_names, instr->result);
+                keep_aggregate(state, num_names, instr->arg1);
+                keep_aggregate(state, num_names, instr->arg2);
+                break;
+            case IR_FREE_HEAP:
+                break; // Dropped with the allocation
+            case IR_CALL: case IR_TAILCALL:
+                // arg1 names the callee.
+                keep_aggregate(state, num_names, instr->result);
+                keep_aggregate(state, num_names, instr->arg2);
+                break;
+            default:
+                keep_aggregate(state, num_names, instr->result);
+                keep_aggregate(state, num_names, instr->arg1);
+                keep_aggregate(state, num_names, instr->arg2);
+                break;
+        }
+    }
+
+    int changes = 0;
+    int kept = 0;
+    for (int i = 0; i < fn->num_instrs; i++) {
+        Instruction instr = fn->instrs[i];
+        if (is_allocation(instr.opcode) && is_split(state, num_names, instr.result)) {
+            changes++;
+            continue;
+        }
+        if (instr.opcode == IR_FREE_HEAP && is_split(state, num_names, instr.arg1)) continue;
+        if (instr.opcode == IR_INDEX_LOAD && is_split(state, num_names, instr.arg1)) {
+            instr.opcode = IR_ASSIGN;
+            instr.arg1 = field_operand(instr.arg1.val.name, instr.arg2.val.int_val);
+            instr.arg2 = create_operand_none();
+            changes++;
+        } else if (instr.opcode == IR_INDEX_STORE && is_split(state, num_names, instr.result)) {
+            instr.opcode = IR_ASSIGN;
+            instr.result = field_operand(instr.result.val.name, instr.arg1.val.int_val);
+            instr.arg1 = instr.arg2;
+            instr.arg2 = create_operand_none();
+            changes++;
+        }
+        fn->instrs[kept++] = instr;
+    }
+    fn->num_instrs = kept;
+    free(state);
+    return changes;
+}
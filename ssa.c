@@ -0,0 +1,372 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ssa.h"
+#include "cfg.h"
+#include "string_pool.h"
+#include "alloc.h"
+
+/*
+ * Construction follows Cytron et al.: phis go at the iterated dominance
+ * frontier of each variable's definitions, then a walk over the dominator
+ * tree renames every definition to a fresh temporary. Phis are only placed
+ * for variables that are live into some block ("semi-pruned" SSA).
+ */
+
+typedef struct {
+    int num_vars;
+    Operand *vars;    // Variable index -> original operand
+    int *name_var;    // StringId -> variable index, or -1
+    int num_names;
+    int *temp_var;    // Temporary -> variable index, or -1
+    int num_temps;
+} SSAVars;
+
+static int var_of(const SSAVars *sv, Operand op) {
+    if (op.type == OP_IDENTIFIER && op.val.name < sv->num_names) return sv->name_var[op.val.name];
+    if (op.type == OP_TEMPORARY && op.val.temp < sv->num_temps) return sv->temp_var[op.val.temp];
+    return -1;
+}
+
+// Identifiers that name storage rather than a value: their address is taken,
+// they are indexed, or they are allocated.
+static void exclude_storage_names(const Instruction *instr, char *excluded) {
+    switch (instr->opcode) {
+        case IR_ADDR_OF: case IR_ADDR: case IR_INDEX_LOAD: case IR_CALL: case IR_TAILCALL:
+            if (instr->arg1.type == OP_IDENTIFIER) excluded[instr->arg1.val.name] = 1;
+            break;
+        case IR_ALLOC_HEAP: case IR_ALLOC_STACK: case IR_INDEX_STORE:
+            if (instr->result.type == OP_IDENTIFIER) excluded[instr->result.val.name] = 1;
+            break;
+        default:
+            break;
+    }
+}
+
+static void find_variables(IRFunction *fn, SSAVars *sv) {
+    sv->num_names = string_pool_size();
+    sv->num_temps = ir_module.num_temps;
+    sv->name_var = (int*) checked_calloc(sv->num_names, sizeof(int));
+    sv->temp_var = (int*) checked_calloc(sv->num_temps, sizeof(int));
+    char *excluded = (char*) checked_calloc(sv->num_names, sizeof(char));
+    char *defined = (char*) checked_calloc(sv->num_names, sizeof(char));
+    int *temp_defs = (int*) checked_calloc(sv->num_temps, sizeof(int));
+
+    // Anything the global initializers define is visible to every function.
+    for (int i = 0; i < ir_module.globals.num_instrs; i++) {
+        Instruction *instr = &ir_module.globals.instrs[i];
+        if (ir_defines_result(instr->opcode) && instr->result.type == OP_IDENTIFIER) {
+            excluded[instr->result.val.name] = 1;
+        }
+    }
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        for (int i = 0; i < block->num_instrs; i++) {
+            Instruction *instr = &block->instrs[i];
+            exclude_storage_names(instr, excluded);
+            if (!ir_defines_result(instr->opcode)) continue;
+            if (instr->result.type == OP_IDENTIFIER) defined[instr->result.val.name] = 1;
+            if (instr->result.type == OP_TEMPORARY) temp_defs[instr->result.val.temp]++;
+        }
+    }
+
+    sv->num_vars = 0;
+    sv->vars = (Operand*) checked_calloc(sv->num_names + sv->num_temps, sizeof(Operand));
+    for (int n = 0; n < sv->num_names; n++) {
+        sv->name_var[n] = -1;
+        if (defined[n] && !excluded[n]) {
+            sv->vars[sv->num_vars].type = OP_IDENTIFIER;
+            sv->vars[sv->num_vars].val.name = n;
+            sv->name_var[n] = sv->num_vars++;
+        }
+    }
+    for (int t = 0; t < sv->num_temps; t++) {
+        sv->temp_var[t] = -1;
+        if (temp_defs[t] > 1) {
+            sv->vars[sv->num_vars].type = OP_TEMPORARY;
+            sv->vars[sv->num_vars].val.temp = t;
+            sv->temp_var[t] = sv->num_vars++;
+        }
+    }
+    free(excluded);
+    free(defined);
+    free(temp_defs);
+}
+
+static void free_variables(SSAVars *sv) {
+    free(sv->vars);
+    free(sv->name_var);
+    free(sv->temp_var);
+}
+
+/* --- Dominance frontiers --- */
+
+typedef struct {
+    int *items;
+    int count;
+    int capacity;
+} IntList;
+
+static void int_list_push(IntList *list, int value) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 4;
+        list->items = (int*) checked_realloc(list->items, list->capacity, sizeof(int));
+    }
+    list->items[list->count++] = value;
+}
+
+// DF(b): the blocks where b's dominance ends. For every join point, walk up
+// from each predecessor to the join's immediate dominator.
+static IntList* compute_dominance_frontiers(IRFunction *fn) {
+    IntList *df = (IntList*) checked_calloc(fn->num_blocks, sizeof(IntList));
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        if (block->rpo < 0 || block->num_preds < 2) continue;
+        for (int p = 0; p < block->num_preds; p++) {
+            BasicBlock *runner = block->preds[p];
+            if (runner->rpo < 0) continue;
+            while (runner && runner != block->idom) {
+                IntList *list = &df[runner->id];
+                if (list->count > 0 && list->items[list->count - 1] == b) break;
+                int_list_push(list, b);
+                runner = runner->idom;
+            }
+        }
+    }
+    return df;
+}
+
+/* --- Phi placement --- */
+
+static int place_phis(IRFunction *fn, SSAVars *sv) {
+    int nb = fn->num_blocks;
+    IntList *def_blocks = (IntList*) checked_calloc(sv->num_vars, sizeof(IntList));
+    char *live_in = (char*) checked_calloc(sv->num_vars, sizeof(char));
+    int *last_def = (int*) checked_calloc(sv->num_vars, sizeof(int)); // Last block that defined the variable
+    for (int v = 0; v < sv->num_vars; v++) last_def[v] = -1;
+
+    for (int b = 0; b < nb; b++) {
+        BasicBlock *block = fn->blocks[b];
+        if (block->rpo < 0) continue;
+        for (int i = 0; i < block->num_instrs; i++) {
+            Instruction *instr = &block->instrs[i];
+            Operand reads[3] = { instr->arg1, instr->arg2, instr->result };
+            int num_reads = ir_reads_result(instr->opcode) ? 3 : 2;
+            for (int r = 0; r < num_reads; r++) {
+                int v = var_of(sv, reads[r]);
+                if (v >= 0 && last_def[v] != b) live_in[v] = 1;
+            }
+            int v = ir_defines_result(instr->opcode) ? var_of(sv, instr->result) : -1;
+            if (v >= 0 && last_def[v] != b) {
+                last_def[v] = b;
+                int_list_push(&def_blocks[v], b);
+            }
+        }
+    }
+
+    IntList *df = compute_dominance_frontiers(fn);
+    int *has_phi = (int*) checked_calloc(nb, sizeof(int));   // Variable + 1 whose phi the block has
+    int *queued = (int*) checked_calloc(nb, sizeof(int));    // Variable + 1 whose worklist holds it
+    int *worklist = (int*) checked_calloc(nb, sizeof(int));
+    int num_phis = 0;
+    for (int v = 0; v < sv->num_vars; v++) {
+        if (!live_in[v]) continue;
+        int size = 0;
+        for (int i = 0; i < def_blocks[v].count; i++) {
+            worklist[size++] = def_blocks[v].items[i];
+            queued[def_blocks[v].items[i]] = v + 1;
+        }
+        while (size > 0) {
+            int b = worklist[--size];
+            for (int i = 0; i < df[b].count; i++) {
+                int d = df[b].items[i];
+                if (has_phi[d] == v + 1 || d == CFG_EXIT) continue;
+                has_phi[d] = v + 1;
+                block_add_phi(fn->blocks[d], sv->vars[v]);
+                num_phis++;
+                if (queued[d] != v + 1) {
+                    queued[d] = v + 1;
+                    worklist[size++] = d;
+                }
+            }
+        }
+    }
+
+    for (int b = 0; b < nb; b++) free(df[b].items);
+    for (int v = 0; v < sv->num_vars; v++) free(def_blocks[v].items);
+    free(df);
+    free(def_blocks);
+    free(live_in);
+    free(last_def);
+    free(has_phi);
+    free(queued);
+    free(worklist);
+    return num_phis;
+}
+
+/* --- Renaming --- */
+
+typedef struct {
+    int var;
+    Operand previous;
+} RenameUndo;
+
+typedef struct {
+    SSAVars *sv;
+    Operand *current;  // Reaching definition of each variable
+    RenameUndo *log;   // Lets a block restore 'current' when the walk leaves it
+    int log_size;
+    int log_capacity;
+} Renamer;
+
+static Operand new_version(Renamer *rn, int v) {
+    if (rn->log_size == rn->log_capacity) {
+        rn->log_capacity = rn->log_capacity ? rn->log_capacity * 2 : 64;
+        rn->log = (RenameUndo*) checked_realloc(rn->log, rn->log_capacity, sizeof(RenameUndo));
+    }
+    rn->log[rn->log_size].var = v;
+    rn->log[rn->log_size].previous = rn->current[v];
+    rn->log_size++;
+    rn->current[v] = create_operand_temp();
+    return rn->current[v];
+}
+
+static void rename_use(Renamer *rn, Operand *op) {
+    int v = var_of(rn->sv, *op);
+    if (v >= 0) *op = rn->current[v];
+}
+
+static void rename_block(Renamer *rn, BasicBlock *block) {
+    for (int i = 0; i < block->num_phis; i++) {
+        block->phis[i].result = new_version(rn, var_of(rn->sv, block->phis[i].origin));
+    }
+    for (int i = 0; i < block->num_instrs; i++) {
+        Instruction *instr = &block->instrs[i];
+        rename_use(rn, &instr->arg1);
+        rename_use(rn, &instr->arg2);
+        if (ir_reads_result(instr->opcode)) {
+            rename_use(rn, &instr->result);
+        } else if (ir_defines_result(instr->opcode)) {
+            int v = var_of(rn->sv, instr->result);
+            if (v >= 0) instr->result = new_version(rn, v);
+        }
+    }
+    for (int s = 0; s < block->num_succs; s++) {
+        BasicBlock *succ = block->succs[s];
+        int slot = 0;
+        while (succ->preds[slot] != block) slot++;
+        for (int i = 0; i < succ->num_phis; i++) {
+            succ->phis[i].args[slot] = rn->current[var_of(rn->sv, succ->phis[i].origin)];
+        }
+    }
+}
+
+static void rename_variables(IRFunction *fn, SSAVars *sv) {
+    Renamer rn;
+    rn.sv = sv;
+    rn.current = (Operand*) checked_calloc(sv->num_vars, sizeof(Operand));
+    memcpy(rn.current, sv->vars, sv->num_vars * sizeof(Operand));
+    rn.log = NULL;
+    rn.log_size = rn.log_capacity = 0;
+
+    // Iterative preorder walk of the dominator tree; a block's definitions
+    // are undone once all of its dominator-tree children are done.
+    int nb = fn->num_blocks;
+    BasicBlock **stack = (BasicBlock**) checked_calloc(nb, sizeof(BasicBlock*));
+    int *log_mark = (int*) checked_calloc(nb, sizeof(int));
+    int *next_child = (int*) checked_calloc(nb, sizeof(int));
+    int depth = 0;
+    stack[depth++] = fn->blocks[CFG_ENTRY];
+    log_mark[CFG_ENTRY] = 0;
+    rename_block(&rn, fn->blocks[CFG_ENTRY]);
+    while (depth > 0) {
+        BasicBlock *block = stack[depth - 1];
+        if (next_child[block->id] < block->num_dom_children) {
+            BasicBlock *child = block->dom_children[next_child[block->id]++];
+            log_mark[child->id] = rn.log_size;
+            rename_block(&rn, child);
+            stack[depth++] = child;
+        } else {
+            while (rn.log_size > log_mark[block->id]) {
+                rn.log_size--;
+                rn.current[rn.log[rn.log_size].var] = rn.log[rn.log_size].previous;
+            }
+            depth--;
+        }
+    }
+    free(stack);
+    free(log_mark);
+    free(next_child);
+    free(rn.current);
+    free(rn.log);
+}
+
+int build_ssa(IRFunction *fn) {
+    if (fn->in_ssa) return count_phis(fn);
+    if (!fn->blocks) build_cfg(fn);
+    compute_dominators(fn);
+
+    SSAVars sv;
+    find_variables(fn, &sv);
+    int num_phis = place_phis(fn, &sv);
+    rename_variables(fn, &sv);
+    free_variables(&sv);
+    fn->in_ssa = 1;
+    return num_phis;
+}
+
+/* --- Leaving SSA --- */
+
+static Instruction make_copy(Operand dest, Operand src) {
+    Instruction copy;
+    copy.opcode = IR_ASSIGN;
+    copy.result = dest;
+    copy.arg1 = src;
+    copy.arg2 = create_operand_none();
+    return copy;
+}
+
+void destroy_ssa(IRFunction *fn) {
+    if (!fn->in_ssa) return;
+    // Each phi 'x = phi(a, b)' gets its own temporary c: every predecessor
+    // ends with 'c = a' (or b), and the block starts with 'x = c'. Because c
+    // is private to the phi, copies for different phis never clobber each
+    // other, so critical edges need no splitting.
+    for (int b = 0; b < fn->num_blocks; b++) {
+        BasicBlock *block = fn->blocks[b];
+        if (block->num_phis == 0) continue;
+        // The block may be its own predecessor, so finish the copies at the
+        // ends of the predecessors before building the new block start.
+        Operand *carriers = (Operand*) checked_calloc(block->num_phis, sizeof(Operand));
+        for (int i = 0; i < block->num_phis; i++) {
+            PhiNode *phi = &block->phis[i];
+            carriers[i] = create_operand_temp();
+            for (int p = 0; p < block->num_preds; p++) {
+                if (phi->args[p].type == OP_NONE) continue; // Unreachable predecessor
+                block_insert_before_terminator(block->preds[p], make_copy(carriers[i], phi->args[p]));
+            }
+        }
+        Instruction *head = (Instruction*) checked_calloc(block->num_phis + block->num_instrs, sizeof(Instruction));
+        for (int i = 0; i < block->num_phis; i++) {
+            head[i] = make_copy(block->phis[i].result, carriers[i]);
+            free(block->phis[i].args);
+        }
+        free(carriers);
+        memcpy(head + block->num_phis, block->instrs, block->num_instrs * sizeof(Instruction));
+        free(block->instrs);
+        block->instrs = head;
+        block->num_instrs += block->num_phis;
+        block->capacity = block->num_instrs;
+        block->num_phis = 0;
+    }
+    fn->in_ssa = 0;
+}
+
+int count_phis(IRFunction *fn) {
+    int count = 0;
+    for (int b = 0; b < fn->num_blocks; b++) {
+        count += fn->blocks[b]->num_phis;
+    }
+    return count;
+}
@@ -0,0 +1,29 @@
+#ifndef SSA_H
+#define SSA_H
+
+#include "ir.h"
+
+/*
+ * Static single assignment form for the 3AC. In SSA form every temporary has
+ * exactly one definition, and values that merge at a join point are selected
+ * by the phis at the start of the block (PhiNode in cfg.h).
+ *
+ * Only variables the IR fully controls are renamed: local scalars whose
+ * address is never taken and that are not globals, array or struct storage,
+ * plus temporaries with more than one definition. Every other identifier is
+ * left as a memory location. Reads that no definition reaches keep the
+ * original name, which stands for the value on entry to the function.
+ */
+
+// Puts a function in SSA form, building its CFG first if needed. Returns the
+// number of phis inserted.
+int build_ssa(IRFunction *fn);
+
+// Takes a function out of SSA form by replacing every phi with copies. The
+// CFG is kept.
+void destroy_ssa(IRFunction *fn);
+
+// Number of phis in a function in SSA form.
+int count_phis(IRFunction *fn);
+
+#endif // SSA_H
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "string_pool.h"
+#include "alloc.h"
+
+#define POOL_CHUNK_SIZE 65536
+#define INITIAL_TABLE_SIZE 1024
+
+// Characters are stored in large chunks that are never moved, so interned
+// pointers stay stable. Each string is preceded by its StringId.
+typedef struct PoolChunk {
+    struct PoolChunk *next;
+    size_t used;
+    size_t size;
+    char data[];
+} PoolChunk;
+
+static PoolChunk *chunks = NULL;
+
+// Id -> string, plus the cached hash of each string.
+static const char **strings = NULL;
+static unsigned int *hashes = NULL;
+static int num_strings = 0;
+static int strings_capacity = 0;
+
+// Open-addressing hash table of ids; -1 marks an empty slot.
+static int *table = NULL;
+static unsigned int table_size = 0;
+
+static unsigned int hash_bytes(const char *str, size_t len) {
+    // FNV-1a
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char) str[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void* pool_alloc(size_t size) {
+    // Keep every header aligned for the StringId stored in front of the string.
+    size = (size + sizeof(StringId) - 1) & ~(sizeof(StringId) - 1);
+    if (!chunks || chunks->used + size > chunks->size) {
+        size_t chunk_size = size > POOL_CHUNK_SIZE ? size : POOL_CHUNK_SIZE;
+        PoolChunk *chunk = (PoolChunk*) checked_realloc(NULL, 1, sizeof(PoolChunk) + chunk_size);
+        chunk->next = chunks;
+        chunk->used = 0;
+        chunk->size = chunk_size;
+        chunks = chunk;
+    }
+    void *mem = chunks->data + chunks->used;
+    chunks->used += size;
+    return mem;
+}
+
+static void grow_table() {
+    unsigned int new_size = table_size ? table_size * 2 : INITIAL_TABLE_SIZE;
+    int *new_table = (int*) checked_calloc(new_size, sizeof(int));
+    memset(new_table, -1, new_size * sizeof(int));
+    for (int id = 0; id < num_strings; id++) {
+        unsigned int slot = hashes[id] & (new_size - 1);
+        while (new_table[slot] != -1) {
+            slot = (slot + 1) & (new_size - 1);
+        }
+        new_table[slot] = id;
+    }
+    free(table);
+    table = new_table;
+    table_size = new_size;
+}
+
+// Returns the table slot holding 'str', or the empty slot where it belongs.
+static unsigned int find_slot(const char *str, size_t len, unsigned int h) {
+    unsigned int slot = h & (table_size - 1);
+    while (table[slot] != -1) {
+        int id = table[slot];
+        if (hashes[id] == h && strncmp(strings[id], str, len) == 0 && strings[id][len] == '\0') {
+            break;
+        }
+        slot = (slot + 1) & (table_size - 1);
+    }
+    return slot;
+}
+
+const char* intern_string_len(const char *str, size_t len) {
+    // Keep the load factor below one half.
+    if ((unsigned int) (num_strings + 1) * 2 > table_size) {
+        grow_table();
+    }
+    unsigned int h = hash_bytes(str, len);
+    unsigned int slot = find_slot(str, len, h);
+    if (table[slot] != -1) {
+        return strings[table[slot]];
+    }
+
+    if (num_strings == strings_capacity) {
+        strings_capacity = strings_capacity ? strings_capacity * 2 : INITIAL_TABLE_SIZE;
+        strings = (const char**) checked_realloc(strings, strings_capacity, sizeof(const char*));
+        hashes = (unsigned int*) checked_realloc(hashes, strings_capacity, sizeof(unsigned int));
+    }
+    StringId *header = (StringId*) pool_alloc(sizeof(StringId) + len + 1);
+    char *copy = (char*) (header + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    *header = num_strings;
+
+    strings[num_strings] = copy;
+    hashes[num_strings] = h;
+    table[slot] = num_strings;
+    num_strings++;
+    return copy;
+}
+
+const char* intern_string(const char *str) {
+    return intern_string_len(str, strlen(str));
+}
+
+const char* find_interned_string(const char *str) {
+    if (!table) return NULL;
+    size_t len = strlen(str);
+    unsigned int slot = find_slot(str, len, hash_bytes(str, len));
+    return table[slot] != -1 ? strings[table[slot]] : NULL;
+}
+
+StringId string_id(const char *interned) {
+    return ((const StringId*) interned)[-1];
+}
+
+const char* string_from_id(StringId id) {
+    return (id >= 0 && id < num_strings) ? strings[id] : NULL;
+}
+
+int string_pool_size() {
+    return num_strings;
+}
+
+void free_string_pool() {
+    while (chunks) {
+        PoolChunk *next = chunks->next;
+        free(chunks);
+        chunks = next;
+    }
+    free(strings);
+    free(hashes);
+    free(table);
+    strings = NULL;
+    hashes = NULL;
+    table = NULL;
+    num_strings = 0;
+    strings_capacity = 0;
+    table_size = 0;
+}
@@ -0,0 +1,37 @@
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <stddef.h>
+
+/*
+ * A global pool of interned strings shared by the lexer, the AST, the symbol
+ * table and the IR. Every distinct string is stored exactly once, so two
+ * interned strings are equal if and only if their pointers are equal.
+ * Interned strings stay valid until free_string_pool() is called.
+ */
+
+// A small integer handle for an interned string (0, 1, 2, ...).
+typedef int StringId;
+
+// Returns the canonical copy of 'str', adding it to the pool if needed.
+const char* intern_string(const char *str);
+
+// Same as intern_string, for a string that is not NUL-terminated.
+const char* intern_string_len(const char *str, size_t len);
+
+// Returns the canonical copy of 'str' if it was interned before, otherwise NULL.
+// Never adds to the pool.
+const char* find_interned_string(const char *str);
+
+// Converts between interned strings and their integer handles.
+// 'interned' must be a pointer returned by the pool, not just an equal string.
+StringId string_id(const char *interned);
+const char* string_from_id(StringId id);
+
+// Number of distinct strings in the pool.
+int string_pool_size();
+
+// Releases every interned string at once.
+void free_string_pool();
+
+#endif // STRING_POOL_H
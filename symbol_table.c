@@ -2,65 +2,139 @@
 #include <stdlib.h>
 #include <string.h>
 #include "symbol_table.h"
+#include "string_pool.h"
+#include "alloc.h"
 
-#define MAX_SCOPE_DEPTH 100
+#define INITIAL_BUCKET_COUNT 256
+#define INITIAL_SCOPE_CAPACITY 16
 
-// A stack of symbol tables for scope management
-Symbol* scope_stack[MAX_SCOPE_DEPTH];
+// All visible symbols, hashed by name. A new symbol is pushed at the front of
+// its bucket, so the first match for a name is always the innermost declaration.
+static Symbol** buckets = NULL;
+static unsigned int bucket_count = 0;
+static unsigned int symbol_count = 0;
+
+// A stack of per-scope undo logs. Each entry lists the symbols declared in that
+// scope (newest first) so leave_scope can unlink them from the hash table.
+Symbol** scope_stack = NULL;
+static int scope_capacity = 0;
 int current_scope_level = -1; // -1 means no scope is active
 
+// Interned names have small sequential ids, which make a good hash.
+#define NAME_HASH(name) ((unsigned int) string_id(name))
+
+// Doubles the bucket array once the table gets too full.
+// Each old chain splits into two new chains with its order preserved, so
+// shadowing declarations stay in front of the ones they hide.
+static void grow_buckets() {
+    unsigned int new_count = bucket_count * 2;
+    Symbol** new_buckets = (Symbol**) checked_calloc(new_count, sizeof(Symbol*));
+    for (unsigned int i = 0; i < bucket_count; i++) {
+        Symbol **low_tail = &new_buckets[i];
+        Symbol **high_tail = &new_buckets[i + bucket_count];
+        Symbol *s = buckets[i];
+        while (s) {
+            Symbol *next = s->hash_next;
+            s->hash_next = NULL;
+            if (NAME_HASH(s->name) & bucket_count) {
+                *high_tail = s;
+                high_tail = &s->hash_next;
+            } else {
+                *low_tail = s;
+                low_tail = &s->hash_next;
+            }
+            s = next;
+        }
+    }
+    free(buckets);
+    buckets = new_buckets;
+    bucket_count = new_count;
+}
+
+// Removes a symbol from its hash chain.
+static void unlink_symbol(Symbol *sym) {
+    Symbol **link = &buckets[NAME_HASH(sym->name) & (bucket_count - 1)];
+    while (*link && *link != sym) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = sym->hash_next;
+        symbol_count--;
+    }
+}
+
 void init_symbol_table() {
+    if (!buckets) {
+        bucket_count = INITIAL_BUCKET_COUNT;
+        buckets = (Symbol**) checked_calloc(bucket_count, sizeof(Symbol*));
+    }
     current_scope_level = -1;
     enter_scope(); // Enter the global scope (level 0)
 }
 
-void insert_symbol(const char *name, Type *type, int kind) {
+int insert_symbol(const char *name, Type *type, int kind) {
     //printf("DEBUG:Semantic Check: Inserting symbol '%s' of kind %d into scope level %d\n", name, kind, current_scope_level);
-    if (current_scope_level < 0) return; // Should not happen
-
-    // Check for re-declaration
-    for (Symbol *s = scope_stack[current_scope_level]; s != NULL; s = s->next) {
-        if (strcmp(s->name, name) == 0) {
-            // In a real compiler, you'd use yyerror here with line numbers
-            fprintf(stderr, "Semantic Error: Redeclaration of identifier '%s'.\n", name);
-            return;
+    if (current_scope_level < 0) return 0; // Should not happen
+
+    // Check for re-declaration. The first symbol with this name in the bucket is
+    // the innermost visible one; it is a clash only if it lives in this scope.
+    const char *interned = intern_string(name);
+    unsigned int hash = NAME_HASH(interned);
+    for (Symbol *s = buckets[hash & (bucket_count - 1)]; s != NULL; s = s->hash_next) {
+        if (s->name == interned) {
+            if (s->scope_level == current_scope_level) {
+                // In a real compiler, you'd use yyerror here with line numbers
+                fprintf(stderr, "Semantic Error: Redeclaration of identifier '%s'.\n", name);
+                return 0;
+            }
+            break;
         }
     }
 
-    Symbol *new_symbol = (Symbol*) malloc(sizeof(Symbol));
-    if (!new_symbol) {
-        fprintf(stderr, "Fatal: Out of memory for new symbol\n");
-        exit(1);
-    }
-    new_symbol->name = strdup(name);
+    Symbol *new_symbol = (Symbol*) checked_calloc(1, sizeof(Symbol));
+    new_symbol->name = interned;
     new_symbol->kind = kind;
     new_symbol->type = type; // Assign the pointer to the complex type
+    new_symbol->scope_level = current_scope_level;
     new_symbol->next = scope_stack[current_scope_level];
     scope_stack[current_scope_level] = new_symbol;
+
+    if (symbol_count >= bucket_count) {
+        grow_buckets();
+    }
+    unsigned int b = hash & (bucket_count - 1);
+    new_symbol->hash_next = buckets[b];
+    buckets[b] = new_symbol;
+    symbol_count++;
+    return 1;
 }
 
 Symbol* lookup_symbol(const char *name) {
-    // Search from the current scope down to the global scope
+    // A name that was never interned cannot belong to any symbol.
+    const char *interned = find_interned_string(name);
+    return interned ? lookup_interned_symbol(interned) : NULL;
+}
+
+Symbol* lookup_interned_symbol(const char *name) {
+    // Only one bucket can hold the name, and inner scopes come first in it.
     //printf("DEBUG:Semantic Check: Looking up symbol '%s' in scope level %d\n", name, current_scope_level);
-    for (int i = current_scope_level; i >= 0; i--) {
-        for (Symbol *s = scope_stack[i]; s != NULL; s = s->next) {
-            if (strcmp(s->name, name) == 0) {
-                //printf("DEBUG:Semantic Check: Found symbol '%s' in scope level %d\n", name, i);
-                return s; // Found it!
-            }
+    if (current_scope_level < 0) return NULL;
+    for (Symbol *s = buckets[NAME_HASH(name) & (bucket_count - 1)]; s != NULL; s = s->hash_next) {
+        if (s->name == name) {
+            return s; // Found it!
         }
     }
     return NULL; // Not found in any scope
 }
 
 void enter_scope() {
-    if (current_scope_level < MAX_SCOPE_DEPTH - 1) {
-        current_scope_level++;
-        scope_stack[current_scope_level] = NULL;
-    } else {
-        fprintf(stderr, "Fatal: Maximum scope depth exceeded.\n");
-        exit(1);
+    if (current_scope_level + 1 >= scope_capacity) {
+        int new_capacity = scope_capacity ? scope_capacity * 2 : INITIAL_SCOPE_CAPACITY;
+        scope_stack = (Symbol**) checked_realloc(scope_stack, new_capacity, sizeof(Symbol*));
+        scope_capacity = new_capacity;
     }
+    current_scope_level++;
+    scope_stack[current_scope_level] = NULL;
 }
 
 void leave_scope() {
@@ -70,7 +144,7 @@ void leave_scope() {
          while (current) {
              Symbol *temp = current;
              current = current->next;
-             free(temp->name);
+             unlink_symbol(temp);
              // Types are owned by the symbol table and will be freed in cleanup_symbol_table.
              free(temp);
          }
@@ -79,15 +153,17 @@ void leave_scope() {
     }
 }
 
-void add_parameters_to_scope(Symbol* params) {
+int add_parameters_to_scope(Symbol* params) {
+    int all_inserted = 1;
     Symbol* current = params;
     while (current) {
         // We insert the symbol into the current scope.
         // The function type and the scope will now both point to this parameter info.
         //printf("DEBUG:Semantic Check: Inserting parameter '%s' into scope\n", current->name);
-        insert_symbol(current->name, current->type, current->kind);
+        if (!insert_symbol(current->name, current->type, current->kind)) all_inserted = 0;
         current = current->next;
     }
+    return all_inserted;
 }
 
 void cleanup_symbol_table() {
@@ -96,19 +172,20 @@ void cleanup_symbol_table() {
         while (current) {
             Symbol *temp = current;
             current = current->next;
-            
-            // Free the type only if it's a variable or function.
-            // Typedefs often point to types owned by other symbols (like structs),
-            // so we avoid double-freeing. A more robust system might use reference counting.
-            if (temp->kind == SYM_VARIABLE || temp->kind == SYM_FUNCTION) {
-                free_type(temp->type);
-            }
-            free(temp->name);
+            // Types are shared between symbols and are freed by free_all_types().
             free(temp);
         }
         scope_stack[i] = NULL;
     }
     current_scope_level = -1;
+    free_all_types();
+    free(buckets);
+    buckets = NULL;
+    bucket_count = 0;
+    symbol_count = 0;
+    free(scope_stack);
+    scope_stack = NULL;
+    scope_capacity = 0;
 }
 
 void print_struct_members(Type* struct_type) {
@@ -238,91 +315,90 @@ int get_type_size(Type* type) {
 
 /* --- Type Management Functions --- */
 
+// Types are freely shared (e.g. "struct S s, *p;" or "int a, b;" share one base
+// type), so no single symbol owns them. Every type is recorded here instead and
+// released exactly once by free_all_types().
+static Type** all_types = NULL;
+static int num_types = 0;
+static int types_capacity = 0;
+
+static Type* alloc_type(int kind) {
+    if (num_types == types_capacity) {
+        types_capacity = types_capacity ? types_capacity * 2 : 256;
+        all_types = (Type**) checked_realloc(all_types, types_capacity, sizeof(Type*));
+    }
+    Type *type = (Type*) checked_calloc(1, sizeof(Type));
+    type->kind = kind;
+    all_types[num_types++] = type;
+    return type;
+}
+
 Type* create_base_type(const char *base_name) {
-    Type *new_type = (Type*) malloc(sizeof(Type));
-    new_type->kind = TYPE_BASE;
-    new_type->data.base_name = strdup(base_name);
+    Type *new_type = alloc_type(TYPE_BASE);
+    new_type->data.base_name = intern_string(base_name);
     return new_type;
 }
 
 Type* create_array_type(Type *element_type, int size) {
-    Type *new_type = (Type*) malloc(sizeof(Type));
-    new_type->kind = TYPE_ARRAY;
+    Type *new_type = alloc_type(TYPE_ARRAY);
     new_type->data.array_info.element_type = element_type;
     new_type->data.array_info.size = size;
     return new_type;
 }
 
 Type* create_aggregate_type(int kind, const char *name) {
-    Type *new_type = (Type*) malloc(sizeof(Type));
-    new_type->kind = kind; // TYPE_STRUCT or TYPE_UNION
-    new_type->data.record_info.name = name ? strdup(name) : NULL;
+    Type *new_type = alloc_type(kind); // TYPE_STRUCT or TYPE_UNION
+    new_type->data.record_info.name = name ? intern_string(name) : NULL;
     new_type->data.record_info.members = NULL;
     new_type->size = 0; // Initialize size to 0, indicating an incomplete type.
     return new_type;
 }
 
 Type* create_pointer_type(Type *points_to) {
-    Type *new_type = (Type*) malloc(sizeof(Type));
-    new_type->kind = TYPE_POINTER;
+    Type *new_type = alloc_type(TYPE_POINTER);
     new_type->data.points_to = points_to;
     return new_type;
 }
 
 Type* create_function_type(Type *return_type, Symbol *params) {
-    Type *new_type = (Type*) malloc(sizeof(Type));
-    new_type->kind = TYPE_FUNCTION;
+    Type *new_type = alloc_type(TYPE_FUNCTION);
     new_type->data.function_info.return_type = return_type;
     new_type->data.function_info.params = params;
     return new_type;
 }
 
-void free_type(Type *type) {
-    if (!type) return;
-
-    switch (type->kind) {
-        case TYPE_BASE:
-            free(type->data.base_name);
-            break;
-        case TYPE_ARRAY:
-            // Recursively free the element type
-            free_type(type->data.array_info.element_type);
-            break;
-        case TYPE_POINTER:
-            // Recursively free the pointed-to type
-            free_type(type->data.points_to);
-            break;
-        case TYPE_FUNCTION:
-            free_type(type->data.function_info.return_type);
+void free_all_types() {
+    for (int i = 0; i < num_types; i++) {
+        Type *type = all_types[i];
+        // Parameter and member nodes belong to exactly one type; the types
+        // they refer to are freed by their own registry entries.
+        if (type->kind == TYPE_FUNCTION) {
             Symbol *param = type->data.function_info.params;
             while (param) {
                 Symbol *temp = param;
                 param = param->next;
-                free(temp->name);
-                free_type(temp->type);
                 free(temp);
             }
-            break;
-        case TYPE_STRUCT:
-        case TYPE_UNION:
-            if (type->data.record_info.name) free(type->data.record_info.name);
+        } else if (type->kind == TYPE_STRUCT || type->kind == TYPE_UNION) {
             StructMember *member = type->data.record_info.members;
             while (member) {
                 StructMember *temp = member;
                 member = member->next;
-                free(temp->name);
-                free_type(temp->type);
                 free(temp);
             }
-            break;
+        }
+        free(type);
     }
-    free(type);
+    free(all_types);
+    all_types = NULL;
+    num_types = 0;
+    types_capacity = 0;
 }
 
 /**
  * @brief Finds a member by name within a struct or union type.
  * @param struct_type The struct or union type to search in.
- * @param member_name The name of the member to find.
+ * @param member_name The interned name of the member to find.
  * @return A pointer to the StructMember if found, otherwise NULL.
  */
 StructMember* get_struct_member(Type* struct_type, const char* member_name) {
@@ -332,7 +408,7 @@ StructMember* get_struct_member(Type* struct_type, const char* member_name) {
 
     StructMember* current_member = struct_type->data.record_info.members;
     while (current_member) {
-        if (strcmp(current_member->name, member_name) == 0) {
+        if (current_member->name == member_name) {
             return current_member;
         }
         current_member = current_member->next;
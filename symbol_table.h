@@ -3,7 +3,7 @@
 
 // Represents a single member in a struct or union
 typedef struct StructMember {
-    char* name;
+    const char* name; // Interned
     struct Type* type;
     int offset; // Byte offset from the beginning of the struct
     struct StructMember* next; // Next member in the list
@@ -24,11 +24,11 @@ typedef struct Type {
     } kind;
     int size; // Size of this type in bytes
     union {
-        char *base_name; // For TYPE_BASE (e.g., "int", "double")
+        const char *base_name; // For TYPE_BASE, interned (e.g., "int", "double")
         struct { struct Type *element_type; int size; } array_info; // For TYPE_ARRAY
         struct Type *points_to; // For TYPE_POINTER
         struct { // For struct/union
-            char *name;
+            const char *name; // Interned
             struct StructMember *members; // Linked list of members
         } record_info;
         struct { // For TYPE_FUNCTION
@@ -45,9 +45,11 @@ typedef struct Symbol {
         SYM_TYPENAME,
         SYM_FUNCTION
     } kind;
-    char *name;
+    const char *name; // Interned, so names can be compared by pointer
     Type *type;
     struct Symbol *next; // For linking symbols in the same scope
+    struct Symbol *hash_next; // Next symbol in the same hash bucket
+    int scope_level; // Scope level the symbol was declared in
 } Symbol;
 
 /* --- Function Prototypes --- */
@@ -55,21 +57,25 @@ typedef struct Symbol {
 // Initializes the symbol table
 void init_symbol_table();
 
-// Inserts a new symbol into the symbol table
-void insert_symbol(const char *name, Type *type, int kind);
+// Inserts a new symbol into the symbol table. Returns 0, after reporting it,
+// if the name is already declared in the current scope.
+int insert_symbol(const char *name, Type *type, int kind);
 
 // Looks up a symbol in the symbol table
 Symbol* lookup_symbol(const char *name);
 
+// Same as lookup_symbol, for a name that is already interned (skips hashing it)
+Symbol* lookup_interned_symbol(const char *name);
+
 // Prints the contents of the symbol table
 void print_symbol_table();
 
 // Scope management functions
 void enter_scope();
 void leave_scope();
-void add_parameters_to_scope(Symbol* params);
+int add_parameters_to_scope(Symbol* params); // 0 if a parameter name repeats
 
-// Cleans up the entire symbol table, freeing all scopes.
+// Cleans up the entire symbol table, freeing all scopes and all types.
 void cleanup_symbol_table();
 
 
@@ -80,9 +86,9 @@ Type* create_record_type(int kind, const char *name, Symbol *members);
 Type* create_pointer_type(Type *points_to);
 Type* create_function_type(Type *return_type, Symbol *params);
 Type* create_aggregate_type(int kind, const char *name);
-void free_type(Type *type);
+void free_all_types(); // Frees every type created by the helpers above
 int get_type_size(Type* type);
 void print_type(Type *type);
-StructMember* get_struct_member(Type* struct_type, const char* member_name);
+StructMember* get_struct_member(Type* struct_type, const char* member_name); // member_name must be interned
 
 #endif // SYMBOL_TABLE_H
\ No newline at end of file
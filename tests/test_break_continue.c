@@ -14,5 +14,5 @@ int main() {
 
     // sum should be 2 + 3 + 4 + 5 = 14
 
-    return sum;
+    return sum; // Should return 14
 }
\ No newline at end of file
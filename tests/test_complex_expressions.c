@@ -33,5 +33,5 @@ int main() {
     printf("Result of complex expression: %f\n", result);
     
 
-    return 0;
+    return 0; // Should return 0
 }
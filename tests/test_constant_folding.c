@@ -0,0 +1,25 @@
+int main() {
+    int table[2 * 3 + 1];
+    int i;
+    int x = 5 - 1;
+    float f = 1.5 * 2.0;
+    char c = 'a' + 1;
+
+    // Folded at compile time; the branch is never taken
+    if (x != 4) {
+        return 1;
+    }
+
+    // Only the constant propagation pass can see that y is 12
+    int y = x * 3;
+    if (y < 10) {
+        x = 0;
+    }
+
+    for (i = 0; i < (1 << 3) - 1; i = i + 1) {
+        table[i] = i * (10 / 5);
+    }
+    table[0] = table[6] - 12; // Constant indexes scale at compile time
+
+    return x + table[0] + ~0 + !0; // Should return 4
+}
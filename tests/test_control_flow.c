@@ -28,5 +28,5 @@ int main() {
         i = i + 1;
     } while (i < 5);
 
-    return sum;
+    return sum; // Should return 29
 }
\ No newline at end of file
@@ -35,5 +35,5 @@ int main() {
     p1.x = 10;
     p1.y = 20;
     arr1[0] = 100;
-    return 0;
+    return 0; // Should return 0
 }
\ No newline at end of file
@@ -23,5 +23,5 @@ int main() {
         c = 3;
     }
 
-    return c;
+    return c; // Should return 3
 }
\ No newline at end of file
@@ -24,6 +24,10 @@ void func_ptr_int(int *ptr) {
     *ptr = *ptr + 1;
 }
 
+int first_plus_last(int values[], int n) { // An array parameter is a pointer
+    return values[0] + values[n - 1];
+}
+
 int main() {
     int x = 10;
     int y = 20;
@@ -31,6 +35,8 @@ int main() {
     float f_val;
     char c_val = 'A';
     int *p_x = &x;
+    int values[3];
+    char letter;
 
     // Test calls to functions
     func_void_void(); // Call function with no args, no return
@@ -43,11 +49,15 @@ int main() {
 
     func_ptr_int(p_x); // Call function with pointer arg, modifies x
 
+    values[0] = 1;
+    values[2] = 2;
+    letter = 66; // An int converts to a char
+
     // Verify results (these would typically be checked by assertions in a real test framework)
     // sum should be 30
     // f_val should be 10 + 5.5 + 65 = 80.5 (assuming ASCII 'A' is 65)
     // x should be 11 after func_ptr_int
 
-    return sum + f_val + x; // Expected: 30 + 80 + 11 = 121
+    return sum + f_val + x + first_plus_last(values, 3) + letter - c_val; // Should return 55 (51 + 3 + 1)
 }
 
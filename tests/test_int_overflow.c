@@ -0,0 +1,6 @@
+int main() {
+    int big = 2147483647;
+    big = big + 1; // int arithmetic wraps at 32 bits
+    if (big < 0) return 1; // Should return 1
+    return 2;
+}
@@ -0,0 +1,32 @@
+// Test nested loops with array indexing (loop-invariant code motion and
+// induction-variable strength reduction at -O2)
+int main() {
+    int values[10];
+    int i;
+    int j;
+    int sum = 0;
+
+    for (i = 0; i < 10; i++) {
+        values[i] = i * 3 + 1;
+    }
+
+    // Bubble sort in descending order: '10 - i - 1' is loop-invariant in the
+    // inner loop, and values[j] indexing steps by the element size.
+    for (i = 0; i < 10 - 1; i++) {
+        for (j = 0; j < 10 - i - 1; j++) {
+            if (values[j] < values[j + 1]) {
+                int temp = values[j];
+                values[j] = values[j + 1];
+                values[j + 1] = temp;
+            }
+        }
+    }
+
+    i = 9;
+    do {
+        sum = sum + values[i] * 2;
+        i = i - 1;
+    } while (i >= 0);
+
+    return sum; // Should return 290
+}
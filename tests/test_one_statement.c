@@ -1,3 +1,3 @@
 int main(void){
-    return 0;
+    return 0; // Should return 0
 }
\ No newline at end of file
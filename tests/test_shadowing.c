@@ -0,0 +1,37 @@
+int g = 5;
+
+int add_shadowed(int a) {
+    int r = g;
+    {
+        int a = 7; // Shadows the parameter
+        r = r + a;
+    }
+    return r + a;
+}
+
+int sibling_scopes() {
+    int s = 0;
+    for (int i = 0; i < 2; i++) s = s + i;
+    for (int i = 0; i < 3; i++) s = s + i; // A new i, not a redeclaration
+    int a = 2;
+    {
+        int a[4]; // Shadows an int with an array, which needs its own storage
+        a[3] = 5;
+        s = s + a[3];
+    }
+    return s + a;
+}
+
+int main() {
+    int g = 100; // Shadows the global, which add_shadowed still reads
+    int s = 0;
+    for (int i = 0; i < 3; i++) {
+        int i = 10; // Shadows the loop counter
+        s = s + i;
+    }
+    {
+        int s = 1000;
+        g = g + s - 1000;
+    }
+    return add_shadowed(1) + s + g + sibling_scopes(); // Should return 154
+}
@@ -16,5 +16,5 @@ int main() {
     // Test member access and pointer member access
     ptr->b = s.a + ptr->a;
 
-    return s.b;
+    return s.b; // Should return 20
 }
\ No newline at end of file
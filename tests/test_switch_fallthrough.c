@@ -18,5 +18,5 @@ int main() {
     }
 
     // The final result should be 5.
-    return result;
+    return result; // Should return 5
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+int main() {
+    int x = 4;
+    int dense = 0;
+    int sparse = 0;
+    int tiny = 0;
+
+    // Consecutive values with a hole: dispatched through a jump table.
+    switch (x) {
+        case 1: dense = 10; break;
+        case 2: dense = 20; break;
+        case 3: dense = 30;
+        case 4: dense = dense + 40; break;
+        case 6: dense = 60; break;
+        default: dense = -1;
+    }
+
+    // Values far apart: a binary search over the case values.
+    switch (x * 25) {
+        case 1: sparse = 1; break;
+        case 100: sparse = 2; break;
+        case 1000: sparse = 3; break;
+        case 10000: sparse = 4; break;
+        case 100000: sparse = 5; break;
+        case -20: sparse = 6; break;
+        case 21: sparse = 7; break;
+        case 22: sparse = 8; break;
+    }
+
+    // Two cases: compared one after the other.
+    switch (x) {
+        case 5: tiny = 1; break;
+        case 4: tiny = 2; break;
+    }
+
+    return dense + sparse + tiny; // Should return 44
+}
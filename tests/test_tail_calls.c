@@ -0,0 +1,33 @@
+int gcd(int a, int b) {
+    if (b == 0) return a;
+    return gcd(b, a % b); // Self-recursive: becomes a loop
+}
+
+int rotate(int a, int b, int c, int n) {
+    if (n == 0) return a * 100 + b * 10 + c;
+    return rotate(b, c, a, n - 1); // Parameters are swapped in parallel
+}
+
+int twice(int x) {
+    return x * 2;
+}
+
+int twice_next(int x) {
+    return twice(x + 1); // Another function: TAILCALL
+}
+
+int through_pointer(int *p) {
+    return *p;
+}
+
+int local_address(int x) {
+    return through_pointer(&x); // x must outlive the call: stays a CALL
+}
+
+int main() {
+    int g = gcd(48, 18);            // 6
+    int r = rotate(1, 2, 3, 4);     // 231
+    int t = twice_next(3);          // 8
+    int l = local_address(5);       // 5
+    return g + r + t + l; // Should return 250
+}
@@ -0,0 +1,1002 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "vm.h"
+#include "string_pool.h"
+#include "alloc.h"
+
+#define VM_STACK_CELLS (1 << 20) // Value cells for all activations of a run
+
+typedef enum { VM_INT, VM_FLOAT, VM_PTR } VMTag;
+
+typedef struct VMValue {
+    int tag;                    // VMTag; zeroed memory reads as the integer 0
+    union {
+        long long i;            // Kept in the range of a C int
+        double f;
+        struct VMValue *p;
+    } u;
+} VMValue;
+
+// Where an operand lives. An operand slot is bases[base][index], with the
+// bases of the running activation.
+enum { BASE_FRAME, BASE_GLOBAL, BASE_CONST, NUM_BASES };
+
+typedef struct {
+    int base;
+    int index;
+} VMOperand;
+
+typedef enum {
+    BC_ADD, BC_SUB, BC_MUL, BC_DIV, BC_MOD,
+    BC_EQ, BC_NE, BC_LT, BC_GT, BC_LE, BC_GE,
+    BC_AND, BC_OR, BC_BIT_AND, BC_BIT_OR, BC_XOR, BC_SHL, BC_SHR,
+    BC_NEG, BC_NOT, BC_BIT_NOT,
+    BC_MOVE,            // result = arg1
+    BC_ADDR,            // result = address of arg1's slot
+    BC_LOAD,            // result = *arg1
+    BC_STORE,           // *result = arg1
+    BC_INDEX_LOAD,      // result = arg1[arg2]
+    BC_INDEX_STORE,     // result[arg1] = arg2
+    BC_ALLOC,           // result = new heap block of 'count' cells
+    BC_FREE,            // releases the heap block arg1
+    BC_JUMP, BC_JUMPF, BC_JUMPT, // To code[target]
+    BC_JUMP_TABLE,      // To code[targets[target + arg1]]
+    BC_PARAM,
+    BC_CALL,            // result = functions[target](count arguments)
+    BC_CALL_BUILTIN,    // result = builtins[target](count arguments)
+    BC_CALL_UNKNOWN,    // Fails: no IR and no builtin; target is the name
+    BC_TAILCALL,        // Replaces the activation with functions[target]
+    BC_TAILCALL_BUILTIN,
+    BC_RETURN,
+    BC_HALT,
+    BC_COUNT
+} ByteOp;
+
+typedef struct {
+    const void *handler;        // Threaded dispatch: address of the opcode's code
+    int opcode;                 // ByteOp
+    int target;
+    int count;                  // Arguments of a call, cells of an allocation
+    VMOperand result, arg1, arg2;
+} VMInstr;
+
+typedef struct {
+    StringId name;
+    VMInstr *code;
+    int num_code;
+    int code_capacity;
+    int *targets;               // Jump table entries, as code indices
+    int num_targets;
+    VMValue *constants;         // constants[0] is the integer 0, read for absent operands
+    int num_constants;
+    int constants_capacity;
+    int frame_cells;            // fn->frame_size: ALLOC_STACK and spill slots come first
+    int num_params;             // ARGn slots, right after the frame cells
+    int activation_size;        // Cells of one activation
+} VMFunction;
+
+struct VMProgram {
+    VMFunction *functions;
+    int num_functions;
+    VMFunction init;            // The global initializers
+    int main_function;
+    int num_globals;
+    VMValue **strings;          // Cells of the string literals
+    int num_strings;
+    int threaded;               // Handlers filled in
+};
+
+typedef struct {
+    VMFunction *fn;
+    VMValue *frame;
+    const VMInstr *return_pc;
+    VMOperand result;
+} VMCallRecord;
+
+typedef struct {
+    VMProgram *program;
+    VMValue *stack;
+    VMValue *globals;
+    VMValue *args;              // Pushed by PARAM, taken by calls
+    int num_args;
+    int args_capacity;
+    VMCallRecord *calls;
+    int num_calls;
+    int calls_capacity;
+    VMValue **heap;             // Live heap blocks, released after the run
+    int num_heap;
+    int heap_capacity;
+    int exit_status;
+    int exited;                 // HALT or exit() ran
+    char error[256];
+} VMState;
+
+static void* vm_grow(void *array, int *capacity, size_t size) {
+    *capacity = *capacity ? *capacity * 2 : 16;
+    return checked_realloc(array, *capacity, size);
+}
+
+static int vm_error(VMState *vm, const char *format, ...) {
+    va_list ap;
+    va_start(ap, format);
+    vsnprintf(vm->error, sizeof(vm->error), format, ap);
+    va_end(ap);
+    return 0;
+}
+
+#define WRAP(x) ((long long) (int) (unsigned int) (x))
+
+static void set_int(VMValue *v, long long i) {
+    v->tag = VM_INT;
+    v->u.i = WRAP(i);
+}
+
+static void set_float(VMValue *v, double f) {
+    v->tag = VM_FLOAT;
+    v->u.f = f;
+}
+
+static void set_pointer(VMValue *v, VMValue *p) {
+    v->tag = VM_PTR;
+    v->u.p = p;
+}
+
+static int is_true(const VMValue *v) {
+    switch (v->tag) {
+        case VM_FLOAT: return v->u.f != 0.0;
+        case VM_PTR: return v->u.p != NULL;
+        default: return v->u.i != 0;
+    }
+}
+
+static double as_double(const VMValue *v) {
+    return v->tag == VM_FLOAT ? v->u.f : (double) v->u.i;
+}
+
+static uintptr_t as_address(const VMValue *v) {
+    return v->tag == VM_PTR ? (uintptr_t) v->u.p : (uintptr_t) v->u.i;
+}
+
+static VMValue* heap_block(VMState *vm, long long cells) {
+    if (cells < 1) cells = 1;
+    VMValue *block = (VMValue*) checked_calloc(cells, sizeof(VMValue));
+    if (vm->num_heap == vm->heap_capacity) {
+        vm->heap = (VMValue**) vm_grow(vm->heap, &vm->heap_capacity, sizeof(VMValue*));
+    }
+    vm->heap[vm->num_heap++] = block;
+    return block;
+}
+
+static int heap_free(VMState *vm, const VMValue *v) {
+    if (v->tag == VM_INT && v->u.i == 0) return 1; // free(NULL)
+    for (int i = vm->num_heap - 1; v->tag == VM_PTR && i >= 0; i--) {
+        if (vm->heap[i] == v->u.p) {
+            free(vm->heap[i]);
+            vm->heap[i] = vm->heap[--vm->num_heap];
+            return 1;
+        }
+    }
+    return vm_error(vm, "free of a pointer that is not a heap block");
+}
+
+/* --- Arithmetic that is not integer on both sides --- */
+
+static int pointer_binary(VMState *vm, int op, VMValue *r, const VMValue *a, const VMValue *b) {
+    if (op == BC_ADD && a->tag == VM_PTR && b->tag == VM_INT) {
+        set_pointer(r, a->u.p + b->u.i);
+    } else if (op == BC_ADD && a->tag == VM_INT && b->tag == VM_PTR) {
+        set_pointer(r, b->u.p + a->u.i);
+    } else if (op == BC_SUB && a->tag == VM_PTR && b->tag == VM_INT) {
+        set_pointer(r, a->u.p - b->u.i);
+    } else if (op == BC_SUB && a->tag == VM_PTR && b->tag == VM_PTR) {
+        set_int(r, a->u.p - b->u.p);
+    } else if (op >= BC_EQ && op <= BC_GE && a->tag != VM_FLOAT && b->tag != VM_FLOAT) {
+        uintptr_t x = as_address(a), y = as_address(b);
+        switch (op) {
+            case BC_EQ: set_int(r, x == y); break;
+            case BC_NE: set_int(r, x != y); break;
+            case BC_LT: set_int(r, x < y); break;
+            case BC_GT: set_int(r, x > y); break;
+            case BC_LE: set_int(r, x <= y); break;
+            default: set_int(r, x >= y); break;
+        }
+    } else {
+        return vm_error(vm, "invalid pointer arithmetic");
+    }
+    return 1;
+}
+
+static int slow_binary(VMState *vm, int op, VMValue *r, const VMValue *a, const VMValue *b) {
+    if (op == BC_AND || op == BC_OR) {
+        int x = is_true(a), y = is_true(b);
+        set_int(r, op == BC_AND ? (x && y) : (x || y));
+        return 1;
+    }
+    if (a->tag == VM_PTR || b->tag == VM_PTR) return pointer_binary(vm, op, r, a, b);
+    double x = as_double(a), y = as_double(b);
+    switch (op) {
+        case BC_ADD: set_float(r, x + y); break;
+        case BC_SUB: set_float(r, x - y); break;
+        case BC_MUL: set_float(r, x * y); break;
+        case BC_DIV: set_float(r, x / y); break;
+        case BC_EQ: set_int(r, x == y); break;
+        case BC_NE: set_int(r, x != y); break;
+        case BC_LT: set_int(r, x < y); break;
+        case BC_GT: set_int(r, x > y); break;
+        case BC_LE: set_int(r, x <= y); break;
+        case BC_GE: set_int(r, x >= y); break;
+        default: return vm_error(vm, "integer operator applied to a floating-point value");
+    }
+    return 1;
+}
+
+/* --- Builtins: library functions the program calls without defining --- */
+
+typedef int (*VMBuiltin)(VMState *vm, VMValue *args, int count, VMValue *result);
+
+// Copies the string at a cell pointer into a malloc'ed C string.
+static char* read_string(VMState *vm, const VMValue *v) {
+    if (v->tag != VM_PTR || !v->u.p) {
+        vm_error(vm, "expected a string");
+        return NULL;
+    }
+    int length = 0;
+    while (v->u.p[length].u.i != 0) length++;
+    char *s = (char*) checked_calloc(length + 1, sizeof(char));
+    for (int i = 0; i < length; i++) s[i] = (char) v->u.p[i].u.i;
+    return s;
+}
+
+static int builtin_printf(VMState *vm, VMValue *args, int count, VMValue *result) {
+    if (count < 1) return vm_error(vm, "printf needs a format");
+    char *format = read_string(vm, &args[0]);
+    if (!format) return 0;
+    int printed = 0, next = 1;
+    for (const char *p = format; *p; p++) {
+        if (*p != '%') {
+            putchar(*p);
+            printed++;
+            continue;
+        }
+        // One conversion: flags, width, precision and length are passed on.
+        char spec[32];
+        int n = 0;
+        spec[n++] = *p++;
+        while (*p && strchr("-+ #0123456789.hlLqjzt", *p) && n < 24) {
+            if (!strchr("hlLqjzt", *p)) spec[n++] = *p;
+            p++;
+        }
+        if (!*p) break;
+        char conversion = *p;
+        char buffer[512];
+        int length;
+        if (conversion == '%') {
+            putchar('%');
+            printed++;
+            continue;
+        }
+        if (next >= count) {
+            free(format);
+            return vm_error(vm, "printf has too few arguments");
+        }
+        VMValue *arg = &args[next++];
+        if (strchr("diouxXc", conversion)) {
+            if (conversion != 'c') {
+                spec[n++] = 'l';
+                spec[n++] = 'l';
+            }
+            spec[n++] = conversion;
+            spec[n] = '\0';
+            long long value = arg->tag == VM_FLOAT ? (long long) arg->u.f : arg->u.i;
+            if (conversion == 'c') {
+                length = snprintf(buffer, sizeof(buffer), spec, (int) value);
+            } else {
+                length = snprintf(buffer, sizeof(buffer), spec, value);
+            }
+        } else if (strchr("feEgGaA", conversion)) {
+            spec[n++] = conversion;
+            spec[n] = '\0';
+            length = snprintf(buffer, sizeof(buffer), spec, as_double(arg));
+        } else if (conversion == 's') {
+            char *s = read_string(vm, arg);
+            if (!s) {
+                free(format);
+                return 0;
+            }
+            spec[n++] = 's';
+            spec[n] = '\0';
+            length = printf(spec, s);
+            printed += length;
+            free(s);
+            continue;
+        } else if (conversion == 'p') {
+            length = snprintf(buffer, sizeof(buffer), "%p", (void*) as_address(arg));
+        } else {
+            free(format);
+            return vm_error(vm, "unsupported printf conversion '%%%c'", conversion);
+        }
+        fputs(buffer, stdout);
+        printed += length;
+    }
+    free(format);
+    set_int(result, printed);
+    return 1;
+}
+
+static int builtin_puts(VMState *vm, VMValue *args, int count, VMValue *result) {
+    if (count < 1) return vm_error(vm, "puts needs a string");
+    char *s = read_string(vm, &args[0]);
+    if (!s) return 0;
+    puts(s);
+    free(s);
+    set_int(result, 0);
+    return 1;
+}
+
+static int builtin_putchar(VMState *vm, VMValue *args, int count, VMValue *result) {
+    if (count < 1) return vm_error(vm, "putchar needs a character");
+    putchar((int) args[0].u.i);
+    set_int(result, args[0].u.i);
+    return 1;
+}
+
+static int builtin_malloc(VMState *vm, VMValue *args, int count, VMValue *result) {
+    if (count < 1) return vm_error(vm, "malloc needs a size");
+    set_pointer(result, heap_block(vm, args[0].u.i));
+    return 1;
+}
+
+static int builtin_calloc(VMState *vm, VMValue *args, int count, VMValue *result) {
+    if (count < 2) return vm_error(vm, "calloc needs a count and a size");
+    set_pointer(result, heap_block(vm, args[0].u.i * args[1].u.i));
+    return 1;
+}
+
+static int builtin_free(VMState *vm, VMValue *args, int count, VMValue *result) {
+    if (count < 1) return vm_error(vm, "free needs a pointer");
+    set_int(result, 0);
+    return heap_free(vm, &args[0]);
+}
+
+static int builtin_abs(VMState *vm, VMValue *args, int count, VMValue *result) {
+    if (count < 1) return vm_error(vm, "abs needs a number");
+    set_int(result, args[0].u.i < 0 ? -args[0].u.i : args[0].u.i);
+    return 1;
+}
+
+static int builtin_exit(VMState *vm, VMValue *args, int count, VMValue *result) {
+    vm->exit_status = count > 0 ? (int) args[0].u.i : 0;
+    vm->exited = 1;
+    set_int(result, 0);
+    return 1;
+}
+
+static const struct {
+    const char *name;
+    VMBuiltin run;
+} builtins[] = {
+    { "printf", builtin_printf },
+    { "puts", builtin_puts },
+    { "putchar", builtin_putchar },
+    { "malloc", builtin_malloc },
+    { "calloc", builtin_calloc },
+    { "free", builtin_free },
+    { "abs", builtin_abs },
+    { "exit", builtin_exit },
+};
+
+#define NUM_BUILTINS ((int) (sizeof(builtins) / sizeof(builtins[0])))
+
+/* --- Loading: IR to bytecode --- */
+
+typedef struct {
+    const IRModule *module;
+    VMProgram *program;
+    int num_names;
+    int *global_slot;           // StringId -> global slot, or -1
+    int *function_of;           // StringId -> function index, or -1
+    int stamp;                  // Invalidates the per-function maps below
+    int *name_slot, *name_stamp;            // StringId -> frame slot
+    int *temp_slot, *temp_stamp;            // Temporary -> frame slot
+    int *label_index, *label_stamp;         // Label -> code index
+    char *aggregate;            // StringId -> allocated in this function (stamp-valued)
+    int *aggregate_stamp;
+    int next_slot;
+    int first_register;
+    int discard_slot;           // Written by instructions without a result
+} Loader;
+
+static int add_constant(VMFunction *fn, VMValue value) {
+    if (fn->num_constants == fn->constants_capacity) {
+        fn->constants = (VMValue*) vm_grow(fn->constants, &fn->constants_capacity, sizeof(VMValue));
+    }
+    fn->constants[fn->num_constants] = value;
+    return fn->num_constants++;
+}
+
+// Cells for a string literal, with its escape sequences decoded.
+static VMValue* string_cells(VMProgram *program, const char *s) {
+    VMValue *cells = (VMValue*) checked_calloc(strlen(s) + 1, sizeof(VMValue));
+    int n = 0;
+    for (const char *p = s; *p; p++) {
+        int c = (unsigned char) *p;
+        if (c == '\\' && p[1]) {
+            p++;
+            switch (*p) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case '0': c = '\0'; break;
+                case 'a': c = '\a'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'v': c = '\v'; break;
+                default: c = (unsigned char) *p; break; // \\ \" \'
+            }
+        }
+        cells[n].tag = VM_INT;
+        cells[n++].u.i = c;
+    }
+    program->strings = (VMValue**) checked_realloc(program->strings, (program->num_strings + 1), sizeof(VMValue*));
+    program->strings[program->num_strings++] = cells;
+    return cells;
+}
+
+static VMOperand frame_operand(int index) {
+    VMOperand o = { BASE_FRAME, index };
+    return o;
+}
+
+static VMOperand resolve(Loader *ld, VMFunction *fn, Operand op) {
+    VMOperand o = { BASE_CONST, 0 };
+    VMValue value;
+    memset(&value, 0, sizeof(value));
+    switch (op.type) {
+        case OP_INT_CONST: set_int(&value, op.val.int_val); break;
+        case OP_CHAR_CONST: set_int(&value, op.val.char_val); break;
+        case OP_FLOAT_CONST: set_float(&value, ld->module->float_consts[op.val.float_index]); break;
+        case OP_STRING_LITERAL: set_pointer(&value, string_cells(ld->program, string_from_id(op.val.str_id))); break;
+        case OP_REGISTER:
+            return frame_operand(ld->first_register + op.val.reg);
+        case OP_TEMPORARY:
+            if (ld->temp_stamp[op.val.temp] != ld->stamp) {
+                ld->temp_stamp[op.val.temp] = ld->stamp;
+                ld->temp_slot[op.val.temp] = ld->next_slot++;
+            }
+            return frame_operand(ld->temp_slot[op.val.temp]);
+        case OP_IDENTIFIER: {
+            StringId name = op.val.name;
+            int n = ir_param_index(name);
+            if (n >= 0) return frame_operand(fn->frame_cells + n);
+            if (ld->global_slot[name] >= 0) {
+                o.base = BASE_GLOBAL;
+                o.index = ld->global_slot[name];
+                return o;
+            }
+            if (ld->name_stamp[name] != ld->stamp) {
+                ld->name_stamp[name] = ld->stamp;
+                ld->name_slot[name] = ld->next_slot++;
+            }
+            return frame_operand(ld->name_slot[name]);
+        }
+        default:
+            return o; // Absent: reads the constant 0
+    }
+    o.index = add_constant(fn, value);
+    return o;
+}
+
+static VMInstr* append_code(VMFunction *fn, int opcode) {
+    if (fn->num_code == fn->code_capacity) {
+        fn->code = (VMInstr*) vm_grow(fn->code, &fn->code_capacity, sizeof(VMInstr));
+    }
+    VMInstr *instr = &fn->code[fn->num_code++];
+    memset(instr, 0, sizeof(*instr));
+    instr->opcode = opcode;
+    return instr;
+}
+
+static int is_aggregate(const Loader *ld, Operand op) {
+    return op.type == OP_IDENTIFIER &&
+           (ld->aggregate_stamp[op.val.name] == ld->stamp || ld->aggregate[op.val.name]);
+}
+
+static const ByteOp binary_ops[] = {
+    [IR_ADD] = BC_ADD, [IR_SUB] = BC_SUB, [IR_MUL] = BC_MUL, [IR_DIV] = BC_DIV, [IR_MOD] = BC_MOD,
+    [IR_EQ] = BC_EQ, [IR_NE] = BC_NE, [IR_LT] = BC_LT, [IR_GT] = BC_GT, [IR_LE] = BC_LE, [IR_GE] = BC_GE,
+    [IR_AND] = BC_AND, [IR_OR] = BC_OR, [IR_BIT_AND] = BC_BIT_AND, [IR_BIT_OR] = BC_BIT_OR,
+    [IR_XOR] = BC_XOR, [IR_SHL] = BC_SHL, [IR_SHR] = BC_SHR,
+};
+
+static void load_function(Loader *ld, const IRFunction *ir, VMFunction *fn) {
+    ld->stamp++;
+    fn->name = ir->name;
+    fn->frame_cells = ir->frame_size;
+    VMValue zero;
+    memset(&zero, 0, sizeof(zero));
+    add_constant(fn, zero);
+
+    // Slots: frame cells, ARGn, registers, then names and temporaries as
+    // they come. Labels map to the index of the next instruction.
+    int registers = 0, code_index = 0;
+    for (int i = 0; i < ir->num_instrs; i++) {
+        const Instruction *instr = &ir->instrs[i];
+        const Operand *ops[3] = { &instr->result, &instr->arg1, &instr->arg2 };
+        for (int k = 0; k < 3; k++) {
+            if (ops[k]->type == OP_REGISTER && ops[k]->val.reg >= registers) registers = ops[k]->val.reg + 1;
+            if (ops[k]->type != OP_IDENTIFIER) continue;
+            int n = ir_param_index(ops[k]->val.name);
+            if (n >= fn->num_params) fn->num_params = n + 1;
+        }
+        if ((instr->opcode == IR_ALLOC_HEAP || instr->opcode == IR_ALLOC_STACK) && instr->result.type == OP_IDENTIFIER) {
+            ld->aggregate_stamp[instr->result.val.name] = ld->stamp;
+        }
+        if (instr->opcode == IR_LABEL) {
+            ld->label_stamp[instr->result.val.label] = ld->stamp;
+            ld->label_index[instr->result.val.label] = code_index;
+        } else if (instr->opcode != IR_NOP) {
+            code_index++;
+        }
+    }
+    ld->first_register = fn->frame_cells + fn->num_params;
+    ld->discard_slot = ld->first_register + registers;
+    ld->next_slot = ld->discard_slot + 1;
+
+    for (int i = 0; i < ir->num_instrs; i++) {
+        const Instruction *in = &ir->instrs[i];
+        VMInstr *out;
+        switch (in->opcode) {
+            case IR_LABEL: case IR_NOP:
+                continue;
+            case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+            case IR_EQ: case IR_NE: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+            case IR_AND: case IR_OR: case IR_BIT_AND: case IR_BIT_OR: case IR_XOR:
+            case IR_SHL: case IR_SHR:
+                out = append_code(fn, binary_ops[in->opcode]);
+                break;
+            case IR_UNARY_MINUS: out = append_code(fn, BC_NEG); break;
+            case IR_NOT: out = append_code(fn, BC_NOT); break;
+            case IR_BIT_NOT: out = append_code(fn, BC_BIT_NOT); break;
+            case IR_ASSIGN: case IR_SPILL: case IR_RELOAD:
+                out = append_code(fn, BC_MOVE);
+                break;
+            case IR_ADDR: case IR_ADDR_OF:
+                // An aggregate's name already holds its address.
+                out = append_code(fn, is_aggregate(ld, in->arg1) ? BC_MOVE : BC_ADDR);
+                break;
+            case IR_DEREF: case IR_DEREF_LOAD: out = append_code(fn, BC_LOAD); break;
+            case IR_DEREF_STORE: out = append_code(fn, BC_STORE); break;
+            case IR_INDEX_LOAD: out = append_code(fn, BC_INDEX_LOAD); break;
+            case IR_INDEX_STORE: out = append_code(fn, BC_INDEX_STORE); break;
+            case IR_ALLOC_HEAP:
+                out = append_code(fn, BC_ALLOC);
+                out->count = in->arg1.val.int_val;
+                out->result = resolve(ld, fn, in->result);
+                continue;
+            case IR_ALLOC_STACK:
+                out = append_code(fn, BC_ADDR);
+                out->result = resolve(ld, fn, in->result);
+                out->arg1 = frame_operand(in->arg2.val.int_val);
+                continue;
+            case IR_FREE_HEAP: out = append_code(fn, BC_FREE); break;
+            case IR_GOTO: case IR_IF_FALSE_GOTO: case IR_IF_TRUE_GOTO:
+                out = append_code(fn, in->opcode == IR_GOTO ? BC_JUMP :
+                                      in->opcode == IR_IF_FALSE_GOTO ? BC_JUMPF : BC_JUMPT);
+                out->target = ld->label_stamp[in->result.val.label] == ld->stamp ?
+                              ld->label_index[in->result.val.label] : -1;
+                out->arg1 = resolve(ld, fn, in->arg1);
+                continue;
+            case IR_JUMP_TABLE: {
+                const JumpTable *table = &ld->module->jump_tables[in->result.val.int_val];
+                out = append_code(fn, BC_JUMP_TABLE);
+                out->target = fn->num_targets;
+                out->count = table->num_labels;
+                out->arg1 = resolve(ld, fn, in->arg1);
+                fn->targets = (int*) checked_realloc(fn->targets, (fn->num_targets + table->num_labels), sizeof(int));
+                for (int l = 0; l < table->num_labels; l++) {
+                    int label = table->labels[l];
+                    fn->targets[fn->num_targets++] = ld->label_stamp[label] == ld->stamp ? ld->label_index[label] : -1;
+                }
+                continue;
+            }
+            case IR_PARAM: out = append_code(fn, BC_PARAM); break;
+            case IR_CALL: case IR_TAILCALL: {
+                StringId name = in->arg1.val.name;
+                int tail = in->opcode == IR_TAILCALL;
+                int callee = ld->function_of[name];
+                int builtin = -1;
+                for (int b = 0; b < NUM_BUILTINS && callee < 0 && builtin < 0; b++) {
+                    if (strcmp(builtins[b].name, string_from_id(name)) == 0) builtin = b;
+                }
+                if (callee >= 0) {
+                    out = append_code(fn, tail ? BC_TAILCALL : BC_CALL);
+                    out->target = callee;
+                } else if (builtin >= 0) {
+                    out = append_code(fn, tail ? BC_TAILCALL_BUILTIN : BC_CALL_BUILTIN);
+                    out->target = builtin;
+                } else {
+                    out = append_code(fn, BC_CALL_UNKNOWN);
+                    out->target = name;
+                }
+                out->count = in->arg2.val.int_val;
+                out->result = in->result.type == OP_NONE ? frame_operand(ld->discard_slot) : resolve(ld, fn, in->result);
+                continue;
+            }
+            case IR_RETURN: out = append_code(fn, BC_RETURN); break;
+            case IR_HALT: out = append_code(fn, BC_HALT); break;
+            default:
+                fprintf(stderr, "Warning: the virtual machine cannot run opcode %d.\n", in->opcode);
+                continue;
+        }
+        out->result = in->result.type == OP_NONE ? frame_operand(ld->discard_slot) : resolve(ld, fn, in->result);
+        out->arg1 = resolve(ld, fn, in->arg1);
+        out->arg2 = resolve(ld, fn, in->arg2);
+        // Operations with a fixed operand order: SPILL writes the frame.
+        if (in->opcode == IR_SPILL) {
+            out->result = frame_operand(in->result.val.int_val);
+        } else if (in->opcode == IR_RELOAD) {
+            out->arg1 = frame_operand(in->arg1.val.int_val);
+        }
+    }
+    append_code(fn, BC_RETURN); // Falling off the end returns 0
+    fn->activation_size = ld->next_slot;
+}
+
+VMProgram* vm_load(const IRModule *module) {
+    VMProgram *program = (VMProgram*) checked_calloc(1, sizeof(VMProgram));
+    Loader ld;
+    memset(&ld, 0, sizeof(ld));
+    ld.module = module;
+    ld.program = program;
+    ld.num_names = string_pool_size();
+    ld.global_slot = (int*) checked_calloc(ld.num_names, sizeof(int));
+    ld.function_of = (int*) checked_calloc(ld.num_names, sizeof(int));
+    ld.name_slot = (int*) checked_calloc(ld.num_names, sizeof(int));
+    ld.name_stamp = (int*) checked_calloc(ld.num_names, sizeof(int));
+    ld.aggregate = (char*) checked_calloc(ld.num_names, sizeof(char));
+    ld.aggregate_stamp = (int*) checked_calloc(ld.num_names, sizeof(int));
+    ld.temp_slot = (int*) checked_calloc(module->num_temps, sizeof(int));
+    ld.temp_stamp = (int*) checked_calloc(module->num_temps, sizeof(int));
+    ld.label_index = (int*) checked_calloc(module->num_labels, sizeof(int));
+    ld.label_stamp = (int*) checked_calloc(module->num_labels, sizeof(int));
+    memset(ld.global_slot, -1, ld.num_names * sizeof(int));
+    memset(ld.function_of, -1, ld.num_names * sizeof(int));
+
+    // Globals: the names the global declarations define or allocate.
+    for (int i = 0; i < module->globals.num_instrs; i++) {
+        const Instruction *instr = &module->globals.instrs[i];
+        if (!ir_defines_result(instr->opcode) || instr->result.type != OP_IDENTIFIER) continue;
+        StringId name = instr->result.val.name;
+        if (ld.global_slot[name] < 0) ld.global_slot[name] = program->num_globals++;
+        if (instr->opcode == IR_ALLOC_HEAP) ld.aggregate[name] = 1;
+    }
+    program->main_function = -1;
+    program->num_functions = module->num_functions;
+    program->functions = (VMFunction*) checked_calloc(module->num_functions, sizeof(VMFunction));
+    for (int f = 0; f < module->num_functions; f++) {
+        ld.function_of[module->functions[f].name] = f;
+        if (strcmp(string_from_id(module->functions[f].name), "main") == 0) program->main_function = f;
+    }
+    load_function(&ld, &module->globals, &program->init);
+    for (int f = 0; f < module->num_functions; f++) {
+        load_function(&ld, &module->functions[f], &program->functions[f]);
+    }
+
+    free(ld.global_slot);
+    free(ld.function_of);
+    free(ld.name_slot);
+    free(ld.name_stamp);
+    free(ld.aggregate);
+    free(ld.aggregate_stamp);
+    free(ld.temp_slot);
+    free(ld.temp_stamp);
+    free(ld.label_index);
+    free(ld.label_stamp);
+    if (program->main_function < 0) {
+        fprintf(stderr, "Error: The program has no main function to run.\n");
+        vm_free(program);
+        return NULL;
+    }
+    return program;
+}
+
+static void free_function(VMFunction *fn) {
+    free(fn->code);
+    free(fn->targets);
+    free(fn->constants);
+}
+
+void vm_free(VMProgram *program) {
+    if (!program) return;
+    for (int f = 0; f < program->num_functions; f++) free_function(&program->functions[f]);
+    free_function(&program->init);
+    for (int i = 0; i < program->num_strings; i++) free(program->strings[i]);
+    free(program->strings);
+    free(program->functions);
+    free(program);
+}
+
+/* --- Execution --- */
+
+static void thread_code(VMFunction *fn, const void *const *handlers) {
+    for (int i = 0; i < fn->num_code; i++) fn->code[i].handler = handlers[fn->code[i].opcode];
+}
+
+// Runs 'entry' until it returns or the program ends. Returns 0, or -1 on a
+// runtime error; 'retired' counts the instructions executed.
+static int execute(VMState *vm, VMFunction *entry, long long *retired) {
+    static const void *const handlers[BC_COUNT] = {
+        [BC_ADD] = &&op_add, [BC_SUB] = &&op_sub, [BC_MUL] = &&op_mul,
+        [BC_DIV] = &&op_div, [BC_MOD] = &&op_mod,
+        [BC_EQ] = &&op_eq, [BC_NE] = &&op_ne, [BC_LT] = &&op_lt,
+        [BC_GT] = &&op_gt, [BC_LE] = &&op_le, [BC_GE] = &&op_ge,
+        [BC_AND] = &&op_and, [BC_OR] = &&op_or, [BC_BIT_AND] = &&op_bit_and,
+        [BC_BIT_OR] = &&op_bit_or, [BC_XOR] = &&op_xor, [BC_SHL] = &&op_shl, [BC_SHR] = &&op_shr,
+        [BC_NEG] = &&op_neg, [BC_NOT] = &&op_not, [BC_BIT_NOT] = &&op_bit_not,
+        [BC_MOVE] = &&op_move, [BC_ADDR] = &&op_addr, [BC_LOAD] = &&op_load, [BC_STORE] = &&op_store,
+        [BC_INDEX_LOAD] = &&op_index_load, [BC_INDEX_STORE] = &&op_index_store,
+        [BC_ALLOC] = &&op_alloc, [BC_FREE] = &&op_free,
+        [BC_JUMP] = &&op_jump, [BC_JUMPF] = &&op_jumpf, [BC_JUMPT] = &&op_jumpt,
+        [BC_JUMP_TABLE] = &&op_jump_table, [BC_PARAM] = &&op_param,
+        [BC_CALL] = &&op_call, [BC_CALL_BUILTIN] = &&op_call_builtin, [BC_CALL_UNKNOWN] = &&op_call_unknown,
+        [BC_TAILCALL] = &&op_tailcall, [BC_TAILCALL_BUILTIN] = &&op_tailcall_builtin,
+        [BC_RETURN] = &&op_return, [BC_HALT] = &&op_halt,
+    };
+    VMProgram *program = vm->program;
+    if (!program->threaded) {
+        for (int f = 0; f < program->num_functions; f++) thread_code(&program->functions[f], handlers);
+        thread_code(&program->init, handlers);
+        program->threaded = 1;
+    }
+
+    VMFunction *fn = entry;
+    VMValue *frame = vm->stack;
+    VMValue *stack_end = vm->stack + VM_STACK_CELLS;
+    VMValue *bases[NUM_BASES] = { frame, vm->globals, fn->constants };
+    const VMInstr *pc = fn->code;
+    const VMInstr *code = fn->code;
+    VMFunction *callee;
+    VMValue *args, value;
+    int base_calls = vm->num_calls;
+    long long count = 0;
+    if (fn->activation_size > VM_STACK_CELLS) {
+        vm_error(vm, "stack overflow");
+        goto runtime_error;
+    }
+    memset(frame, 0, fn->activation_size * sizeof(VMValue));
+
+#define SLOT(o) (&bases[(o).base][(o).index])
+#define DISPATCH() do { count++; goto *pc->handler; } while (0)
+#define NEXT() do { pc++; DISPATCH(); } while (0)
+#define JUMP_TO(index) do { pc = code + (index); DISPATCH(); } while (0)
+#define INT_BINARY(label, expr) \
+    label: { \
+        VMValue *a = SLOT(pc->arg1), *b = SLOT(pc->arg2); \
+        if (a->tag == VM_INT && b->tag == VM_INT) { \
+            long long x = a->u.i, y = b->u.i; \
+            set_int(SLOT(pc->result), (expr)); \
+        } else if (!slow_binary(vm, pc->opcode, SLOT(pc->result), a, b)) { \
+            goto runtime_error; \
+        } \
+        NEXT(); \
+    }
+
+    DISPATCH();
+
+    INT_BINARY(op_add, x + y)
+    INT_BINARY(op_sub, x - y)
+    INT_BINARY(op_mul, x * y)
+    INT_BINARY(op_eq, x == y)
+    INT_BINARY(op_ne, x != y)
+    INT_BINARY(op_lt, x < y)
+    INT_BINARY(op_gt, x > y)
+    INT_BINARY(op_le, x <= y)
+    INT_BINARY(op_ge, x >= y)
+    INT_BINARY(op_and, x && y)
+    INT_BINARY(op_or, x || y)
+    INT_BINARY(op_bit_and, x & y)
+    INT_BINARY(op_bit_or, x | y)
+    INT_BINARY(op_xor, x ^ y)
+    INT_BINARY(op_shl, (long long) ((unsigned long long) x << (y & 31)))
+    INT_BINARY(op_shr, (long long) ((int) x >> (y & 31)))
+
+op_div:
+op_mod: {
+        VMValue *a = SLOT(pc->arg1), *b = SLOT(pc->arg2);
+        if (a->tag == VM_INT && b->tag == VM_INT) {
+            if (b->u.i == 0) {
+                vm_error(vm, "division by zero");
+                goto runtime_error;
+            }
+            set_int(SLOT(pc->result), pc->opcode == BC_DIV ? a->u.i / b->u.i : a->u.i % b->u.i);
+        } else if (!slow_binary(vm, pc->opcode, SLOT(pc->result), a, b)) {
+            goto runtime_error;
+        }
+        NEXT();
+    }
+op_neg: {
+        VMValue *a = SLOT(pc->arg1);
+        if (a->tag == VM_FLOAT) set_float(SLOT(pc->result), -a->u.f);
+        else set_int(SLOT(pc->result), -a->u.i);
+        NEXT();
+    }
+op_not:
+    set_int(SLOT(pc->result), !is_true(SLOT(pc->arg1)));
+    NEXT();
+op_bit_not:
+    set_int(SLOT(pc->result), ~SLOT(pc->arg1)->u.i);
+    NEXT();
+op_move:
+    *SLOT(pc->result) = *SLOT(pc->arg1);
+    NEXT();
+op_addr:
+    set_pointer(SLOT(pc->result), SLOT(pc->arg1));
+    NEXT();
+op_load: {
+        VMValue *p = SLOT(pc->arg1);
+        if (p->tag != VM_PTR || !p->u.p) goto bad_pointer;
+        *SLOT(pc->result) = *p->u.p;
+        NEXT();
+    }
+op_store: {
+        VMValue *p = SLOT(pc->result);
+        if (p->tag != VM_PTR || !p->u.p) goto bad_pointer;
+        *p->u.p = *SLOT(pc->arg1);
+        NEXT();
+    }
+op_index_load: {
+        VMValue *p = SLOT(pc->arg1);
+        if (p->tag != VM_PTR || !p->u.p) goto bad_pointer;
+        *SLOT(pc->result) = p->u.p[SLOT(pc->arg2)->u.i];
+        NEXT();
+    }
+op_index_store: {
+        VMValue *p = SLOT(pc->result);
+        if (p->tag != VM_PTR || !p->u.p) goto bad_pointer;
+        p->u.p[SLOT(pc->arg1)->u.i] = *SLOT(pc->arg2);
+        NEXT();
+    }
+op_alloc:
+    set_pointer(SLOT(pc->result), heap_block(vm, pc->count));
+    NEXT();
+op_free:
+    if (!heap_free(vm, SLOT(pc->arg1))) goto runtime_error;
+    NEXT();
+op_jump:
+    JUMP_TO(pc->target);
+op_jumpf:
+    if (!is_true(SLOT(pc->arg1))) JUMP_TO(pc->target);
+    NEXT();
+op_jumpt:
+    if (is_true(SLOT(pc->arg1))) JUMP_TO(pc->target);
+    NEXT();
+op_jump_table: {
+        long long index = SLOT(pc->arg1)->u.i;
+        if (index < 0 || index >= pc->count) {
+            vm_error(vm, "jump table index %lld out of range", index);
+            goto runtime_error;
+        }
+        JUMP_TO(fn->targets[pc->target + index]);
+    }
+op_param:
+    if (vm->num_args == vm->args_capacity) {
+        vm->args = (VMValue*) vm_grow(vm->args, &vm->args_capacity, sizeof(VMValue));
+    }
+    vm->args[vm->num_args++] = *SLOT(pc->arg1);
+    NEXT();
+op_call:
+    if (vm->num_calls == vm->calls_capacity) {
+        vm->calls = (VMCallRecord*) vm_grow(vm->calls, &vm->calls_capacity, sizeof(VMCallRecord));
+    }
+    vm->calls[vm->num_calls].fn = fn;
+    vm->calls[vm->num_calls].frame = frame;
+    vm->calls[vm->num_calls].return_pc = pc + 1;
+    vm->calls[vm->num_calls].result = pc->result;
+    vm->num_calls++;
+    frame += fn->activation_size;
+    // Falls into the common part of a tail call.
+op_tailcall:
+    callee = &program->functions[pc->target];
+    if (callee->activation_size > stack_end - frame) {
+        vm_error(vm, "stack overflow");
+        goto runtime_error;
+    }
+    memset(frame, 0, callee->activation_size * sizeof(VMValue));
+    if (pc->count > 0) {
+        args = vm->args + vm->num_args - pc->count;
+        memcpy(frame + callee->frame_cells, args,
+               (pc->count < callee->num_params ? pc->count : callee->num_params) * sizeof(VMValue));
+        vm->num_args -= pc->count;
+    }
+    fn = callee;
+    bases[BASE_FRAME] = frame;
+    bases[BASE_CONST] = fn->constants;
+    code = pc = fn->code;
+    DISPATCH();
+op_call_builtin:
+    args = vm->args + vm->num_args - pc->count;
+    if (!builtins[pc->target].run(vm, args, pc->count, &value)) goto runtime_error;
+    vm->num_args -= pc->count;
+    if (vm->exited) goto finished;
+    *SLOT(pc->result) = value;
+    NEXT();
+op_tailcall_builtin:
+    args = vm->args + vm->num_args - pc->count;
+    if (!builtins[pc->target].run(vm, args, pc->count, &value)) goto runtime_error;
+    vm->num_args -= pc->count;
+    if (vm->exited) goto finished;
+    goto return_value;
+op_call_unknown:
+    vm_error(vm, "call of undefined function '%s'", string_from_id(pc->target));
+    goto runtime_error;
+op_return:
+    value = *SLOT(pc->arg1);
+return_value:
+    if (vm->num_calls == base_calls) {
+        vm->exit_status = (int) value.u.i;
+        goto finished;
+    }
+    vm->num_calls--;
+    fn = vm->calls[vm->num_calls].fn;
+    frame = vm->calls[vm->num_calls].frame;
+    bases[BASE_FRAME] = frame;
+    bases[BASE_CONST] = fn->constants;
+    code = fn->code;
+    pc = vm->calls[vm->num_calls].return_pc;
+    *SLOT(pc[-1].result) = value;
+    DISPATCH();
+op_halt:
+    vm->exit_status = (int) SLOT(pc->arg1)->u.i;
+    vm->exited = 1;
+    goto finished;
+
+bad_pointer:
+    vm_error(vm, "memory access through an invalid pointer");
+runtime_error:
+    *retired += count;
+    fprintf(stderr, "Runtime error in %s: %s.\n", string_from_id(fn->name), vm->error);
+    return -1;
+finished:
+    *retired += count;
+    return 0;
+
+#undef SLOT
+#undef DISPATCH
+#undef NEXT
+#undef JUMP_TO
+#undef INT_BINARY
+}
+
+int vm_run(VMProgram *program, VMRunStats *stats) {
+    VMState vm;
+    memset(&vm, 0, sizeof(vm));
+    vm.program = program;
+    vm.stack = (VMValue*) checked_calloc(VM_STACK_CELLS, sizeof(VMValue));
+    vm.globals = (VMValue*) checked_calloc(program->num_globals, sizeof(VMValue));
+    memset(stats, 0, sizeof(*stats));
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int result = execute(&vm, &program->init, &stats->retired);
+    if (result == 0 && !vm.exited) {
+        result = execute(&vm, &program->functions[program->main_function], &stats->retired);
+    }
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stats->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    stats->exit_status = vm.exit_status;
+    stats->failed = result != 0;
+
+    for (int i = 0; i < vm.num_heap; i++) free(vm.heap[i]);
+    free(vm.heap);
+    free(vm.stack);
+    free(vm.globals);
+    free(vm.args);
+    free(vm.calls);
+    return result;
+}
@@ -0,0 +1,45 @@
+#ifndef VM_H
+#define VM_H
+
+#include "ir.h"
+
+/*
+ * A virtual machine that runs a module's 3AC. vm_load() translates every
+ * function into compact bytecode: labels become instruction indices, every
+ * operand becomes a pre-resolved slot (in the activation's frame, among the
+ * globals, or among the function's constants) and calls are bound to their
+ * callee. vm_run() executes the bytecode with computed-goto threaded
+ * dispatch.
+ *
+ * Values are tagged integers (C int semantics), doubles or pointers. Memory
+ * is made of value cells, one per byte offset, so the byte offsets of the IR
+ * index memory directly whatever the width of the data. An activation holds
+ * the function's frame (ALLOC_STACK and spill slots, see frame.h) followed
+ * by its ARGn, variables, temporaries and registers. Functions without IR
+ * are looked up among a few library builtins (printf, puts, putchar, malloc,
+ * calloc, free, abs, exit).
+ *
+ * The global initializers run first, then main; HALT or main's return ends
+ * the run with its value as exit status.
+ */
+
+typedef struct VMProgram VMProgram;
+
+typedef struct {
+    long long retired;      // Bytecode instructions executed
+    double seconds;         // Wall time of the run
+    int exit_status;
+    int failed;             // A runtime error stopped the run
+} VMRunStats;
+
+// Translates the module (linear, register-allocated or not) into bytecode.
+// Returns NULL and reports the problem if the module has no main.
+VMProgram* vm_load(const IRModule *module);
+
+// Runs the program from a fresh state. Returns 0, or -1 after reporting a
+// runtime error.
+int vm_run(VMProgram *program, VMRunStats *stats);
+
+void vm_free(VMProgram *program);
+
+#endif // VM_H
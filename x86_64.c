@@ -0,0 +1,812 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "x86_64.h"
+#include "string_pool.h"
+#include "alloc.h"
+
+#define NUM_HARDWARE_REGISTERS 5  // Registers r0 .. r4 of the allocator
+#define SAVED_BYTES (8 * NUM_HARDWARE_REGISTERS)
+#define NUM_ARGUMENT_REGISTERS 6
+#define NUM_SSE_ARGUMENTS 8
+// The IR carries no access widths: each byte offset into an aggregate is a
+// cell that holds a whole value, an int or a pointer or a double, as in the
+// VM. Packing memory into C layout needs typed loads and stores in the IR;
+// until then the library must not be handed an aggregate (see emit_call).
+#define CELL_SIZE 8               // Bytes per IR byte offset
+#define KIND_PASSES 2             // Dry passes before the real one
+
+static const char *hardware_registers[NUM_HARDWARE_REGISTERS] = { "%rbx", "%r12", "%r13", "%r14", "%r15" };
+static const char *argument_registers[NUM_ARGUMENT_REGISTERS] = { "%rdi", "%rsi", "%rdx", "%rcx", "%r8", "%r9" };
+
+// What a value holds; joined by taking the larger.
+typedef enum { KIND_INT, KIND_PTR, KIND_FLOAT } ValueKind;
+
+typedef struct {
+    char *arg_kinds;            // Of ARGn, joined over the call sites
+    char *arg_cells;            // ARGn points into cells at some call site
+    int num_params;
+    char return_kind;
+    char return_cells;          // Some return points into cells
+} FunctionInfo;
+
+typedef struct {
+    FILE *fp;                   // NULL during the dry passes
+    const IRModule *module;
+    int num_names;
+    FunctionInfo *info;         // By function index
+    int *function_of;           // StringId -> function index, or -1
+    char *is_global;            // StringId -> defined by the global initializers
+    char *global_aggregate;     // StringId -> a global holding an allocation
+    char *global_kind;
+    char *used_string;          // StringId -> a string literal referenced
+
+    // The function being emitted.
+    const IRFunction *fn;
+    FunctionInfo *current;      // NULL for the global initializers
+    int label_prefix;
+    int stamp;
+    int *name_slot, *name_stamp;
+    int *temp_slot, *temp_stamp;
+    char *name_kind, *temp_kind;
+    int *name_kind_stamp, *temp_kind_stamp;
+    char *name_cells, *temp_cells; // Points into cells; valid with the kind stamps
+    int *aggregate_stamp;
+    char *reg_kind, *reg_cells;
+    char *cell_kind, *cell_cells; // Of the frame cells written by SPILL
+    int num_registers;
+    int arg_base, reg_base, param_base, num_slots;
+    int cell_base;              // %rbp offset of frame cell 0
+    char *param_kinds, *param_cells; // Pending PARAMs
+    int num_params_pending;
+    char buffers[4][96];
+    int next_buffer;
+    int num_errors;
+} Emitter;
+
+static void emit(Emitter *em, const char *format, ...) {
+    if (!em->fp) return;
+    va_list ap;
+    va_start(ap, format);
+    fputc('\t', em->fp);
+    vfprintf(em->fp, format, ap);
+    fputc('\n', em->fp);
+    va_end(ap);
+}
+
+static void emit_label(Emitter *em, int label) {
+    if (em->fp) fprintf(em->fp, ".L%d_%d:\n", em->label_prefix, label);
+}
+
+static int is_local_name(const Emitter *em, Operand op) {
+    return op.type == OP_IDENTIFIER && !em->is_global[op.val.name] && ir_param_index(op.val.name) < 0;
+}
+
+static int slot_offset(int slot) {
+    return -(SAVED_BYTES + 8 * (slot + 1));
+}
+
+/* --- Value kinds --- */
+
+static ValueKind operand_kind(const Emitter *em, Operand op) {
+    switch (op.type) {
+        case OP_FLOAT_CONST: return KIND_FLOAT;
+        case OP_STRING_LITERAL: return KIND_PTR;
+        case OP_TEMPORARY:
+            return em->temp_kind_stamp[op.val.temp] == em->stamp ? em->temp_kind[op.val.temp] : KIND_INT;
+        case OP_REGISTER: return em->reg_kind[op.val.reg];
+        case OP_IDENTIFIER: {
+            int n = ir_param_index(op.val.name);
+            if (n >= 0) return em->current && n < em->current->num_params ? em->current->arg_kinds[n] : KIND_INT;
+            if (em->is_global[op.val.name]) return em->global_kind[op.val.name];
+            return em->name_kind_stamp[op.val.name] == em->stamp ? em->name_kind[op.val.name] : KIND_INT;
+        }
+        default: return KIND_INT;
+    }
+}
+
+static void set_kind(Emitter *em, Operand op, ValueKind kind) {
+    switch (op.type) {
+        case OP_TEMPORARY:
+            em->temp_kind_stamp[op.val.temp] = em->stamp;
+            em->temp_kind[op.val.temp] = kind;
+            em->temp_cells[op.val.temp] = 0;
+            break;
+        case OP_REGISTER:
+            em->reg_kind[op.val.reg] = kind;
+            em->reg_cells[op.val.reg] = 0;
+            break;
+        case OP_IDENTIFIER:
+            if (ir_param_index(op.val.name) >= 0) break;
+            if (em->is_global[op.val.name]) {
+                em->global_kind[op.val.name] = kind;
+            } else {
+                em->name_kind_stamp[op.val.name] = em->stamp;
+                em->name_kind[op.val.name] = kind;
+                em->name_cells[op.val.name] = 0;
+            }
+            break;
+        default: break;
+    }
+}
+
+static int is_aggregate(const Emitter *em, Operand op) {
+    if (op.type != OP_IDENTIFIER) return 0;
+    return em->aggregate_stamp[op.val.name] == em->stamp || em->global_aggregate[op.val.name];
+}
+
+// Whether a value points into cells: an aggregate or an allocation, or an
+// address computed from one. Unlike the kinds, this is not tracked through
+// memory or global variables.
+static int points_to_cells(const Emitter *em, Operand op) {
+    if (is_aggregate(em, op)) return 1;
+    switch (op.type) {
+        case OP_TEMPORARY:
+            return em->temp_kind_stamp[op.val.temp] == em->stamp && em->temp_cells[op.val.temp];
+        case OP_REGISTER: return em->reg_cells[op.val.reg];
+        case OP_IDENTIFIER: {
+            int n = ir_param_index(op.val.name);
+            if (n >= 0) return em->current && n < em->current->num_params && em->current->arg_cells[n];
+            if (em->is_global[op.val.name]) return 0;
+            return em->name_kind_stamp[op.val.name] == em->stamp && em->name_cells[op.val.name];
+        }
+        default: return 0;
+    }
+}
+
+// Marks a value, whose kind has just been set, as pointing into cells.
+static void set_cells(Emitter *em, Operand op) {
+    switch (op.type) {
+        case OP_TEMPORARY: em->temp_cells[op.val.temp] = 1; break;
+        case OP_REGISTER: em->reg_cells[op.val.reg] = 1; break;
+        case OP_IDENTIFIER:
+            if (is_local_name(em, op)) em->name_cells[op.val.name] = 1;
+            break;
+        default: break;
+    }
+}
+
+static void join_kind(char *kind, ValueKind other) {
+    if (other > *kind) *kind = other;
+}
+
+/* --- Operands --- */
+
+// Memory or register operand of a variable, temporary or register.
+static const char* location(Emitter *em, Operand op) {
+    char *buffer = em->buffers[em->next_buffer++ % 4];
+    switch (op.type) {
+        case OP_TEMPORARY:
+            sprintf(buffer, "%d(%%rbp)", slot_offset(em->temp_slot[op.val.temp]));
+            break;
+        case OP_REGISTER:
+            if (op.val.reg < NUM_HARDWARE_REGISTERS) return hardware_registers[op.val.reg];
+            sprintf(buffer, "%d(%%rbp)", slot_offset(em->reg_base + op.val.reg - NUM_HARDWARE_REGISTERS));
+            break;
+        default: {
+            int n = ir_param_index(op.val.name);
+            if (n >= 0) {
+                sprintf(buffer, "%d(%%rbp)", slot_offset(em->arg_base + n));
+            } else if (em->is_global[op.val.name]) {
+                sprintf(buffer, "%s(%%rip)", string_from_id(op.val.name));
+            } else {
+                sprintf(buffer, "%d(%%rbp)", slot_offset(em->name_slot[op.val.name]));
+            }
+            break;
+        }
+    }
+    return buffer;
+}
+
+static void load(Emitter *em, Operand op, const char *reg) {
+    switch (op.type) {
+        case OP_NONE: emit(em, "movq $0, %s", reg); break;
+        case OP_INT_CONST: emit(em, "movq $%d, %s", op.val.int_val, reg); break;
+        case OP_CHAR_CONST: emit(em, "movq $%d, %s", op.val.char_val, reg); break;
+        case OP_FLOAT_CONST: emit(em, "movq .LF%d(%%rip), %s", op.val.float_index, reg); break;
+        case OP_STRING_LITERAL:
+            em->used_string[op.val.str_id] = 1;
+            emit(em, "leaq .LS%d(%%rip), %s", op.val.str_id, reg);
+            break;
+        default: {
+            const char *from = location(em, op);
+            if (strcmp(from, reg) != 0) emit(em, "movq %s, %s", from, reg);
+            break;
+        }
+    }
+}
+
+static void store(Emitter *em, const char *reg, Operand op) {
+    if (op.type == OP_NONE) return;
+    const char *to = location(em, op);
+    if (strcmp(to, reg) != 0) emit(em, "movq %s, %s", reg, to);
+}
+
+// Loads an operand as a double into an SSE register.
+static void load_double(Emitter *em, Operand op, const char *xmm) {
+    load(em, op, "%rax");
+    if (operand_kind(em, op) == KIND_FLOAT) {
+        emit(em, "movq %%rax, %s", xmm);
+    } else {
+        emit(em, "cvtsi2sdq %%rax, %s", xmm);
+    }
+}
+
+/* --- Instructions --- */
+
+static const char* condition_code(OpCode opcode) {
+    switch (opcode) {
+        case IR_EQ: return "e";
+        case IR_NE: return "ne";
+        case IR_LT: return "l";
+        case IR_GT: return "g";
+        case IR_LE: return "le";
+        default: return "ge";
+    }
+}
+
+static void emit_float_binary(Emitter *em, const Instruction *in) {
+    // LT and LE compare the other way round so that unordered is false.
+    int swap = in->opcode == IR_LT || in->opcode == IR_LE;
+    load_double(em, swap ? in->arg2 : in->arg1, "%xmm0");
+    load_double(em, swap ? in->arg1 : in->arg2, "%xmm1");
+    switch (in->opcode) {
+        case IR_ADD: emit(em, "addsd %%xmm1, %%xmm0"); break;
+        case IR_SUB: emit(em, "subsd %%xmm1, %%xmm0"); break;
+        case IR_MUL: emit(em, "mulsd %%xmm1, %%xmm0"); break;
+        case IR_DIV: emit(em, "divsd %%xmm1, %%xmm0"); break;
+        default:
+            emit(em, "ucomisd %%xmm1, %%xmm0");
+            if (in->opcode == IR_EQ) {
+                emit(em, "sete %%al");
+                emit(em, "setnp %%cl");
+                emit(em, "andb %%cl, %%al");
+            } else if (in->opcode == IR_NE) {
+                emit(em, "setne %%al");
+                emit(em, "setp %%cl");
+                emit(em, "orb %%cl, %%al");
+            } else {
+                emit(em, "set%s %%al", in->opcode == IR_LT || in->opcode == IR_GT ? "a" : "ae");
+            }
+            emit(em, "movzbq %%al, %%rax");
+            store(em, "%rax", in->result);
+            set_kind(em, in->result, KIND_INT);
+            return;
+    }
+    emit(em, "movq %%xmm0, %%rax");
+    store(em, "%rax", in->result);
+    set_kind(em, in->result, KIND_FLOAT);
+}
+
+static void emit_binary(Emitter *em, const Instruction *in) {
+    ValueKind a = operand_kind(em, in->arg1), b = operand_kind(em, in->arg2);
+    ValueKind kind = KIND_INT;
+    int cells = points_to_cells(em, in->arg1) || points_to_cells(em, in->arg2);
+    if ((a == KIND_FLOAT || b == KIND_FLOAT) &&
+        (in->opcode <= IR_DIV || (in->opcode >= IR_EQ && in->opcode <= IR_GE))) {
+        emit_float_binary(em, in);
+        return;
+    }
+    load(em, in->arg1, "%rax");
+    load(em, in->arg2, "%rcx");
+    switch (in->opcode) {
+        case IR_ADD:
+            // Pointer arithmetic moves by cells.
+            if (a == KIND_PTR && b != KIND_PTR) emit(em, "salq $3, %%rcx");
+            if (b == KIND_PTR && a != KIND_PTR) emit(em, "salq $3, %%rax");
+            emit(em, "addq %%rcx, %%rax");
+            if (a == KIND_PTR || b == KIND_PTR) kind = KIND_PTR;
+            break;
+        case IR_SUB:
+            if (a == KIND_PTR && b != KIND_PTR) emit(em, "salq $3, %%rcx");
+            emit(em, "subq %%rcx, %%rax");
+            if (a == KIND_PTR && b == KIND_PTR) emit(em, "sarq $3, %%rax");
+            else if (a == KIND_PTR) kind = KIND_PTR;
+            break;
+        case IR_MUL: emit(em, "imulq %%rcx, %%rax"); break;
+        case IR_DIV: case IR_MOD:
+            emit(em, "cqto");
+            emit(em, "idivq %%rcx");
+            if (in->opcode == IR_MOD) emit(em, "movq %%rdx, %%rax");
+            break;
+        case IR_EQ: case IR_NE: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+            emit(em, "cmpq %%rcx, %%rax");
+            emit(em, "set%s %%al", condition_code(in->opcode));
+            emit(em, "movzbq %%al, %%rax");
+            break;
+        case IR_AND: case IR_OR:
+            emit(em, "testq %%rax, %%rax");
+            emit(em, "setne %%al");
+            emit(em, "testq %%rcx, %%rcx");
+            emit(em, "setne %%cl");
+            emit(em, "%s %%cl, %%al", in->opcode == IR_AND ? "andb" : "orb");
+            emit(em, "movzbq %%al, %%rax");
+            break;
+        case IR_BIT_AND: emit(em, "andq %%rcx, %%rax"); break;
+        case IR_BIT_OR: emit(em, "orq %%rcx, %%rax"); break;
+        case IR_XOR: emit(em, "xorq %%rcx, %%rax"); break;
+        case IR_SHL: emit(em, "sall %%cl, %%eax"); break;
+        default: emit(em, "sarl %%cl, %%eax"); break;
+    }
+    // int arithmetic wraps at 32 bits, as in the VM and the constant folder.
+    if (kind == KIND_INT && (in->opcode <= IR_MOD || in->opcode == IR_SHL || in->opcode == IR_SHR)) emit(em, "movslq %%eax, %%rax");
+    store(em, "%rax", in->result);
+    set_kind(em, in->result, kind);
+    if (kind == KIND_PTR && cells) set_cells(em, in->result);
+}
+
+static void emit_unary(Emitter *em, const Instruction *in) {
+    ValueKind kind = operand_kind(em, in->arg1);
+    load(em, in->arg1, "%rax");
+    if (in->opcode == IR_UNARY_MINUS) {
+        if (kind == KIND_FLOAT) {
+            emit(em, "btcq $63, %%rax");
+        } else {
+            emit(em, "negq %%rax");
+            emit(em, "movslq %%eax, %%rax"); // -INT_MIN wraps
+        }
+    } else if (in->opcode == IR_BIT_NOT) {
+        emit(em, "notq %%rax");
+        kind = KIND_INT;
+    } else {
+        if (kind == KIND_FLOAT) emit(em, "salq $1, %%rax"); // -0.0 is false too
+        emit(em, "testq %%rax, %%rax");
+        emit(em, "sete %%al");
+        emit(em, "movzbq %%al, %%rax");
+        kind = KIND_INT;
+    }
+    store(em, "%rax", in->result);
+    set_kind(em, in->result, kind);
+}
+
+static void emit_epilogue(Emitter *em) {
+    emit(em, "leaq -%d(%%rbp), %%rsp", SAVED_BYTES);
+    for (int r = NUM_HARDWARE_REGISTERS - 1; r >= 0; r--) emit(em, "popq %s", hardware_registers[r]);
+    emit(em, "popq %%rbp");
+}
+
+static int returns_int(const char *name) {
+    static const char *names[] = { "printf", "puts", "putchar", "abs", "scanf", "strlen", "strcmp", "rand" };
+    for (int i = 0; i < (int) (sizeof(names) / sizeof(names[0])); i++) {
+        if (strcmp(names[i], name) == 0) return 1;
+    }
+    return 0;
+}
+
+// CALL and TAILCALL. The arguments are the last 'count' PARAM slots.
+static void emit_call(Emitter *em, const Instruction *in) {
+    StringId name = in->arg1.val.name;
+    const char *callee = string_from_id(name);
+    int index = em->function_of[name];
+    int count = in->arg2.val.int_val;
+    int first = em->num_params_pending - count;
+    if (first < 0) first = 0;
+    int tail = in->opcode == IR_TAILCALL;
+
+    if (index >= 0) {
+        FunctionInfo *info = &em->info[index];
+        for (int i = 0; i < count && first + i < em->num_params_pending; i++) {
+            if (i >= info->num_params) continue;
+            join_kind(&info->arg_kinds[i], em->param_kinds[first + i]);
+            info->arg_cells[i] |= em->param_cells[first + i];
+        }
+    } else if (em->fp && strcmp(callee, "free") != 0) {
+        // The library would read C layout where the program keeps cells.
+        for (int i = 0; i < count && first + i < em->num_params_pending; i++) {
+            if (!em->param_cells[first + i]) continue;
+            fprintf(stderr, "Code Generation Error: argument %d of '%s' in '%s' is the address of an array or struct, "
+                    "which the x86-64 backend does not lay out in memory as C does.\n",
+                    i, callee, em->current ? string_from_id(em->fn->name) : "the global initializers");
+            em->num_errors++;
+        }
+    }
+    // Where each argument goes: integer register (0..5), SSE register
+    // (6..13) or the stack (-1).
+    int *where = (int*) checked_calloc(count, sizeof(int));
+    int gprs = 0, sses = 0, stacked = 0;
+    for (int i = 0; i < count; i++) {
+        int is_float = index < 0 && first + i < em->num_params_pending && em->param_kinds[first + i] == KIND_FLOAT;
+        if (is_float && sses < NUM_SSE_ARGUMENTS) where[i] = NUM_ARGUMENT_REGISTERS + sses++;
+        else if (!is_float && gprs < NUM_ARGUMENT_REGISTERS) where[i] = gprs++;
+        else { where[i] = -1; stacked++; }
+    }
+    tail = tail && index >= 0 && stacked == 0;
+    if (stacked % 2) emit(em, "subq $8, %%rsp");
+    for (int i = count - 1; i >= 0; i--) {
+        if (where[i] < 0) emit(em, "pushq %d(%%rbp)", slot_offset(em->param_base + first + i));
+    }
+    for (int i = 0; i < count; i++) {
+        if (where[i] >= NUM_ARGUMENT_REGISTERS) {
+            emit(em, "movq %d(%%rbp), %%xmm%d", slot_offset(em->param_base + first + i), where[i] - NUM_ARGUMENT_REGISTERS);
+        } else if (where[i] >= 0) {
+            emit(em, "movq %d(%%rbp), %s", slot_offset(em->param_base + first + i), argument_registers[where[i]]);
+        }
+    }
+    em->num_params_pending = first;
+    free(where);
+
+    if (tail) {
+        emit_epilogue(em);
+        emit(em, "jmp %s", callee);
+        return;
+    }
+    ValueKind kind = KIND_INT;
+    int cells = 0;
+    if (index >= 0) {
+        emit(em, "call %s", callee);
+        kind = em->info[index].return_kind;
+        cells = em->info[index].return_cells;
+    } else {
+        // The library sees bytes; the program indexes cells.
+        if (strcmp(callee, "malloc") == 0 && count >= 1) emit(em, "salq $3, %%rdi");
+        if (strcmp(callee, "calloc") == 0 && count >= 2) emit(em, "salq $3, %%rsi");
+        emit(em, "movl $%d, %%eax", sses);
+        emit(em, "call %s@PLT", callee);
+        if (returns_int(callee)) emit(em, "movslq %%eax, %%rax");
+        if (strcmp(callee, "malloc") == 0 || strcmp(callee, "calloc") == 0) {
+            kind = KIND_PTR;
+            cells = 1;
+        }
+    }
+    if (stacked > 0) emit(em, "addq $%d, %%rsp", 8 * (stacked + stacked % 2));
+    if (tail) {
+        emit(em, "jmp .L%d_ret", em->label_prefix);
+        if (em->current) {
+            join_kind(&em->current->return_kind, kind);
+            em->current->return_cells |= cells;
+        }
+    } else {
+        store(em, "%rax", in->result);
+        set_kind(em, in->result, kind);
+        if (cells) set_cells(em, in->result);
+    }
+}
+
+static void emit_instruction(Emitter *em, const Instruction *in) {
+    switch (in->opcode) {
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+        case IR_EQ: case IR_NE: case IR_LT: case IR_GT: case IR_LE: case IR_GE:
+        case IR_AND: case IR_OR: case IR_BIT_AND: case IR_BIT_OR: case IR_XOR:
+        case IR_SHL: case IR_SHR:
+            emit_binary(em, in);
+            break;
+        case IR_UNARY_MINUS: case IR_NOT: case IR_BIT_NOT:
+            emit_unary(em, in);
+            break;
+        case IR_ASSIGN: {
+            ValueKind kind = operand_kind(em, in->arg1);
+            int cells = points_to_cells(em, in->arg1);
+            if (in->result.type == OP_REGISTER && in->result.val.reg < NUM_HARDWARE_REGISTERS) {
+                load(em, in->arg1, location(em, in->result));
+            } else {
+                load(em, in->arg1, "%rax");
+                store(em, "%rax", in->result);
+            }
+            set_kind(em, in->result, kind);
+            if (cells) set_cells(em, in->result);
+            break;
+        }
+        case IR_ADDR: case IR_ADDR_OF: {
+            int cells = points_to_cells(em, in->arg1);
+            if (is_aggregate(em, in->arg1) || in->arg1.type != OP_IDENTIFIER) {
+                load(em, in->arg1, "%rax"); // An aggregate's name holds its address
+            } else {
+                emit(em, "leaq %s, %%rax", location(em, in->arg1));
+            }
+            store(em, "%rax", in->result);
+            set_kind(em, in->result, KIND_PTR);
+            if (cells) set_cells(em, in->result);
+            break;
+        }
+        case IR_DEREF: case IR_DEREF_LOAD:
+            load(em, in->arg1, "%rax");
+            emit(em, "movq (%%rax), %%rax");
+            store(em, "%rax", in->result);
+            set_kind(em, in->result, KIND_INT);
+            break;
+        case IR_DEREF_STORE:
+            load(em, in->result, "%rax");
+            load(em, in->arg1, "%rcx");
+            emit(em, "movq %%rcx, (%%rax)");
+            break;
+        case IR_INDEX_LOAD:
+            load(em, in->arg1, "%rax");
+            load(em, in->arg2, "%rcx");
+            emit(em, "movq (%%rax,%%rcx,%d), %%rax", CELL_SIZE);
+            store(em, "%rax", in->result);
+            set_kind(em, in->result, KIND_INT);
+            break;
+        case IR_INDEX_STORE:
+            load(em, in->result, "%rax");
+            load(em, in->arg1, "%rcx");
+            load(em, in->arg2, "%rdx");
+            emit(em, "movq %%rdx, (%%rax,%%rcx,%d)", CELL_SIZE);
+            break;
+        case IR_ALLOC_HEAP:
+            emit(em, "movq $%d, %%rdi", in->arg1.val.int_val);
+            emit(em, "movq $%d, %%rsi", CELL_SIZE);
+            emit(em, "call calloc@PLT");
+            store(em, "%rax", in->result);
+            set_kind(em, in->result, KIND_PTR);
+            set_cells(em, in->result);
+            break;
+        case IR_ALLOC_STACK:
+            emit(em, "leaq %d(%%rbp), %%rax", em->cell_base + CELL_SIZE * in->arg2.val.int_val);
+            store(em, "%rax", in->result);
+            set_kind(em, in->result, KIND_PTR);
+            set_cells(em, in->result);
+            break;
+        case IR_FREE_HEAP:
+            load(em, in->arg1, "%rdi");
+            emit(em, "call free@PLT");
+            break;
+        case IR_SPILL:
+            load(em, in->arg1, "%rax");
+            emit(em, "movq %%rax, %d(%%rbp)", em->cell_base + CELL_SIZE * in->result.val.int_val);
+            em->cell_kind[in->result.val.int_val] = operand_kind(em, in->arg1);
+            em->cell_cells[in->result.val.int_val] = points_to_cells(em, in->arg1);
+            break;
+        case IR_RELOAD:
+            emit(em, "movq %d(%%rbp), %%rax", em->cell_base + CELL_SIZE * in->arg1.val.int_val);
+            store(em, "%rax", in->result);
+            set_kind(em, in->result, em->cell_kind[in->arg1.val.int_val]);
+            if (em->cell_cells[in->arg1.val.int_val]) set_cells(em, in->result);
+            break;
+        case IR_GOTO:
+            emit(em, "jmp .L%d_%d", em->label_prefix, in->result.val.label);
+            break;
+        case IR_IF_FALSE_GOTO: case IR_IF_TRUE_GOTO:
+            load(em, in->arg1, "%rax");
+            if (operand_kind(em, in->arg1) == KIND_FLOAT) emit(em, "salq $1, %%rax");
+            emit(em, "testq %%rax, %%rax");
+            emit(em, "%s .L%d_%d", in->opcode == IR_IF_FALSE_GOTO ? "jz" : "jnz",
+                 em->label_prefix, in->result.val.label);
+            break;
+        case IR_JUMP_TABLE:
+            load(em, in->arg1, "%rax");
+            emit(em, "leaq .LJ%d_%d(%%rip), %%rcx", em->label_prefix, in->result.val.int_val);
+            emit(em, "movslq (%%rcx,%%rax,4), %%rax");
+            emit(em, "addq %%rcx, %%rax");
+            emit(em, "jmp *%%rax");
+            break;
+        case IR_PARAM:
+            load(em, in->arg1, "%rax");
+            emit(em, "movq %%rax, %d(%%rbp)", slot_offset(em->param_base + em->num_params_pending));
+            em->param_cells[em->num_params_pending] = points_to_cells(em, in->arg1);
+            em->param_kinds[em->num_params_pending++] = operand_kind(em, in->arg1);
+            break;
+        case IR_CALL: case IR_TAILCALL:
+            emit_call(em, in);
+            break;
+        case IR_RETURN:
+            load(em, in->arg1, "%rax");
+            if (em->current) {
+                join_kind(&em->current->return_kind, operand_kind(em, in->arg1));
+                em->current->return_cells |= points_to_cells(em, in->arg1);
+            }
+            emit(em, "jmp .L%d_ret", em->label_prefix);
+            break;
+        case IR_HALT:
+            load(em, in->arg1, "%rdi");
+            emit(em, "call exit@PLT");
+            break;
+        case IR_LABEL:
+            emit_label(em, in->result.val.label);
+            break;
+        default:
+            break;
+    }
+}
+
+/* --- Functions --- */
+
+// The operands of an instruction that are values in slots or registers.
+static int value_operands(const Instruction *in, Operand *ops) {
+    switch (in->opcode) {
+        case IR_CALL: case IR_TAILCALL: case IR_ALLOC_HEAP: case IR_ALLOC_STACK: case IR_RELOAD:
+            ops[0] = in->result;
+            return 1;
+        case IR_SPILL: case IR_JUMP_TABLE:
+        case IR_GOTO: case IR_IF_FALSE_GOTO: case IR_IF_TRUE_GOTO: case IR_LABEL:
+            ops[0] = in->arg1;
+            return 1;
+        default:
+            ops[0] = in->result;
+            ops[1] = in->arg1;
+            ops[2] = in->arg2;
+            return 3;
+    }
+}
+
+static void assign_slot(Emitter *em, Operand op, int *next) {
+    if (op.type == OP_TEMPORARY && em->temp_stamp[op.val.temp] != em->stamp) {
+        em->temp_stamp[op.val.temp] = em->stamp;
+        em->temp_slot[op.val.temp] = (*next)++;
+    } else if (is_local_name(em, op) && em->name_stamp[op.val.name] != em->stamp) {
+        em->name_stamp[op.val.name] = em->stamp;
+        em->name_slot[op.val.name] = (*next)++;
+    } else if (op.type == OP_REGISTER && op.val.reg >= em->num_registers) {
+        em->num_registers = op.val.reg + 1;
+    }
+}
+
+// Emits one function; 'index' is -1 for the global initializers.
+static void emit_function(Emitter *em, const IRFunction *fn, int index) {
+    em->stamp++;
+    em->fn = fn;
+    em->current = index >= 0 ? &em->info[index] : NULL;
+    em->label_prefix = index + 1;
+    em->num_registers = 0;
+
+    // Slots: variables and temporaries, ARGn, registers beyond the
+    // hardware ones, then the pending PARAMs.
+    int next = 0, num_params = 0, depth = 0, max_depth = 0;
+    for (int i = 0; i < fn->num_instrs; i++) {
+        const Instruction *in = &fn->instrs[i];
+        Operand ops[3];
+        int count = value_operands(in, ops);
+        for (int k = 0; k < count; k++) {
+            int param = ops[k].type == OP_IDENTIFIER ? ir_param_index(ops[k].val.name) : -1;
+            if (param >= num_params) num_params = param + 1;
+            assign_slot(em, ops[k], &next);
+        }
+        if ((in->opcode == IR_ALLOC_HEAP || in->opcode == IR_ALLOC_STACK) && in->result.type == OP_IDENTIFIER) {
+            em->aggregate_stamp[in->result.val.name] = em->stamp;
+        }
+        if (in->opcode == IR_PARAM && ++depth > max_depth) max_depth = depth;
+        if (in->opcode == IR_CALL || in->opcode == IR_TAILCALL) depth -= in->arg2.val.int_val;
+        if (depth < 0) depth = 0;
+    }
+    if (em->current && num_params > em->current->num_params) {
+        em->current->arg_kinds = (char*) checked_realloc(em->current->arg_kinds, num_params, 1);
+        memset(em->current->arg_kinds + em->current->num_params, KIND_INT, num_params - em->current->num_params);
+        em->current->arg_cells = (char*) checked_realloc(em->current->arg_cells, num_params, 1);
+        memset(em->current->arg_cells + em->current->num_params, 0, num_params - em->current->num_params);
+        em->current->num_params = num_params;
+    }
+    em->arg_base = next;
+    em->reg_base = em->arg_base + num_params;
+    em->param_base = em->reg_base + (em->num_registers > NUM_HARDWARE_REGISTERS ? em->num_registers - NUM_HARDWARE_REGISTERS : 0);
+    em->num_slots = em->param_base + max_depth;
+    em->cell_base = -(SAVED_BYTES + 8 * em->num_slots + CELL_SIZE * fn->frame_size);
+    int locals = 8 * em->num_slots + CELL_SIZE * fn->frame_size;
+    if ((SAVED_BYTES + locals) % 16) locals += 8;
+    em->reg_kind = (char*) checked_calloc(em->num_registers, sizeof(char));
+    em->reg_cells = (char*) checked_calloc(em->num_registers, sizeof(char));
+    em->cell_kind = (char*) checked_calloc(fn->frame_size, sizeof(char));
+    em->cell_cells = (char*) checked_calloc(fn->frame_size, sizeof(char));
+    em->param_kinds = (char*) checked_calloc(max_depth, sizeof(char));
+    em->param_cells = (char*) checked_calloc(max_depth, sizeof(char));
+    em->num_params_pending = 0;
+
+    if (em->fp) {
+        fprintf(em->fp, "\n\t.text\n\t.p2align 4\n");
+        if (index >= 0) {
+            const char *name = string_from_id(fn->name);
+            fprintf(em->fp, "\t.globl %s\n\t.type %s, @function\n%s:\n", name, name, name);
+        } else {
+            fprintf(em->fp, ".Lglobals:\n");
+        }
+    }
+    emit(em, "pushq %%rbp");
+    emit(em, "movq %%rsp, %%rbp");
+    for (int r = 0; r < NUM_HARDWARE_REGISTERS; r++) emit(em, "pushq %s", hardware_registers[r]);
+    if (locals > 0) emit(em, "subq $%d, %%rsp", locals);
+    for (int n = 0; n < num_params; n++) {
+        if (n < NUM_ARGUMENT_REGISTERS) {
+            emit(em, "movq %s, %d(%%rbp)", argument_registers[n], slot_offset(em->arg_base + n));
+        } else {
+            emit(em, "movq %d(%%rbp), %%rax", 16 + 8 * (n - NUM_ARGUMENT_REGISTERS));
+            emit(em, "movq %%rax, %d(%%rbp)", slot_offset(em->arg_base + n));
+        }
+    }
+    for (int i = 0; i < fn->num_instrs; i++) emit_instruction(em, &fn->instrs[i]);
+    emit(em, "xorl %%eax, %%eax"); // Falling off the end returns 0
+    if (em->fp) fprintf(em->fp, ".L%d_ret:\n", em->label_prefix);
+    emit_epilogue(em);
+    emit(em, "ret");
+    if (em->fp && index >= 0) {
+        const char *name = string_from_id(fn->name);
+        fprintf(em->fp, "\t.size %s, .-%s\n", name, name);
+    }
+
+    // Jump tables hold offsets from the table, so they need no relocation.
+    for (int i = 0; em->fp && i < fn->num_instrs; i++) {
+        if (fn->instrs[i].opcode != IR_JUMP_TABLE) continue;
+        int number = fn->instrs[i].result.val.int_val;
+        const JumpTable *table = &em->module->jump_tables[number];
+        fprintf(em->fp, "\t.section .rodata\n\t.p2align 2\n.LJ%d_%d:\n", em->label_prefix, number);
+        for (int l = 0; l < table->num_labels; l++) {
+            fprintf(em->fp, "\t.long .L%d_%d-.LJ%d_%d\n", em->label_prefix, table->labels[l], em->label_prefix, number);
+        }
+        fprintf(em->fp, "\t.text\n");
+    }
+    free(em->reg_kind);
+    free(em->reg_cells);
+    free(em->cell_kind);
+    free(em->cell_cells);
+    free(em->param_kinds);
+    free(em->param_cells);
+}
+
+int emit_x86_64(FILE *fp, const IRModule *module) {
+    Emitter em;
+    memset(&em, 0, sizeof(em));
+    em.module = module;
+    em.num_names = string_pool_size();
+    em.info = (FunctionInfo*) checked_calloc(module->num_functions, sizeof(FunctionInfo));
+    em.function_of = (int*) checked_calloc(em.num_names, sizeof(int));
+    em.is_global = (char*) checked_calloc(em.num_names, sizeof(char));
+    em.global_aggregate = (char*) checked_calloc(em.num_names, sizeof(char));
+    em.global_kind = (char*) checked_calloc(em.num_names, sizeof(char));
+    em.used_string = (char*) checked_calloc(em.num_names, sizeof(char));
+    em.name_slot = (int*) checked_calloc(em.num_names, sizeof(int));
+    em.name_stamp = (int*) checked_calloc(em.num_names, sizeof(int));
+    em.name_kind = (char*) checked_calloc(em.num_names, sizeof(char));
+    em.name_kind_stamp = (int*) checked_calloc(em.num_names, sizeof(int));
+    em.name_cells = (char*) checked_calloc(em.num_names, sizeof(char));
+    em.aggregate_stamp = (int*) checked_calloc(em.num_names, sizeof(int));
+    em.temp_slot = (int*) checked_calloc(module->num_temps, sizeof(int));
+    em.temp_stamp = (int*) checked_calloc(module->num_temps, sizeof(int));
+    em.temp_kind = (char*) checked_calloc(module->num_temps, sizeof(char));
+    em.temp_kind_stamp = (int*) checked_calloc(module->num_temps, sizeof(int));
+    em.temp_cells = (char*) checked_calloc(module->num_temps, sizeof(char));
+    memset(em.function_of, -1, em.num_names * sizeof(int));
+    for (int f = 0; f < module->num_functions; f++) em.function_of[module->functions[f].name] = f;
+    for (int i = 0; i < module->globals.num_instrs; i++) {
+        const Instruction *in = &module->globals.instrs[i];
+        if (!ir_defines_result(in->opcode) || in->result.type != OP_IDENTIFIER) continue;
+        em.is_global[in->result.val.name] = 1;
+        if (in->opcode == IR_ALLOC_HEAP) em.global_aggregate[in->result.val.name] = 1;
+    }
+
+    // The dry passes settle the kinds of arguments and return values.
+    for (int pass = 0; pass <= KIND_PASSES; pass++) {
+        em.fp = pass == KIND_PASSES ? fp : NULL;
+        if (em.fp) fprintf(fp, "\t.file \"3ac\"\n");
+        emit_function(&em, &module->globals, -1);
+        for (int f = 0; f < module->num_functions; f++) emit_function(&em, &module->functions[f], f);
+    }
+
+    fprintf(fp, "\n\t.section .init_array,\"aw\"\n\t.p2align 3\n\t.quad .Lglobals\n");
+    fprintf(fp, "\n\t.bss\n");
+    for (int name = 0; name < em.num_names; name++) {
+        if (em.is_global[name]) fprintf(fp, "\t.local %s\n\t.comm %s, 8, 8\n", string_from_id(name), string_from_id(name));
+    }
+    fprintf(fp, "\n\t.section .rodata\n");
+    for (int i = 0; i < module->num_float_consts; i++) {
+        long long bits;
+        memcpy(&bits, &module->float_consts[i], sizeof(bits));
+        fprintf(fp, "\t.p2align 3\n.LF%d:\n\t.quad %lld\n", i, bits);
+    }
+    for (int name = 0; name < em.num_names; name++) {
+        // Literals keep their source escapes, which as understands.
+        if (em.used_string[name]) fprintf(fp, ".LS%d:\n\t.string \"%s\"\n", name, string_from_id(name));
+    }
+    fprintf(fp, "\t.section .note.GNU-stack,\"\",@progbits\n");
+
+    for (int f = 0; f < module->num_functions; f++) {
+        free(em.info[f].arg_kinds);
+        free(em.info[f].arg_cells);
+    }
+    free(em.info);
+    free(em.function_of);
+    free(em.is_global);
+    free(em.global_aggregate);
+    free(em.global_kind);
+    free(em.used_string);
+    free(em.name_slot);
+    free(em.name_stamp);
+    free(em.name_kind);
+    free(em.name_kind_stamp);
+    free(em.name_cells);
+    free(em.aggregate_stamp);
+    free(em.temp_slot);
+    free(em.temp_stamp);
+    free(em.temp_kind);
+    free(em.temp_kind_stamp);
+    free(em.temp_cells);
+    return em.num_errors;
+}
@@ -0,0 +1,36 @@
+#ifndef X86_64_H
+#define X86_64_H
+
+#include <stdio.h>
+#include "ir.h"
+
+/*
+ * Native backend: lowers a module's 3AC to System V x86-64 assembly for GNU
+ * as. The output links with the C library ('gcc prog.s -o prog').
+ *
+ * Every value is 64 bits wide and memory follows the virtual machine's
+ * model (see vm.h): each byte offset of the IR addresses an 8-byte cell, so
+ * an aggregate of n bytes takes n cells and 'INDEX_LOAD t, base, off' reads
+ * the cell at base + 8 * off. Calls to malloc and calloc are scaled to
+ * match. No other library function can read or write cells, so passing one
+ * the address of an array or struct is reported as an error. The IR carries no types; a forward pass over each function infers
+ * which values are floating-point (from float constants, through copies,
+ * arithmetic, arguments and return values) or pointers (from allocations
+ * and ADDR_OF). Floating-point values travel as bit patterns in integer
+ * registers and only enter SSE registers to be computed with or passed to
+ * a library function.
+ *
+ * Variables, temporaries and ARGn live in the activation's stack slots.
+ * After register allocation (see regalloc.h), registers r0 .. r4 are
+ * mapped onto the callee-saved %rbx, %r12 .. %r15 and the rest onto stack
+ * slots. Calls between functions of the module pass every argument in
+ * integer registers; calls into the library follow the full convention.
+ * The global initializers run from .init_array, before main.
+ */
+
+// Writes the assembly for the whole module, which must be linear. Returns
+// the number of errors reported, each a call that hands the library an
+// aggregate's cells; the assembly is then not usable.
+int emit_x86_64(FILE *fp, const IRModule *module);
+
+#endif // X86_64_H